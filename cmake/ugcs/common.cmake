@@ -45,7 +45,9 @@ if(NOT CMAKE_BUILD_TYPE MATCHES "RELEASE")
 endif()
 
 if (CMAKE_SYSTEM_NAME MATCHES "Linux")
-    set(VSM_PLAT_LIBS rt)
+    set(VSM_PLAT_LIBS rt z)
+elseif (CMAKE_SYSTEM_NAME MATCHES "Darwin")
+    set(VSM_PLAT_LIBS z)
 elseif (CMAKE_SYSTEM_NAME MATCHES "Windows")
     set(VSM_PLAT_LIBS ws2_32 Userenv bfd iberty dbghelp z iphlpapi)
 endif()
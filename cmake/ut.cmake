@@ -62,3 +62,14 @@ add_executable(hello_world_vsm ${CMAKE_SOURCE_DIR}/../../doc/examples/Hello_worl
 target_link_libraries(hello_world_vsm ${EXT_LIB})
 
 include(ugcs/ut)
+
+# Coroutine adapters require C++20 while the SDK is built as C++14, so their
+# test is built separately when the compiler supports it.
+include(CheckCXXCompilerFlag)
+check_cxx_compiler_flag(-std=c++20 COMPILER_SUPPORTS_CXX20)
+if (COMPILER_SUPPORTS_CXX20)
+    add_executable(ut_coroutine cxx20/ut_coroutine.cpp main.cpp ${DLL_IMPORT_LIBS})
+    set_target_properties(ut_coroutine PROPERTIES COMPILE_FLAGS -std=c++20)
+    target_link_libraries(ut_coroutine unittestpp ${EXT_LIB} ${VSM_PLAT_LIBS})
+    add_test(coroutine ${EXT_TOOL} ./ut_coroutine)
+endif()
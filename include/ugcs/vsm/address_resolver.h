@@ -0,0 +1,171 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/**
+ * @file address_resolver.h
+ *
+ * Asynchronous host name resolution with caching.
+ */
+
+#ifndef _UGCS_VSM_ADDRESS_RESOLVER_H_
+#define _UGCS_VSM_ADDRESS_RESOLVER_H_
+
+#include <ugcs/vsm/request_worker.h>
+#include <ugcs/vsm/operation_waiter.h>
+#include <ugcs/vsm/sockets.h>
+#include <ugcs/vsm/clock.h>
+
+#include <unordered_map>
+#include <vector>
+
+namespace ugcs {
+namespace vsm {
+
+/** Immutable result of getaddrinfo() call. Entries own their socket
+ * addresses, so they are valid as long as this object exists.
+ */
+class Resolved_addresses: public std::enable_shared_from_this<Resolved_addresses> {
+    DEFINE_COMMON_CLASS(Resolved_addresses, Resolved_addresses)
+
+public:
+    /** Construct from getaddrinfo() results.
+     *
+     * @param error Return code of getaddrinfo(), zero on success.
+     * @param result Result list, can be nullptr.
+     */
+    Resolved_addresses(int error, const addrinfo *result);
+
+    /** Get getaddrinfo() return code, zero on success. */
+    int
+    Get_error() const
+    {
+        return error;
+    }
+
+    /** Check if resolution succeeded and returned at least one address. */
+    bool
+    Is_ok() const
+    {
+        return !error && !entries.empty();
+    }
+
+    /** Resolved addresses. Entries are not chained by ai_next and have no
+     * canonical name.
+     */
+    const std::vector<addrinfo> &
+    Get_entries() const
+    {
+        return entries;
+    }
+
+private:
+    int error;
+    std::vector<addrinfo> entries;
+    std::vector<sockaddr_storage> addresses;
+};
+
+/** Resolves host names in a small pool of threads, so blocking getaddrinfo()
+ * calls do not stall I/O threads. Results are cached for a limited time,
+ * failures are cached as well but for a shorter time. Numeric addresses are
+ * resolved immediately in the calling thread without cache.
+ */
+class Address_resolver: public std::enable_shared_from_this<Address_resolver> {
+    DEFINE_COMMON_CLASS(Address_resolver, Address_resolver)
+
+public:
+    /** Resolution completion handler. */
+    typedef Callback_proxy<void, Resolved_addresses::Ptr> Handler;
+
+    /** Construct resolver.
+     *
+     * @param threads_count Number of resolving threads.
+     * @param positive_ttl Time to keep successful results.
+     * @param negative_ttl Time to keep failures.
+     */
+    Address_resolver(
+        size_t threads_count = DEFAULT_THREADS_COUNT,
+        std::chrono::milliseconds positive_ttl = DEFAULT_POSITIVE_TTL,
+        std::chrono::milliseconds negative_ttl = DEFAULT_NEGATIVE_TTL);
+
+    /** Start resolving threads. */
+    void
+    Enable();
+
+    /** Stop resolving threads. Pending resolutions are aborted. */
+    void
+    Disable();
+
+    /** Resolve address without blocking. Succeeds for numeric addresses and
+     * for names which are present in the cache.
+     *
+     * @return Result or nullptr if the name should be resolved with
+     *      Resolve().
+     */
+    Resolved_addresses::Ptr
+    Resolve_immediately(const std::string &host, const std::string &service,
+                        const addrinfo &hints);
+
+    /** Resolve address asynchronously. The handler is always invoked in the
+     * specified completion context, even if the result is available
+     * immediately.
+     */
+    Operation_waiter
+    Resolve(const std::string &host, const std::string &service,
+            const addrinfo &hints, Handler handler,
+            Request_completion_context::Ptr completion_ctx);
+
+    /** Drop all cached results. */
+    void
+    Clear_cache();
+
+private:
+    /** Cache entry. */
+    struct Cache_entry {
+        Resolved_addresses::Ptr addresses;
+        Clock::Time_point expires;
+    };
+
+    static constexpr size_t DEFAULT_THREADS_COUNT = 2;
+    static constexpr std::chrono::milliseconds DEFAULT_POSITIVE_TTL =
+        std::chrono::milliseconds(60000);
+    static constexpr std::chrono::milliseconds DEFAULT_NEGATIVE_TTL =
+        std::chrono::milliseconds(5000);
+    /** Cache is purged from expired entries when grows above this size. */
+    static constexpr size_t MAX_CACHE_SIZE = 1024;
+
+    Request_worker::Ptr worker;
+    std::chrono::milliseconds positive_ttl;
+    std::chrono::milliseconds negative_ttl;
+
+    /** Protects the cache. */
+    std::mutex cache_mutex;
+    std::unordered_map<std::string, Cache_entry> cache;
+
+    static std::string
+    Make_key(const std::string &host, const std::string &service,
+             const addrinfo &hints);
+
+    /** Resolve numeric host without DNS queries.
+     * @return nullptr if the host is not numeric.
+     */
+    static Resolved_addresses::Ptr
+    Resolve_numeric(const std::string &host, const std::string &service,
+                    const addrinfo &hints);
+
+    Resolved_addresses::Ptr
+    Lookup_cache(const std::string &key);
+
+    void
+    Store_cache(const std::string &key, Resolved_addresses::Ptr addresses);
+
+    /** Processing handler of resolution request, executes in pool thread. */
+    void
+    On_resolve(Request::Ptr request, std::string host, std::string service,
+               addrinfo hints, Handler handler);
+};
+
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* _UGCS_VSM_ADDRESS_RESOLVER_H_ */
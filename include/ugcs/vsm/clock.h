@@ -0,0 +1,190 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/**
+ * @file clock.h
+ *
+ * Pluggable time source for timers and timeouts.
+ */
+
+#ifndef _UGCS_VSM_CLOCK_H_
+#define _UGCS_VSM_CLOCK_H_
+
+#include <ugcs/vsm/callback.h>
+#include <ugcs/vsm/utils.h>
+
+#include <chrono>
+#include <map>
+#include <mutex>
+
+namespace ugcs {
+namespace vsm {
+
+/** Monotonic time source used by the timer processor and all timeout logic
+ * built on top of it. By default the system steady clock is used. Another
+ * clock (typically Virtual_clock) can be installed with Set_current() in
+ * order to run timer driven logic deterministically or faster than real
+ * time. The clock should be installed before any timers are created, i.e.
+ * before the SDK is initialized.
+ */
+class Clock: public std::enable_shared_from_this<Clock> {
+    DEFINE_COMMON_CLASS(Clock, Clock)
+
+public:
+    /** Clock time point. Same type as the steady clock uses, so the code
+     * which stores time points does not depend on the clock selected.
+     */
+    typedef std::chrono::steady_clock::time_point Time_point;
+
+    /** Clock duration. */
+    typedef std::chrono::steady_clock::duration Duration;
+
+    /** Handler invoked when clock time changes not by itself, e.g. virtual
+     * time is advanced.
+     */
+    typedef Callback_proxy<void> Change_handler;
+
+    virtual
+    ~Clock() = default;
+
+    /** Get current time of this clock. */
+    virtual Time_point
+    Get_time() = 0;
+
+    /** Check if the clock time flows by itself in real time. If not, the
+     * time changes only via explicit calls and the change handlers are
+     * invoked then.
+     */
+    virtual bool
+    Is_real_time()
+    {
+        return true;
+    }
+
+    /** Called by timer processor when it has nothing to do until the
+     * specified time.
+     *
+     * @param next_time Time of the nearest timer.
+     * @return true if clock time was moved so the timers should be checked
+     *      again, false if the timer processor should wait.
+     */
+    virtual bool
+    On_idle(Time_point next_time);
+
+    /** Register handler for clock time changes.
+     *
+     * @return Handler identifier for Remove_change_handler().
+     */
+    int
+    Add_change_handler(Change_handler handler);
+
+    /** Remove previously registered change handler. */
+    void
+    Remove_change_handler(int id);
+
+    /** Get currently installed clock.
+     *
+     * @return Clock instance, nullptr if system steady clock is used.
+     */
+    static Ptr
+    Get_current();
+
+    /** Install the clock to use. nullptr restores system steady clock. */
+    static void
+    Set_current(Ptr clock);
+
+    /** Get current time of the currently installed clock. */
+    static Time_point
+    Now();
+
+protected:
+    /** Invoke all registered change handlers. Should not be called with any
+     * clock internal locks held.
+     */
+    void
+    Notify_changed();
+
+private:
+    /** Currently installed clock. */
+    static Ptr current;
+
+    /** Protects change handlers. */
+    std::mutex handlers_mutex;
+
+    /** Registered change handlers. */
+    std::map<int, Change_handler> handlers;
+
+    /** Identifier for the next registered handler. */
+    int next_handler_id = 1;
+};
+
+/** Clock which time is changed only explicitly. Can be advanced manually (e.g.
+ * from unit tests) or, in free running mode, it jumps directly to the nearest
+ * timer each time the timer processor becomes idle, so replayed sessions run
+ * as fast as possible.
+ */
+class Virtual_clock: public Clock {
+    DEFINE_COMMON_CLASS(Virtual_clock, Clock)
+
+public:
+    /** Construct virtual clock.
+     *
+     * @param start_time Initial time. Default is the current steady clock
+     *      time, so time points taken before the clock was installed remain
+     *      comparable.
+     */
+    Virtual_clock(Time_point start_time = std::chrono::steady_clock::now());
+
+    virtual Time_point
+    Get_time() override;
+
+    virtual bool
+    Is_real_time() override
+    {
+        return false;
+    }
+
+    virtual bool
+    On_idle(Time_point next_time) override;
+
+    /** Move time forward by the specified duration. Timers which become
+     * expired are fired.
+     */
+    void
+    Advance(Duration duration);
+
+    /** Set current time.
+     *
+     * @throw Invalid_param_exception if the time is in the past.
+     */
+    void
+    Set_time(Time_point time);
+
+    /** Enable or disable free running mode. In free running mode time jumps
+     * to the nearest timer when the timer processor has no pending requests.
+     * Handlers of fired timers run in their own contexts, and the time can be
+     * moved before they complete.
+     */
+    void
+    Set_free_running(bool enable);
+
+    /** Check if free running mode is enabled. */
+    bool
+    Is_free_running();
+
+private:
+    /** Protects time and mode. */
+    std::mutex mutex;
+
+    /** Current time. */
+    Time_point time;
+
+    /** Free running mode enabled. */
+    bool free_running = false;
+};
+
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* _UGCS_VSM_CLOCK_H_ */
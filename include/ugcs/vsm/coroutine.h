@@ -0,0 +1,704 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/**
+ * @file coroutine.h
+ *
+ * Coroutine adapters for asynchronous SDK operations. Allows writing
+ * sequential code like
+ * @code
+ * Async_task
+ * Reader::Run()
+ * {
+ *     while (true) {
+ *         auto read = co_await Async_read(stream, 1024, 1, completion_ctx);
+ *         if (read.result != Io_result::OK) {
+ *             break;
+ *         }
+ *         ...
+ *     }
+ * }
+ * @endcode
+ * instead of chains of completion handlers. Coroutines are resumed in the
+ * completion context passed to the awaited operation. If the operation is
+ * abandoned without completion, the coroutine is resumed in that context with
+ * an error result instead, or its frame is destroyed if the context is
+ * disabled, so the frame is always released.
+ *
+ * The SDK itself is built as C++14, so this header is available only when
+ * the application which includes it is compiled with C++20 coroutines
+ * support. It is header-only and does not require rebuilding the SDK.
+ */
+
+#ifndef _UGCS_VSM_COROUTINE_H_
+#define _UGCS_VSM_COROUTINE_H_
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <ugcs/vsm/io_stream.h>
+#include <ugcs/vsm/timer_processor.h>
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+
+namespace ugcs {
+namespace vsm {
+
+namespace internal {
+
+/** Thread local pool of coroutine frames. Frames are allocated from fixed size
+ * classes and cached on release, so frequently started coroutines do not hit
+ * the heap. A frame can be released in another thread than it was allocated
+ * in, then it just migrates to that thread's cache.
+ */
+class Coroutine_frame_pool {
+public:
+    /** Allocate memory for a frame of the given size. */
+    static void *
+    Allocate(size_t size)
+    {
+        size_t bucket = Get_bucket(size);
+        if (bucket >= BUCKETS_COUNT) {
+            return ::operator new(size);
+        }
+        auto &cache = Get_cache();
+        Free_block *block = cache.head[bucket];
+        if (block) {
+            cache.head[bucket] = block->next;
+            cache.count[bucket]--;
+            return block;
+        }
+        return ::operator new((bucket + 1) * GRANULARITY);
+    }
+
+    /** Release memory previously returned by Allocate() for the same size. */
+    static void
+    Deallocate(void *ptr, size_t size)
+    {
+        size_t bucket = Get_bucket(size);
+        if (bucket >= BUCKETS_COUNT) {
+            ::operator delete(ptr);
+            return;
+        }
+        auto &cache = Get_cache();
+        if (cache.count[bucket] >= MAX_CACHED_BLOCKS) {
+            ::operator delete(ptr);
+            return;
+        }
+        auto block = static_cast<Free_block *>(ptr);
+        block->next = cache.head[bucket];
+        cache.head[bucket] = block;
+        cache.count[bucket]++;
+    }
+
+private:
+    /** Size class step. */
+    static constexpr size_t GRANULARITY = 64;
+    /** Number of size classes, larger frames are not pooled. */
+    static constexpr size_t BUCKETS_COUNT = 16;
+    /** Maximal number of cached frames per size class and thread. */
+    static constexpr size_t MAX_CACHED_BLOCKS = 256;
+
+    struct Free_block {
+        Free_block *next;
+    };
+
+    struct Cache {
+        Free_block *head[BUCKETS_COUNT] = {};
+        size_t count[BUCKETS_COUNT] = {};
+
+        ~Cache()
+        {
+            for (auto block : head) {
+                while (block) {
+                    auto next = block->next;
+                    ::operator delete(block);
+                    block = next;
+                }
+            }
+        }
+    };
+
+    static size_t
+    Get_bucket(size_t size)
+    {
+        return size ? (size - 1) / GRANULARITY : 0;
+    }
+
+    static Cache &
+    Get_cache()
+    {
+        thread_local Cache cache;
+        return cache;
+    }
+};
+
+} /* namespace internal */
+
+/** Return type of fire-and-forget coroutines. The coroutine starts executing
+ * immediately in the calling thread and runs till the first suspension point.
+ * The frame is destroyed automatically when the coroutine finishes. Exception
+ * escaping the coroutine finishes it as well, the exception is logged and can
+ * be retrieved by Get_exception(). The returned object can be dropped if the
+ * caller is not interested in the outcome.
+ */
+class Async_task {
+public:
+    /** Coroutine promise. */
+    struct promise_type {
+        promise_type():
+            state(std::make_shared<State>())
+        {
+        }
+
+        /** Frame is destroyed either after the coroutine finishes or when
+         * the coroutine is destroyed explicitly.
+         */
+        ~promise_type()
+        {
+            state->done = true;
+        }
+
+        Async_task
+        get_return_object() noexcept
+        {
+            return Async_task(state);
+        }
+
+        std::suspend_never
+        initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never
+        final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void
+        return_void() noexcept
+        {
+        }
+
+        void
+        unhandled_exception() noexcept
+        {
+            state->exception = std::current_exception();
+            try {
+                throw;
+            } catch (const std::exception &e) {
+                LOG_ERR("Unhandled exception in coroutine: %s", e.what());
+            } catch (...) {
+                LOG_ERR("Unhandled exception in coroutine");
+            }
+        }
+
+        static void *
+        operator new(size_t size)
+        {
+            return internal::Coroutine_frame_pool::Allocate(size);
+        }
+
+        static void
+        operator delete(void *ptr, size_t size)
+        {
+            internal::Coroutine_frame_pool::Deallocate(ptr, size);
+        }
+
+    private:
+        friend class Async_task;
+
+        /** State shared between the promise and the task object. */
+        struct State {
+            /** Exception escaped the coroutine, if any. */
+            std::exception_ptr exception;
+            /** Set when the coroutine frame is destroyed. */
+            std::atomic<bool> done = { false };
+        };
+
+        std::shared_ptr<State> state;
+    };
+
+    /** Check if the coroutine has finished and its frame is destroyed. */
+    bool
+    Is_done() const
+    {
+        return state && state->done;
+    }
+
+    /** Get exception escaped the coroutine, nullptr if none. Valid only
+     * after the coroutine is done.
+     */
+    std::exception_ptr
+    Get_exception() const
+    {
+        return Is_done() ? state->exception : nullptr;
+    }
+
+private:
+    explicit Async_task(std::shared_ptr<promise_type::State> state):
+        state(std::move(state))
+    {
+    }
+
+    std::shared_ptr<promise_type::State> state;
+};
+
+namespace internal {
+
+/** Check that the context is suitable for resuming a coroutine. Temporal
+ * contexts are processed synchronously by the waiter destructor, which would
+ * resume the coroutine while it is still being suspended.
+ */
+inline void
+Check_resume_context(const Request_completion_context::Ptr &ctx)
+{
+    if (!ctx) {
+        VSM_EXCEPTION(Invalid_param_exception, "Completion context not specified");
+    }
+    if (ctx->Check_type(Request_container::Type::TEMPORAL)) {
+        VSM_EXCEPTION(Invalid_param_exception,
+                      "Temporal completion context cannot resume coroutine");
+    }
+}
+
+/** Owns a suspended coroutine until it is resumed. If released without
+ * resuming, the coroutine frame is destroyed instead, so it does not leak.
+ */
+class Coroutine_frame_ref {
+public:
+    explicit Coroutine_frame_ref(std::coroutine_handle<> handle):
+        handle(handle)
+    {
+    }
+
+    Coroutine_frame_ref(Coroutine_frame_ref &&other):
+        handle(other.handle)
+    {
+        other.handle = nullptr;
+    }
+
+    Coroutine_frame_ref(const Coroutine_frame_ref &) = delete;
+
+    ~Coroutine_frame_ref()
+    {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    /** Resume the coroutine, the reference is empty after that. */
+    void
+    Resume()
+    {
+        auto resumed = handle;
+        handle = nullptr;
+        resumed.resume();
+    }
+
+private:
+    std::coroutine_handle<> handle;
+};
+
+/** Resume the coroutine from the completion context. If the context is
+ * disabled, or the request is dropped or aborted by the context, the
+ * coroutine frame is destroyed without resuming.
+ */
+inline void
+Post_resume(std::coroutine_handle<> handle, const Request_completion_context::Ptr &ctx)
+{
+    Coroutine_frame_ref frame(handle);
+    if (!ctx->Is_enabled()) {
+        return;
+    }
+    auto request = Request::Create();
+    request->Set_processing_handler(
+            Make_callback([](Request::Ptr r) {
+                r->Complete();
+            }, request));
+    request->Set_completion_handler(ctx, Make_callback(
+        [frame = std::move(frame)]() mutable
+        {
+            frame.Resume();
+        }));
+    request->Process(true);
+}
+
+/** Resume state of a coroutine suspended on an asynchronous operation. It is
+ * a member of the awaiter, i.e. it lives in the coroutine frame, so awaiting
+ * allocates nothing besides the operation handler and request.
+ *
+ * The operation handler owns a Handler_ref. When the handler is invoked, it
+ * resumes the coroutine in place, which is the completion context. If the
+ * handler is released without being invoked, e.g. the request is aborted or
+ * the timer is cancelled, the coroutine is resumed with the error result.
+ * This can happen in an arbitrary thread with its locks held, so the resume
+ * is posted to the completion context.
+ */
+template <typename Result>
+class Coroutine_resumer {
+public:
+    /** Reference to the resumer held by the operation handler. Move only,
+     * the last owner resumes the coroutine.
+     */
+    class Handler_ref {
+    public:
+        explicit Handler_ref(Coroutine_resumer *resumer):
+            resumer(resumer)
+        {
+        }
+
+        Handler_ref(Handler_ref &&other):
+            resumer(other.resumer)
+        {
+            other.resumer = nullptr;
+        }
+
+        Handler_ref(const Handler_ref &) = delete;
+
+        ~Handler_ref()
+        {
+            if (resumer) {
+                resumer->Complete(std::move(resumer->error), false);
+            }
+        }
+
+        /** Resume with the operation result. */
+        void
+        Resume(Result value)
+        {
+            auto completed = resumer;
+            resumer = nullptr;
+            completed->Complete(std::move(value), true);
+        }
+
+    private:
+        Coroutine_resumer *resumer;
+    };
+
+    /** @param error Result to resume with if the handler is never invoked.
+     * @param ctx Completion context to resume the coroutine in.
+     */
+    Coroutine_resumer(Result error, Request_completion_context::Ptr ctx):
+        result(error), error(std::move(error)), ctx(std::move(ctx))
+    {
+    }
+
+    Coroutine_resumer(const Coroutine_resumer &) = delete;
+
+    /** Get reference for the operation handler. Called before the operation
+     * is started.
+     */
+    Handler_ref
+    Suspend(std::coroutine_handle<> handle)
+    {
+        this->handle = handle;
+        return Handler_ref(this);
+    }
+
+    /** Called after the operation is started. If the handler is done before
+     * that, the coroutine could not be resumed in place, so it is posted to
+     * the completion context. If starting the operation throws, this is not
+     * called, and the exception resumes the coroutine instead.
+     */
+    void
+    Arm()
+    {
+        int expected = SUSPENDING;
+        if (!state.compare_exchange_strong(expected, ARMED)) {
+            Post_resume(handle, ctx);
+        }
+    }
+
+    /** Get the operation result. */
+    Result &
+    Get_result()
+    {
+        return result;
+    }
+
+private:
+    enum {
+        /** Operation is being started. */
+        SUSPENDING,
+        /** Operation is started, the handler resumes the coroutine. */
+        ARMED,
+        /** Handler is done before the operation start returned. */
+        DONE
+    };
+
+    std::coroutine_handle<> handle;
+    Result result;
+    Result error;
+    Request_completion_context::Ptr ctx;
+    std::atomic<int> state = { SUSPENDING };
+
+    void
+    Complete(Result value, bool invoked)
+    {
+        result = std::move(value);
+        int expected = SUSPENDING;
+        if (state.compare_exchange_strong(expected, DONE)) {
+            return;
+        }
+        if (invoked) {
+            handle.resume();
+        } else {
+            Post_resume(handle, ctx);
+        }
+    }
+};
+
+} /* namespace internal */
+
+/** Result of awaited read operation. */
+struct Async_read_result {
+    /** Data read, can be nullptr on failure. */
+    Io_buffer::Ptr buffer;
+    /** Operation result. */
+    Io_result result = Io_result::OTHER_FAILURE;
+};
+
+/** Awaitable stream read. @see Async_read */
+class Async_read_awaiter {
+public:
+    /** @see Async_read */
+    Async_read_awaiter(Io_stream::Ref stream, size_t max_to_read,
+                       size_t min_to_read, Request_completion_context::Ptr ctx):
+        stream(stream), max_to_read(max_to_read), min_to_read(min_to_read),
+        ctx(ctx), resumer(Async_read_result {nullptr, Io_result::CANCELED}, ctx)
+    {
+        internal::Check_resume_context(this->ctx);
+    }
+
+    bool
+    await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void
+    await_suspend(std::coroutine_handle<> handle)
+    {
+        stream->Read(max_to_read, min_to_read,
+            Make_read_callback(
+                [ref = resumer.Suspend(handle)](Io_buffer::Ptr buffer, Io_result result) mutable
+                {
+                    ref.Resume({buffer, result});
+                }),
+            ctx);
+        resumer.Arm();
+    }
+
+    Async_read_result
+    await_resume()
+    {
+        return std::move(resumer.Get_result());
+    }
+
+private:
+    Io_stream::Ref stream;
+    size_t max_to_read;
+    size_t min_to_read;
+    Request_completion_context::Ptr ctx;
+    internal::Coroutine_resumer<Async_read_result> resumer;
+};
+
+/** Read from the stream, see Io_stream::Read.
+ *
+ * @param ctx Completion context to resume the coroutine in. Should not be
+ *      temporal.
+ * @return Awaitable which yields Async_read_result.
+ */
+inline Async_read_awaiter
+Async_read(Io_stream::Ref stream, size_t max_to_read, size_t min_to_read,
+           Request_completion_context::Ptr ctx)
+{
+    return Async_read_awaiter(stream, max_to_read, min_to_read, ctx);
+}
+
+/** Awaitable stream write. @see Async_write */
+class Async_write_awaiter {
+public:
+    /** @see Async_write */
+    Async_write_awaiter(Io_stream::Ref stream, Io_buffer::Ptr buffer,
+                        Request_completion_context::Ptr ctx):
+        stream(stream), buffer(buffer), ctx(ctx), resumer(Io_result::CANCELED, ctx)
+    {
+        internal::Check_resume_context(this->ctx);
+    }
+
+    bool
+    await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void
+    await_suspend(std::coroutine_handle<> handle)
+    {
+        stream->Write(buffer,
+            Make_write_callback(
+                [ref = resumer.Suspend(handle)](Io_result result) mutable
+                {
+                    ref.Resume(result);
+                }),
+            ctx);
+        resumer.Arm();
+    }
+
+    Io_result
+    await_resume()
+    {
+        return resumer.Get_result();
+    }
+
+private:
+    Io_stream::Ref stream;
+    Io_buffer::Ptr buffer;
+    Request_completion_context::Ptr ctx;
+    internal::Coroutine_resumer<Io_result> resumer;
+};
+
+/** Write to the stream, see Io_stream::Write.
+ *
+ * @param ctx Completion context to resume the coroutine in. Should not be
+ *      temporal.
+ * @return Awaitable which yields Io_result.
+ */
+inline Async_write_awaiter
+Async_write(Io_stream::Ref stream, Io_buffer::Ptr buffer,
+            Request_completion_context::Ptr ctx)
+{
+    return Async_write_awaiter(stream, buffer, ctx);
+}
+
+/** Awaitable timer. @see Async_sleep */
+class Async_sleep_awaiter {
+public:
+    /** @see Async_sleep */
+    Async_sleep_awaiter(std::chrono::milliseconds interval,
+                        Request_completion_context::Ptr ctx):
+        interval(interval), ctx(ctx), resumer(false, ctx)
+    {
+        internal::Check_resume_context(this->ctx);
+    }
+
+    bool
+    await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void
+    await_suspend(std::coroutine_handle<> handle)
+    {
+        Timer_processor::Get_instance()->Create_timer(
+            interval,
+            Make_callback(
+                [ref = resumer.Suspend(handle)]() mutable
+                {
+                    ref.Resume(true);
+                    return false;
+                }),
+            ctx);
+        resumer.Arm();
+    }
+
+    bool
+    await_resume()
+    {
+        return resumer.Get_result();
+    }
+
+private:
+    std::chrono::milliseconds interval;
+    Request_completion_context::Ptr ctx;
+    internal::Coroutine_resumer<bool> resumer;
+};
+
+/** Suspend the coroutine for the specified interval using Timer_processor.
+ *
+ * @param ctx Completion context to resume the coroutine in. Should not be
+ *      temporal.
+ * @return Awaitable which yields true if the interval elapsed, false if the
+ *      timer was cancelled without firing.
+ */
+inline Async_sleep_awaiter
+Async_sleep(std::chrono::milliseconds interval,
+            Request_completion_context::Ptr ctx)
+{
+    return Async_sleep_awaiter(interval, ctx);
+}
+
+/** Awaitable request submission. @see Async_submit */
+class Async_submit_awaiter {
+public:
+    /** @see Async_submit */
+    Async_submit_awaiter(Request_container::Ptr processor, Request::Ptr request,
+                         Request_completion_context::Ptr ctx):
+        processor(processor), request(request), ctx(ctx),
+        resumer(Request::Status::ABORTED, ctx)
+    {
+        internal::Check_resume_context(this->ctx);
+    }
+
+    bool
+    await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void
+    await_suspend(std::coroutine_handle<> handle)
+    {
+        /* Raw pointer, the request owns its completion handler. */
+        auto raw_request = request.get();
+        request->Set_completion_handler(ctx, Make_callback(
+            [ref = resumer.Suspend(handle), raw_request]() mutable
+            {
+                ref.Resume(raw_request->Get_status());
+            }));
+        processor->Submit_request(request);
+        resumer.Arm();
+    }
+
+    Request::Status
+    await_resume()
+    {
+        return resumer.Get_result();
+    }
+
+private:
+    Request_container::Ptr processor;
+    Request::Ptr request;
+    Request_completion_context::Ptr ctx;
+    internal::Coroutine_resumer<Request::Status> resumer;
+};
+
+/** Submit request to the processor and suspend until it is completed.
+ *
+ * @param request Request with processing handler set. Completion handler is
+ *      set by this call.
+ * @param ctx Completion context to resume the coroutine in. Should not be
+ *      temporal.
+ * @return Awaitable which yields final request status, ABORTED if the
+ *      request was aborted.
+ */
+inline Async_submit_awaiter
+Async_submit(Request_container::Ptr processor, Request::Ptr request,
+             Request_completion_context::Ptr ctx)
+{
+    return Async_submit_awaiter(processor, request, ctx);
+}
+
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* __cpp_impl_coroutine */
+
+#endif /* _UGCS_VSM_COROUTINE_H_ */
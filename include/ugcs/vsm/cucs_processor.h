@@ -17,8 +17,15 @@
 #include <ugcs/vsm/socket_processor.h>
 #include <ugcs/vsm/mavlink_stream.h>
 #include <ugcs/vsm/transport_detector.h>
+#include <ugcs/vsm/telemetry_cache.h>
+#include <ugcs/vsm/io_buffer_pool.h>
+#include <ugcs/vsm/deflate_stream.h>
 #include <ucs_vsm_proto.h>
 #include <unordered_set>
+#include <atomic>
+#include <mutex>
+#include <array>
+#include <deque>
 #include <map>
 
 namespace ugcs {
@@ -57,8 +64,130 @@ public:
     void
     Unregister_device(uint32_t handle);
 
+    /** Receive times of telemetry fields, see Device::Telemetry_rx_times. */
+    typedef Device::Telemetry_rx_times Telemetry_rx_times;
+
+    /** Number of buckets in telemetry age histogram. */
+    constexpr static size_t TELEMETRY_AGE_BUCKETS = 16;
+
+    /** Histogram of telemetry field age at the moment of sending to server.
+     * Bucket 0 counts fields younger than 1 ms, bucket N counts fields with
+     * age in range [2^(N-1), 2^N) ms. The last bucket counts all older fields.
+     * The age is counted from the receive time of the property, see
+     * Property::Set_value().
+     */
+    typedef std::array<uint64_t, TELEMETRY_AGE_BUCKETS> Telemetry_age_histogram;
+
     void
-    Send_ucs_message(uint32_t handle, Proto_msg_ptr message, uint32_t stream_id = 0);
+    Send_ucs_message(
+        uint32_t handle,
+        Proto_msg_ptr message,
+        uint32_t stream_id = 0,
+        Telemetry_rx_times rx_times = Telemetry_rx_times());
+
+    /** Get telemetry age histogram collected for the device.
+     * Returns empty histogram for unknown device. */
+    Telemetry_age_histogram
+    Get_telemetry_age_histogram(uint32_t handle);
+
+    /** Get histogram bucket index for the given telemetry age. */
+    static size_t
+    Get_telemetry_age_bucket(std::chrono::steady_clock::duration age);
+
+    /** Largest number of bytes queued for writing to a single server
+     * connection. Growing backlog means the link can not keep up with the
+     * telemetry rate. Can be called from any thread.
+     */
+    size_t
+    Get_write_backlog()
+    {
+        return write_backlog;
+    }
+
+    /** Traffic and compression statistics of server connection. Byte
+     * counters include message frames without length headers.
+     */
+    struct Link_stats {
+        size_t stream_id = 0;
+        Optional<uint32_t> ucs_id;
+        proto::Compression_type tx_compression = proto::COMPRESSION_TYPE_NONE;
+        proto::Compression_type rx_compression = proto::COMPRESSION_TYPE_NONE;
+        /** Serialized messages sent. */
+        uint64_t tx_raw_bytes = 0;
+        /** Bytes sent after compression. */
+        uint64_t tx_bytes = 0;
+        /** Bytes received before decompression. */
+        uint64_t rx_bytes = 0;
+        /** Serialized messages received. */
+        uint64_t rx_raw_bytes = 0;
+        /** Time spent compressing. */
+        std::chrono::nanoseconds tx_time = std::chrono::nanoseconds::zero();
+        /** Time spent decompressing. */
+        std::chrono::nanoseconds rx_time = std::chrono::nanoseconds::zero();
+        /** Messages waiting until previous writes complete. */
+        size_t tx_queued = 0;
+        /** Telemetry messages dropped because the queue was full. */
+        uint64_t tx_dropped = 0;
+
+        double
+        Get_tx_ratio() const
+        {
+            return tx_bytes ? static_cast<double>(tx_raw_bytes) / tx_bytes : 1;
+        }
+
+        double
+        Get_rx_ratio() const
+        {
+            return rx_bytes ? static_cast<double>(rx_raw_bytes) / rx_bytes : 1;
+        }
+    };
+
+    /** Get statistics of all server connections. Must not be called from
+     * processor context.
+     */
+    std::vector<Link_stats>
+    Get_link_stats();
+
+    /** Routing fields of inbound message. */
+    struct Message_header {
+        uint32_t device_id = 0;
+        Optional<uint32_t> message_id;
+        bool response_required = false;
+        /** Message carries Device_response. */
+        bool is_response = false;
+        /** Message carries Register_peer. */
+        bool is_register_peer = false;
+        /** Message carries fields other than the routing ones and
+         * Device_response.
+         */
+        bool has_payload = false;
+
+        /** Peer keep-alive ping or response to VSM ping. It has no ordering
+         * dependency on other messages of the connection.
+         */
+        bool
+        Is_keep_alive() const
+        {
+            return  device_id == 0 && !is_register_peer && !has_payload
+                &&  (response_required || is_response);
+        }
+    };
+
+    /** Get routing fields of serialized Vsm_message by scanning its top
+     * level tags only. Nested messages are skipped without parsing.
+     *
+     * @return false if the message is malformed or has no device_id.
+     */
+    static bool
+    Peek_message_header(const void *data, size_t len, Message_header &header);
+
+    /** Parse serialized Vsm_message on an arena owned by the returned
+     * pointer, so the whole message tree is freed at once.
+     *
+     * @return nullptr if parsing failed.
+     */
+    static Proto_msg_ptr
+    Parse_message(const void *data, size_t len);
 
     // VSM will not communicate with server version below this:
     constexpr static uint32_t SUPPORTED_UCS_VERSION_MAJOR = 2;
@@ -74,6 +203,26 @@ private:
     // Protobuf message of size above this is considered an attack.
     constexpr static size_t PROTO_MAX_MESSAGE_LEN = 1000000;
 
+    // Maximal length of varint message size header.
+    constexpr static size_t PROTO_MAX_HEADER_LEN = 5;
+
+    // Maximal size of one chunk read from server connection. Large messages
+    // like mission uploads arrive in a few chunks instead of one per TCP
+    // segment.
+    constexpr static size_t READ_CHUNK_SIZE = 64 * 1024;
+
+    // Default limit of requests queued to the processor and of messages
+    // queued for each connection. Oldest telemetry messages are dropped
+    // above it.
+    constexpr static size_t DEFAULT_MAX_QUEUED_REQUESTS = 1000;
+
+    // Bytes written to a connection at once. Following messages wait in
+    // the connection queue until the writes complete.
+    constexpr static size_t WRITE_WINDOW = 256 * 1024;
+
+    // Limit of messages queued for each connection.
+    size_t max_queued = DEFAULT_MAX_QUEUED_REQUESTS;
+
     /** Standard worker is enough, because there are no custom threads
      * in Cucs processor.
      */
@@ -88,21 +237,96 @@ private:
     // If specified, VSM will send regular pings to server.
     std::chrono::seconds keep_alive_timeout = std::chrono::seconds(0);
 
+    // Number of dropped telemetry messages at the last resync. Servers get
+    // the whole telemetry cache when it changes, so the values of the
+    // dropped messages are not lost.
+    uint64_t telemetry_dropped = 0;
+
+    // Telemetry messages dropped from connection queues.
+    std::atomic<uint64_t> connection_dropped = {0};
+
     uint32_t
     Get_next_id() { return ucs_id_counter++; }
 
+    // Message serialized in processor thread. Connection threads only read
+    // it, so the same frame can be passed to several connections.
+    struct Tx_frame {
+        // Length header followed by serialized message.
+        Io_buffer::Ptr frame;
+        // Length of the header in front of the message.
+        size_t header_len = 0;
+        // Serialized fields appended to the message, counted in the header.
+        Io_buffer::Ptr payload;
+        // Frame compression switched by the message, if any.
+        Optional<proto::Compression_type> compression;
+        // Telemetry which can be dropped when the connection is overloaded.
+        bool droppable = false;
+        // Keep-alive message which goes ahead of other unsent frames.
+        bool urgent = false;
+    };
+
+    // I/O state of server connection. Framing, parsing and serialization of
+    // messages and stream operations are done in the connection own thread,
+    // so processor thread does only bookkeeping and different connections
+    // are served in parallel.
+    struct Connection {
+        typedef std::shared_ptr<Connection> Ptr;
+
+        size_t stream_id;
+        Io_stream::Ref stream;
+
+        Request_processor::Ptr processor;
+        Request_completion_context::Ptr completion_ctx;
+        Request_worker::Ptr worker;
+
+        // Accessed only from connection thread.
+        Read_subscription::Ptr subscription;
+
+        // Beginning of the frame which is not received completely yet.
+        std::vector<uint8_t> rx_frame;
+
+        // Frame compression negotiated in Register_peer exchange. Each
+        // direction is switched independently by Register_peer with
+        // compression field set, so all following frames are compressed.
+        // Accessed only from connection thread.
+        Deflate_stream::Ptr deflater;
+        Deflate_stream::Ptr inflater;
+
+        // Link statistics, read from processor thread.
+        std::atomic<int> tx_compression = {proto::COMPRESSION_TYPE_NONE};
+        std::atomic<int> rx_compression = {proto::COMPRESSION_TYPE_NONE};
+        std::atomic<uint64_t> tx_raw_bytes = {0};
+        std::atomic<uint64_t> tx_bytes = {0};
+        std::atomic<uint64_t> rx_raw_bytes = {0};
+        std::atomic<uint64_t> rx_bytes = {0};
+        std::atomic<int64_t> tx_time_ns = {0};
+        std::atomic<int64_t> rx_time_ns = {0};
+
+        // Number of bytes written but not yet completed. Protected by
+        // backlog_mutex.
+        size_t write_backlog = 0;
+
+        // Messages waiting for the write window, so a stalled server does
+        // not make the socket write queue grow. Bounded by max_queued.
+        // Accessed only from connection thread.
+        std::deque<Tx_frame> tx_queue;
+
+        // Size of tx_queue, read from processor thread.
+        std::atomic<size_t> tx_queued = {0};
+
+        // Telemetry messages dropped from tx_queue.
+        std::atomic<uint64_t> tx_dropped = {0};
+    };
+
+    /** Offer frame compression to servers. */
+    bool compression_enabled = true;
+
     typedef struct {
         size_t stream_id;
         Io_stream::Ref stream;
+        Connection::Ptr connection;
         Socket_address::Ptr address;
         Optional<uint32_t> ucs_id;
-        Operation_waiter read_waiter;
-
-        // wireformat reader FSM
-        bool reading_header = true;
-        size_t to_read = 1;
-        size_t message_size = 0;
-        int shift = 0;
 
         // This is primary connection with this server.
         // VSM will use this as primary connection.
@@ -120,34 +344,65 @@ private:
 
         // Last time we have received something form this server.
         std::chrono::time_point<std::chrono::steady_clock> last_message_time;
+
     } Server_context;
 
-    typedef struct {
+    struct Vehicle_context {
+        typedef std::shared_ptr<Vehicle_context> Ptr;
+
         Device::Ptr vehicle;
-        // field_id -> field value
-        std::unordered_map<uint32_t, ugcs::vsm::proto::Telemetry_field> telemetry_cache;
-        std::unordered_map<uint32_t, ugcs::vsm::proto::Command_availability> availability_cache;
 
-        // created on vehicle register and not updated any more.
+        // Protects the telemetry state below, which is updated from
+        // device threads.
+        std::mutex mutex;
+
+        // Latest telemetry values and command availability sent to servers.
+        Telemetry_cache telemetry_cache;
+
+        // Age of telemetry fields at the moment of sending to server.
+        Telemetry_age_histogram telemetry_age_histogram = {};
+
+        // Serialized Register_device message with response_required set.
+        // Created on vehicle register and not updated any more.
         // I.e. for now vehicle in not allowed to modify its
-        // telemetry, commands, or props after registration
-        ugcs::vsm::proto::Vsm_message registration_message;
-    } Vehicle_context;
+        // telemetry, commands, or props after registration.
+        // Connection specific message_id is sent in front of it, which is
+        // valid because protobuf parser merges fields in any order.
+        Io_buffer::Ptr registration_payload;
+    };
 
     /** Currently established UCS server connections. Indexed by stream_id*/
     std::unordered_map<
         uint32_t,
         Server_context> ucs_connections;
 
-    /** System ids of registered vehicles and their contexts. */
+    /** System ids of registered vehicles and their contexts. Modified only
+     * in processor context under vehicles_mutex, so the processor reads it
+     * without locking.
+     */
     std::unordered_map<
         uint32_t,
-        Vehicle_context> vehicles;
+        Vehicle_context::Ptr> vehicles;
+
+    std::mutex vehicles_mutex;
+
+    /** Find vehicle context from any thread. */
+    Vehicle_context::Ptr
+    Find_vehicle(uint32_t device_id);
 
     /** Dedicated detector only for server connections.
      * Because the singleton Transport_detector is used by vehicles and can be disabled. */
     Transport_detector::Ptr ucs_connector;
 
+    /** Largest write backlog among server connections. */
+    std::atomic<size_t> write_backlog = {0};
+
+    /** Protects write backlogs of the connections. */
+    std::mutex backlog_mutex;
+
+    /** Recycled buffers for outgoing messages, shared by all connections. */
+    Io_buffer_pool::Ptr buffer_pool;
+
     /** Leave transport detector on when there are no server connections. */
     bool transport_detector_on_when_diconnected = false;
 
@@ -165,58 +420,148 @@ private:
     bool
     On_timer();
 
+    // Send cached telemetry of all vehicles to servers.
+    void
+    Resend_telemetry();
+
     /** Incoming connection from UCS arrived. */
     void
     On_incoming_connection(std::string, int, Socket_address::Ptr, Io_stream::Ref);
 
-    /** Schedule next read operation for a stream. */
+    /** Subscribe to data received by a connection. */
     void
-    Schedule_next_read(Server_context& sc);
+    Start_reading(Connection::Ptr connection);
 
-    /** Read operation for a given UCS connection stream completed. */
+    /** Data received by a given UCS connection. Called in connection
+     * thread.
+     */
     void
     Read_completed(
-            Io_buffer::Ptr,
+            std::vector<Io_buffer::Ptr>,
             Io_result,
-            size_t stream_id);
+            Connection::Ptr connection);
+
+    /** Split received data into frames and process complete ones. Partial
+     * frame is kept in the connection until the rest is received.
+     *
+     * @return false if the stream should be closed.
+     */
+    bool
+    Process_received_data(Connection::Ptr connection, const uint8_t *data, size_t len);
+
+    /** Decode received frame and pass the message to the processor.
+     *
+     * @return false if the stream should be closed.
+     */
+    bool
+    Process_frame(Connection::Ptr connection, const void *data, size_t len);
+
+    /** Send Register_peer which switches frames sent to the server to
+     * compressed mode if the server supports it.
+     */
+    void
+    Negotiate_compression(Server_context& ctx, const proto::Register_peer& peer);
+
+    /** Message parsed by connection thread. */
+    void
+    On_message_received(
+            size_t stream_id,
+            Proto_msg_ptr message);
+
+    /** Serialize message into a frame. Called in processor thread.
+     *
+     * @param payload Optional serialized fields which are appended to the
+     *      message. Written without copying.
+     */
+    Tx_frame
+    Serialize_message(const proto::Vsm_message& message, Io_buffer::Ptr payload = nullptr);
+
+    /** Queue the frame for writing. Called in connection thread. */
+    void
+    On_write_message(
+            Request::Ptr request,
+            Connection::Ptr connection,
+            Tx_frame tx);
+
+    /** Write queued frames while the write window is not full. Called in
+     * connection thread.
+     */
+    void
+    Flush_writes(Connection::Ptr connection);
+
+    /** Compress if needed and write the frame. Called in connection
+     * thread.
+     */
+    void
+    Write_frame(Connection::Ptr connection, const Tx_frame& tx);
 
-    /** Read operation for a given UCS connection stream completed. */
+    /** Stop connection I/O. Called in connection thread. */
+    void
+    On_close_connection(Request::Ptr request, Connection::Ptr connection);
+
+    /** Stop connection I/O and its thread. */
+    void
+    Close_connection(Connection::Ptr connection);
+
+    /** Write operation for a given UCS connection stream completed. */
     void
     Write_completed(
             Io_result,
-            size_t stream_id);
+            Connection::Ptr connection,
+            size_t size);
 
+    /** Recalculate write_backlog after connection backlog change. Called
+     * with backlog_mutex locked in processor thread.
+     */
     void
-    On_register_vehicle(Request::Ptr, Device::Ptr);
+    Update_write_backlog();
 
     void
-    On_unregister_vehicle(Request::Ptr, uint32_t handle);
+    On_register_vehicle(Request::Ptr, Device::Ptr);
 
     void
-    On_send_ucs_message(Request::Ptr request, uint32_t handle, Proto_msg_ptr message, uint32_t stream_id);
+    On_unregister_vehicle(Request::Ptr, uint32_t handle);
 
     void
-    Send_ucs_message(
+    On_send_ucs_message(
+        Request::Ptr request,
+        uint32_t handle,
+        Proto_msg_ptr message,
         uint32_t stream_id,
-        ugcs::vsm::proto::Vsm_message& message);
+        Telemetry_rx_times rx_times);
 
+    // Send message to the given connection. Message is serialized in
+    // processor thread, it is copied if connection specific fields should
+    // be set.
     void
     Send_ucs_message_ptr(uint32_t stream_id, Proto_msg_ptr message);
 
+    // Send keep-alive ping or response to peer request. It is written
+    // ahead of messages queued for the connection, so keep-alive does not
+    // time out behind telemetry bursts and mission uploads.
+    void
+    Send_keep_alive(uint32_t stream_id, Proto_msg_ptr message);
+
+    // Send message to the given connection reusing the frame serialized
+    // for other connections. If the frame is empty and the message is sent
+    // unchanged, its frame is stored for the next connections.
+    void
+    Send_ucs_frame(uint32_t stream_id, Proto_msg_ptr message, Tx_frame& serialized,
+                   bool urgent = false);
+
     // Send message to all connected ucs.
     // Prefers locally connected.
     void
-    Broadcast_message_to_ucs(ugcs::vsm::proto::Vsm_message& message);
+    Broadcast_message_to_ucs(Proto_msg_ptr message);
 
+    // Send cached Register_device message of the vehicle.
     void
-    On_ucs_message(
-        uint32_t stream_id,
-        ugcs::vsm::proto::Vsm_message message);
+    Send_registration(Server_context& ctx, uint32_t device_id, const Vehicle_context& vehicle);
 
     void
-    On_ucs_message_vehicle(
+    On_ucs_message(
         uint32_t stream_id,
-        ugcs::vsm::proto::Vsm_message message);
+        Proto_msg_ptr message);
 
     void
     Send_vehicle_registrations(
@@ -37,6 +37,16 @@
 
 #ifdef DEBUG
 
+/** Check if stack unwinding is in progress. std::uncaught_exception() is
+ * deprecated since C++17, so the headers can be used in applications built
+ * with newer standards.
+ */
+#if __cplusplus >= 201703L
+#define UNCAUGHT_EXCEPTION_ACTIVE() (std::uncaught_exceptions() > 0)
+#else
+#define UNCAUGHT_EXCEPTION_ACTIVE() std::uncaught_exception()
+#endif
+
 /** Verify that expression is true in debug build. In release build the
  * expression is not evaluated.
  * @param x Expression to check. Assertion fires when false.
@@ -44,7 +54,7 @@
 #define ASSERT(x) do { \
     if (!(x)) { \
         LOG_ERROR("Assert failed: '%s'", # x); \
-        if (std::uncaught_exception()) { \
+        if (UNCAUGHT_EXCEPTION_ACTIVE()) { \
             LOG_ERROR("WARNING: uncaught exception active when assertion fired!"); \
         } \
         ASSERT_IMPL(# x); \
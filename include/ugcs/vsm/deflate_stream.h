@@ -0,0 +1,79 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/**
+ * @file deflate_stream.h
+ *
+ * Streaming deflate compression of framed messages.
+ */
+
+#ifndef _UGCS_VSM_DEFLATE_STREAM_H_
+#define _UGCS_VSM_DEFLATE_STREAM_H_
+
+#include <ugcs/vsm/utils.h>
+
+#include <memory>
+#include <vector>
+
+namespace ugcs {
+namespace vsm {
+
+/** Raw deflate stream which compresses or decompresses a sequence of
+ * frames. Compression history is kept for the whole stream, so content
+ * repeated by consecutive messages (field ids, semantics, names) is encoded
+ * by back references to previous frames. Each frame is flushed to a byte
+ * boundary and can be decoded as soon as it is received. Trailing empty
+ * block marker of each flushed frame is implied and not stored.
+ */
+class Deflate_stream: public std::enable_shared_from_this<Deflate_stream> {
+    DEFINE_COMMON_CLASS(Deflate_stream, Deflate_stream)
+
+public:
+    /** Direction of the stream. */
+    enum class Mode {
+        COMPRESS,
+        DECOMPRESS
+    };
+
+    /** Construct stream.
+     *
+     * @param level Compression level 1-9, used for COMPRESS mode.
+     * @throws Exception if zlib stream cannot be initialized.
+     */
+    Deflate_stream(Mode mode, int level = 6);
+
+    ~Deflate_stream();
+
+    /** Disable copying. */
+    Deflate_stream(const Deflate_stream &) = delete;
+
+    /** Compress next part of the current frame and append the result to
+     * "out".
+     *
+     * @param finish Finish the frame. Frame can consist of several parts.
+     */
+    void
+    Compress(const void *data, size_t len, bool finish, std::vector<uint8_t> &out);
+
+    /** Decompress complete frame and append the result to "out".
+     *
+     * @param max_len Maximal length of decompressed frame.
+     * @return false if data are corrupted or frame is too long. Stream
+     *      cannot be used after that.
+     */
+    bool
+    Decompress(const void *data, size_t len, size_t max_len, std::vector<uint8_t> &out);
+
+private:
+    class Impl;
+
+    Mode mode;
+
+    std::unique_ptr<Impl> impl;
+};
+
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* _UGCS_VSM_DEFLATE_STREAM_H_ */
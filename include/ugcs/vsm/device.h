@@ -26,6 +26,9 @@ class Ucs_request :public Request
 public:
     Ucs_request(ugcs::vsm::proto::Vsm_message);
 
+    // Message is shared with the receive path and not copied.
+    Ucs_request(Proto_msg_ptr);
+
     void
     Complete(
         ugcs::vsm::proto::Status_code = ugcs::vsm::proto::STATUS_OK,
@@ -37,7 +40,10 @@ public:
     // Used to send in-progress status for the request.
     uint32_t stream_id = 0;
 
-    ugcs::vsm::proto::Vsm_message request;
+    // Owns the request message.
+    Proto_msg_ptr message;
+
+    ugcs::vsm::proto::Vsm_message &request;
 };
 
 // Structure to get info about ucs servers device is registered with.
@@ -71,6 +77,10 @@ public:
             std::vector<Property::Ptr>>
             Command_handler;
 
+    /** Receive times of telemetry fields in the order they appear in
+     * device status message. Default constructed value means unknown time. */
+    typedef std::vector<std::chrono::time_point<std::chrono::steady_clock>> Telemetry_rx_times;
+
     /** Completion handler type of the request. */
     typedef Callback_proxy<void, uint32_t, Proto_msg_ptr> Response_sender;
 
@@ -105,6 +115,16 @@ public:
         Response_sender completion_handler = Response_sender(),
         ugcs::vsm::Request_completion_context::Ptr completion_ctx = nullptr);
 
+    /**
+     * Same as above, but the message is shared by the caller and must not
+     * be modified by it afterwards.
+     */
+    void
+    On_ucs_message(
+        Proto_msg_ptr message,
+        Response_sender completion_handler = Response_sender(),
+        ugcs::vsm::Request_completion_context::Ptr completion_ctx = nullptr);
+
     // Used by Cucs_processor only.
     // Derived class must override.
     void
@@ -159,6 +179,44 @@ public:
     Subsystem::Ptr
     Add_subsystem(proto::Subsystem_type);
 
+    // Set commit policy for telemetry fields of the given semantic which
+    // do not have their own policy set via Property::Set_commit_policy().
+    // Should be called from device context.
+    void
+    Set_telemetry_policy(proto::Field_semantic semantic, const Property::Commit_policy& policy);
+
+    // Enable automatic telemetry rate reduction on congested links. Minimal
+    // send intervals of all telemetry fields are scaled up proportionally to
+    // the UCS write backlog reaching LINK_BUDGET_MAX_SCALE when backlog is
+    // max_backlog bytes. Fields with zero minimal interval stay unlimited.
+    // Zero disables. Should be called from device context.
+    void
+    Set_link_budget(size_t max_backlog);
+
+    // Maximal multiplier of telemetry send intervals in link budget mode.
+    static constexpr double LINK_BUDGET_MAX_SCALE = 16;
+
+    // Send interval multiplier for the given write backlog.
+    static double
+    Get_link_budget_scale(size_t backlog, size_t max_backlog);
+
+    // Enable history of the telemetry field keeping up to capacity last
+    // values, see Property::Enable_history(). Memory used by histories of
+    // all fields of the device is limited by the history budget, capacity is
+    // reduced to fit into what is left of it. Zero capacity disables the
+    // history of the field. Returns actual capacity. Should be called from
+    // device context.
+    size_t
+    Enable_telemetry_history(Property::Ptr field, size_t capacity);
+
+    // Set maximal memory in bytes used by telemetry histories of the device.
+    // Does not affect already enabled histories.
+    void
+    Set_history_budget(size_t bytes);
+
+    // Default memory limit of telemetry histories of a device.
+    static constexpr size_t DEFAULT_HISTORY_BUDGET = 1024 * 1024;
+
     /** Get default processing context of the vehicle. */
     Request_processor::Ptr
     Get_processing_ctx();
@@ -210,8 +268,10 @@ protected:
         float progress = -1.0,
         const std::string& description = std::string());
 
+    // Send message to all connected servers. Receive times of the telemetry
+    // fields in the message are used to collect telemetry age statistics.
     void
-    Send_ucs_message(Proto_msg_ptr msg);
+    Send_ucs_message(Proto_msg_ptr msg, Telemetry_rx_times rx_times = Telemetry_rx_times());
 
     Vsm_command::Ptr
     Get_command(int id);
@@ -258,6 +318,17 @@ private:
     bool is_enabled = false;
 
     std::unordered_map<std::string, Property::Ptr> properties;
+
+    // Commit policies by field semantic.
+    std::unordered_map<int, Property::Commit_policy> telemetry_policies;
+
+    // Write backlog at which telemetry rate is reduced most. Zero if
+    // link budget mode is disabled.
+    size_t link_budget = 0;
+
+    // Memory limit of telemetry histories and memory already used.
+    size_t history_budget = DEFAULT_HISTORY_BUDGET;
+    size_t history_used = 0;
 };
 
 /** Convenience vehicle logging macro. Vehicle should be given by value (no
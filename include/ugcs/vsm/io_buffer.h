@@ -9,7 +9,9 @@
  */
 
 #include <ugcs/vsm/utils.h>
+#include <ugcs/vsm/clock.h>
 
+#include <chrono>
 #include <memory>
 #include <vector>
 
@@ -29,6 +31,10 @@ namespace vsm {
  * modified buffer is required it can be easily created based on existing one
  * via different constructors, operators and methods. Create() method should be
  * used for obtaining Io_buffer instance.
+ *
+ * Buffer may optionally carry a receive timestamp which is a metadata, not a
+ * part of the data. It is set by I/O processors when the data are received and
+ * is used to measure the age of the information carried by the buffer.
  */
 class Io_buffer: public std::enable_shared_from_this<Io_buffer> {
     DEFINE_COMMON_CLASS(Io_buffer, Io_buffer)
@@ -37,6 +43,9 @@ public:
     /** Special value which references data end. */
     static const size_t END;
 
+    /** Type for the receive timestamp. */
+    typedef std::chrono::time_point<std::chrono::steady_clock> Rx_time;
+
     /** Copy constructor.
      *
      * @param buf Buffer to copy from.
@@ -136,6 +145,35 @@ public:
     std::string
     Get_hex() const;
 
+    /** Set receive timestamp of the buffer data. Timestamp is preserved by
+     * copy and slice operations. Concatenated buffer gets the latest timestamp
+     * of both operands.
+     *
+     * @param time Time when the data were received from the wire. Current
+     *      Clock time by default.
+     */
+    void
+    Set_rx_time(Rx_time time = Clock::Now())
+    {
+        rx_time = time;
+    }
+
+    /** Check if the buffer has receive timestamp set. */
+    bool
+    Has_rx_time() const
+    {
+        return rx_time != Rx_time();
+    }
+
+    /** Get receive timestamp. Default constructed value (clock epoch) is
+     * returned if the timestamp is not set.
+     */
+    Rx_time
+    Get_rx_time() const
+    {
+        return rx_time;
+    }
+
 private:
     /** Data contained in the buffer. The buffer may reference only part of them.
      * Null pointer if the buffer is empty.
@@ -147,6 +185,8 @@ private:
     size_t offset;
     /** Data length of the chunk in "data" member. */
     size_t len;
+    /** Time when the data were received, epoch if unknown. */
+    Rx_time rx_time;
 
     /** Internal constructor for copy/slice operations.
      *
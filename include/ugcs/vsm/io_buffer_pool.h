@@ -0,0 +1,75 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/**
+ * @file io_buffer_pool.h
+ *
+ * Pool of data vectors for Io_buffer instances.
+ */
+
+#ifndef _UGCS_VSM_IO_BUFFER_POOL_H_
+#define _UGCS_VSM_IO_BUFFER_POOL_H_
+
+#include <ugcs/vsm/io_buffer.h>
+
+#include <mutex>
+
+namespace ugcs {
+namespace vsm {
+
+/** Recycles data vectors of buffers which are created and released at high
+ * rate, e.g. outgoing messages, so their memory is not allocated each time.
+ * Vector is returned to the pool when the last buffer referencing it is
+ * released, in any thread. Pool instance is kept alive while any of its
+ * vectors is in use.
+ */
+class Io_buffer_pool: public std::enable_shared_from_this<Io_buffer_pool> {
+    DEFINE_COMMON_CLASS(Io_buffer_pool, Io_buffer_pool)
+
+public:
+    /** Data vector type. */
+    typedef std::shared_ptr<std::vector<uint8_t>> Data_ptr;
+
+    /** Construct pool.
+     *
+     * @param max_pooled Maximal number of free vectors kept in the pool.
+     * @param max_capacity Vectors with bigger capacity are not kept.
+     */
+    Io_buffer_pool(size_t max_pooled = 32, size_t max_capacity = 64 * 1024);
+
+    /** Get vector of the specified size. Content of the vector is
+     * undefined. Fill it and pass to Create_buffer().
+     */
+    Data_ptr
+    Allocate(size_t size);
+
+    /** Create buffer from the vector obtained by Allocate(). */
+    static Io_buffer::Ptr
+    Create_buffer(Data_ptr &&data)
+    {
+        return Io_buffer::Create(std::shared_ptr<const std::vector<uint8_t>>(std::move(data)));
+    }
+
+    /** Number of free vectors in the pool. */
+    size_t
+    Get_pooled_count();
+
+private:
+    size_t max_pooled;
+
+    size_t max_capacity;
+
+    std::mutex mutex;
+
+    std::vector<std::unique_ptr<std::vector<uint8_t>>> pool;
+
+    /** Return vector to the pool. */
+    void
+    Release(std::vector<uint8_t> *data);
+};
+
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* _UGCS_VSM_IO_BUFFER_POOL_H_ */
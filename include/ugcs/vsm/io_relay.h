@@ -0,0 +1,141 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/**
+ * @file io_relay.h
+ *
+ * Bidirectional data relay between two I/O streams.
+ */
+
+#ifndef _UGCS_VSM_IO_RELAY_H_
+#define _UGCS_VSM_IO_RELAY_H_
+
+#include <ugcs/vsm/io_stream.h>
+#include <ugcs/vsm/operation_waiter.h>
+
+#include <atomic>
+#include <mutex>
+
+namespace ugcs {
+namespace vsm {
+
+/** Relays data between two streams in both directions without inspecting
+ * it. TCP socket pairs are relayed inside the kernel by
+ * Socket_processor::Stream::Splice_to() where it is supported, other
+ * streams (e.g. serial port to socket) are relayed by reading and writing
+ * buffers in the completion context.
+ */
+class Io_relay: public std::enable_shared_from_this<Io_relay> {
+    DEFINE_COMMON_CLASS(Io_relay, Io_relay)
+
+public:
+    /** Relay completion handler. Invoked once when relaying in either
+     * direction stops, in the completion context or in Stop() caller
+     * thread. The result is CLOSED when a stream reached its end or was
+     * closed, CANCELED when stopped by Stop().
+     */
+    typedef Callback_proxy<void, Io_result> Done_handler;
+
+    /** Construct relay.
+     *
+     * @param first First stream.
+     * @param second Second stream.
+     * @param completion_ctx Context for buffered transfers and done handler.
+     * @param allow_splice Allow in-kernel relaying if possible. Should be
+     *      disabled if the streams are read or written by other parties.
+     */
+    Io_relay(Io_stream::Ref first, Io_stream::Ref second,
+             Request_completion_context::Ptr completion_ctx,
+             bool allow_splice = true);
+
+    /** Start relaying. Streams should not be read by anybody else
+     * afterwards.
+     *
+     * @param handler Handler invoked when relaying stops, can be empty.
+     */
+    void
+    Start(Done_handler handler = Done_handler());
+
+    /** Stop relaying in both directions. Streams are not closed. */
+    void
+    Stop();
+
+    /** Number of bytes relayed from the first stream to the second one. In
+     * splice mode it is updated only when relaying stops.
+     */
+    uint64_t
+    Get_forward_bytes() const
+    {
+        return directions[0].bytes;
+    }
+
+    /** Number of bytes relayed from the second stream to the first one. In
+     * splice mode it is updated only when relaying stops.
+     */
+    uint64_t
+    Get_backward_bytes() const
+    {
+        return directions[1].bytes;
+    }
+
+    /** Check if any direction is relayed inside the kernel. */
+    bool
+    Is_spliced() const
+    {
+        return directions[0].spliced || directions[1].spliced;
+    }
+
+private:
+    /** Size of read chunk for buffered relaying. */
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    /** Relay direction. */
+    struct Direction {
+        Io_stream::Ref from;
+        Io_stream::Ref to;
+        /** Current read, write or splice operation. */
+        Operation_waiter op;
+        std::atomic<uint64_t> bytes {0};
+        std::atomic_bool spliced {false};
+    };
+
+    Direction directions[2];
+
+    Request_completion_context::Ptr completion_ctx;
+
+    bool allow_splice;
+
+    /** Protects the state below and the direction operations. */
+    std::mutex mutex;
+
+    bool active = false;
+
+    Done_handler done_handler;
+
+    /** Start relaying in the specified direction. */
+    void
+    Start_direction(size_t idx);
+
+    /** Issue next read for buffered relaying. */
+    void
+    Read_next(size_t idx);
+
+    void
+    On_read(Io_buffer::Ptr buffer, Io_result result, size_t idx);
+
+    void
+    On_write(Io_result result, size_t idx);
+
+    void
+    On_spliced(uint64_t bytes, Io_result result, size_t idx);
+
+    /** Stop relaying and notify the done handler. */
+    void
+    Finish(Io_result result);
+};
+
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* _UGCS_VSM_IO_RELAY_H_ */
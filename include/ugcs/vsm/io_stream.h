@@ -17,6 +17,8 @@
 #include <ugcs/vsm/reference_guard.h>
 
 #include <chrono>
+#include <condition_variable>
+#include <deque>
 
 namespace ugcs {
 namespace vsm {
@@ -59,6 +61,160 @@ enum class Io_result {
     OTHER_FAILURE
 };
 
+/** Continuous read operation on a stream, see Io_stream::Subscribe().
+ *
+ * Each chunk (datagram for UDP) received by the stream is queued to the
+ * subscription and queued chunks are delivered to the handler in batches,
+ * one handler invocation at a time, until the subscription is ended either
+ * by the stream (closure or error) or by Cancel(). The stream stops reading
+ * when the number of undelivered chunks reaches the limit (e.g. subscription
+ * is paused or the handler is slower than the link), so the backlog is left
+ * in the system buffers and throttles the peer.
+ */
+class Read_subscription: public std::enable_shared_from_this<Read_subscription> {
+    DEFINE_COMMON_CLASS(Read_subscription, Read_subscription)
+
+public:
+    /** Handler of received data. Invoked with OK result and a non-empty
+     * batch while the subscription is active. Result other than OK is passed
+     * exactly once, with the remaining chunks (possibly none), when the stream
+     * ends the subscription. Handler is not invoked after Cancel() returns.
+     */
+    typedef Callback_proxy<void, std::vector<Io_buffer::Ptr>, Io_result> Handler;
+
+    /** Handler invoked by the subscription when it can accept more chunks
+     * or is canceled. Used by stream implementations.
+     */
+    typedef Callback_proxy<void> Ready_handler;
+
+    /** Default maximal number of chunks delivered by one handler invocation. */
+    static constexpr size_t DEFAULT_MAX_BATCH = 16;
+
+    /** Default maximal number of undelivered chunks. */
+    static constexpr size_t DEFAULT_MAX_PENDING = 64;
+
+    /** Construct subscription.
+     *
+     * @param max_to_read Maximal size of one chunk.
+     * @param handler Handler of received data.
+     * @param comp_ctx Context where the handler is invoked.
+     * @param max_batch Maximal number of chunks per handler invocation.
+     * @param max_pending Stream is not read while this number of chunks is
+     *      not delivered yet.
+     */
+    Read_subscription(size_t max_to_read, Handler handler,
+                      Request_completion_context::Ptr comp_ctx,
+                      size_t max_batch = DEFAULT_MAX_BATCH,
+                      size_t max_pending = DEFAULT_MAX_PENDING);
+
+    /** Stop invoking the handler. Received chunks are queued until the
+     * limit is reached, then the stream stops reading.
+     */
+    void
+    Pause();
+
+    /** Resume delivery after Pause(). */
+    void
+    Resume();
+
+    /** End the subscription. Undelivered chunks are dropped, the handler
+     * is released without final invocation. If the handler is being invoked
+     * in another thread, waits until it returns, so it must not be called
+     * while holding a lock which the handler takes.
+     */
+    void
+    Cancel();
+
+    /** Check if the subscription is ended either by the stream or by
+     * Cancel().
+     */
+    bool
+    Is_ended();
+
+    /** Maximal size of one chunk. */
+    size_t
+    Get_max_to_read() const
+    {
+        return max_to_read;
+    }
+
+    /* Stream side interface. */
+
+    /** Check if the stream should read more data for the subscription. */
+    bool
+    Is_ready();
+
+    /** Queue received chunk. */
+    void
+    Push(Io_buffer::Ptr buffer);
+
+    /** End the subscription by the stream. The result is delivered after
+     * the queued chunks.
+     */
+    void
+    End(Io_result result);
+
+    /** Set handler which is invoked when the subscription stops being full
+     * or is canceled. The handler may be invoked in any thread.
+     */
+    void
+    Set_ready_handler(Ready_handler handler);
+
+    /** Context where the handler is invoked. */
+    Request_completion_context::Ptr
+    Get_completion_context() const
+    {
+        return comp_ctx;
+    }
+
+private:
+    const size_t max_to_read;
+    const size_t max_batch;
+    const size_t max_pending;
+
+    Request_completion_context::Ptr comp_ctx;
+
+    std::mutex mutex;
+
+    /** Released when the subscription is ended and the final result is
+     * delivered or when canceled.
+     */
+    Handler handler;
+
+    Ready_handler ready_handler;
+
+    std::deque<Io_buffer::Ptr> pending;
+
+    /** Result passed by the stream in End(). */
+    Io_result result = Io_result::OK;
+
+    bool ended = false;
+
+    /** Ended by Cancel(). */
+    bool canceled = false;
+
+    bool paused = false;
+
+    /** Delivery request is submitted to the completion context. */
+    bool delivering = false;
+
+    /** Thread which is invoking the handler, if any. */
+    std::thread::id handler_thread;
+
+    /** Signaled when the handler invocation returns. */
+    std::condition_variable handler_done;
+
+    /** Submit delivery if there is something to deliver. Called with the
+     * lock held, returns with the lock released.
+     */
+    void
+    Schedule(std::unique_lock<std::mutex> &lock);
+
+    /** Invoke the handler with the next batch. */
+    void
+    Deliver();
+};
+
 /** Abstract I/O stream interface. All SDK objects which supports reading
  * and/or writing raw bytes (like network connections, files, serial
  * connections) implement this interface.
@@ -258,6 +414,51 @@ public:
         return Read_impl(max_to_read, min_to_read, OFFSET_NONE, completion_handler, comp_ctx);
     }
 
+    /** Subscribe to all data received by the stream. Unlike Read(), the
+     * subscription stays active after each chunk is delivered, so the stream
+     * is read continuously without re-arming a read operation per chunk.
+     * Only one subscription per stream can be active. Read() operations
+     * issued while subscribed take precedence over the subscription.
+     *
+     * @param max_to_read Maximal size of one chunk. If 0 then it is
+     *      determined like for Read(), must be specified for stream types
+     *      other than TCP and UDP.
+     * @param handler Handler of received data.
+     * @param comp_ctx Completion context for the handler.
+     * @param max_batch Maximal number of chunks per handler invocation.
+     * @return Subscription which can be paused, resumed and canceled.
+     * @throw Invalid_param_exception If handler or context is not set or
+     *      max_to_read is not specified.
+     */
+    Read_subscription::Ptr
+    Subscribe(size_t max_to_read,
+              Read_subscription::Handler handler,
+              Request_completion_context::Ptr comp_ctx,
+              size_t max_batch = Read_subscription::DEFAULT_MAX_BATCH)
+    {
+        if (!handler || !comp_ctx) {
+            VSM_EXCEPTION(Invalid_param_exception, "Subscription requires "
+                    "completion handler and completion context.");
+        }
+        if (max_to_read == 0) {
+            switch (stream_type) {
+            case Type::UDP:
+            case Type::UDP_MULTICAST:
+                max_to_read = MIN_UDP_PAYLOAD_SIZE_TO_READ;
+                break;
+            case Type::TCP:
+                max_to_read = MAX_TCP_PAYLOAD_SIZE_TO_READ;
+                break;
+            default:
+                VSM_EXCEPTION(Invalid_param_exception, "max_to_read should be "
+                        "specified for this stream type.");
+            }
+        }
+        auto subscription = Read_subscription::Create(max_to_read, handler, comp_ctx, max_batch);
+        Subscribe_impl(subscription);
+        return subscription;
+    }
+
     /** Initiate stream close operation.
      * @param completion_handler Completion handler for the operation.
      * @param comp_ctx Completion context for the operation.
@@ -354,6 +555,15 @@ protected:
               Read_handler completion_handler,
               Request_completion_context::Ptr comp_ctx) = 0;
 
+    /** Subscribe call implementation. Default implementation keeps one
+     * Read_impl() operation pending on behalf of the subscription. Streams
+     * which can read continuously override it.
+     *
+     * @see Subscribe
+     */
+    virtual void
+    Subscribe_impl(Read_subscription::Ptr subscription);
+
     /** Close call implementation.
      * @param completion_handler Completion handler.
      * @param comp_ctx Completion context.
@@ -386,6 +596,11 @@ DEFINE_CALLBACK_BUILDER(Make_write_callback, (Io_result), (Io_result::OTHER_FAIL
 DEFINE_CALLBACK_BUILDER(Make_read_callback, (Io_buffer::Ptr, Io_result),
                         (nullptr, Io_result::OTHER_FAILURE))
 
+/** Convenience builder for read subscription handlers. */
+DEFINE_CALLBACK_BUILDER(Make_read_subscription_callback,
+                        (std::vector<Io_buffer::Ptr>, Io_result),
+                        (std::vector<Io_buffer::Ptr>(), Io_result::OTHER_FAILURE))
+
 } /* namespace vsm */
 } /* namespace ugcs */
 
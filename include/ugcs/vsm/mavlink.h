@@ -47,6 +47,11 @@ static constexpr size_t MAVLINK_1_MIN_FRAME_LEN = MAVLINK_1_HEADER_LEN + 2;
 static constexpr size_t MAVLINK_2_HEADER_LEN = 10;
 static constexpr size_t MAVLINK_2_MIN_FRAME_LEN = MAVLINK_2_HEADER_LEN + 2;
 
+/** Incompatibility flag of signed Mavlink v2 packet. */
+static constexpr uint8_t MAVLINK_2_IFLAG_SIGNED = 0x01;
+/** Length of Mavlink v2 signature block which follows the checksum. */
+static constexpr size_t MAVLINK_2_SIGNATURE_LEN = 13;
+
 /** ID for field type in MAVLink message. */
 enum Field_type_id {
     /** Special value for internal usage. Indicates that value not present. */
@@ -625,7 +630,8 @@ public:
         payload(buffer),
         sender_system_id(system_id),
         sender_component_id(component_id),
-        sender_request_id(request_id) {}
+        sender_request_id(request_id),
+        rx_time(buffer->Get_rx_time()) {}
 
     /** Get system id of the sender. */
     uint8_t
@@ -648,6 +654,15 @@ public:
         return sender_request_id;
     }
 
+    /** Get time when the message was received from the wire. Default
+     * constructed value is returned if the time is unknown.
+     */
+    Io_buffer::Rx_time
+    Get_rx_time() const
+    {
+        return rx_time;
+    }
+
     /** Payload of the message. */
     typename Payload_type_mapper<message_id, Extension_type>::type payload;
 
@@ -660,6 +675,9 @@ private:
 
     /** Request id of the sender */
     uint32_t sender_request_id;
+
+    /** Receive time of the message. */
+    Io_buffer::Rx_time rx_time;
 };
 
 /** Mavlink compatible checksum (ITU X.25/SAE AS-4 hash) calculation class. It
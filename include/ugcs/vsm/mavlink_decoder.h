@@ -9,6 +9,7 @@
  */
 #include <ugcs/vsm/callback.h>
 #include <ugcs/vsm/mavlink.h>
+#include <ugcs/vsm/mavlink_signing.h>
 
 #include <unordered_map>
 
@@ -18,7 +19,9 @@
 namespace ugcs {
 namespace vsm {
 
-/** Decodes Mavlink 1.0 messages from byte stream. */
+/** Decodes Mavlink 1.0 and 2.0 messages from byte stream. Signed Mavlink 2.0
+ * messages are verified if signing is enabled by Set_signing().
+ */
 class Mavlink_decoder {
 private:
     /** Decoding state. */
@@ -33,7 +36,7 @@ private:
 
 public:
     /** Handler type of the received Mavlink message. Arguments are:
-     * - Payload buffer
+     * - Payload buffer, carries receive timestamp of the packet if known
      * - Message id
      * - Sending system id
      * - Sending component id
@@ -72,6 +75,13 @@ public:
         /** Number of STX bytes found during decoding, i.e. how many times packet
          * decode was tried to be started. Only total for the connection is counted. */
         uint64_t stx_syncs = 0;
+        /** Signed messages with wrong signature or replayed timestamp.
+         * Total and per system_id. */
+        uint64_t bad_signature = 0;
+        /** Unsigned messages dropped because signing is required. Total and per system_id. */
+        uint64_t unsigned_dropped = 0;
+        /** Messages with unknown incompatibility flags. Only total for the connection is counted. */
+        uint64_t unknown_flags = 0;
     };
 
 
@@ -107,6 +117,15 @@ public:
         data_handler = handler;
     }
 
+    /** Enable verification of signed Mavlink v2 messages. Without signing
+     * state signed messages are accepted without verification.
+     */
+    void
+    Set_signing(Mavlink_signing::Ptr signing)
+    {
+        this->signing = signing;
+    }
+
     /** Decode buffer from the wire. */
     void
     Decode(Io_buffer::Ptr buffer)
@@ -173,6 +192,11 @@ public:
                 }
                 data = static_cast<const uint8_t*>(packet_buf->Get_data());
                 packet_len = wrapper_len + static_cast<size_t>(*data);
+                if (    state == State::VER2
+                    &&  buffer_len > 1
+                    &&  (data[1] & mavlink::MAVLINK_2_IFLAG_SIGNED)) {
+                    packet_len += mavlink::MAVLINK_2_SIGNATURE_LEN;
+                }
                 if (packet_len > buffer_len) {
                     // need the whole packet. Initiate next read.
                     next_read_len = packet_len - buffer_len;
@@ -230,9 +254,11 @@ private:
         uint8_t component_id;
         uint8_t seq;
         uint8_t header_len;
+        uint8_t incompat_flags = 0;
         mavlink::MESSAGE_ID_TYPE msg_id;
 
         if (state == State::VER2) {
+            incompat_flags = data[1];
             seq = data[3];
             system_id = data[4];
             component_id = data[5];
@@ -249,6 +275,12 @@ private:
             header_len = mavlink::MAVLINK_1_HEADER_LEN - 1;
         }
 
+        if (incompat_flags & ~mavlink::MAVLINK_2_IFLAG_SIGNED) {
+            std::lock_guard<std::mutex> stats_lock(stats_mutex);
+            stats[mavlink::SYSTEM_ID_ANY].unknown_flags++;
+            return false;
+        }
+
         mavlink::Checksum sum(data, header_len);
 
         mavlink::Extra_byte_length_pair crc_byte_len_pair;
@@ -277,6 +309,27 @@ private:
             /*
              * Fully valid packet received.
              */
+            if (signing) {
+                Mavlink_signing::Result result = Mavlink_signing::Result::OK;
+                if (incompat_flags & mavlink::MAVLINK_2_IFLAG_SIGNED) {
+                    stats_lock.unlock();
+                    result = signing->Verify(data, header_len + payload_len + sizeof(uint16_t),
+                        data + header_len + payload_len + sizeof(uint16_t), system_id, component_id);
+                    stats_lock.lock();
+                } else if (!signing->Is_unsigned_accepted()) {
+                    stats[system_id].unsigned_dropped++;
+                    stats[mavlink::SYSTEM_ID_ANY].unsigned_dropped++;
+                    /* Frame is valid, skip it. */
+                    return true;
+                }
+                if (result != Mavlink_signing::Result::OK) {
+                    stats[system_id].bad_signature++;
+                    stats[mavlink::SYSTEM_ID_ANY].bad_signature++;
+                    LOG_DEBUG("Mavlink message %d signature rejected: %s.", msg_id,
+                        result == Mavlink_signing::Result::REPLAY ? "replay" : "mismatch");
+                    return true;
+                }
+            }
             if (handler) {
                 stats[system_id].handled++;
                 stats[mavlink::SYSTEM_ID_ANY].handled++;
@@ -311,6 +364,9 @@ private:
     /** Raw data handler. */
     Raw_data_handler data_handler;
 
+    /** Signing state of the link, if enabled. */
+    Mavlink_signing::Ptr signing;
+
     /** Statistics. */
     std::unordered_map<int, Stats> stats;
     std::mutex stats_mutex;
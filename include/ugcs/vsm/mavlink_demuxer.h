@@ -155,6 +155,18 @@ public:
     void
     Register_default_handler(Default_handler handler);
 
+    /** Set request processor for the handlers which are registered without
+     * own processor. Used when the messages are demultiplexed in a thread
+     * other than the one the handlers expect to be called from, e.g. when
+     * decoding is offloaded to a pool of decoding threads. Default handler
+     * is always called from the thread which calls @ref Demux method.
+     *
+     * @param processor Request processor, nullptr to call such handlers from
+     *      the thread which calls @ref Demux method.
+     */
+    void
+    Set_default_processor(Request_processor::Ptr processor);
+
     /** Register handler for specific Mavlink message, system id and
      * component id.
      * @param handler Handler taking specific Mavlink message.
@@ -163,8 +175,9 @@ public:
      * @param component_id Component id to call the handler for, or
      * @ref COMPONENT_ID_ANY to call the handler for any component id.
      * @param processor If given, specifies request processor in which context
-     * the handler should be executed, otherwise handler is executed from the
-     * thread which calls @ref Demux method.
+     * the handler should be executed, otherwise handler is executed in the
+     * default processor, if set, or from the thread which calls @ref Demux
+     * method.
      * @return Valid registration key which can be used to unregister the
      * handler later.
      */
@@ -232,9 +245,15 @@ private:
         ~Callback_base()
         {};
 
+        /** Invoke the handler.
+         *
+         * @param default_processor Processor to use if the callback does
+         *      not have own one.
+         */
         virtual void
         operator()(Io_buffer::Ptr buffer, System_id system_id,
-                    uint8_t component_id, uint32_t request_id) = 0;
+                    uint8_t component_id, uint32_t request_id,
+                    const Request_processor::Ptr &default_processor) = 0;
 
     protected:
         /** Optional request processor for a handler (may be nullptr). */
@@ -258,10 +277,12 @@ private:
 
         virtual void
         operator()(Io_buffer::Ptr buffer, System_id system_id,
-                    uint8_t component_id, uint32_t request_id) override
+                    uint8_t component_id, uint32_t request_id,
+                    const Request_processor::Ptr &default_processor) override
         {
             typename Message_type::Ptr message =
                     Message_type::Create(system_id, component_id, request_id, buffer);
+            auto &processor = this->processor ? this->processor : default_processor;
             if (processor) {
                 /* Callback will be invoked from processor context. */
                 auto request = Request::Create();
@@ -293,6 +314,9 @@ private:
     /** Default handler for unregistered messages. */
     Default_handler default_handler;
 
+    /** Processor for handlers without own processor. */
+    Request_processor::Ptr default_processor;
+
     /** Handlers for specific Mavlink messages. */
     std::unordered_multimap<Key, Callback_base::Ptr, Key::Hasher> handlers;
 
@@ -10,6 +10,7 @@
 
 #include <ugcs/vsm/io_buffer.h>
 #include <ugcs/vsm/mavlink.h>
+#include <ugcs/vsm/mavlink_signing.h>
 
 namespace ugcs {
 namespace vsm {
@@ -19,6 +20,15 @@ namespace vsm {
  */
 class Mavlink_encoder {
 public:
+    /** Sign Mavlink v2 messages with the provided signing state. Signing is
+     * disabled if nullptr.
+     */
+    void
+    Set_signing(Mavlink_signing::Ptr signing)
+    {
+        this->signing = signing;
+    }
+
     /** Encode Mavlink version 1 message.
      * @param payload Payload.
      * @param system_id System id.
@@ -57,7 +67,8 @@ public:
 
         return Io_buffer::Create(std::move(data));
     }
-    /** Encode Mavlink version 2 message.
+    /** Encode Mavlink version 2 message. Message is signed if signing is
+     * enabled.
      * @param payload Payload.
      * @param system_id System id.
      * @param component_id Component id.
@@ -73,7 +84,7 @@ public:
 
         /* Fill the header. */
         data[0] = mavlink::START_SIGN2;
-        data[2] = 0;    // incompat_flags
+        data[2] = signing ? mavlink::MAVLINK_2_IFLAG_SIGNED : 0;    // incompat_flags
         data[3] = 0;    // compat_flags
         data[4] = seq++;
         data[5] = system_id;
@@ -100,7 +111,13 @@ public:
             reinterpret_cast<mavlink::Uint16*>(&data[mavlink::MAVLINK_2_HEADER_LEN + packet_len]);
         *wire_sum = sum_val;
 
-        data.resize(mavlink::MAVLINK_2_HEADER_LEN + packet_len + 2);
+        size_t frame_len = mavlink::MAVLINK_2_HEADER_LEN + packet_len + 2;
+        if (signing) {
+            data.resize(frame_len + mavlink::MAVLINK_2_SIGNATURE_LEN);
+            signing->Sign(data.data(), frame_len);
+        } else {
+            data.resize(frame_len);
+        }
 
         return Io_buffer::Create(std::move(data));
     }
@@ -108,6 +125,9 @@ public:
 private:
     /** Current sequence number. */
     uint8_t seq = 0;
+
+    /** Signing state, if enabled. */
+    Mavlink_signing::Ptr signing;
 };
 
 } /* namespace vsm */
@@ -0,0 +1,236 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/**
+ * @file mavlink_rate_manager.h
+ *
+ * Demand driven negotiation of Mavlink message rates.
+ */
+
+#ifndef _UGCS_VSM_MAVLINK_RATE_MANAGER_H_
+#define _UGCS_VSM_MAVLINK_RATE_MANAGER_H_
+
+#include <ugcs/vsm/mavlink_stream.h>
+#include <ugcs/vsm/clock.h>
+
+#include <map>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+
+namespace ugcs {
+namespace vsm {
+
+/** Requests from the vehicle only the messages which have registered
+ * handlers, at the rates the handlers need. Handlers are registered via the
+ * manager instead of the demuxer of the stream, with the rate they need.
+ * Messages with several handlers are requested at the highest of their
+ * rates. Messages received from the vehicle without any handler are switched
+ * off, except the ones which are sent on request or on events, e.g. command
+ * acknowledgements, parameters, mission items.
+ *
+ * Rates are set by MAV_CMD_SET_MESSAGE_INTERVAL. If the vehicle reports it
+ * as unsupported, REQUEST_DATA_STREAM is used instead, which controls only
+ * groups of messages. Everything is applied again when the vehicle reboot is
+ * detected by a gap in heartbeats.
+ *
+ * Methods may be called from any thread. The state is guarded by a mutex,
+ * because the default handler of the demuxer is invoked from the decoding
+ * threads when the stream decode offload is enabled.
+ */
+class Mavlink_rate_manager: public std::enable_shared_from_this<Mavlink_rate_manager> {
+    DEFINE_COMMON_CLASS(Mavlink_rate_manager, Mavlink_rate_manager)
+
+public:
+    /** Registration identifier. */
+    typedef int Handler_id;
+
+    /** Heartbeat gap after which the vehicle is considered rebooted. */
+    static constexpr std::chrono::seconds REBOOT_GAP = std::chrono::seconds(5);
+
+    /** Minimal interval between repeated requests to switch off a message
+     * which is still received.
+     */
+    static constexpr std::chrono::seconds DISABLE_RETRY = std::chrono::seconds(5);
+
+    /** Timeout of sent requests. */
+    static constexpr std::chrono::seconds SEND_TIMEOUT = std::chrono::seconds(2);
+
+    /** Construct manager.
+     *
+     * @param stream Stream connected to the vehicle, with decoder and
+     *      demuxer bound.
+     * @param completion_ctx Context for completion of sent messages.
+     * @param target_system System id of the vehicle.
+     * @param target_component Component id of the autopilot.
+     * @param system_id System id to send messages from.
+     * @param component_id Component id to send messages from.
+     */
+    Mavlink_rate_manager(
+            Mavlink_stream::Ptr stream,
+            Request_completion_context::Ptr completion_ctx,
+            uint8_t target_system,
+            uint8_t target_component,
+            uint8_t system_id,
+            uint8_t component_id);
+
+    /** Start managing the rates. Registers default handler of the demuxer
+     * which switches off unhandled messages.
+     *
+     * @param fallback Default handler to invoke for unhandled messages after
+     *      the manager, if the application needs one.
+     */
+    void
+    Enable(Mavlink_demuxer::Default_handler fallback = Mavlink_demuxer::Default_handler());
+
+    /** Unregister all handlers. Rates already set on the vehicle are left
+     * as is.
+     */
+    void
+    Disable();
+
+    /** Register handler for messages of the vehicle and request the
+     * message at the specified rate.
+     *
+     * @param handler Message handler.
+     * @param rate Needed rate in Hz. Zero means any rate the vehicle uses,
+     *      i.e. the message is not switched off but its rate is not changed.
+     * @param processor Request processor to invoke the handler in, see
+     *      Mavlink_demuxer::Register_handler.
+     * @return Identifier for Unregister_handler().
+     */
+    template<mavlink::MESSAGE_ID_TYPE message_id, class Extension_type = mavlink::Extension>
+    Handler_id
+    Register_handler(
+            Mavlink_demuxer::Handler<message_id, Extension_type> handler,
+            double rate,
+            Request_processor::Ptr processor = nullptr)
+    {
+        auto key = stream->Get_demuxer().Register_handler<message_id, Extension_type>(
+                handler, target_system, Mavlink_demuxer::COMPONENT_ID_ANY, processor);
+        return Add_demand(message_id, rate, key);
+    }
+
+    /** Unregister handler. The message is switched off if no handlers
+     * remain for it.
+     */
+    void
+    Unregister_handler(Handler_id id);
+
+    /** Do not switch off the message even if it has no handlers. */
+    void
+    Keep_message(mavlink::MESSAGE_ID_TYPE message_id);
+
+    /** Send all rates to the vehicle again. */
+    void
+    Reapply();
+
+    /** Get the rate the message is requested at.
+     *
+     * @return Rate in Hz, zero if the rate is not controlled, negative if
+     *      the message is switched off.
+     */
+    double
+    Get_requested_rate(mavlink::MESSAGE_ID_TYPE message_id);
+
+    /** Check if REQUEST_DATA_STREAM is used because the vehicle does not
+     * support MAV_CMD_SET_MESSAGE_INTERVAL.
+     */
+    bool
+    Is_legacy_mode() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return legacy_mode;
+    }
+
+private:
+    /** Handler registered via the manager. */
+    struct Demand {
+        mavlink::MESSAGE_ID_TYPE message_id;
+        double rate;
+        Mavlink_demuxer::Key key;
+    };
+
+    Mavlink_stream::Ptr stream;
+
+    Request_completion_context::Ptr completion_ctx;
+
+    uint8_t target_system;
+
+    uint8_t target_component;
+
+    uint8_t system_id;
+
+    uint8_t component_id;
+
+    /** Guards the members below. */
+    mutable std::mutex mutex;
+
+    Mavlink_demuxer::Default_handler fallback;
+
+    /** Keys of the manager own handlers. */
+    Mavlink_demuxer::Key heartbeat_key, ack_key;
+
+    std::map<Handler_id, Demand> demands;
+
+    Handler_id next_id = 1;
+
+    /** Messages which are never switched off. */
+    std::set<mavlink::MESSAGE_ID_TYPE> kept;
+
+    /** Switched off messages and time of the last request. */
+    std::unordered_map<mavlink::MESSAGE_ID_TYPE, Clock::Time_point> switched_off;
+
+    /** Time of the last heartbeat of the vehicle. */
+    Clock::Time_point last_heartbeat;
+
+    bool heartbeat_received = false;
+
+    bool legacy_mode = false;
+
+    /** Get_requested_rate() with the mutex already acquired. */
+    double
+    Get_requested_rate_locked(mavlink::MESSAGE_ID_TYPE message_id);
+
+    Handler_id
+    Add_demand(mavlink::MESSAGE_ID_TYPE message_id, double rate, Mavlink_demuxer::Key key);
+
+    /** Reapply() with the mutex already acquired. */
+    void
+    Reapply_locked();
+
+    /** Send the rate of one message according to its demands. Called with
+     * the mutex acquired, as are the methods below.
+     */
+    void
+    Apply(mavlink::MESSAGE_ID_TYPE message_id);
+
+    /** Send the rates of REQUEST_DATA_STREAM groups. */
+    void
+    Apply_legacy();
+
+    /** Send MAV_CMD_SET_MESSAGE_INTERVAL.
+     *
+     * @param interval Interval in microseconds, -1 to switch off, 0 for
+     *      default rate.
+     */
+    void
+    Send_interval(mavlink::MESSAGE_ID_TYPE message_id, float interval);
+
+    void
+    On_heartbeat(mavlink::Message<mavlink::MESSAGE_ID::HEARTBEAT>::Ptr message);
+
+    void
+    On_command_ack(mavlink::Message<mavlink::MESSAGE_ID::COMMAND_ACK>::Ptr message);
+
+    bool
+    On_unhandled(Io_buffer::Ptr buffer, mavlink::MESSAGE_ID_TYPE message_id,
+                 Mavlink_demuxer::System_id system_id, uint8_t component_id,
+                 uint32_t request_id);
+};
+
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* _UGCS_VSM_MAVLINK_RATE_MANAGER_H_ */
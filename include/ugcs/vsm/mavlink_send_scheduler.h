@@ -0,0 +1,188 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/**
+ * @file mavlink_send_scheduler.h
+ *
+ * Scheduler of periodically sent Mavlink messages.
+ */
+
+#ifndef _UGCS_VSM_MAVLINK_SEND_SCHEDULER_H_
+#define _UGCS_VSM_MAVLINK_SEND_SCHEDULER_H_
+
+#include <ugcs/vsm/mavlink_stream.h>
+#include <ugcs/vsm/timer_processor.h>
+
+#include <map>
+#include <mutex>
+
+namespace ugcs {
+namespace vsm {
+
+/** Sends periodic Mavlink messages (heartbeats, setpoints, RC overrides,
+ * time synchronization etc.) of any number of vehicles from a single timer.
+ * Each registered entry has a payload generator, a rate and a phase. On each
+ * tick all entries which are due are invoked and their messages are encoded
+ * into one buffer per stream, which is written with a single write
+ * operation.
+ *
+ * Send times of an entry are aligned to the scheduler start time, i.e. the
+ * message is due at start + phase + N * period. Entries with the same rate
+ * and different phases are therefore spread over the period instead of being
+ * sent in bursts. Rates higher than the tick rate are limited by the tick
+ * rate. If the tick comes too late and some periods of an entry are missed,
+ * the message is sent once and the missed periods are counted in the
+ * statistics.
+ *
+ * Messages are sent from the completion context of the scheduler, so other
+ * messages should be sent to the same streams from that context as well.
+ */
+class Mavlink_send_scheduler: public std::enable_shared_from_this<Mavlink_send_scheduler> {
+    DEFINE_COMMON_CLASS(Mavlink_send_scheduler, Mavlink_send_scheduler)
+
+public:
+    /** Payload generator. Invoked when the message is due, should return
+     * the payload to send or nullptr to skip this period.
+     */
+    typedef Callback_proxy<mavlink::Payload_base::Ptr> Generator;
+
+    /** Entry identifier. */
+    typedef int Entry_id;
+
+    /** Default tick interval. */
+    static constexpr std::chrono::milliseconds DEFAULT_TICK = std::chrono::milliseconds(10);
+
+    /** Timeout of the write operations. */
+    static constexpr std::chrono::milliseconds WRITE_TIMEOUT = std::chrono::milliseconds(1000);
+
+    /** Send statistics. Jitter is the delay between the time the message was
+     * due and the time it was actually sent.
+     */
+    struct Stats {
+        /** Number of timer ticks. */
+        uint64_t ticks = 0;
+        /** Number of sent messages. */
+        uint64_t sent = 0;
+        /** Number of write operations. */
+        uint64_t writes = 0;
+        /** Number of periods skipped because of late ticks. */
+        uint64_t missed = 0;
+        /** Maximal jitter. */
+        std::chrono::microseconds max_jitter = std::chrono::microseconds::zero();
+        /** Sum of jitter of all sent messages. */
+        std::chrono::microseconds total_jitter = std::chrono::microseconds::zero();
+
+        /** Get average jitter. */
+        std::chrono::microseconds
+        Get_mean_jitter() const
+        {
+            return sent ? total_jitter / static_cast<int64_t>(sent) : std::chrono::microseconds::zero();
+        }
+    };
+
+    /** Construct scheduler.
+     *
+     * @param completion_ctx Context where the ticks are processed and
+     *      generators are invoked. Also used for write operations completion.
+     * @param tick Tick interval.
+     */
+    Mavlink_send_scheduler(
+            Request_completion_context::Ptr completion_ctx,
+            std::chrono::milliseconds tick = DEFAULT_TICK);
+
+    /** Start the timer. */
+    void
+    Enable();
+
+    /** Stop the timer and remove all entries. */
+    void
+    Disable();
+
+    /** Register periodic message.
+     *
+     * @param stream Stream to send the message to.
+     * @param generator Payload generator.
+     * @param rate Rate in Hz.
+     * @param system_id System id to send the message from.
+     * @param component_id Component id to send the message from.
+     * @param phase Offset of send times inside the period.
+     * @return Identifier for Remove() and Set_rate().
+     * @throw Invalid_param_exception if the rate is not positive.
+     */
+    Entry_id
+    Add(Mavlink_stream::Ptr stream,
+        Generator generator,
+        double rate,
+        uint8_t system_id,
+        uint8_t component_id,
+        std::chrono::milliseconds phase = std::chrono::milliseconds::zero());
+
+    /** Remove periodic message. Does nothing if the entry does not exist. */
+    void
+    Remove(Entry_id id);
+
+    /** Remove all periodic messages of the stream, e.g. when the vehicle is
+     * disconnected.
+     */
+    void
+    Remove_stream(Mavlink_stream::Ptr stream);
+
+    /** Change rate of the periodic message, keeping its phase.
+     *
+     * @throw Invalid_param_exception if the rate is not positive.
+     */
+    void
+    Set_rate(Entry_id id, double rate);
+
+    /** Get send statistics. */
+    Stats
+    Get_stats();
+
+private:
+    /** Registered periodic message. */
+    struct Entry {
+        Mavlink_stream::Ptr stream;
+        Generator generator;
+        uint8_t system_id;
+        uint8_t component_id;
+        Clock::Duration period;
+        Clock::Duration phase;
+        /** Time the message is due next time. */
+        Clock::Time_point next;
+    };
+
+    Request_completion_context::Ptr completion_ctx;
+
+    std::chrono::milliseconds tick;
+
+    Timer_processor::Timer::Ptr timer;
+
+    /** Time the send times are aligned to. */
+    Clock::Time_point start_time;
+
+    /** Protects entries and statistics. */
+    std::mutex mutex;
+
+    std::map<Entry_id, Entry> entries;
+
+    Entry_id next_id = 1;
+
+    Stats stats;
+
+    /** Calculate period from rate. */
+    static Clock::Duration
+    Get_period(double rate);
+
+    /** Calculate the first due time of the entry after the specified time. */
+    Clock::Time_point
+    Get_next_time(const Entry &entry, Clock::Time_point after);
+
+    bool
+    On_timer();
+};
+
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* _UGCS_VSM_MAVLINK_SEND_SCHEDULER_H_ */
@@ -0,0 +1,131 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/**
+ * @file mavlink_signing.h
+ *
+ * Mavlink v2 packet signing.
+ */
+
+#ifndef _UGCS_VSM_MAVLINK_SIGNING_H_
+#define _UGCS_VSM_MAVLINK_SIGNING_H_
+
+#include <ugcs/vsm/mavlink.h>
+#include <ugcs/vsm/utils.h>
+
+#include <array>
+#include <mutex>
+#include <unordered_map>
+
+namespace ugcs {
+namespace vsm {
+
+/** Signing state of one Mavlink link. Signature is the first 48 bits of
+ * SHA-256 of the secret key, the packet and the signature block header
+ * (link id and timestamp). Timestamp is in 10 microseconds units since
+ * 2015-01-01 and increases with each sent packet. Received packet is
+ * accepted only if its timestamp is newer than the previous one from the
+ * same link, system and component, or, for the first packet of such stream,
+ * is not older than one minute. Shared by decoder and encoder of the link.
+ */
+class Mavlink_signing: public std::enable_shared_from_this<Mavlink_signing> {
+    DEFINE_COMMON_CLASS(Mavlink_signing, Mavlink_signing)
+
+public:
+    /** Secret key type. */
+    typedef std::array<uint8_t, 32> Key;
+
+    /** Result of received packet verification. */
+    enum class Result {
+        /** Signature is valid. */
+        OK,
+        /** Signature does not match. */
+        BAD_SIGNATURE,
+        /** Timestamp is not newer than the last one of the stream. */
+        REPLAY
+    };
+
+    /** Maximal age of the first packet of a stream, in timestamp units. */
+    static constexpr uint64_t MAX_NEW_STREAM_AGE = 60 * 100000;
+
+    /** Maximal number of tracked streams. Packets of new streams are
+     * rejected above that.
+     */
+    static constexpr size_t MAX_STREAMS = 256;
+
+    /** Construct signing state.
+     *
+     * @param key Secret key shared with the other side.
+     * @param link_id Link id put into sent packets.
+     * @param accept_unsigned Accept unsigned packets from the link.
+     */
+    Mavlink_signing(const Key &key, uint8_t link_id, bool accept_unsigned = false);
+
+    /** Derive key from a passphrase, the same way ground stations do, i.e.
+     * SHA-256 of the passphrase.
+     */
+    static Key
+    Make_key(const std::string &passphrase);
+
+    /** Sign the packet. Packet starts with the start sign, incompatibility
+     * flags should already have signed flag set and checksum calculated.
+     * Signature block is written to the MAVLINK_2_SIGNATURE_LEN bytes
+     * following the packet.
+     *
+     * @param packet Packet buffer with the space for the signature.
+     * @param len Packet length without the signature.
+     */
+    void
+    Sign(uint8_t *packet, size_t len);
+
+    /** Verify received packet.
+     *
+     * @param packet Packet without the start sign and signature.
+     * @param len Packet length.
+     * @param signature Signature block of the packet.
+     * @param system_id Sender system id.
+     * @param component_id Sender component id.
+     */
+    Result
+    Verify(const uint8_t *packet, size_t len, const uint8_t *signature,
+           uint8_t system_id, uint8_t component_id);
+
+    /** Check if unsigned packets are accepted. */
+    bool
+    Is_unsigned_accepted() const
+    {
+        return accept_unsigned;
+    }
+
+    /** Get current timestamp since Mavlink signing epoch. */
+    static uint64_t
+    Get_current_timestamp();
+
+private:
+    Key key;
+
+    uint8_t link_id;
+
+    bool accept_unsigned;
+
+    std::mutex mutex;
+
+    /** Last timestamp sent or received. */
+    uint64_t timestamp;
+
+    /** Last timestamp of each received stream, indexed by link id, system id
+     * and component id.
+     */
+    std::unordered_map<uint32_t, uint64_t> streams;
+
+    /** Calculate 48 bit signature. */
+    void
+    Calculate(const uint8_t *packet, size_t len, const uint8_t *signature_header,
+              uint8_t *signature);
+};
+
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* _UGCS_VSM_MAVLINK_SIGNING_H_ */
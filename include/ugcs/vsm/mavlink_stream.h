@@ -12,6 +12,7 @@
 #include <ugcs/vsm/mavlink_decoder.h>
 #include <ugcs/vsm/mavlink_demuxer.h>
 #include <ugcs/vsm/mavlink_encoder.h>
+#include <ugcs/vsm/request_strand.h>
 #include <tuple>
 #include <queue>
 
@@ -78,6 +79,53 @@ public:
                         binder, Shared_from_this()));
     }
 
+    /** Offload decoding of received data to a pool of threads. Framing,
+     * checksum and signature verification and demultiplexing of the stream
+     * are then done by a strand on the specified executor, so received data
+     * of one stream are still processed in order, while different streams
+     * sharing the executor are decoded in parallel. Only the final handler
+     * invocations are posted to the processors the handlers are registered
+     * with.
+     *
+     * Should be called before any data are passed to Decode().
+     *
+     * @param executor Container with the pool of decoding threads, typically
+     *      Request_worker shared by all streams.
+     * @param handler_processor Processor to invoke the handlers which are
+     *      registered without own processor, typically the one which
+     *      previously called Decode(). If nullptr, such handlers are invoked
+     *      from the decoding threads.
+     */
+    void
+    Enable_decode_offload(
+            Request_container::Ptr executor,
+            Request_processor::Ptr handler_processor = nullptr)
+    {
+        decode_strand = Request_strand::Create("Mavlink decode", executor);
+        decode_strand->Enable();
+        demuxer.Set_default_processor(handler_processor);
+    }
+
+    /** Decode received data. Data are decoded in the calling thread or, if
+     * decode offload is enabled, asynchronously by the decoding threads.
+     */
+    void
+    Decode(Io_buffer::Ptr buffer)
+    {
+        if (!decode_strand) {
+            decoder.Decode(buffer);
+            return;
+        }
+        if (!decode_strand->Is_enabled()) {
+            /* Stream is disabled. */
+            return;
+        }
+        auto request = Request::Create();
+        request->Set_processing_handler(Make_callback(
+                &Mavlink_stream::Decode_offloaded, Shared_from_this(), buffer, request));
+        decode_strand->Submit_request(request);
+    }
+
     /** Toggle mavlink protocol v1/v2 for outgoing messages. */
     void
     Set_mavlink_v2(bool enable = true)
@@ -92,6 +140,17 @@ public:
         return send_mavlink2;
     }
 
+    /** Enable Mavlink v2 signing of the link. Sent Mavlink v2 messages are
+     * signed and received signed messages are verified with the provided
+     * state. nullptr disables signing.
+     */
+    void
+    Set_signing(Mavlink_signing::Ptr signing)
+    {
+        decoder.Set_signing(signing);
+        encoder.Set_signing(signing);
+    }
+
     /** Send Mavlink message to other end asynchronously. Timeout should be
      * always present, otherwise there is a chance to overflow the write queue
      * if underlying stream is write-blocked. Only non-temporal completion
@@ -129,14 +188,54 @@ public:
             const Request_completion_context::Ptr& completion_ctx,
             bool mav2)
     {
-        ASSERT(completion_ctx->Get_type() != Request_completion_context::Type::TEMPORAL);
+        Send_buffer(
+            Encode_message(payload, system_id, component_id, mav2),
+            timeout,
+            timeout_handler,
+            completion_ctx);
+    }
 
-        Io_buffer::Ptr buffer;
+    /** Encode Mavlink message with the encoder of this stream, so that
+     * sequence numbers and signing of the link are preserved.
+     */
+    Io_buffer::Ptr
+    Encode_message(
+            const mavlink::Payload_base& payload,
+            uint8_t system_id,
+            uint8_t component_id,
+            bool mav2)
+    {
         if (mav2) {
-            buffer = encoder.Encode_v2(payload, system_id, component_id);
+            return encoder.Encode_v2(payload, system_id, component_id);
         } else {
-            buffer = encoder.Encode_v1(payload, system_id, component_id);
+            return encoder.Encode_v1(payload, system_id, component_id);
         }
+    }
+
+    /** Encode Mavlink message in the protocol version currently selected
+     * for outgoing messages.
+     */
+    Io_buffer::Ptr
+    Encode_message(
+            const mavlink::Payload_base& payload,
+            uint8_t system_id,
+            uint8_t component_id)
+    {
+        return Encode_message(payload, system_id, component_id, send_mavlink2);
+    }
+
+    /** Send already encoded Mavlink messages to other end asynchronously.
+     * The same requirements for the timeout and completion context apply as
+     * for Send_message().
+     */
+    void
+    Send_buffer(
+            Io_buffer::Ptr buffer,
+            const std::chrono::milliseconds& timeout,
+            Operation_waiter::Timeout_handler timeout_handler,
+            const Request_completion_context::Ptr& completion_ctx)
+    {
+        ASSERT(completion_ctx->Get_type() != Request_completion_context::Type::TEMPORAL);
 
         Operation_waiter waiter = stream->Write(
                 buffer,
@@ -155,6 +254,10 @@ public:
     void
     Disable()
     {
+        if (decode_strand) {
+            /* Waits for the data being decoded. */
+            decode_strand->Disable();
+        }
         decoder.Disable();
         demuxer.Disable();
         stream = nullptr;
@@ -177,6 +280,19 @@ private:
     /** Encoder used with a stream. */
     Mavlink_encoder encoder;
 
+    /** Strand for offloaded decoding, nullptr if decoding is done in the
+     * calling thread.
+     */
+    Request_strand::Ptr decode_strand;
+
+    /** Decode data in the decoding thread. */
+    void
+    Decode_offloaded(Io_buffer::Ptr buffer, Request::Ptr request)
+    {
+        decoder.Decode(buffer);
+        request->Complete();
+    }
+
     /** Removes completed write operations from the top of the queue. */
     void
     Cleanup_write_ops()
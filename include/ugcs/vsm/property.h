@@ -8,6 +8,7 @@
 #include <ucs_vsm_proto.h>
 #include <ugcs/vsm/utils.h>
 #include <ugcs/vsm/optional.h>
+#include <ugcs/vsm/property_history.h>
 #include <unordered_map>
 
 namespace ugcs {
@@ -35,6 +36,22 @@ public:
         VALUE_SPEC_NA = 2,      // Value is "N/A"
     } Value_spec;
 
+    // Do not send telemetry field to server more than 5 times per second
+    // by default.
+    static constexpr std::chrono::milliseconds COMMIT_TIMEOUT = std::chrono::milliseconds(200);
+
+    // Rules for sending telemetry field to server. Zero value disables the
+    // corresponding rule.
+    struct Commit_policy {
+        // Minimal interval between sending of changed values.
+        std::chrono::milliseconds min_interval = COMMIT_TIMEOUT;
+        // Numeric value is not sent until it differs from the last sent
+        // value by at least this much.
+        double deadband = 0;
+        // Value is re-sent after this interval even if it has not changed.
+        std::chrono::milliseconds heartbeat = std::chrono::milliseconds(0);
+    };
+
     // Create from built in semantics
     Property(int id, const std::string& name, proto::Field_semantic semantic);
 
@@ -121,6 +138,26 @@ public:
     void
     Set_value_na();
 
+    // Set value and remember the time when it was received from the vehicle.
+    // Used to measure the age of telemetry at the moment it is sent to server.
+    // Default constructed time is ignored, i.e. receive time is not known.
+    // SDK does not parse vehicle telemetry, so VSM should pass the receive
+    // time of the message the value is taken from, e.g.
+    // Set_value(v, message->Get_rx_time()). Otherwise the time of this call
+    // is used and the age does not include the VSM processing delay.
+    template<typename Type>
+    void
+    Set_value(Type v, std::chrono::time_point<std::chrono::steady_clock> rx_time)
+    {
+        Set_value(v);
+        if (rx_time != std::chrono::time_point<std::chrono::steady_clock>()) {
+            this->rx_time = rx_time;
+            if (history) {
+                history->Set_last_time(rx_time);
+            }
+        }
+    }
+
     // Set value from incoming message
     bool
     Set_value(const proto::Field_value& val);
@@ -179,6 +216,32 @@ public:
     bool
     Is_changed();
 
+    // Same as above but uses the given commit policy instead of the default
+    // one. Minimal interval is multiplied by interval_scale which is used
+    // to reduce telemetry rate on congested links.
+    bool
+    Is_changed(const Commit_policy& policy, double interval_scale = 1);
+
+    // Set commit policy of this field. Overrides the policy given for
+    // field semantic via Device::Set_telemetry_policy().
+    void
+    Set_commit_policy(const Commit_policy& policy);
+
+    // Commit policy of this field or nullptr if not set.
+    const Commit_policy*
+    Get_commit_policy() {return has_commit_policy ? &commit_policy : nullptr;}
+
+    // Keep history of the last capacity values of numeric or bool property.
+    // Each Set_value() call records one sample stamped with the receive
+    // time. Zero capacity disables the history. Telemetry fields should use
+    // Device::Enable_telemetry_history() which bounds the memory per device.
+    void
+    Enable_history(size_t capacity);
+
+    // History of the value or nullptr if not enabled.
+    Property_history::Ptr
+    Get_history() {return history;}
+
     // Force sending telemetry on value update even if value has not changed.
     void
     Set_changed();
@@ -195,6 +258,11 @@ public:
     std::chrono::time_point<std::chrono::system_clock>
     Get_update_time() {return update_time;}
 
+    // Time when the current value was received from the vehicle.
+    // Equals to the time of the last Set_value call if not given explicitly.
+    std::chrono::time_point<std::chrono::steady_clock>
+    Get_rx_time() {return rx_time;}
+
     std::string
     Dump_value();
 
@@ -231,14 +299,29 @@ private:
     std::chrono::seconds timeout = std::chrono::seconds(0); // timeout in seconds
     Value_spec value_spec = VALUE_SPEC_NA;
     std::chrono::time_point<std::chrono::system_clock> update_time;
+    std::chrono::time_point<std::chrono::steady_clock> rx_time;
 
     // time when field was last sent to server.
     // Used to throttle telemetry sending to server.
     std::chrono::time_point<std::chrono::steady_clock> last_commit_time;
 
-    // do not send telemetry field to server more than 5 times per second.
-    // TODO: make this configurable
-    static constexpr std::chrono::milliseconds COMMIT_TIMEOUT = std::chrono::milliseconds(200);
+    Commit_policy commit_policy;
+    bool has_commit_policy = false;
+
+    // Numeric value last sent to server. Used for deadband check.
+    double committed_value = 0;
+    bool is_committed_value_valid = false;
+
+    // Recent values, nullptr if history is disabled.
+    Property_history::Ptr history;
+
+    // Record current value into the history.
+    void
+    Record_history();
+
+    // true if numeric value is within deadband from the last sent value.
+    bool
+    Is_within_deadband(double deadband);
 
     static proto::Field_semantic
     Get_default_semantic(const std::string& name);
@@ -0,0 +1,150 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/**
+ * @file property_history.h
+ *
+ * Time series history of a numeric property value.
+ */
+
+#ifndef _UGCS_VSM_PROPERTY_HISTORY_H_
+#define _UGCS_VSM_PROPERTY_HISTORY_H_
+
+#include <ugcs/vsm/utils.h>
+#include <ugcs/vsm/clock.h>
+
+#include <vector>
+
+namespace ugcs {
+namespace vsm {
+
+/** Fixed capacity ring buffer of the recent values of a numeric property.
+ * Timestamps and values are stored in separate arrays allocated on
+ * construction, so recording a sample does not allocate and queries scan
+ * contiguous memory. When the buffer is full, the oldest sample is
+ * overwritten. N/A values are recorded as NaN and skipped by the queries.
+ *
+ * Samples are expected to be recorded in time order. Not thread safe, should
+ * be used from the context of the property owner.
+ */
+class Property_history: public std::enable_shared_from_this<Property_history> {
+    DEFINE_COMMON_CLASS(Property_history, Property_history)
+
+public:
+    /** Memory used by one sample in bytes. */
+    static constexpr size_t SAMPLE_SIZE = sizeof(Clock::Time_point) + sizeof(double);
+
+    /** Recorded value. */
+    struct Sample {
+        Clock::Time_point time;
+        double value;
+    };
+
+    /** Statistics of the values in a time window. */
+    struct Stats {
+        /** Number of valid samples in the window. Other fields are NaN if
+         * zero.
+         */
+        size_t count = 0;
+        double min;
+        double max;
+        double mean;
+    };
+
+    /** Construct history.
+     *
+     * @param capacity Maximal number of samples, should be non-zero.
+     * @throw Invalid_param_exception if capacity is zero.
+     */
+    Property_history(size_t capacity);
+
+    /** Record a sample, overwriting the oldest one if full. */
+    void
+    Record(Clock::Time_point time, double value)
+    {
+        times[head] = time;
+        values[head] = value;
+        head = head + 1 == capacity ? 0 : head + 1;
+        if (size < capacity) {
+            size++;
+        }
+    }
+
+    /** Change time of the last recorded sample. */
+    void
+    Set_last_time(Clock::Time_point time);
+
+    /** Get maximal number of samples. */
+    size_t
+    Get_capacity() const
+    {
+        return capacity;
+    }
+
+    /** Get number of recorded samples. */
+    size_t
+    Get_size() const
+    {
+        return size;
+    }
+
+    /** Get recorded sample.
+     *
+     * @param index Sample index, zero is the oldest one.
+     * @throw Invalid_param_exception if index is out of range.
+     */
+    Sample
+    Get_sample(size_t index) const;
+
+    /** Calculate statistics of the samples in the time range [from, to]. */
+    Stats
+    Get_stats(Clock::Time_point from,
+              Clock::Time_point to = Clock::Time_point::max()) const;
+
+    /** Calculate statistics of the samples not older than the window. */
+    Stats
+    Get_stats(Clock::Duration window) const;
+
+    /** Downsample the history in the time range [from, to). The range is
+     * split into intervals of the specified step, each interval with valid
+     * samples gives one sample with the mean value, stamped with the
+     * interval start time.
+     *
+     * @throw Invalid_param_exception if step is not positive.
+     */
+    std::vector<Sample>
+    Downsample(Clock::Time_point from, Clock::Time_point to, Clock::Duration step) const;
+
+    /** Remove all samples. */
+    void
+    Clear();
+
+private:
+    size_t capacity;
+
+    /** Sample timestamps. */
+    std::vector<Clock::Time_point> times;
+
+    /** Sample values, same indexing as times. */
+    std::vector<double> values;
+
+    /** Index where the next sample is written. */
+    size_t head = 0;
+
+    /** Number of recorded samples. */
+    size_t size = 0;
+
+    /** Get array index of the sample, zero is the oldest one. */
+    size_t
+    Get_index(size_t index) const
+    {
+        size_t i = head + capacity - size + index;
+        return i >= capacity ? i - capacity : i;
+    }
+};
+
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* _UGCS_VSM_PROPERTY_HISTORY_H_ */
@@ -12,14 +12,17 @@
 #define _UGCS_VSM_REQUEST_CONTAINER_H_
 
 #include <ugcs/vsm/callback.h>
+#include <ugcs/vsm/clock.h>
 #include <ugcs/vsm/utils.h>
 
 #include <memory>
 #include <mutex>
 #include <chrono>
 #include <condition_variable>
+#include <array>
 #include <atomic>
 #include <list>
+#include <unordered_set>
 
 namespace ugcs {
 namespace vsm {
@@ -31,6 +34,23 @@ class Request_container: public std::enable_shared_from_this<Request_container>
     DEFINE_COMMON_CLASS(Request_container, Request_container)
 
 public:
+    /** Priority class of a request. Container serves queued requests of a
+     * higher class first, see Request_queue.
+     */
+    enum class Priority {
+        /** Latency critical requests, e.g. emergency commands. */
+        HIGH,
+        /** Default class. */
+        NORMAL,
+        /** Bulk traffic, e.g. telemetry. */
+        LOW
+    };
+
+    /** Number of priority classes. */
+    static constexpr size_t PRIORITY_COUNT = 3;
+
+    class Request_queue;
+
     /** Generic request for implementing inter-threads communications and asynchronous
      * operations.
      */
@@ -38,6 +58,9 @@ public:
         DEFINE_COMMON_CLASS(Request, Request)
 
     public:
+        /** Priority class type. */
+        typedef Request_container::Priority Priority;
+
         /** Request processing status which is returned by the handler or set
          * internally.
          */
@@ -308,6 +331,42 @@ public:
             return timed_out;
         }
 
+        /** Set priority class of the request. Should be set before the
+         * request is submitted, applies both to processing and completion
+         * notification.
+         */
+        void
+        Set_priority(Priority priority)
+        {
+            this->priority = priority;
+        }
+
+        /** Get priority class of the request. */
+        Priority
+        Get_priority() const
+        {
+            return priority;
+        }
+
+        /** Allow the container to abort the request while it is still
+         * queued, when the container is overloaded and its overflow policy is
+         * Overflow_policy::DROP_OLDEST. Intended for requests superseded by
+         * later ones, e.g. periodic telemetry. Should be set before the
+         * request is submitted.
+         */
+        void
+        Set_droppable(bool droppable = true)
+        {
+            this->droppable = droppable;
+        }
+
+        /** Check if the request can be dropped on overload. */
+        bool
+        Is_droppable() const
+        {
+            return droppable;
+        }
+
     protected:
         /** Called to destroy request. Primarily should be used by derived classes
          * to destroy circular references if such exist.
@@ -325,6 +384,14 @@ public:
         Is_completion_handler_present();
 
     private:
+        friend class Request_queue;
+
+        /** Priority class. */
+        Priority priority = Priority::NORMAL;
+        /** Request can be dropped on overload. */
+        bool droppable = false;
+        /** Time when the request was queued, set by Request_queue. */
+        Clock::Time_point queued_time;
         /** Request processing handler. Called when request is about to be processed. */
         Handler processing_handler;
         /** Request completion handler. Called when request is completed. */
@@ -421,17 +488,61 @@ public:
                          std::chrono::milliseconds timeout = std::chrono::milliseconds::zero(),
                          int requests_limit = 0, Predicate predicate = Predicate());
 
+        /** Wait for request submission. It blocks until request submitted or the
+         * specified timeout elapses. If there are some requests submitted they
+         * are processed. After processing the method exits.
+         *
+         * @param containers Set of containers to check and wait for.
+         * @param timeout Timeout in milliseconds. Zero value indicates indefinite
+         *      waiting.
+         * @param requests_limit Limit of requests to process at once. Zero means no
+         *      limit.
+         * @param predicate Predicate to check during waiting. It overrides
+         *      default predicate which checks number of processed requests.
+         * @return Number of requests processed.
+         */
+        int
+        Wait_and_process(const std::unordered_set<Request_container::Ptr> &containers,
+                         std::chrono::milliseconds timeout = std::chrono::milliseconds::zero(),
+                         int requests_limit = 0, Predicate predicate = Predicate());
+
         virtual
         ~Request_waiter() = default;
 
     private:
         friend class Locker;
+        friend class Request_container;
+
+        /** Maximal number of requests processed from one container before
+         * other ready containers get their turn.
+         */
+        static constexpr int READY_QUANTUM = 16;
 
         /** Mutex for submitting and waiting/getting requests. */
         std::mutex mutex;
         /** Condition variable for waiting and notifying about requests. */
         std::condition_variable cond_var;
 
+        /** Containers which have queued requests or are disabled, in order
+         * of their turn. So a wakeup visits only containers with work
+         * instead of all containers associated with the waiter. Protected
+         * by the mutex.
+         */
+        std::list<std::weak_ptr<Request_container>> ready_list;
+
+        /** Append the container to the ready list if it is not there yet.
+         * Container which is being destroyed is not added. Called with the
+         * mutex locked.
+         */
+        void
+        Push_ready(Request_container *container);
+
+        /** Remove the container from the ready list. Called with the mutex
+         * locked.
+         */
+        void
+        Remove_ready(Request_container *container);
+
         /** Implementation for public methods Wait_and_process.
          * @see Wait_and_process
          */
@@ -442,6 +553,134 @@ public:
                               int requests_limit, Predicate ext_predicate);
     };
 
+    /** Queue statistics of one priority lane. */
+    struct Lane_stats {
+        /** Number of requests currently queued. */
+        size_t queued = 0;
+        /** Number of requests taken for processing. */
+        uint64_t processed = 0;
+        /** Total time spent in the queue by processed requests. */
+        std::chrono::nanoseconds total_latency = std::chrono::nanoseconds::zero();
+        /** Maximal time spent in the queue by a processed request. */
+        std::chrono::nanoseconds max_latency = std::chrono::nanoseconds::zero();
+    };
+
+    /** Queue of requests with a lane per priority class. Lanes are served
+     * by strict priority, except that a waiting lower lane gets one request
+     * after STARVATION_LIMIT requests were taken from higher lanes. Requests
+     * of the same lane are served in submission order. Protected by the
+     * waiter of the container.
+     */
+    class Request_queue {
+    public:
+        /** Number of requests taken from higher lanes while a lower lane
+         * is waiting before it gets its turn.
+         */
+        static constexpr unsigned STARVATION_LIMIT = 32;
+
+        /** Queue the request to the lane of its priority. */
+        void
+        Push(Request::Ptr request);
+
+        /** Take next request to process.
+         * @return nullptr if the queue is empty.
+         */
+        Request::Ptr
+        Pop();
+
+        /** Check if the queue is empty. */
+        bool
+        Is_empty() const
+        {
+            return !size;
+        }
+
+        /** Number of requests in all lanes. */
+        size_t
+        Get_size() const
+        {
+            return size;
+        }
+
+        /** Remove all requests, higher lanes first. */
+        std::list<Request::Ptr>
+        Take_all();
+
+        /** Invoke the function for each queued request. */
+        template <class Function>
+        void
+        For_each(Function func) const
+        {
+            for (auto &lane : lanes) {
+                for (auto &request : lane.requests) {
+                    func(request);
+                }
+            }
+        }
+
+        /** Get statistics of the lane. */
+        Lane_stats
+        Get_stats(Priority priority) const;
+
+        /** Remove the oldest droppable request, lower lanes first. Requests
+         * of the HIGH lane are never removed.
+         * @return nullptr if there are no droppable requests.
+         */
+        Request::Ptr
+        Remove_droppable();
+
+    private:
+        struct Lane {
+            std::list<Request::Ptr> requests;
+            /** Requests taken from higher lanes since this lane is waiting. */
+            unsigned starved = 0;
+            Lane_stats stats;
+        };
+
+        std::array<Lane, PRIORITY_COUNT> lanes;
+
+        size_t size = 0;
+    };
+
+    /** What to do with a submitted request when the container queue is at
+     * its capacity.
+     */
+    enum class Overflow_policy {
+        /** Submitter waits until the queue has space. Should not be used by
+         * containers which can be submitted to from their own serving thread.
+         */
+        BLOCK,
+        /** Submission fails with Overflow_exception. */
+        REJECT,
+        /** Oldest droppable request is aborted to make space, see
+         * Request::Set_droppable. If there is none, the submitted request is
+         * aborted if droppable, otherwise it is queued over the capacity.
+         */
+        DROP_OLDEST
+    };
+
+    /** Thrown when a request is submitted to a full container with
+     * Overflow_policy::REJECT. The request is left pending, the submitter
+     * should abort it or retry later.
+     */
+    VSM_DEFINE_EXCEPTION(Overflow_exception);
+
+    /** Queue depth and overload counters of the container. */
+    struct Overload_stats {
+        /** Number of requests currently queued. */
+        size_t depth = 0;
+        /** Maximal number of queued requests observed. */
+        size_t max_depth = 0;
+        /** Number of times the queue became full. */
+        uint64_t overload_events = 0;
+        /** Number of requests rejected. */
+        uint64_t rejected = 0;
+        /** Number of requests dropped. */
+        uint64_t dropped = 0;
+        /** Number of submissions which had to wait for space. */
+        uint64_t blocked = 0;
+    };
+
     /** Container type. */
     enum class Type {
         /** None type used in base class. */
@@ -557,6 +796,25 @@ public:
     bool
     Is_enabled() const;
 
+    /** Get queue statistics of the priority lane. */
+    Lane_stats
+    Get_lane_stats(Priority priority);
+
+    /** Limit the number of queued requests. Requests of HIGH priority are
+     * always accepted and are not dropped, so the limit can be exceeded by
+     * them.
+     *
+     * @param capacity Maximal number of queued requests, zero for unbounded
+     *      queue which is the default.
+     * @param policy What to do with requests submitted to the full queue.
+     */
+    void
+    Set_capacity(size_t capacity, Overflow_policy policy = Overflow_policy::REJECT);
+
+    /** Get queue depth and overload counters. */
+    Overload_stats
+    Get_overload_stats();
+
 protected:
     /** Waiter associated with this container. It is used to synchronize access
      * to the request queue in derived classes.
@@ -565,7 +823,7 @@ protected:
     /** Queue of pending requests, i.e. waiting for completion notification
      * processing.
      */
-    std::list<Request::Ptr> request_queue;
+    Request_queue request_queue;
 
     /** Request processing loop implementation. It does not return while the
      * container is enabled.
@@ -618,6 +876,22 @@ private:
     void
     Abort_requests();
 
+    /** Make space for the request if the queue is full, according to the
+     * overflow policy. Called with the waiter locked, which can be
+     * temporarily released while blocked.
+     *
+     * @return Request to abort after the waiter is unlocked, if any.
+     * @throws Overflow_exception if the request is rejected.
+     */
+    Request::Ptr
+    Check_capacity(const Request::Ptr &request);
+
+    /** Update overload state after requests were taken from the queue.
+     * Called with the waiter locked.
+     */
+    void
+    On_requests_taken();
+
     /** Indicates the container is currently enabled. */
     std::atomic_bool is_enabled = { false };
 
@@ -635,6 +909,35 @@ private:
 
     /** Queue of the requests being abort during context disabling. */
     std::list<Request::Ptr> aborted_request_queue;
+
+    /** The container is in the ready list of its waiter. Protected by the
+     * waiter mutex.
+     */
+    bool in_ready_list = false;
+
+    /** Maximal number of queued requests, zero if unbounded. Protected by
+     * the waiter mutex as well as the members below.
+     */
+    size_t capacity = 0;
+
+    /** Policy applied when the queue is full. */
+    Overflow_policy overflow_policy = Overflow_policy::REJECT;
+
+    /** Overload counters. */
+    Overload_stats overload_stats;
+
+    /** The queue has been full and not yet drained below half of the
+     * capacity.
+     */
+    bool overloaded = false;
+
+    /** Number of submitters waiting for space. */
+    size_t blocked_submitters = 0;
+
+    /** Signalled when space appears in the queue or the container is
+     * disabled. Used with the waiter mutex.
+     */
+    std::condition_variable space_cond;
 };
 
 /** Request waiter type for convenient usage. */
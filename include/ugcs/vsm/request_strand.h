@@ -0,0 +1,116 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/**
+ * @file request_strand.h
+ *
+ * Request strand - ordered request container without dedicated thread.
+ */
+
+#ifndef _UGCS_VSM_REQUEST_STRAND_H_
+#define _UGCS_VSM_REQUEST_STRAND_H_
+
+#include <ugcs/vsm/request_container.h>
+
+#include <condition_variable>
+#include <thread>
+
+namespace ugcs {
+namespace vsm {
+
+/** Request container which processes its requests one by one in submission
+ * order, but has no dedicated thread. When it has pending requests it
+ * schedules itself to the executor container, which is typically a
+ * Request_worker with a pool of threads shared between many strands. So
+ * handlers submitted to the same strand never run concurrently, while
+ * different strands are processed in parallel.
+ *
+ * Strand can be used both as request processor and completion context, e.g.
+ * for a Device instead of dedicated worker thread.
+ *
+ * Strand should be disabled before its executor.
+ */
+class Request_strand: public Request_container {
+    DEFINE_COMMON_CLASS(Request_strand, Request_container)
+
+public:
+    /** Construct strand.
+     *
+     * @param name Strand name.
+     * @param executor Container which runs the strand, should process
+     *      requests, e.g. Request_worker.
+     * @throw Nullptr_exception if executor is not specified.
+     */
+    Request_strand(const std::string& name, Request_container::Ptr executor);
+
+    /** Get this container type. */
+    virtual Type
+    Get_type() const override
+    {
+        return Type::ANY;
+    }
+
+private:
+    /** Waiter which schedules the strand on request submission. */
+    class Strand_waiter: public Request_waiter {
+        DEFINE_COMMON_CLASS(Strand_waiter, Request_waiter)
+
+    public:
+        /** Strand should outlive its waiter usage. */
+        Strand_waiter(Request_strand *strand):
+            strand(strand)
+        {}
+
+        virtual void
+        Notify() override;
+
+    private:
+        Request_strand *strand;
+    };
+
+    /** Maximal number of requests processed at once before the strand is
+     * re-scheduled, so other strands of the executor are not starved.
+     */
+    static constexpr int RUN_BATCH = 16;
+
+    /** Executor container. */
+    Request_container::Ptr executor;
+
+    /** Protects the state below. */
+    std::mutex state_mutex;
+
+    /** Signaled when the strand is not scheduled anymore. */
+    std::condition_variable idle_cond;
+
+    /** Run request is submitted to the executor or is being processed. */
+    bool scheduled = false;
+
+    /** Thread which currently processes the strand requests. */
+    std::thread::id run_thread;
+
+    /** Submit run request to the executor if there are pending requests and
+     * it is not submitted yet.
+     */
+    void
+    Schedule();
+
+    /** Process pending requests in the executor thread. */
+    void
+    Run(Request::Ptr request);
+
+    /** Submit run request to the executor. */
+    void
+    Submit_run();
+
+    virtual void
+    On_disable() override;
+
+    virtual void
+    Process_request(Request::Ptr request) override;
+};
+
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* _UGCS_VSM_REQUEST_STRAND_H_ */
@@ -14,6 +14,7 @@
 #include <ugcs/vsm/request_context.h>
 
 #include <thread>
+#include <vector>
 
 namespace ugcs {
 namespace vsm {
@@ -29,6 +30,15 @@ public:
     Request_worker(const std::string& name) :
         Request_completion_context(name) {}
 
+    /** Construct worker with a pool of threads. Requests submitted to the
+     * worker are processed by any of the threads concurrently, so it is
+     * typically used as executor for Request_strand instances which provide
+     * ordering.
+     *
+     * @param threads_count Number of threads, should be non-zero.
+     */
+    Request_worker(const std::string& name, size_t threads_count);
+
     /** Construct request worker by list of containers to work with. */
     Request_worker(
             const std::string& name,
@@ -55,10 +65,14 @@ public:
     Disable_containers();
 
 private:
-    /** Dedicated thread. */
-    std::thread thread;
+    /** Number of dedicated threads. */
+    size_t threads_count = 1;
+    /** Dedicated threads. */
+    std::vector<std::thread> threads;
     /** Associated containers. */
     std::list<Request_container::Ptr> containers;
+    /** The same containers for fast lookup while processing. */
+    std::unordered_set<Request_container::Ptr> container_set;
 
     /** Handle container enabling. */
     virtual void
@@ -0,0 +1,78 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/**
+ * @file sha256.h
+ *
+ * SHA-256 hash function.
+ */
+
+#ifndef _UGCS_VSM_SHA256_H_
+#define _UGCS_VSM_SHA256_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace ugcs {
+namespace vsm {
+
+/** Incremental SHA-256 hash calculation. Block transform uses SHA
+ * instructions of the CPU if they are available (SHA-NI on x86, crypto
+ * extensions on ARMv8), otherwise portable implementation.
+ */
+class Sha256 {
+public:
+    /** Length of the digest in bytes. */
+    static constexpr size_t DIGEST_LEN = 32;
+
+    /** Length of the transform block in bytes. */
+    static constexpr size_t BLOCK_LEN = 64;
+
+    /** Digest type. */
+    typedef std::array<uint8_t, DIGEST_LEN> Digest;
+
+    /** Start new hash calculation.
+     *
+     * @param allow_acceleration Use CPU SHA instructions if available.
+     */
+    explicit Sha256(bool allow_acceleration = true);
+
+    /** Hash next portion of data. */
+    void
+    Update(const void *data, size_t len);
+
+    /** Finish the calculation. The instance should not be used after that. */
+    Digest
+    Final();
+
+    /** Calculate digest of the data at once. */
+    static Digest
+    Calculate(const void *data, size_t len);
+
+    /** Check if CPU SHA instructions are available and used. */
+    static bool
+    Is_accelerated();
+
+private:
+    /** Block transform function type. */
+    typedef void (*Transform)(uint32_t *state, const uint8_t *blocks, size_t count);
+
+    Transform transform;
+
+    uint32_t state[8];
+
+    /** Partial block. */
+    uint8_t buffer[BLOCK_LEN];
+
+    size_t buffer_len = 0;
+
+    /** Total length of the hashed data. */
+    uint64_t total_len = 0;
+};
+
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* _UGCS_VSM_SHA256_H_ */
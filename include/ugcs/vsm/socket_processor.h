@@ -10,6 +10,7 @@
 #ifndef _UGCS_VSM_SOCKET_PROCESSOR_H_
 #define _UGCS_VSM_SOCKET_PROCESSOR_H_
 
+#include <ugcs/vsm/address_resolver.h>
 #include <ugcs/vsm/io_request.h>
 #include <ugcs/vsm/piped_request_waiter.h>
 #include <ugcs/vsm/singleton.h>
@@ -59,6 +60,48 @@ public:
         return singleton.Get_instance(std::forward<Args>(args)...);
     }
 
+    /** CAN identifier filter. Frame is accepted when
+     * (frame_id & mask) == (id & mask). Identifier flags (EFF, RTR) can be
+     * included in both fields as in SocketCAN API.
+     */
+    struct Can_filter {
+        uint32_t id;
+        uint32_t mask;
+    };
+
+    /** Options of CAN stream created by Bind_can(). */
+    struct Can_options {
+        /** Frames to receive, filtering is done in kernel. Empty means all. */
+        std::vector<Can_filter> filters;
+        /** Receive and send CAN FD frames in addition to classic ones. */
+        bool fd_frames = false;
+        /** Read returns all pending frames at once packed into one buffer,
+         * each frame preceded by Can_frame_header.
+         */
+        bool batched = false;
+        /** Fill frame timestamps in batched mode. */
+        bool timestamps = false;
+    };
+
+    /** Header of each frame record in batched CAN read buffer. It is followed
+     * by frame_size bytes of raw frame (struct can_frame or
+     * struct canfd_frame). Records are 8 bytes aligned.
+     */
+    struct Can_frame_header {
+        /** Receive time in nanoseconds, hardware clock if
+         * CAN_FRAME_HW_TIMESTAMP flag is set, system real time clock
+         * otherwise. Zero if not available.
+         */
+        uint64_t timestamp;
+        /** Size of the following frame. */
+        uint32_t frame_size;
+        /** Frame flags. */
+        uint32_t flags;
+    };
+
+    /** Timestamp of the frame is taken from hardware. */
+    static constexpr uint32_t CAN_FRAME_HW_TIMESTAMP = 1;
+
     /** Socket specific stream. */
     class Stream: public Io_stream
     {
@@ -138,6 +181,29 @@ public:
         bool
         Enable_broadcast(bool enable);
 
+        /** Completion handler of Splice_to(). */
+        typedef Callback_proxy<
+                void,
+                uint64_t,   // number of bytes relayed
+                Io_result   // OK if the source reached end of stream.
+                > Splice_handler;
+
+        /** Relay all data received from this TCP stream to the target TCP
+         * stream inside the kernel, without copying it to user space. See
+         * Socket_processor::Is_splice_supported().
+         *
+         * Completes with OK when this stream reaches end of stream, with
+         * CLOSED when either stream fails or is closed, with CANCELED when
+         * canceled, with OTHER_FAILURE if relaying is not possible for the
+         * streams. Reads from this stream and writes to the target should
+         * not be issued while relaying.
+         */
+        Operation_waiter
+        Splice_to(
+                Stream::Ptr target,
+                Splice_handler completion_handler,
+                Request_completion_context::Ptr comp_ctx = Request_temp_completion_context::Create());
+
         typedef std::unique_ptr<std::vector<uint8_t>> Buf_ptr;
 
     private:
@@ -216,6 +282,22 @@ public:
 
         Io_request::Ptr connect_request;
 
+        // Splice relay state of the source stream, see Splice_to().
+        Io_request::Ptr splice_request;
+        Splice_handler splice_handler;
+        Stream::Ptr splice_target;
+        int splice_pipe[2] = {-1, -1};
+        // Bytes spliced into the pipe but not yet to the target.
+        size_t splice_pending = 0;
+        uint64_t spliced_bytes = 0;
+        // Set on the target stream of a splice relay.
+        Stream::Ptr splice_source;
+
+        // CAN stream options.
+        bool can_batched = false;
+        bool can_fd = false;
+        bool can_timestamps = false;
+
         // true if socket was connected using connect() call.
         // I.e. no need to specify destination when doing send().
         // Applies to both SOCK_DGRAM and SOCK_STREAM
@@ -229,6 +311,9 @@ public:
 
         std::list<Io_request::Ptr> accept_requests;
 
+        // Continuous read, served when no read requests are pending.
+        Read_subscription::Ptr read_subscription;
+
         Buf_ptr reading_buffer;
         size_t read_bytes = 0;      // bytes read by current read request
         size_t written_bytes = 0;   // bytes written by current write request
@@ -275,6 +360,10 @@ public:
         Close_impl(Close_handler completion_handler,
                    Request_completion_context::Ptr comp_ctx) override;
 
+        /** @see Io_stream::Subscribe_impl */
+        void
+        Subscribe_impl(Read_subscription::Ptr subscription) override;
+
         void
         Process_udp_read_requests();
     };
@@ -437,9 +526,34 @@ public:
             Listen_handler completion_handler,
             Request_completion_context::Ptr completion_context = Request_temp_completion_context::Create());
 
+    /** Create CAN socket with the specified options.
+     *
+     * In batched mode a read request is completed as soon as at least one
+     * frame is available and returns as many frames as fit into max_to_read
+     * bytes, min_to_read is ignored. Frames are received with one system call
+     * per batch where supported.
+     *
+     * @param interface CAN interface name. Typically "can0" or "vcan0".
+     * @param options Stream options.
+     *
+     * See Listen_handler for completion handler parameters.
+     */
+    Operation_waiter
+    Bind_can(
+            std::string interface,
+            Can_options options,
+            Listen_handler completion_handler,
+            Request_completion_context::Ptr completion_context = Request_temp_completion_context::Create());
+
     static std::list<Local_interface>
     Enumerate_local_interfaces();
 
+    /** Check if Stream::Splice_to() is supported on this platform. If not,
+     * data should be relayed by reading and writing buffers.
+     */
+    static bool
+    Is_splice_supported();
+
 protected:
     /** Worker thread of socket processor. */
     std::thread thread;
@@ -451,6 +565,9 @@ protected:
      */
     Request_completion_context::Ptr completion_ctx;
 
+    /** Resolves peer names off the processor thread. */
+    Address_resolver::Ptr resolver;
+
     /** Handle processor enabling. */
     void
     On_enable() override;
@@ -472,6 +589,21 @@ protected:
     void
     On_read(Read_request::Ptr request, Socket_address::Ptr addr = nullptr);
 
+    /** Attach read subscription to the stream. */
+    void
+    On_subscribe(Request::Ptr request, Stream::Ptr stream,
+                 Read_subscription::Ptr subscription);
+
+    /** Called by the subscription of the stream when it can accept more
+     * data or is canceled. Invoked in arbitrary thread.
+     */
+    void
+    On_subscription_ready(Stream::Ptr stream);
+
+    /** Resume reading for the stream subscription in processor context. */
+    void
+    On_subscription_resume(Request::Ptr request, Stream::Ptr stream);
+
     void
     On_close(Io_request::Ptr request);
 
@@ -481,13 +613,23 @@ protected:
     void
     On_connect(Io_request::Ptr request, Stream::Ptr stream);
 
+    /** Peer name resolved asynchronously for connect request. */
+    void
+    On_connect_resolved(Resolved_addresses::Ptr addresses,
+                        Io_request::Ptr request, Stream::Ptr stream);
+
+    /** Connect the stream to one of the resolved peer addresses. */
+    void
+    Connect_resolved(Io_request::Ptr request, Stream::Ptr stream,
+                     Resolved_addresses::Ptr addresses);
+
     void
     On_listen(Io_request::Ptr request, Stream::Ptr stream, Socket_address::Ptr addr);
 
     void
     On_bind_can(
         Io_request::Ptr request,
-        std::vector<int> filter_messges,
+        Can_options options,
         Stream::Ptr stream,
         std::string iface_id);
 
@@ -500,6 +642,14 @@ protected:
     void
     On_get_addr_info(Io_request::Ptr request, Get_addr_info_handler handler);
 
+    void
+    On_splice(Io_request::Ptr request, Stream::Ptr target,
+              Stream::Splice_handler handler);
+
+    void
+    On_addr_info_resolved(Resolved_addresses::Ptr addresses,
+                          Io_request::Ptr request, Get_addr_info_handler handler);
+
     Operation_waiter
     Accept_impl(
         Socket_listener::Ref listener,
@@ -518,6 +668,11 @@ private:
 
     Streams_map streams;
 
+    /** Receive buffer of read subscriptions. Chunks are copied out of it in
+     * their actual size, so a large chunk size does not waste memory.
+     */
+    std::vector<uint8_t> subscription_read_buffer;
+
     /** Socket processor singleton instance. */
     static Singleton<Socket_processor> singleton;
 
@@ -538,9 +693,41 @@ private:
     void
     Handle_write_requests(Stream::Ptr stream);
 
+    /** Write data of several pending write requests of TCP stream by one
+     * system call.
+     * @return true if all gathered requests are completed and there may be
+     *      more to write, false if the remaining requests should be handled
+     *      one by one.
+     */
+    bool
+    Handle_gather_write(Stream::Ptr stream);
+
     void
     Handle_read_requests(Stream::Ptr stream);
 
+    /** Read data for the stream subscription while it accepts more. */
+    void
+    Handle_read_subscription(Stream::Ptr stream);
+
+    /** Create splice pipe for the source stream.
+     * @return false if splice is not supported.
+     */
+    bool
+    Start_splice(Stream::Ptr source);
+
+    /** Move data of splice relay while both sockets are ready. */
+    void
+    Handle_splice(Stream::Ptr source);
+
+    /** Complete splice relay of the source stream and release the pipe. */
+    void
+    End_splice(Stream::Ptr source, Io_result result,
+               Request::Locker locker = Request::Locker());
+
+    /** Read requests handling for batched CAN streams. */
+    void
+    Handle_can_read_requests(Stream::Ptr stream);
+
     void
     Handle_udp_read_requests(Stream::Ptr stream);
 
@@ -70,6 +70,19 @@ public:
     Is_mission_item()
         {return in_mission;}
 
+    // Preemption rule: request which carries only preemptive commands is
+    // handled by the device before the requests queued earlier. Requests
+    // with any other command are handled in the order received, and the
+    // request being handled is never interrupted. Meant for emergency
+    // commands which do not depend on preceding ones, e.g. emergency_land.
+    void
+    Set_preemptive(bool preemptive = true)
+        {this->preemptive = preemptive;}
+
+    bool
+    Is_preemptive()
+        {return preemptive;}
+
 private:
     uint32_t command_id = 0;
     std::unordered_map<int, Property::Ptr> parameters;
@@ -77,6 +90,8 @@ private:
 
     bool in_mission = false;
 
+    bool preemptive = false;
+
     bool is_available = false;
     bool is_enabled = false;
     bool capability_state_dirty = true;
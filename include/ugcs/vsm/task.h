@@ -15,6 +15,7 @@
 #include <ugcs/vsm/task_attributes_action.h>
 #include <ugcs/vsm/optional.h>
 #include <ugcs/vsm/action.h>
+#include <ugcs/vsm/sha256.h>
 #include <vector>
 
 namespace ugcs {
@@ -25,6 +26,19 @@ typedef std::shared_ptr<ugcs::vsm::proto::Vsm_message> Proto_msg_ptr;
 /** Action plan for a single vehicle. */
 class Task {
 public:
+    /** Hash of a mission item. */
+    typedef Sha256::Digest Item_hash;
+
+    /** Range of mission items. Item indexes are the indexes of the mission
+     * sub-commands received from UCS, the same as the ids of the actions.
+     */
+    struct Item_range {
+        /** Index of the first item. */
+        size_t first;
+        /** Number of items. */
+        size_t count;
+    };
+
     /** Constructor.
      * @param reserved_size Initial size of the actions vector.
      */
@@ -56,7 +70,30 @@ public:
     void
     Set_takeoff_altitude(double altitude);
 
-    /** Action list of the task .*/
+    /** Check if the mission previously uploaded to the vehicle is known, so
+     * the task can be uploaded partially, only the changed items.
+     */
+    bool
+    Is_incremental() const
+    {
+        return !previous_item_hashes.empty();
+    }
+
+    /** Get ranges of the items which differ from the previously uploaded
+     * mission, in ascending order. Items outside of the ranges are the same
+     * as the items of the previous mission at the same indexes, except the
+     * items after a range which changes the number of items, those are
+     * shifted. Removal of items gives a range with zero count at the
+     * removal position. If the previous mission is not known, the range
+     * covers the whole task. Empty if the mission is not changed.
+     */
+    std::vector<Item_range>
+    Get_changed_items() const;
+
+    /** Action list of the task. Actions of the items which are not changed
+     * since the previous upload are copies of the previous actions, so the
+     * actions can be modified by the VSM.
+     */
     std::vector<Action::Ptr> actions;
 
     /** Task attributes action. If nullptr, then vehicle defaults should
@@ -69,6 +106,15 @@ public:
 
     Proto_msg_ptr ucs_response;
 
+    /** Hash of each mission item in UCS representation. */
+    std::vector<Item_hash> item_hashes;
+
+    /** Item hashes of the mission previously uploaded to the vehicle via
+     * this VSM, empty if not known or if the mission parameters (altitude
+     * origin, route parameters, task attributes) are changed since then.
+     */
+    std::vector<Item_hash> previous_item_hashes;
+
     bool return_native_route = false;
     bool use_crlf_in_native_route = false;
 
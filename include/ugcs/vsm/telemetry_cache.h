@@ -0,0 +1,145 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/**
+ * @file telemetry_cache.h
+ *
+ * Cache of the latest device telemetry values and command availability.
+ */
+
+#ifndef _UGCS_VSM_TELEMETRY_CACHE_H_
+#define _UGCS_VSM_TELEMETRY_CACHE_H_
+
+#include <ucs_vsm_proto.h>
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace ugcs {
+namespace vsm {
+
+/** Latest telemetry values and command availability of a device. Field and
+ * command ids are small dense integers given by Get_unique_id(), so values
+ * are kept in flat arrays indexed by id in compact form and converted to
+ * protobuf only when a snapshot is needed for a new server connection.
+ */
+class Telemetry_cache {
+public:
+    /** Store the latest value of telemetry field. */
+    void
+    Update(const proto::Telemetry_field &field);
+
+    /** Store the latest command availability. */
+    void
+    Update(const proto::Command_availability &availability);
+
+    /** Add all cached values to the device status message. Telemetry values
+     * which are not available (META_VALUE_NA) are omitted.
+     */
+    void
+    Fill(proto::Device_status &status) const;
+
+    /** Number of cached telemetry fields. */
+    size_t
+    Get_telemetry_count() const;
+
+    /** Number of cached command availability entries. */
+    size_t
+    Get_availability_count() const;
+
+private:
+    /** Storage of telemetry value. */
+    enum class Value_type: uint8_t {
+        NONE,
+        META,
+        INT,
+        FLOAT,
+        DOUBLE,
+        BOOL,
+        STRING,
+        BYTES,
+        /** Lists and values with several members set are kept serialized. */
+        ENCODED
+    };
+
+    /** No data table entry. */
+    static constexpr uint32_t NO_DATA_INDEX = UINT32_MAX;
+
+    /** Trivially copyable, so growing the array never copies strings. */
+    struct Telemetry_value {
+        int64_t ms_since_epoch = 0;
+        union {
+            int64_t int_value = 0;
+            double double_value;
+            float float_value;
+            bool bool_value;
+            int meta_value;
+        };
+        /** Entry of string, bytes or encoded value in the data table. Kept
+         * when the value type changes, so it is reused by later updates.
+         */
+        uint32_t data_index = NO_DATA_INDEX;
+        Value_type type = Value_type::NONE;
+    };
+
+    static_assert(std::is_trivially_copyable<Telemetry_value>::value,
+                  "Telemetry value should be trivially copyable");
+
+    struct Availability_value {
+        enum Flags: uint8_t {
+            PRESENT = 1 << 0,
+            HAS_AVAILABLE = 1 << 1,
+            AVAILABLE = 1 << 2,
+            HAS_ENABLED = 1 << 3,
+            ENABLED = 1 << 4
+        };
+        uint8_t flags = 0;
+    };
+
+    /** Array indexed by id starting from the lowest id seen. */
+    template <typename Value>
+    class Flat_map {
+    public:
+        Value &
+        operator [](uint32_t id);
+
+        uint32_t
+        Get_base() const
+        {
+            return base;
+        }
+
+        const std::vector<Value> &
+        Get_values() const
+        {
+            return values;
+        }
+
+    private:
+        uint32_t base = 0;
+        std::vector<Value> values;
+    };
+
+    Flat_map<Telemetry_value> telemetry;
+    Flat_map<Availability_value> availability;
+    /** Out of line data of telemetry values, at most one entry per field. */
+    std::vector<std::string> data;
+
+    /** Get data table entry of the value, allocate if not yet. */
+    std::string &
+    Get_data(Telemetry_value &entry);
+
+    const std::string &
+    Get_data(const Telemetry_value &entry) const
+    {
+        return data[entry.data_index];
+    }
+};
+
+} /* namespace vsm */
+} /* namespace ugcs */
+
+#endif /* _UGCS_VSM_TELEMETRY_CACHE_H_ */
@@ -13,13 +13,16 @@
 
 #include <ugcs/vsm/request_context.h>
 #include <ugcs/vsm/singleton.h>
+#include <ugcs/vsm/clock.h>
 #include <thread>
 #include <map>
 
 namespace ugcs {
 namespace vsm {
 
-/** Timer processor manages all timers in the VSM. */
+/** Timer processor manages all timers in the VSM. Time is taken from the
+ * currently installed Clock, so timers can be driven by virtual time.
+ */
 class Timer_processor: public Request_processor {
     DEFINE_COMMON_CLASS(Timer_processor, Request_container)
 
@@ -150,6 +153,15 @@ private:
     std::mutex tree_lock;
     /** Singleton object. */
     static Singleton<Timer_processor> singleton;
+    /** Clock which change handler is registered. */
+    Clock::Ptr watched_clock;
+    /** Identifier of the registered clock change handler. */
+    int clock_handler_id = 0;
+    /** Real time to wait for new requests before considering the processor
+     * idle when virtual clock is used.
+     */
+    static constexpr std::chrono::milliseconds VIRTUAL_IDLE_CHECK_TIME =
+        std::chrono::milliseconds(1);
 
     /** Handle processor enabling. */
     virtual void
@@ -180,6 +192,22 @@ private:
     static Tick_type
     Get_ticks(const std::chrono::steady_clock::time_point &time);
 
+    /** Register clock change handler on the specified clock and remove it
+     * from the previously watched one.
+     */
+    void
+    Watch_clock(const Clock::Ptr &clock);
+
+    /** Called when virtual clock time is changed. Wakes up processing thread
+     * to re-evaluate expired timers.
+     */
+    void
+    On_clock_changed();
+
+    /** Processing handler of the wake-up request. */
+    void
+    Wake_up_handler(Request::Ptr request);
+
     /** Create and submit request for the specified timer. */
     void
     Create_request(Timer::Ptr &timer, const Handler &handler,
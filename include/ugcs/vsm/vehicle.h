@@ -320,6 +320,12 @@ protected:
     Command_succeeded(
         Ucs_request::Ptr ucs_request);
 
+    // Forget the previously uploaded mission, so the next mission upload
+    // is not incremental. Call when the mission on the vehicle is changed
+    // not via this VSM, e.g. by another ground station or vehicle reset.
+    void
+    Reset_mission_baseline();
+
     /**
      * Task has arrived from UCS and should be uploaded to the vehicle.
      */
@@ -449,6 +455,37 @@ private:
     /** If vehicle is able to know it own altitude origin.*/
     Optional<float> current_altitude_origin;
 
+    /** Items of the mission uploaded to the vehicle. */
+    struct Mission_baseline {
+        /** Hash of the mission parameters, see Get_mission_hash(). */
+        Task::Item_hash mission_hash;
+        /** Hash of each item. */
+        std::vector<Task::Item_hash> item_hashes;
+        /** Converted action of each item, nullptr if item has no action. */
+        std::vector<Action::Ptr> actions;
+    };
+
+    /** Last successfully uploaded mission, nullptr if not known. */
+    std::shared_ptr<Mission_baseline> mission_baseline;
+
+    /** Completion handler of mission upload which updates the baseline. */
+    void
+    Mission_upload_completed(
+        Vehicle_request::Result result,
+        const std::string& status_text,
+        Ucs_request::Ptr ucs_request,
+        std::shared_ptr<Mission_baseline> baseline);
+
+    /** Calculate hash of a mission item. */
+    static Task::Item_hash
+    Get_mission_item_hash(const proto::Device_command& item);
+
+    /** Calculate hash of the mission parameters which apply to the whole
+     * task: mission upload command parameters and route parameter items.
+     */
+    Task::Item_hash
+    Get_mission_hash(const proto::Device_command& mission);
+
     /* Friend classes mostly for accessing system_id variable which we want
      * to hide from SDK user.
      */
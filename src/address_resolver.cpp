@@ -0,0 +1,202 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Address_resolver class implementation.
+ */
+
+#include <ugcs/vsm/address_resolver.h>
+#include <ugcs/vsm/debug.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+using namespace ugcs::vsm;
+
+/* Resolved_addresses class implementation. */
+
+Resolved_addresses::Resolved_addresses(int error, const addrinfo *result):
+    error(error)
+{
+    size_t count = 0;
+    for (auto rp = result; rp; rp = rp->ai_next) {
+        count++;
+    }
+    /* Reserve to keep pointers to the addresses valid. */
+    addresses.reserve(count);
+    entries.reserve(count);
+    for (auto rp = result; rp; rp = rp->ai_next) {
+        if (!rp->ai_addr || rp->ai_addrlen > sizeof(sockaddr_storage)) {
+            continue;
+        }
+        addresses.emplace_back();
+        memcpy(&addresses.back(), rp->ai_addr, rp->ai_addrlen);
+        addrinfo entry = *rp;
+        entry.ai_addr = reinterpret_cast<sockaddr *>(&addresses.back());
+        entry.ai_canonname = nullptr;
+        entry.ai_next = nullptr;
+        entries.push_back(entry);
+    }
+}
+
+/* Address_resolver class implementation. */
+
+constexpr size_t Address_resolver::DEFAULT_THREADS_COUNT;
+constexpr std::chrono::milliseconds Address_resolver::DEFAULT_POSITIVE_TTL;
+constexpr std::chrono::milliseconds Address_resolver::DEFAULT_NEGATIVE_TTL;
+constexpr size_t Address_resolver::MAX_CACHE_SIZE;
+
+Address_resolver::Address_resolver(
+        size_t threads_count,
+        std::chrono::milliseconds positive_ttl,
+        std::chrono::milliseconds negative_ttl):
+    worker(Request_worker::Create("Address resolver", threads_count)),
+    positive_ttl(positive_ttl),
+    negative_ttl(negative_ttl)
+{
+}
+
+void
+Address_resolver::Enable()
+{
+    worker->Enable();
+}
+
+void
+Address_resolver::Disable()
+{
+    worker->Disable();
+    Clear_cache();
+}
+
+std::string
+Address_resolver::Make_key(const std::string &host, const std::string &service,
+                           const addrinfo &hints)
+{
+    return host + '\n' + service + '\n' +
+        std::to_string(hints.ai_flags) + ':' +
+        std::to_string(hints.ai_family) + ':' +
+        std::to_string(hints.ai_socktype) + ':' +
+        std::to_string(hints.ai_protocol);
+}
+
+Resolved_addresses::Ptr
+Address_resolver::Resolve_numeric(const std::string &host,
+                                  const std::string &service,
+                                  const addrinfo &hints)
+{
+    addrinfo numeric_hints = hints;
+    numeric_hints.ai_flags |= AI_NUMERICHOST;
+    if (std::all_of(service.begin(), service.end(),
+                    [](char c) { return std::isdigit(static_cast<unsigned char>(c)); })) {
+        numeric_hints.ai_flags |= AI_NUMERICSERV;
+    }
+    addrinfo *result = nullptr;
+    int rc = getaddrinfo(host.c_str(), service.c_str(), &numeric_hints, &result);
+    if (rc == EAI_NONAME && !(hints.ai_flags & AI_NUMERICHOST)) {
+        /* Not a numeric host, needs real resolution. */
+        return nullptr;
+    }
+    auto addresses = Resolved_addresses::Create(rc, result);
+    if (result) {
+        freeaddrinfo(result);
+    }
+    return addresses;
+}
+
+Resolved_addresses::Ptr
+Address_resolver::Lookup_cache(const std::string &key)
+{
+    std::unique_lock<std::mutex> lock(cache_mutex);
+    auto iter = cache.find(key);
+    if (iter == cache.end()) {
+        return nullptr;
+    }
+    if (iter->second.expires <= Clock::Now()) {
+        cache.erase(iter);
+        return nullptr;
+    }
+    return iter->second.addresses;
+}
+
+void
+Address_resolver::Store_cache(const std::string &key,
+                              Resolved_addresses::Ptr addresses)
+{
+    auto now = Clock::Now();
+    std::unique_lock<std::mutex> lock(cache_mutex);
+    if (cache.size() >= MAX_CACHE_SIZE) {
+        for (auto iter = cache.begin(); iter != cache.end();) {
+            if (iter->second.expires <= now) {
+                iter = cache.erase(iter);
+            } else {
+                iter++;
+            }
+        }
+        if (cache.size() >= MAX_CACHE_SIZE) {
+            cache.clear();
+        }
+    }
+    cache[key] = Cache_entry {
+        addresses,
+        now + (addresses->Get_error() ? negative_ttl : positive_ttl)};
+}
+
+void
+Address_resolver::Clear_cache()
+{
+    std::unique_lock<std::mutex> lock(cache_mutex);
+    cache.clear();
+}
+
+Resolved_addresses::Ptr
+Address_resolver::Resolve_immediately(const std::string &host,
+                                      const std::string &service,
+                                      const addrinfo &hints)
+{
+    auto addresses = Resolve_numeric(host, service, hints);
+    if (addresses) {
+        return addresses;
+    }
+    return Lookup_cache(Make_key(host, service, hints));
+}
+
+Operation_waiter
+Address_resolver::Resolve(const std::string &host, const std::string &service,
+                          const addrinfo &hints, Handler handler,
+                          Request_completion_context::Ptr completion_ctx)
+{
+    auto request = Request::Create();
+    request->Set_completion_handler(completion_ctx, handler);
+    request->Set_processing_handler(
+        Make_callback(&Address_resolver::On_resolve, Shared_from_this(),
+                      request, host, service, hints, handler));
+    worker->Submit_request(request);
+    return request;
+}
+
+void
+Address_resolver::On_resolve(Request::Ptr request, std::string host,
+                             std::string service, addrinfo hints,
+                             Handler handler)
+{
+    auto addresses = Resolve_immediately(host, service, hints);
+    if (!addresses) {
+        addrinfo *result = nullptr;
+        /* This is a blocking call. */
+        int rc = getaddrinfo(host.c_str(), service.c_str(), &hints, &result);
+        if (rc) {
+            LOG_INFO("getaddrinfo failed for [%s:%s]: %s",
+                     host.c_str(), service.c_str(), gai_strerror(rc));
+        }
+        addresses = Resolved_addresses::Create(rc, result);
+        if (result) {
+            freeaddrinfo(result);
+        }
+        Store_cache(Make_key(host, service, hints), addresses);
+    }
+    handler.Set_arg<0>(addresses);
+    request->Complete();
+}
@@ -0,0 +1,147 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Clock and Virtual_clock implementation.
+ */
+
+#include <ugcs/vsm/clock.h>
+
+#include <vector>
+
+using namespace ugcs::vsm;
+
+/* Clock class implementation. */
+
+Clock::Ptr Clock::current;
+
+bool
+Clock::On_idle(Time_point)
+{
+    return false;
+}
+
+int
+Clock::Add_change_handler(Change_handler handler)
+{
+    std::unique_lock<std::mutex> lock(handlers_mutex);
+    int id = next_handler_id++;
+    handlers.emplace(id, handler);
+    return id;
+}
+
+void
+Clock::Remove_change_handler(int id)
+{
+    std::unique_lock<std::mutex> lock(handlers_mutex);
+    handlers.erase(id);
+}
+
+void
+Clock::Notify_changed()
+{
+    std::vector<Change_handler> to_call;
+    {
+        std::unique_lock<std::mutex> lock(handlers_mutex);
+        for (auto &iter : handlers) {
+            to_call.push_back(iter.second);
+        }
+    }
+    for (auto &handler : to_call) {
+        handler();
+    }
+}
+
+Clock::Ptr
+Clock::Get_current()
+{
+    return std::atomic_load(&current);
+}
+
+void
+Clock::Set_current(Ptr clock)
+{
+    std::atomic_store(&current, clock);
+}
+
+Clock::Time_point
+Clock::Now()
+{
+    auto clock = std::atomic_load(&current);
+    if (clock) {
+        return clock->Get_time();
+    }
+    return std::chrono::steady_clock::now();
+}
+
+/* Virtual_clock class implementation. */
+
+Virtual_clock::Virtual_clock(Time_point start_time):
+    time(start_time)
+{
+}
+
+Clock::Time_point
+Virtual_clock::Get_time()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return time;
+}
+
+bool
+Virtual_clock::On_idle(Time_point next_time)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!free_running) {
+        return false;
+    }
+    if (next_time > time) {
+        time = next_time;
+    }
+    return true;
+}
+
+void
+Virtual_clock::Advance(Duration duration)
+{
+    if (duration < Duration::zero()) {
+        VSM_EXCEPTION(Invalid_param_exception, "Virtual time cannot go backwards");
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        time += duration;
+    }
+    Notify_changed();
+}
+
+void
+Virtual_clock::Set_time(Time_point new_time)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (new_time < time) {
+            VSM_EXCEPTION(Invalid_param_exception, "Virtual time cannot go backwards");
+        }
+        time = new_time;
+    }
+    Notify_changed();
+}
+
+void
+Virtual_clock::Set_free_running(bool enable)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        free_running = enable;
+    }
+    /* Let timer processor re-evaluate its waiting. */
+    Notify_changed();
+}
+
+bool
+Virtual_clock::Is_free_running()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return free_running;
+}
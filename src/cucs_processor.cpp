@@ -7,9 +7,14 @@
 #include <ugcs/vsm/cucs_processor.h>
 #include <ugcs/vsm/request_context.h>
 #include <ugcs/vsm/timer_processor.h>
+#include <ugcs/vsm/clock.h>
 #include <ugcs/vsm/transport_detector.h>
 #include <ugcs/vsm/properties.h>
 #include <ugcs/vsm/param_setter.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+#include <google/protobuf/arena.h>
+#include <algorithm>
 
 using namespace ugcs::vsm;
 
@@ -18,13 +23,17 @@ constexpr std::chrono::seconds Cucs_processor::REGISTER_PEER_TIMEOUT;
 
 constexpr uint32_t Cucs_processor::SUPPORTED_UCS_VERSION_MAJOR;
 constexpr uint32_t Cucs_processor::SUPPORTED_UCS_VERSION_MINOR;
+constexpr size_t Cucs_processor::TELEMETRY_AGE_BUCKETS;
+constexpr size_t Cucs_processor::DEFAULT_MAX_QUEUED_REQUESTS;
+constexpr size_t Cucs_processor::WRITE_WINDOW;
 
 Singleton<Cucs_processor> Cucs_processor::singleton;
 
 Cucs_processor::Cucs_processor():
         Request_processor("Cucs processor"),
         ucs_id_counter(1),
-        ucs_connector(Transport_detector::Create())
+        ucs_connector(Transport_detector::Create()),
+        buffer_pool(Io_buffer_pool::Create())
 {
 }
 
@@ -57,8 +66,23 @@ Cucs_processor::Unregister_device(uint32_t handle)
 }
 
 void
-Cucs_processor::Send_ucs_message(uint32_t handle, Proto_msg_ptr message, uint32_t stream_id)
+Cucs_processor::Send_ucs_message(
+    uint32_t handle,
+    Proto_msg_ptr message,
+    uint32_t stream_id,
+    Telemetry_rx_times rx_times)
 {
+    auto ctx = Find_vehicle(handle);
+    if (ctx) {
+        // Update the cache in device thread to unload the processor.
+        std::unique_lock<std::mutex> lock(ctx->mutex);
+        for (auto &f : message->device_status().telemetry_fields()) {
+            ctx->telemetry_cache.Update(f);
+        }
+        for (auto &f : message->device_status().command_availability()) {
+            ctx->telemetry_cache.Update(f);
+        }
+    }
     auto request = Request::Create();
     auto proc_handler = Make_callback(
         &Cucs_processor::On_send_ucs_message,
@@ -66,11 +90,51 @@ Cucs_processor::Send_ucs_message(uint32_t handle, Proto_msg_ptr message, uint32_
         request,
         handle,
         message,
-        stream_id);
+        stream_id,
+        std::move(rx_times));
     request->Set_processing_handler(proc_handler);
+    if (message->has_device_status()) {
+        // Values are kept in the cache and resent if the message is dropped.
+        request->Set_droppable();
+    }
     Submit_request(request);
 }
 
+Cucs_processor::Telemetry_age_histogram
+Cucs_processor::Get_telemetry_age_histogram(uint32_t handle)
+{
+    Telemetry_age_histogram histogram = {};
+    auto ctx = Find_vehicle(handle);
+    if (ctx) {
+        std::unique_lock<std::mutex> lock(ctx->mutex);
+        histogram = ctx->telemetry_age_histogram;
+    }
+    return histogram;
+}
+
+Cucs_processor::Vehicle_context::Ptr
+Cucs_processor::Find_vehicle(uint32_t device_id)
+{
+    std::unique_lock<std::mutex> lock(vehicles_mutex);
+    auto it = vehicles.find(device_id);
+    if (it == vehicles.end()) {
+        return nullptr;
+    }
+    return it->second;
+}
+
+size_t
+Cucs_processor::Get_telemetry_age_bucket(std::chrono::steady_clock::duration age)
+{
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(age).count();
+    size_t bucket = 0;
+    while (ms > 0 && bucket < TELEMETRY_AGE_BUCKETS - 1) {
+        ms >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
 void
 Cucs_processor::On_enable()
 {
@@ -83,6 +147,12 @@ Cucs_processor::On_enable()
     worker->Enable();
 
     auto props = Properties::Get_instance();
+    max_queued = DEFAULT_MAX_QUEUED_REQUESTS;
+    if (props->Exists("ucs.max_queued_requests")) {
+        max_queued = props->Get_int("ucs.max_queued_requests");
+    }
+    Set_capacity(max_queued, Overflow_policy::DROP_OLDEST);
+
     if (props->Exists("ucs.disable")) {
         return;
     }
@@ -95,6 +165,8 @@ Cucs_processor::On_enable()
         Transport_detector::Get_instance()->Activate(false);
     }
 
+    compression_enabled = !props->Exists("ucs.disable_compression");
+
     if (Properties::Get_instance()->Exists("ucs.keep_alive_timeout")) {
         auto t = Properties::Get_instance()->Get_int("ucs.keep_alive_timeout");
         keep_alive_timeout = std::chrono::seconds(t);
@@ -144,16 +216,19 @@ Cucs_processor::Process_on_disable(Request::Ptr request)
     }
 
     // TODO clean vehicle shutdown.
-    vehicles.clear();
+    {
+        std::unique_lock<std::mutex> lock(vehicles_mutex);
+        vehicles.clear();
+    }
 
     for (auto& iter : ucs_connections) {
-        iter.second.read_waiter.Abort();
-        iter.second.stream->Close();
+        Close_connection(iter.second.connection);
     }
     ucs_connections.clear();
 
     completion_ctx->Disable();
     completion_ctx = nullptr;
+    write_backlog = 0;
 
     request->Complete();
 }
@@ -161,8 +236,15 @@ Cucs_processor::Process_on_disable(Request::Ptr request)
 bool
 Cucs_processor::On_timer()
 {
+    auto dropped = Get_overload_stats().dropped + connection_dropped;
+    if (dropped != telemetry_dropped) {
+        LOG_INFO("%" PRIu64 " telemetry messages dropped, resending telemetry.",
+                 dropped - telemetry_dropped);
+        telemetry_dropped = dropped;
+        Resend_telemetry();
+    }
     for (auto& iter : ucs_connections) {
-        auto now = std::chrono::steady_clock::now();
+        auto now = Clock::Now();
         if (iter.second.ucs_id) {
             // known ucs.
             if (keep_alive_timeout.count()) {
@@ -172,10 +254,10 @@ Cucs_processor::On_timer()
                     iter.second.stream->Close();
                 } else {
                     // Still good. Send another ping.
-                    ugcs::vsm::proto::Vsm_message ping_msg;
-                    ping_msg.set_device_id(0);
-                    ping_msg.set_response_required(true); // this will set message_id automatically.
-                    Send_ucs_message(iter.first, ping_msg);
+                    auto ping_msg = std::make_shared<ugcs::vsm::proto::Vsm_message>();
+                    ping_msg->set_device_id(0);
+                    ping_msg->set_response_required(true); // this will set message_id automatically.
+                    Send_keep_alive(iter.first, ping_msg);
                 }
             }
         } else {
@@ -188,6 +270,20 @@ Cucs_processor::On_timer()
     return true;
 }
 
+void
+Cucs_processor::Resend_telemetry()
+{
+    for (auto &iter : vehicles) {
+        auto message = std::make_shared<ugcs::vsm::proto::Vsm_message>();
+        message->set_device_id(iter.first);
+        {
+            std::unique_lock<std::mutex> lock(iter.second->mutex);
+            iter.second->telemetry_cache.Fill(*message->mutable_device_status());
+        }
+        Broadcast_message_to_ucs(message);
+    }
+}
+
 void
 Cucs_processor::On_incoming_connection(std::string, int, Socket_address::Ptr addr, Io_stream::Ref stream)
 {
@@ -198,17 +294,42 @@ Cucs_processor::On_incoming_connection(std::string, int, Socket_address::Ptr add
     }
 
     auto new_id = Get_next_id();
+    auto connection = std::make_shared<Connection>();
+    connection->stream_id = new_id;
+    connection->stream = stream;
+    connection->processor = Request_processor::Create("UCS connection processor");
+    connection->completion_ctx = Request_completion_context::Create("UCS connection completion");
+    connection->worker = Request_worker::Create(
+        "UCS connection worker",
+        std::initializer_list<Request_container::Ptr>(
+            {connection->completion_ctx, connection->processor}));
+    connection->completion_ctx->Enable();
+    connection->processor->Enable();
+    connection->worker->Enable();
+
+    // Read operations are issued only from connection thread.
+    auto request = Request::Create();
+    request->Set_processing_handler(
+        Make_callback([](Request::Ptr r, Cucs_processor::Ptr self, Connection::Ptr c) {
+            self->Start_reading(c);
+            r->Complete();
+        },
+        request,
+        Shared_from_this(),
+        connection));
+    connection->processor->Submit_request(request);
+
     Server_context sc;
     sc.stream = stream;
     sc.stream_id = new_id;
+    sc.connection = connection;
     sc.address = addr;
-    sc.last_message_time = std::chrono::steady_clock::now();
-    Schedule_next_read(sc);
+    sc.last_message_time = Clock::Now();
 
     ucs_connections.emplace(sc.stream_id, std::move(sc));
 
-    ugcs::vsm::proto::Vsm_message msg;
-    auto p = msg.mutable_register_peer();
+    auto msg = std::make_shared<ugcs::vsm::proto::Vsm_message>();
+    auto p = msg->mutable_register_peer();
     p->set_peer_id(Get_application_instance_id());
     p->set_peer_type(proto::PEER_TYPE_VSM);
     // Get the VSM name which must be defined using DEFINE_DEFAULT_VSM_NAME in VSM sources.
@@ -216,30 +337,309 @@ Cucs_processor::On_incoming_connection(std::string, int, Socket_address::Ptr add
     p->set_version_major(SDK_VERSION_MAJOR);
     p->set_version_minor(SDK_VERSION_MINOR);
     p->set_version_build(SDK_VERSION_BUILD);
-    msg.set_device_id(0);
-    Send_ucs_message(new_id, msg);
+    if (compression_enabled) {
+        p->add_supported_compression(proto::COMPRESSION_TYPE_DEFLATE);
+    }
+    msg->set_device_id(0);
+    Send_ucs_message_ptr(new_id, msg);
 }
 
 void
-Cucs_processor::Schedule_next_read(
-        Server_context& sc)
-{
-    sc.read_waiter.Abort();
-    sc.read_waiter = sc.stream->Read(
-        sc.to_read,
-        sc.to_read,
-        Make_read_callback(
+Cucs_processor::Start_reading(
+        Connection::Ptr connection)
+{
+    // Stream is read continuously, each batch of received chunks is framed
+    // at once instead of issuing a read per header byte and per message.
+    connection->subscription = connection->stream->Subscribe(
+        READ_CHUNK_SIZE,
+        Make_read_subscription_callback(
             &Cucs_processor::Read_completed,
             Shared_from_this(),
-            sc.stream_id),
-        completion_ctx);
+            connection),
+        connection->completion_ctx);
 }
 
 void
 Cucs_processor::Read_completed(
-        Io_buffer::Ptr buffer,
+        std::vector<Io_buffer::Ptr> buffers,
         Io_result result,
-        size_t stream_id)
+        Connection::Ptr connection)
+{
+    auto stream_id = connection->stream_id;
+    auto close_stream = [this, stream_id]() {
+        auto request = Request::Create();
+        request->Set_processing_handler(
+            Make_callback([](Request::Ptr r, Cucs_processor::Ptr self, size_t id) {
+                self->Close_ucs_stream(id);
+                r->Complete();
+            },
+            request,
+            Shared_from_this(),
+            stream_id));
+        Submit_request(request);
+    };
+
+    for (auto &buffer : buffers) {
+        if (!Process_received_data(
+                connection,
+                static_cast<const uint8_t*>(buffer->Get_data()),
+                buffer->Get_length())) {
+            connection->subscription->Cancel();
+            close_stream();
+            return;
+        }
+    }
+    if (result != Io_result::OK) {
+        close_stream();
+    }
+}
+
+bool
+Cucs_processor::Process_received_data(Connection::Ptr connection, const uint8_t *data, size_t len)
+{
+    auto &frame = connection->rx_frame;
+    if (!frame.empty()) {
+        // Continue the frame started in previous chunks.
+        frame.insert(frame.end(), data, data + len);
+        data = frame.data();
+        len = frame.size();
+    }
+    size_t pos = 0;
+    while (pos < len) {
+        // wireformat header is varint of message size.
+        size_t message_size = 0;
+        size_t header_len = 0;
+        bool header_complete = false;
+        while (pos + header_len < len) {
+            int byte = data[pos + header_len];
+            message_size |= static_cast<size_t>(byte & 0x7f) << (7 * header_len);
+            header_len++;
+            if (message_size > PROTO_MAX_MESSAGE_LEN || header_len >= PROTO_MAX_HEADER_LEN) {
+                LOG_ERR("Proto message len of %zu exceeds allowed %zu bytes!",
+                    message_size,
+                    PROTO_MAX_MESSAGE_LEN);
+                return false;
+            }
+            if (!(byte & 0x80)) {
+                header_complete = true;
+                break;
+            }
+        }
+        if (!header_complete || len - pos - header_len < message_size) {
+            break;
+        }
+        pos += header_len;
+        // Zero len message is skipped.
+        if (message_size && !Process_frame(connection, data + pos, message_size)) {
+            return false;
+        }
+        pos += message_size;
+    }
+    if (frame.empty()) {
+        frame.assign(data + pos, data + len);
+    } else {
+        frame.erase(frame.begin(), frame.begin() + pos);
+    }
+    return true;
+}
+
+bool
+Cucs_processor::Process_frame(Connection::Ptr connection, const void *data, size_t len)
+{
+    connection->rx_bytes += len;
+    Io_buffer_pool::Data_ptr plain;
+    if (connection->inflater) {
+        auto started = std::chrono::steady_clock::now();
+        plain = buffer_pool->Allocate(0);
+        if (!connection->inflater->Decompress(data, len, PROTO_MAX_MESSAGE_LEN, *plain)) {
+            LOG_ERR("Failed to decompress message, closing.");
+            return false;
+        }
+        connection->rx_time_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - started).count();
+        data = plain->data();
+        len = plain->size();
+    }
+    connection->rx_raw_bytes += len;
+
+    Message_header header;
+    Proto_msg_ptr vsm_msg;
+    if (!Peek_message_header(data, len, header)) {
+        LOG_ERR("Malformed message, closing.");
+        return false;
+    }
+    if (    header.device_id
+        &&  !header.is_response
+        &&  !header.is_register_peer
+        &&  !Find_vehicle(header.device_id)) {
+        // Nobody to deliver to, routing fields are enough to respond.
+        vsm_msg = std::make_shared<ugcs::vsm::proto::Vsm_message>();
+        vsm_msg->set_device_id(header.device_id);
+        if (header.message_id) {
+            vsm_msg->set_message_id(*header.message_id);
+        }
+        vsm_msg->set_response_required(header.response_required);
+    } else {
+        vsm_msg = Parse_message(data, len);
+    }
+    if (!vsm_msg) {
+        LOG_ERR("ParseFromArray failed, closing.");
+        return false;
+    }
+    if (vsm_msg->has_register_peer() && vsm_msg->register_peer().has_compression()) {
+        // All following frames from the server are compressed.
+        auto compression = vsm_msg->register_peer().compression();
+        if (compression == proto::COMPRESSION_TYPE_DEFLATE) {
+            connection->inflater = Deflate_stream::Create(Deflate_stream::Mode::DECOMPRESS);
+        } else {
+            connection->inflater = nullptr;
+        }
+        connection->rx_compression = compression;
+    }
+    // Message parsed ok. Pass it to processor.
+    // LOG("received msg: %s", vsm_msg->SerializeAsString().c_str());
+    auto request = Request::Create();
+    request->Set_processing_handler(
+        Make_callback([](Request::Ptr r, Cucs_processor::Ptr self, size_t id, Proto_msg_ptr m) {
+            self->On_message_received(id, m);
+            r->Complete();
+        },
+        request,
+        Shared_from_this(),
+        connection->stream_id,
+        vsm_msg));
+    if (header.Is_keep_alive()) {
+        request->Set_priority(Request::Priority::HIGH);
+    }
+    Submit_request(request);
+    return true;
+}
+
+bool
+Cucs_processor::Peek_message_header(const void *data, size_t len, Message_header &header)
+{
+    using google::protobuf::internal::WireFormatLite;
+    google::protobuf::io::CodedInputStream stream(static_cast<const uint8_t*>(data), len);
+    bool has_device_id = false;
+    uint32_t value;
+    while (auto tag = stream.ReadTag()) {
+        switch (tag) {
+        case WireFormatLite::MakeTag(
+                proto::Vsm_message::kDeviceIdFieldNumber, WireFormatLite::WIRETYPE_VARINT):
+            if (!stream.ReadVarint32(&value)) {
+                return false;
+            }
+            header.device_id = value;
+            has_device_id = true;
+            break;
+        case WireFormatLite::MakeTag(
+                proto::Vsm_message::kMessageIdFieldNumber, WireFormatLite::WIRETYPE_VARINT):
+            if (!stream.ReadVarint32(&value)) {
+                return false;
+            }
+            header.message_id = value;
+            break;
+        case WireFormatLite::MakeTag(
+                proto::Vsm_message::kResponseRequiredFieldNumber, WireFormatLite::WIRETYPE_VARINT):
+            if (!stream.ReadVarint32(&value)) {
+                return false;
+            }
+            header.response_required = value != 0;
+            break;
+        default:
+            switch (WireFormatLite::GetTagFieldNumber(tag)) {
+            case proto::Vsm_message::kDeviceResponseFieldNumber:
+                header.is_response = true;
+                break;
+            case proto::Vsm_message::kRegisterPeerFieldNumber:
+                header.is_register_peer = true;
+                break;
+            default:
+                header.has_payload = true;
+                break;
+            }
+            if (!WireFormatLite::SkipField(&stream, tag)) {
+                return false;
+            }
+        }
+    }
+    return has_device_id && stream.CurrentPosition() == static_cast<int>(len);
+}
+
+Proto_msg_ptr
+Cucs_processor::Parse_message(const void *data, size_t len)
+{
+    google::protobuf::ArenaOptions options;
+    // Parsed tree usually fits into the first block.
+    options.start_block_size = std::max(options.start_block_size, len * 4);
+    auto arena = std::make_shared<google::protobuf::Arena>(options);
+    auto message = google::protobuf::Arena::CreateMessage<ugcs::vsm::proto::Vsm_message>(arena.get());
+    if (!message->ParseFromArray(data, len)) {
+        return nullptr;
+    }
+    // Message lives as long as its arena.
+    return Proto_msg_ptr(arena, message);
+}
+
+void
+Cucs_processor::Negotiate_compression(Server_context& ctx, const proto::Register_peer& peer)
+{
+    if (!compression_enabled) {
+        return;
+    }
+    auto& supported = peer.supported_compression();
+    if (std::find(supported.begin(), supported.end(), proto::COMPRESSION_TYPE_DEFLATE) == supported.end()) {
+        return;
+    }
+    auto msg = std::make_shared<ugcs::vsm::proto::Vsm_message>();
+    auto p = msg->mutable_register_peer();
+    p->set_peer_id(Get_application_instance_id());
+    p->set_peer_type(proto::PEER_TYPE_VSM);
+    p->set_compression(proto::COMPRESSION_TYPE_DEFLATE);
+    msg->set_device_id(0);
+    Send_ucs_message_ptr(ctx.stream_id, msg);
+    LOG("Compression enabled for UCS %08X on %s", *ctx.ucs_id, ctx.stream->Get_name().c_str());
+}
+
+std::vector<Cucs_processor::Link_stats>
+Cucs_processor::Get_link_stats()
+{
+    std::vector<Link_stats> result;
+    auto request = Request::Create();
+    request->Set_processing_handler(
+        Make_callback([&result](Request::Ptr r, Cucs_processor::Ptr self) {
+            for (auto& iter : self->ucs_connections) {
+                auto& connection = *iter.second.connection;
+                Link_stats stats;
+                stats.stream_id = iter.first;
+                stats.ucs_id = iter.second.ucs_id;
+                stats.tx_compression = static_cast<proto::Compression_type>(connection.tx_compression.load());
+                stats.rx_compression = static_cast<proto::Compression_type>(connection.rx_compression.load());
+                stats.tx_raw_bytes = connection.tx_raw_bytes;
+                stats.tx_bytes = connection.tx_bytes;
+                stats.rx_raw_bytes = connection.rx_raw_bytes;
+                stats.rx_bytes = connection.rx_bytes;
+                stats.tx_time = std::chrono::nanoseconds(connection.tx_time_ns);
+                stats.rx_time = std::chrono::nanoseconds(connection.rx_time_ns);
+                stats.tx_queued = connection.tx_queued;
+                stats.tx_dropped = connection.tx_dropped;
+                result.push_back(stats);
+            }
+            r->Complete();
+        },
+        request,
+        Shared_from_this()));
+    // Does not depend on the queued requests, the caller is blocked.
+    request->Set_priority(Request::Priority::HIGH);
+    Submit_request(request);
+    request->Wait_done(false);
+    return result;
+}
+
+void
+Cucs_processor::On_message_received(
+        size_t stream_id,
+        Proto_msg_ptr message)
 {
     auto iter = ucs_connections.find(stream_id);
     if (iter == ucs_connections.end()) {
@@ -247,193 +647,138 @@ Cucs_processor::Read_completed(
         return;
     }
     auto & connection = iter->second;
-    if (result == Io_result::OK) {
-        if (connection.reading_header) {
-            if (buffer->Get_length() != 1) {
-                VSM_EXCEPTION(Internal_error_exception, "Internal error");
-            }
-            int byte = *static_cast<const uint8_t*>(buffer->Get_data());
-            connection.message_size |= (byte & 0x7f) << connection.shift;
-            if (connection.message_size > PROTO_MAX_MESSAGE_LEN) {
-                LOG_ERR("Proto message len of %zu exceeds allowed %zu bytes!",
-                    connection.message_size,
-                    PROTO_MAX_MESSAGE_LEN);
-                Close_ucs_stream(stream_id);
-                return;
-            }
-            if (byte & 0x80) {
-                // there is more
-                connection.shift += 7;
+    if (connection.ucs_id) {
+        // knwon ucs
+        connection.last_message_time = Clock::Now();
+        if (message->has_device_response()) {
+            // This is a response to VSM request.
+            auto conn_it = connection.pending_registrations.find(message->message_id());
+            if (conn_it == connection.pending_registrations.end()) {
+                // This response is not for Register_device. Pass it on.
+                On_ucs_message(stream_id, message);
             } else {
-                connection.shift = 0;
-                if (connection.message_size) {
-                    connection.to_read = connection.message_size;
-                    connection.reading_header = false;
-                } else {
-                    // Zero len message, continue with next header.
-                    connection.to_read = 1;
+                // we have a pending registration.
+                switch (message->device_response().code()) {
+                case proto::STATUS_OK: {
+                    LOG("Device %d registered with ucs %08X", conn_it->second, *connection.ucs_id);
+                    auto it = vehicles.find(conn_it->second);
+                    if (it != vehicles.end()) {
+                        connection.registered_devices.insert(conn_it->second);
+                        // Signal device about new connection.
+                        Notify_device_about_ucs_connections(conn_it->second);
+                        // Send cached telemetry data
+                        auto reg = std::make_shared<ugcs::vsm::proto::Vsm_message>();
+                        reg->set_device_id(it->first);
+                        {
+                            std::unique_lock<std::mutex> lock(it->second->mutex);
+                            it->second->telemetry_cache.Fill(*reg->mutable_device_status());
+                        }
+                        Send_ucs_message_ptr(connection.stream_id, reg);
+                    }
+                    connection.pending_registrations.erase(conn_it);
+                } break;
+                case proto::STATUS_IN_PROGRESS:
+                    LOG("Device %d registration with ucs %08X in progress (%d%%)",
+                        conn_it->second,
+                        *connection.ucs_id,
+                        static_cast<int>(message->device_response().progress() * 100));
+                    break;
+                default:
+                    LOG("Device %d registration failed with ucs %08X code: %d, reason: %s",
+                        conn_it->second,
+                        *connection.ucs_id,
+                        message->device_response().code(),
+                        message->device_response().status().c_str());
+                    connection.pending_registrations.erase(conn_it);
                 }
             }
         } else {
-            ugcs::vsm::proto::Vsm_message vsm_msg;
-            if (vsm_msg.ParseFromArray(buffer->Get_data(), buffer->Get_length())) {
-                // Message parsed ok.
-                // LOG("received msg: %s", vsm_msg.SerializeAsString().c_str());
-                if (connection.ucs_id) {
-                    // knwon ucs
-                    connection.last_message_time = std::chrono::steady_clock::now();
-                    if (vsm_msg.has_device_response()) {
-                        // This is a response to VSM request.
-                        auto conn_it = connection.pending_registrations.find(vsm_msg.message_id());
-                        if (conn_it == connection.pending_registrations.end()) {
-                            // This response is not for Register_device. Pass it on.
-                            On_ucs_message(stream_id, std::move(vsm_msg));
-                        } else {
-                            // we have a pending registration.
-                            switch (vsm_msg.device_response().code()) {
-                            case proto::STATUS_OK: {
-                                LOG("Device %d registered with ucs %08X", conn_it->second, *connection.ucs_id);
-                                auto it = vehicles.find(conn_it->second);
-                                if (it != vehicles.end()) {
-                                    connection.registered_devices.insert(conn_it->second);
-                                    // Signal device about new connection.
-                                    Notify_device_about_ucs_connections(conn_it->second);
-                                    // Send cached telemetry data
-                                    ugcs::vsm::proto::Vsm_message reg;
-                                    reg.set_device_id(it->first);
-                                    auto tf = reg.mutable_device_status()->mutable_telemetry_fields();
-                                    for (auto& e : it->second.telemetry_cache) {
-                                        // Do not send cached telemetry values which are N/A
-                                        if (    !e.second.value().has_meta_value()
-                                            ||  e.second.value().meta_value() != ugcs::vsm::proto::META_VALUE_NA) {
-                                            auto f = tf->Add();
-                                            f->CopyFrom(e.second);
-                                        }
-                                    }
-                                    auto av = reg.mutable_device_status()->mutable_command_availability();
-                                    for (auto& e : it->second.availability_cache) {
-                                        auto f = av->Add();
-                                        f->CopyFrom(e.second);
-                                    }
-                                    Send_ucs_message(connection.stream_id, reg);
-                                }
-                                connection.pending_registrations.erase(conn_it);
-                            } break;
-                            case proto::STATUS_IN_PROGRESS:
-                                LOG("Device %d registration with ucs %08X in progress (%d%%)",
-                                    conn_it->second,
-                                    *connection.ucs_id,
-                                    static_cast<int>(vsm_msg.device_response().progress() * 100));
-                                break;
-                            default:
-                                LOG("Device %d registration failed with ucs %08X code: %d, reason: %s",
-                                    conn_it->second,
-                                    *connection.ucs_id,
-                                    vsm_msg.device_response().code(),
-                                    vsm_msg.device_response().status().c_str());
-                                connection.pending_registrations.erase(conn_it);
+            // This is not a Device_response message.
+            On_ucs_message(stream_id, message);
+        }
+    } else {
+        // ucs id still unknown.
+        if (message->has_register_peer()) {
+            // message has Register_peer payload.
+            connection.last_message_time = Clock::Now();
+            auto& reg_peer = message->register_peer();
+            if (!reg_peer.has_peer_type() || reg_peer.peer_type() == proto::PEER_TYPE_SERVER)
+            {
+                // no peer_type assumes server.
+                auto new_peer = reg_peer.peer_id();
+                // Look if it is a duplicate connection
+                auto dupe = false;
+                for (auto& ucs : ucs_connections) {
+                    if (ucs.second.ucs_id && *(ucs.second.ucs_id) == new_peer) {
+                        dupe = true;
+                        if (ucs.second.primary) {
+                            if (    !ucs.second.address->Is_loopback_address()
+                                ||  connection.address->Is_loopback_address()) {
+                                ucs.second.primary = false;
+                                connection.primary = true;
+                                LOG("Switched primary connection for %08X from %s to %s",
+                                    new_peer,
+                                    ucs.second.stream->Get_name().c_str(),
+                                    connection.stream->Get_name().c_str());
                             }
+                            break;
                         }
-                    } else {
-                        // This is not a Device_response message.
-                        On_ucs_message(stream_id, std::move(vsm_msg));
                     }
-                } else {
-                    // ucs id still unknown.
-                    if (vsm_msg.has_register_peer()) {
-                        // message has Register_peer payload.
-                        connection.last_message_time = std::chrono::steady_clock::now();
-                        auto& reg_peer = vsm_msg.register_peer();
-                        if (!reg_peer.has_peer_type() || reg_peer.peer_type() == proto::PEER_TYPE_SERVER)
-                        {
-                            // no peer_type assumes server.
-                            auto new_peer = reg_peer.peer_id();
-                            // Look if it is a duplicate connection
-                            auto dupe = false;
-                            for (auto& ucs : ucs_connections) {
-                                if (ucs.second.ucs_id && *(ucs.second.ucs_id) == new_peer) {
-                                    dupe = true;
-                                    if (ucs.second.primary) {
-                                        if (    !ucs.second.address->Is_loopback_address()
-                                            ||  connection.address->Is_loopback_address()) {
-                                            ucs.second.primary = false;
-                                            connection.primary = true;
-                                            LOG("Switched primary connection for %08X from %s to %s",
-                                                new_peer,
-                                                ucs.second.stream->Get_name().c_str(),
-                                                connection.stream->Get_name().c_str());
-                                        }
-                                        break;
-                                    }
-                                }
-                            }
-
-                            uint32_t ver_major = 0, ver_minor = 0;
-                            if (reg_peer.has_version_major()) {
-                                ver_major = reg_peer.version_major();
-                            }
-                            if (reg_peer.has_version_minor()) {
-                                ver_minor = reg_peer.version_minor();
-                            }
-
-                            // From now on we know that this ucs is reachable via this connection.
-                            connection.ucs_id = new_peer;
-                            if (dupe) {
-                                LOG("Another connection from UCS %08X detected from %s",
-                                    new_peer,
-                                    connection.stream->Get_name().c_str());
-                            } else {
-                                // We have connection from new ucs.
-                                connection.primary = true;
+                }
 
-                                std::string version = std::to_string(ver_major) + "." + std::to_string(ver_minor);
-                                if (reg_peer.has_version_build()) {
-                                    version += ".";
-                                    version += reg_peer.version_build();
-                                }
-                                LOG("New UCS %08X detected on %s, version: %s",
-                                    new_peer,
-                                    connection.stream->Get_name().c_str(),
-                                    version.c_str());
-                                // Activate transport_detector
-                                Transport_detector::Get_instance()->Activate(true);
-                            }
+                uint32_t ver_major = 0, ver_minor = 0;
+                if (reg_peer.has_version_major()) {
+                    ver_major = reg_peer.version_major();
+                }
+                if (reg_peer.has_version_minor()) {
+                    ver_minor = reg_peer.version_minor();
+                }
 
-                            // We know that UCS below this version uses different protocol.
-                            if (ver_major < SUPPORTED_UCS_VERSION_MAJOR ||
-                                (ver_major == SUPPORTED_UCS_VERSION_MAJOR && ver_minor < SUPPORTED_UCS_VERSION_MINOR))
-                            {
-                                connection.is_compatible = false;
-                                LOG("UCS %08X is incompatible with this VSM.", new_peer);
-                            }
+                // From now on we know that this ucs is reachable via this connection.
+                connection.ucs_id = new_peer;
+                if (dupe) {
+                    LOG("Another connection from UCS %08X detected from %s",
+                        new_peer,
+                        connection.stream->Get_name().c_str());
+                } else {
+                    // We have connection from new ucs.
+                    connection.primary = true;
 
-                            // Send all known vehicles.
-                            Send_vehicle_registrations(connection);
-                        } else {
-                            // Invalid peer type.
-                            LOG_WARN(
-                                "connection from invalid peer_type: %d. VSM supports connections only from server.",
-                                reg_peer.peer_type());
-                            Close_ucs_stream(stream_id);
-                            return;
-                        }
-                    } else {
-                        LOG_WARN("Got message for device %d from unregistered peer. Dropped.", vsm_msg.device_id());
+                    std::string version = std::to_string(ver_major) + "." + std::to_string(ver_minor);
+                    if (reg_peer.has_version_build()) {
+                        version += ".";
+                        version += reg_peer.version_build();
                     }
+                    LOG("New UCS %08X detected on %s, version: %s",
+                        new_peer,
+                        connection.stream->Get_name().c_str(),
+                        version.c_str());
+                    // Activate transport_detector
+                    Transport_detector::Get_instance()->Activate(true);
                 }
+
+                // We know that UCS below this version uses different protocol.
+                if (ver_major < SUPPORTED_UCS_VERSION_MAJOR ||
+                    (ver_major == SUPPORTED_UCS_VERSION_MAJOR && ver_minor < SUPPORTED_UCS_VERSION_MINOR))
+                {
+                    connection.is_compatible = false;
+                    LOG("UCS %08X is incompatible with this VSM.", new_peer);
+                }
+
+                Negotiate_compression(connection, reg_peer);
+
+                // Send all known vehicles.
+                Send_vehicle_registrations(connection);
             } else {
-                LOG_ERR("ParseFromArray failed, closing.");
+                // Invalid peer type.
+                LOG_WARN(
+                    "connection from invalid peer_type: %d. VSM supports connections only from server.",
+                    reg_peer.peer_type());
                 Close_ucs_stream(stream_id);
-                return;
             }
-            // wait for next message header
-            connection.to_read = 1;
-            connection.reading_header = true;
-            connection.message_size = 0;
+        } else {
+            LOG_WARN("Got message for device %d from unregistered peer. Dropped.", message->device_id());
         }
-        Schedule_next_read(iter->second);
-    } else {
-        Close_ucs_stream(stream_id);
     }
 }
 
@@ -445,19 +790,36 @@ Cucs_processor::On_register_vehicle(Request::Ptr request, Device::Ptr vehicle)
         VSM_EXCEPTION(Exception, "Vehicle %d already registered", device_id);
     }
 
-    auto res = vehicles.emplace(device_id, Vehicle_context());
-    auto &ctx = res.first->second;
-    ctx.vehicle = vehicle;
+    auto ctx = std::make_shared<Vehicle_context>();
+    ctx->vehicle = vehicle;
+
+    ugcs::vsm::proto::Vsm_message registration_message;
+    registration_message.set_device_id(device_id);
 
-    ctx.registration_message.set_device_id(device_id);
+    vehicle->Register(registration_message);
 
-    vehicle->Register(ctx.registration_message);
+    // LOG("Vehicle registered %s",registration_message.SerializeAsString().c_str());
 
-    // LOG("Vehicle registered %s",ctx.registration_message.SerializeAsString().c_str());
+    // Serialize once. Force response_required for Register_device.
+    registration_message.set_response_required(true);
+    registration_message.clear_message_id();
+    std::vector<uint8_t> payload(registration_message.ByteSizeLong());
+    registration_message.SerializeWithCachedSizesToArray(payload.data());
+    ctx->registration_payload = Io_buffer::Create(std::move(payload));
+
+    {
+        std::unique_lock<std::mutex> lock(vehicles_mutex);
+        vehicles.emplace(device_id, ctx);
+    }
 
     request->Complete();
 
-    Broadcast_message_to_ucs(ctx.registration_message);
+    for (auto& iter : ucs_connections) {
+        // Broadcast only to primary connections.
+        if (iter.second.primary) {
+            Send_registration(iter.second, device_id, *ctx);
+        }
+    }
 }
 
 void
@@ -465,8 +827,36 @@ Cucs_processor::Send_vehicle_registrations(
     Server_context& ctx)
 {
     for (auto &it : vehicles) {
-        Send_ucs_message(ctx.stream_id, it.second.registration_message);
+        Send_registration(ctx, it.first, *it.second);
+    }
+}
+
+void
+Cucs_processor::Send_registration(Server_context& ctx, uint32_t device_id, const Vehicle_context& vehicle)
+{
+    if (!ctx.ucs_id) {
+        LOG_ERR("Must register peer before sending anything else");
+        return;
+    }
+    if (!ctx.is_compatible) {
+        return;
     }
+    // Only message_id (and required device_id) is serialized for each
+    // connection.
+    auto message = std::make_shared<ugcs::vsm::proto::Vsm_message>();
+    message->set_device_id(device_id);
+    message->set_message_id(Get_next_id());
+    ctx.pending_registrations.insert(std::make_pair(message->message_id(), device_id));
+
+    auto request = Request::Create();
+    request->Set_processing_handler(
+        Make_callback(
+            &Cucs_processor::On_write_message,
+            Shared_from_this(),
+            request,
+            ctx.connection,
+            Serialize_message(*message, vehicle.registration_payload)));
+    ctx.connection->processor->Submit_request(request);
 }
 
 void
@@ -476,10 +866,13 @@ Cucs_processor::On_unregister_vehicle(Request::Ptr request, uint32_t device_id)
     if (it == vehicles.end()) {
         VSM_EXCEPTION(Invalid_param_exception, "Unregister unknown device id %d", device_id);
     } else {
-        ugcs::vsm::proto::Vsm_message reg;
-        reg.set_device_id(device_id);
-        reg.mutable_unregister_device();
-        vehicles.erase(device_id);
+        auto reg = std::make_shared<ugcs::vsm::proto::Vsm_message>();
+        reg->set_device_id(device_id);
+        reg->mutable_unregister_device();
+        {
+            std::unique_lock<std::mutex> lock(vehicles_mutex);
+            vehicles.erase(device_id);
+        }
         Broadcast_message_to_ucs(reg);
     }
     request->Complete();
@@ -490,31 +883,24 @@ Cucs_processor::On_send_ucs_message(
     Request::Ptr request,
     uint32_t device_id,
     Proto_msg_ptr message,
-    uint32_t stream_id)
+    uint32_t stream_id,
+    Telemetry_rx_times rx_times)
 {
     auto it = vehicles.find(device_id);
     if (it != vehicles.end()) {
-        for (int i = 0; i < message->device_status().telemetry_fields_size(); i++) {
-            auto &f = message->device_status().telemetry_fields(i);
-            auto ce = it->second.telemetry_cache.emplace(f.field_id(), f);
-            if (!ce.second) {
-                // update cache entry
-                ce.first->second.CopyFrom(f);
-            }
-        }
-        for (int i = 0; i < message->device_status().command_availability_size(); i++) {
-            auto &f = message->device_status().command_availability(i);
-            auto ce = it->second.availability_cache.emplace(f.id(), f);
-            if (!ce.second) {
-                // update cache entry
-                ce.first->second.CopyFrom(f);
-            }
-        }
+        // Telemetry cache is already updated by the sender.
         message->set_device_id(device_id);
         if (stream_id) {
-            Send_ucs_message(stream_id, *message);
+            Send_ucs_message_ptr(stream_id, message);
         } else {
-            Broadcast_message_to_ucs(*message);
+            Broadcast_message_to_ucs(message);
+        }
+        auto now = Clock::Now();
+        std::unique_lock<std::mutex> lock(it->second->mutex);
+        for (auto& rx_time : rx_times) {
+            if (rx_time != std::chrono::time_point<std::chrono::steady_clock>()) {
+                it->second->telemetry_age_histogram[Get_telemetry_age_bucket(now - rx_time)]++;
+            }
         }
     } else {
         // This can happen if vehicle is removed while message is dispatched already.
@@ -524,12 +910,14 @@ Cucs_processor::On_send_ucs_message(
 }
 
 void
-Cucs_processor::Broadcast_message_to_ucs(ugcs::vsm::proto::Vsm_message& message)
+Cucs_processor::Broadcast_message_to_ucs(Proto_msg_ptr message)
 {
+    // Connections which get the message unchanged share one frame.
+    Tx_frame serialized;
     for (auto& iter : ucs_connections) {
         // Broadcast only to primary connections.
         if (iter.second.primary) {
-            Send_ucs_message(iter.first, message);
+            Send_ucs_frame(iter.first, message, serialized);
         }
     }
 }
@@ -539,48 +927,59 @@ Cucs_processor::Send_ucs_message_ptr(
     uint32_t stream_id,
     Proto_msg_ptr message)
 {
-    Send_ucs_message(stream_id, *message);
+    Tx_frame serialized;
+    Send_ucs_frame(stream_id, message, serialized);
 }
 
 void
-Cucs_processor::Send_ucs_message(
+Cucs_processor::Send_keep_alive(
     uint32_t stream_id,
-    ugcs::vsm::proto::Vsm_message& message)
+    Proto_msg_ptr message)
+{
+    Tx_frame serialized;
+    Send_ucs_frame(stream_id, message, serialized, true);
+}
+
+void
+Cucs_processor::Send_ucs_frame(
+    uint32_t stream_id,
+    Proto_msg_ptr message,
+    Tx_frame& serialized,
+    bool urgent)
 {
     auto iter = ucs_connections.find(stream_id);
     if (iter != ucs_connections.end()) {
         auto & ctx = iter->second;
+        auto original = message;
 
         if (!ctx.ucs_id) {
             // only register_peer message is allowed to be sent to unknown ucs.
-            if (!message.has_register_peer()) {
+            if (!message->has_register_peer()) {
                 LOG_ERR("Must register peer before sending anything else");
                 return;
             }
-            message.set_device_id(0);
+            if (message->device_id() != 0) {
+                message = std::make_shared<ugcs::vsm::proto::Vsm_message>(*message);
+                message->set_device_id(0);
+            }
         }
 
         if (!ctx.is_compatible) {
             return;
         }
 
-        if (message.has_register_device()) {
-            // Force response_required for Register_device.
-            message.set_response_required(true);
-            message.set_message_id(Get_next_id());
-            ctx.pending_registrations.insert(std::make_pair(message.message_id(), message.device_id()));
-        } else if (message.device_id() != 0) {
+        if (message->device_id() != 0) {
             // This is a message from some device.
-            auto it = ctx.registered_devices.find(message.device_id());
+            auto it = ctx.registered_devices.find(message->device_id());
             if (it == ctx.registered_devices.end()) {
                 // Not sending if device is not registered with this connection.
                 return;
             } else {
-                if (message.has_unregister_device()) {
+                if (message->has_unregister_device()) {
                     // clean device specific stuff from ctx on Unregister_device.
-                    ctx.registered_devices.erase(message.device_id());
+                    ctx.registered_devices.erase(message->device_id());
                     for (auto m : ctx.pending_registrations) {
-                        if (m.second == message.device_id()) {
+                        if (m.second == message->device_id()) {
                             ctx.pending_registrations.erase(m.first);
                             break;
                         }
@@ -589,51 +988,268 @@ Cucs_processor::Send_ucs_message(
             }
         }
 
-        if (   !message.has_message_id()
-            &&  message.has_response_required()
-            &&  message.response_required())
+        if (   !message->has_message_id()
+            &&  message->has_response_required()
+            &&  message->response_required())
         {
-            message.set_message_id(Get_next_id());
-        }
-
-        int header_len = 0;
-        auto payload_len = message.ByteSize();
-        auto tmp_len = payload_len;
-        std::vector<uint8_t> user_data(10 + payload_len);
-        do {
-            uint8_t byte = (tmp_len & 0x7f);
-            tmp_len >>= 7;
-            if (tmp_len) {
-                byte |= 0x80;
+            message = std::make_shared<ugcs::vsm::proto::Vsm_message>(*message);
+            message->set_message_id(Get_next_id());
+        }
+
+        // Serialized here, so connection threads never access the message
+        // which can be shared with other connections.
+        Tx_frame tx;
+        if (message == original) {
+            if (!serialized.frame) {
+                serialized = Serialize_message(*message);
             }
-            user_data[header_len] = byte;
-            header_len++;
-        } while (tmp_len);
-        message.SerializeToArray(user_data.data() + header_len, payload_len);
-        user_data.resize(header_len + payload_len);
-        Io_buffer::Ptr buffer = Io_buffer::Create(std::move(user_data));
-
-        // LOG("sending msg: %s", message.SerializeAsString().c_str());
-        // LOG("sending msg len: %d", header_len + payload_len);
-        ctx.stream->Write(
+            tx = serialized;
+        } else {
+            tx = Serialize_message(*message);
+        }
+        tx.urgent = urgent;
+
+        // Compression and writing is done in connection thread.
+        auto request = Request::Create();
+        request->Set_processing_handler(
+            Make_callback(
+                &Cucs_processor::On_write_message,
+                Shared_from_this(),
+                request,
+                ctx.connection,
+                tx));
+        if (urgent) {
+            request->Set_priority(Request::Priority::HIGH);
+        }
+        ctx.connection->processor->Submit_request(request);
+    }
+}
+
+Cucs_processor::Tx_frame
+Cucs_processor::Serialize_message(const proto::Vsm_message& message, Io_buffer::Ptr payload)
+{
+    using google::protobuf::io::CodedOutputStream;
+    // Compute sizes once, then serialize the length header and the message
+    // directly into exactly sized pooled buffer in a single pass.
+    size_t message_len = message.ByteSizeLong();
+    size_t payload_len = message_len;
+    if (payload) {
+        payload_len += payload->Get_length();
+    }
+    Tx_frame tx;
+    tx.header_len = CodedOutputStream::VarintSize64(payload_len);
+    auto data = buffer_pool->Allocate(tx.header_len + message_len);
+    auto ptr = CodedOutputStream::WriteVarint64ToArray(payload_len, data->data());
+    message.SerializeWithCachedSizesToArray(ptr);
+    tx.frame = Io_buffer_pool::Create_buffer(std::move(data));
+    tx.payload = std::move(payload);
+    if (message.has_register_peer() && message.register_peer().has_compression()) {
+        tx.compression = message.register_peer().compression();
+    }
+    // Values are kept in the cache and resent if the message is dropped.
+    tx.droppable = message.has_device_status();
+    return tx;
+}
+
+void
+Cucs_processor::On_write_message(
+    Request::Ptr request,
+    Connection::Ptr connection,
+    Tx_frame tx)
+{
+    auto& queue = connection->tx_queue;
+    if (queue.size() >= max_queued) {
+        auto count_dropped = [&]() {
+            if (!connection->tx_dropped++) {
+                LOG_WARN("UCS connection %zu overloaded, dropping telemetry.",
+                    connection->stream_id);
+            }
+            connection_dropped++;
+        };
+        // Drop the oldest telemetry, other messages are queued over the
+        // limit.
+        auto it = std::find_if(queue.begin(), queue.end(),
+            [](const Tx_frame& f) { return f.droppable; });
+        if (it != queue.end()) {
+            queue.erase(it);
+            count_dropped();
+        } else if (tx.droppable) {
+            count_dropped();
+            request->Complete();
+            return;
+        }
+    }
+    if (tx.urgent) {
+        // Compression state follows the write order, so unsent frames can
+        // be reordered.
+        auto it = std::find_if(queue.begin(), queue.end(),
+            [](const Tx_frame& f) { return !f.urgent; });
+        queue.emplace(it, std::move(tx));
+    } else {
+        queue.emplace_back(std::move(tx));
+    }
+    connection->tx_queued = queue.size();
+    Flush_writes(connection);
+    request->Complete();
+}
+
+void
+Cucs_processor::Flush_writes(Connection::Ptr connection)
+{
+    auto& queue = connection->tx_queue;
+    while (!queue.empty()) {
+        {
+            std::unique_lock<std::mutex> lock(backlog_mutex);
+            if (connection->write_backlog >= WRITE_WINDOW) {
+                // Continued when writes complete.
+                return;
+            }
+        }
+        auto tx = std::move(queue.front());
+        queue.pop_front();
+        connection->tx_queued = queue.size();
+        Write_frame(connection, tx);
+    }
+}
+
+void
+Cucs_processor::Write_frame(Connection::Ptr connection, const Tx_frame& tx)
+{
+    using google::protobuf::io::CodedOutputStream;
+    auto frame = tx.frame;
+    auto payload = tx.payload;
+    size_t message_len = frame->Get_length() - tx.header_len;
+    size_t payload_len = message_len;
+    if (payload) {
+        payload_len += payload->Get_length();
+    }
+    connection->tx_raw_bytes += payload_len;
+    if (connection->deflater) {
+        auto started = std::chrono::steady_clock::now();
+        // Length is known after compression, reserve space for the header.
+        constexpr size_t headroom = PROTO_MAX_HEADER_LEN;
+        auto data = buffer_pool->Allocate(headroom);
+        auto message_data = static_cast<const uint8_t*>(frame->Get_data()) + tx.header_len;
+        connection->deflater->Compress(message_data, message_len, !payload, *data);
+        if (payload) {
+            connection->deflater->Compress(payload->Get_data(), payload->Get_length(), true, *data);
+            payload = nullptr;
+        }
+        uint32_t frame_len = data->size() - headroom;
+        size_t header_len = CodedOutputStream::VarintSize32(frame_len);
+        CodedOutputStream::WriteVarint32ToArray(frame_len, data->data() + headroom - header_len);
+        frame = Io_buffer_pool::Create_buffer(std::move(data))->Slice(headroom - header_len);
+        connection->tx_bytes += frame_len;
+        connection->tx_time_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - started).count();
+    } else {
+        connection->tx_bytes += payload_len;
+    }
+
+    // LOG("sending msg len: %d", header_len + payload_len);
+    // Header and payload are sent by one system call if possible.
+    for (auto& buffer : {frame, payload}) {
+        if (!buffer) {
+            continue;
+        }
+        auto size = buffer->Get_length();
+        {
+            std::unique_lock<std::mutex> lock(backlog_mutex);
+            connection->write_backlog += size;
+            if (connection->write_backlog > write_backlog) {
+                write_backlog = connection->write_backlog;
+            }
+        }
+        connection->stream->Write(
                 buffer,
                 Make_write_callback(
                         &Cucs_processor::Write_completed,
                         Shared_from_this(),
-                        stream_id),
+                        connection,
+                        size),
                 completion_ctx).Timeout(WRITE_TIMEOUT);
     }
+
+    if (tx.compression) {
+        // All following frames are compressed.
+        if (*tx.compression == proto::COMPRESSION_TYPE_DEFLATE) {
+            connection->deflater = Deflate_stream::Create(Deflate_stream::Mode::COMPRESS);
+        } else {
+            connection->deflater = nullptr;
+        }
+        connection->tx_compression = *tx.compression;
+    }
 }
 
 void
 Cucs_processor::Write_completed(
         Io_result result,
-        size_t stream_id)
+        Connection::Ptr connection,
+        size_t size)
 {
+    {
+        std::unique_lock<std::mutex> lock(backlog_mutex);
+        connection->write_backlog -= size;
+        Update_write_backlog();
+    }
     if (result != Io_result::OK) {
         // Write failed. Assume connection dead.
-        Close_ucs_stream(stream_id);
+        Close_ucs_stream(connection->stream_id);
+        return;
+    }
+    auto iter = ucs_connections.find(connection->stream_id);
+    if (connection->tx_queued && iter != ucs_connections.end()) {
+        // Write queued messages in connection thread.
+        auto request = Request::Create();
+        request->Set_processing_handler(
+            Make_callback([](Request::Ptr r, Cucs_processor::Ptr self, Connection::Ptr c) {
+                self->Flush_writes(c);
+                r->Complete();
+            },
+            request,
+            Shared_from_this(),
+            connection));
+        connection->processor->Submit_request(request);
+    }
+}
+
+void
+Cucs_processor::Update_write_backlog()
+{
+    size_t backlog = 0;
+    for (auto& iter : ucs_connections) {
+        backlog = std::max(backlog, iter.second.connection->write_backlog);
     }
+    write_backlog = backlog;
+}
+
+void
+Cucs_processor::On_close_connection(Request::Ptr request, Connection::Ptr connection)
+{
+    // Release subscription handler which refers to the connection.
+    if (connection->subscription) {
+        connection->subscription->Cancel();
+        connection->subscription = nullptr;
+    }
+    connection->stream->Close();
+    request->Complete();
+}
+
+void
+Cucs_processor::Close_connection(Connection::Ptr connection)
+{
+    auto request = Request::Create();
+    request->Set_processing_handler(
+        Make_callback(
+            &Cucs_processor::On_close_connection,
+            Shared_from_this(),
+            request,
+            connection));
+    connection->processor->Submit_request(request);
+    request->Wait_done(false);
+    connection->completion_ctx->Disable();
+    connection->processor->Disable();
+    connection->worker->Disable();
 }
 
 void
@@ -646,7 +1262,7 @@ Cucs_processor::Close_ucs_stream(size_t stream_id)
             *iter->second.ucs_id,
             iter->second.address->Get_as_string().c_str());
         }
-        iter->second.stream->Close();
+        Close_connection(iter->second.connection);
         auto primary = iter->second.primary;
         uint32_t ucs_id = 0;
         if (iter->second.ucs_id) {
@@ -655,6 +1271,10 @@ Cucs_processor::Close_ucs_stream(size_t stream_id)
 
         auto devices = iter->second.registered_devices;
         ucs_connections.erase(iter);
+        {
+            std::unique_lock<std::mutex> lock(backlog_mutex);
+            Update_write_backlog();
+        }
 
         if (primary) {
             // Primary connection erased.
@@ -736,22 +1356,22 @@ Cucs_processor::Get_device(uint32_t device_id)
     if (it == vehicles.end()) {
         return nullptr;
     }
-    return it->second.vehicle;
+    return it->second->vehicle;
 }
 
 void
 Cucs_processor::On_ucs_message(
     uint32_t stream_id,
-    ugcs::vsm::proto::Vsm_message message)
+    Proto_msg_ptr message)
 {
-    auto dev_id = message.device_id();
+    auto dev_id = message->device_id();
     auto dev = Get_device(dev_id);
-    if (message.has_response_required() && message.response_required()) {
+    if (message->has_response_required() && message->response_required()) {
         // ucs will wait for response on this message.
         // Prepare the response template and set up completion handler.
         // Need this to send the response into the same connection as request.
         auto resp = std::make_shared<ugcs::vsm::proto::Vsm_message>();
-        resp->set_message_id(message.message_id());
+        resp->set_message_id(message->message_id());
         resp->set_device_id(dev_id);
         if (dev) {
             // by default assume failure
@@ -764,7 +1384,7 @@ Cucs_processor::On_ucs_message(
                 resp);
 
             dev->On_ucs_message(
-                std::move(message),
+                message,
                 completion_handler,
                 completion_ctx);
             return;     // completion handler will send the response.
@@ -775,6 +1395,8 @@ Cucs_processor::On_ucs_message(
             } else {
                 // Respond OK to any request for the peer itself.
                 resp->mutable_device_response()->set_code(ugcs::vsm::proto::STATUS_OK);
+                Send_keep_alive(stream_id, resp);
+                return;
             }
         }
         // Message not passed to vehicle. Send response.
@@ -783,7 +1405,7 @@ Cucs_processor::On_ucs_message(
         // No response required.
         if (dev) {
             // Call vehicle handler. No completion handler needed.
-            dev->On_ucs_message(std::move(message));
+            dev->On_ucs_message(message);
         } else {
             if (dev_id) {
                 LOG_ERR("Received message for unknown vehicle %d", dev_id);
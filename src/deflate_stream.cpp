@@ -0,0 +1,114 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Deflate_stream class implementation.
+ */
+
+#include <ugcs/vsm/deflate_stream.h>
+#include <ugcs/vsm/exception.h>
+#include <ugcs/vsm/debug.h>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace ugcs::vsm;
+
+namespace {
+
+/** Empty stored block which terminates sync flushed frame. */
+const uint8_t FLUSH_MARKER[] = {0x00, 0x00, 0xff, 0xff};
+
+/** Minimal output space reserved per zlib call. */
+constexpr size_t MIN_CHUNK = 256;
+
+} /* anonymous namespace */
+
+class Deflate_stream::Impl {
+public:
+    z_stream stream;
+};
+
+Deflate_stream::Deflate_stream(Mode mode, int level):
+    mode(mode),
+    impl(std::make_unique<Impl>())
+{
+    memset(&impl->stream, 0, sizeof(impl->stream));
+    int res;
+    if (mode == Mode::COMPRESS) {
+        res = deflateInit2(&impl->stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    } else {
+        res = inflateInit2(&impl->stream, -MAX_WBITS);
+    }
+    if (res != Z_OK) {
+        VSM_EXCEPTION(Exception, "Failed to initialize zlib stream: %d", res);
+    }
+}
+
+Deflate_stream::~Deflate_stream()
+{
+    if (mode == Mode::COMPRESS) {
+        deflateEnd(&impl->stream);
+    } else {
+        inflateEnd(&impl->stream);
+    }
+}
+
+void
+Deflate_stream::Compress(const void *data, size_t len, bool finish, std::vector<uint8_t> &out)
+{
+    ASSERT(mode == Mode::COMPRESS);
+    auto &stream = impl->stream;
+    stream.next_in = const_cast<Bytef *>(static_cast<const Bytef *>(data));
+    stream.avail_in = len;
+    size_t chunk = std::max(len / 2, MIN_CHUNK);
+    do {
+        auto pos = out.size();
+        out.resize(pos + chunk);
+        stream.next_out = out.data() + pos;
+        stream.avail_out = chunk;
+        deflate(&stream, finish ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+        out.resize(pos + chunk - stream.avail_out);
+    } while (stream.avail_out == 0);
+    if (    finish
+        &&  out.size() >= sizeof(FLUSH_MARKER)
+        &&  !memcmp(out.data() + out.size() - sizeof(FLUSH_MARKER), FLUSH_MARKER, sizeof(FLUSH_MARKER))) {
+        out.resize(out.size() - sizeof(FLUSH_MARKER));
+    }
+}
+
+bool
+Deflate_stream::Decompress(const void *data, size_t len, size_t max_len, std::vector<uint8_t> &out)
+{
+    ASSERT(mode == Mode::DECOMPRESS);
+    auto &stream = impl->stream;
+    auto start = out.size();
+    size_t chunk = std::max(len * 4, MIN_CHUNK);
+    for (int part = 0; part < 2; part++) {
+        if (part == 0) {
+            stream.next_in = const_cast<Bytef *>(static_cast<const Bytef *>(data));
+            stream.avail_in = len;
+        } else {
+            stream.next_in = const_cast<Bytef *>(FLUSH_MARKER);
+            stream.avail_in = sizeof(FLUSH_MARKER);
+        }
+        do {
+            auto pos = out.size();
+            out.resize(pos + chunk);
+            stream.next_out = out.data() + pos;
+            stream.avail_out = chunk;
+            int res = inflate(&stream, Z_SYNC_FLUSH);
+            out.resize(pos + chunk - stream.avail_out);
+            if (res != Z_OK && !(res == Z_BUF_ERROR && stream.avail_in == 0)) {
+                return false;
+            }
+            if (out.size() - start > max_len) {
+                return false;
+            }
+        } while (stream.avail_in || stream.avail_out == 0);
+    }
+    return true;
+}
@@ -5,10 +5,21 @@
 #include <ugcs/vsm/device.h>
 #include <ugcs/vsm/cucs_processor.h>
 
+#include <algorithm>
+
 using namespace ugcs::vsm;
 
+constexpr double Device::LINK_BUDGET_MAX_SCALE;
+constexpr size_t Device::DEFAULT_HISTORY_BUDGET;
+
 Ucs_request::Ucs_request(ugcs::vsm::proto::Vsm_message m):
-    request(std::move(m))
+    Ucs_request(std::make_shared<ugcs::vsm::proto::Vsm_message>(std::move(m)))
+{
+}
+
+Ucs_request::Ucs_request(Proto_msg_ptr m):
+    message(std::move(m)),
+    request(*message)
 {
 }
 
@@ -154,6 +165,18 @@ Device::On_ucs_message(
     ugcs::vsm::proto::Vsm_message message,
     Response_sender completion_handler,
     ugcs::vsm::Request_completion_context::Ptr completion_ctx)
+{
+    On_ucs_message(
+        std::make_shared<ugcs::vsm::proto::Vsm_message>(std::move(message)),
+        completion_handler,
+        completion_ctx);
+}
+
+void
+Device::On_ucs_message(
+    Proto_msg_ptr message,
+    Response_sender completion_handler,
+    ugcs::vsm::Request_completion_context::Ptr completion_ctx)
 {
     auto request = Ucs_request::Create(std::move(message));
 
@@ -169,14 +192,26 @@ Device::On_ucs_message(
             Shared_from_this(),
             request));
 
+    // See Vsm_command::Set_preemptive().
+    auto& commands = request->request.device_commands();
+    if (    commands.size()
+        &&  std::all_of(commands.begin(), commands.end(),
+                [this](const proto::Device_command& cmd) {
+                    auto vsm_cmd = Get_command(cmd.command_id());
+                    return vsm_cmd && vsm_cmd->Is_preemptive();
+                }))
+    {
+        request->Set_priority(Request::Priority::HIGH);
+    }
+
     processor->Submit_request(request);
 }
 
 void
-Device::Send_ucs_message(Proto_msg_ptr msg)
+Device::Send_ucs_message(Proto_msg_ptr msg, Telemetry_rx_times rx_times)
 {
     if (my_handle) {
-        Cucs_processor::Get_instance()->Send_ucs_message(my_handle, msg);
+        Cucs_processor::Get_instance()->Send_ucs_message(my_handle, msg, 0, std::move(rx_times));
     } else {
         LOG_ERR("Send while device not registered");
     }
@@ -220,12 +255,31 @@ Device::Commit_to_ucs(bool log_message)
     }
     auto msg = std::make_shared<ugcs::vsm::proto::Vsm_message>();
     auto report = msg->mutable_device_status();
+    Telemetry_rx_times rx_times;
+
+    double interval_scale = 1;
+    if (link_budget) {
+        interval_scale = Get_link_budget_scale(
+            Cucs_processor::Get_instance()->Get_write_backlog(), link_budget);
+    }
+    const Property::Commit_policy default_policy;
 
     for (auto sd : subsystems) {
         for (auto it : sd->telemetry_fields) {
-            if (it->Is_changed()) {
+            auto policy = it->Get_commit_policy();
+            if (!policy) {
+                policy = &default_policy;
+                if (!telemetry_policies.empty()) {
+                    auto pit = telemetry_policies.find(it->Get_semantic());
+                    if (pit != telemetry_policies.end()) {
+                        policy = &pit->second;
+                    }
+                }
+            }
+            if (it->Is_changed(*policy, interval_scale)) {
                 auto tf = report->add_telemetry_fields();
                 it->Write_as_telemetry(tf);
+                rx_times.push_back(it->Get_rx_time());
                 tf->set_ms_since_epoch(
                     std::chrono::duration_cast<std::chrono::milliseconds>(
                         it->Get_update_time() - begin_of_epoch).count());
@@ -251,8 +305,57 @@ Device::Commit_to_ucs(bool log_message)
         if (log_message) {
             LOG("%s", msg->SerializeAsString().c_str());
         }
-        Send_ucs_message(msg);
+        Send_ucs_message(msg, std::move(rx_times));
+    }
+}
+
+void
+Device::Set_telemetry_policy(proto::Field_semantic semantic, const Property::Commit_policy& policy)
+{
+    telemetry_policies[semantic] = policy;
+}
+
+void
+Device::Set_link_budget(size_t max_backlog)
+{
+    link_budget = max_backlog;
+}
+
+size_t
+Device::Enable_telemetry_history(Property::Ptr field, size_t capacity)
+{
+    auto history = field->Get_history();
+    if (history) {
+        history_used -= history->Get_capacity() * Property_history::SAMPLE_SIZE;
+    }
+    size_t available = (history_budget - std::min(history_budget, history_used)) /
+        Property_history::SAMPLE_SIZE;
+    if (capacity > available) {
+        LOG_WARN("History of %s reduced to %zu samples, budget exceeded",
+            field->Get_name().c_str(), available);
+        capacity = available;
+    }
+    field->Enable_history(capacity);
+    history_used += capacity * Property_history::SAMPLE_SIZE;
+    return capacity;
+}
+
+void
+Device::Set_history_budget(size_t bytes)
+{
+    history_budget = bytes;
+}
+
+double
+Device::Get_link_budget_scale(size_t backlog, size_t max_backlog)
+{
+    if (!max_backlog) {
+        return 1;
+    }
+    if (backlog >= max_backlog) {
+        return LINK_BUDGET_MAX_SCALE;
     }
+    return 1 + (LINK_BUDGET_MAX_SCALE - 1) * backlog / max_backlog;
 }
 
 Vsm_command::Ptr
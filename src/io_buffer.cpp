@@ -10,6 +10,7 @@
 #include <ugcs/vsm/io_buffer.h>
 #include <ugcs/vsm/exception.h>
 
+#include <algorithm>
 #include <cstring>
 
 using namespace ugcs::vsm;
@@ -41,7 +42,7 @@ Io_buffer::Io_buffer():
 
 Io_buffer::Io_buffer(const Io_buffer &buf, size_t offset, size_t len):
     std::enable_shared_from_this<ugcs::vsm::Io_buffer>(buf),
-    data(buf.data)
+    data(buf.data), rx_time(buf.rx_time)
 {
     if (len == END) {
         if (offset > buf.len) {
@@ -63,7 +64,7 @@ Io_buffer::Io_buffer(const Io_buffer &buf, size_t offset, size_t len):
 }
 
 Io_buffer::Io_buffer(Io_buffer &&buf):
-    data(std::move(buf.data)), offset(buf.offset), len(buf.len)
+    data(std::move(buf.data)), offset(buf.offset), len(buf.len), rx_time(buf.rx_time)
 {
 }
 
@@ -134,16 +135,24 @@ Io_buffer::Io_buffer(const void *data, size_t len)
 Io_buffer::Ptr
 Io_buffer::Concatenate(Io_buffer::Ptr buf)
 {
-    if (buf->len == 0) {
+    if (buf->len == 0 && buf->rx_time <= rx_time) {
         return Shared_from_this();
     }
-    if (len == 0) {
+    if (len == 0 && rx_time <= buf->rx_time) {
         return buf;
     }
+    if (buf->len == 0 || len == 0) {
+        /* Only timestamp should be updated, data are shared. */
+        auto result = Create(len ? *this : *buf);
+        result->rx_time = std::max(rx_time, buf->rx_time);
+        return result;
+    }
     auto vec = std::make_shared<std::vector<uint8_t>>(len + buf->len);
     std::memcpy(&vec->front(), &(*data)[offset], len);
     std::memcpy(&(*vec)[len], &(*buf->data)[buf->offset], buf->len);
-    return Create(std::move(vec));
+    auto result = Create(std::move(vec));
+    result->rx_time = std::max(rx_time, buf->rx_time);
+    return result;
 }
 
 Io_buffer::Ptr
@@ -159,10 +168,14 @@ Io_buffer::Slice(size_t offset, size_t len) const
         VSM_EXCEPTION(Invalid_param_exception,
                       "Offset and length exceeds buffer boundary");
     }
+    Ptr result;
     if (len == 0) {
-        return Create(nullptr, 0);
+        result = Create(nullptr, 0);
+    } else {
+        result = Create(data, this->offset + offset, len);
     }
-    return Create(data, this->offset + offset, len);
+    result->rx_time = rx_time;
+    return result;
 }
 
 const void *
@@ -0,0 +1,58 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Io_buffer_pool class implementation.
+ */
+
+#include <ugcs/vsm/io_buffer_pool.h>
+
+using namespace ugcs::vsm;
+
+Io_buffer_pool::Io_buffer_pool(size_t max_pooled, size_t max_capacity):
+    max_pooled(max_pooled),
+    max_capacity(max_capacity)
+{
+}
+
+Io_buffer_pool::Data_ptr
+Io_buffer_pool::Allocate(size_t size)
+{
+    std::unique_ptr<std::vector<uint8_t>> data;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!pool.empty()) {
+            data = std::move(pool.back());
+            pool.pop_back();
+        }
+    }
+    if (!data) {
+        data = std::make_unique<std::vector<uint8_t>>();
+    }
+    data->resize(size);
+    auto self = Shared_from_this();
+    return Data_ptr(data.release(), [self](std::vector<uint8_t> *data) {
+        self->Release(data);
+    });
+}
+
+size_t
+Io_buffer_pool::Get_pooled_count()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return pool.size();
+}
+
+void
+Io_buffer_pool::Release(std::vector<uint8_t> *data)
+{
+    std::unique_ptr<std::vector<uint8_t>> ptr(data);
+    if (ptr->capacity() > max_capacity) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    if (pool.size() < max_pooled) {
+        pool.push_back(std::move(ptr));
+    }
+}
@@ -0,0 +1,168 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Io_relay class implementation.
+ */
+
+#include <ugcs/vsm/io_relay.h>
+#include <ugcs/vsm/socket_processor.h>
+#include <ugcs/vsm/debug.h>
+
+using namespace ugcs::vsm;
+
+constexpr size_t Io_relay::CHUNK_SIZE;
+
+Io_relay::Io_relay(Io_stream::Ref first, Io_stream::Ref second,
+                   Request_completion_context::Ptr completion_ctx,
+                   bool allow_splice):
+    completion_ctx(completion_ctx),
+    allow_splice(allow_splice)
+{
+    if (!first || !second || !completion_ctx) {
+        VSM_EXCEPTION(Nullptr_exception, "Relay streams and context should be specified");
+    }
+    directions[0].from = first;
+    directions[0].to = second;
+    directions[1].from = second;
+    directions[1].to = first;
+}
+
+void
+Io_relay::Start(Done_handler handler)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (active) {
+        VSM_EXCEPTION(Invalid_op_exception, "Relay already started");
+    }
+    active = true;
+    done_handler = handler;
+    Start_direction(0);
+    Start_direction(1);
+}
+
+void
+Io_relay::Stop()
+{
+    Finish(Io_result::CANCELED);
+}
+
+void
+Io_relay::Start_direction(size_t idx)
+{
+    auto &dir = directions[idx];
+    if (allow_splice && Socket_processor::Is_splice_supported()) {
+        auto from = std::dynamic_pointer_cast<Socket_processor::Stream>(
+            dir.from->shared_from_this());
+        auto to = std::dynamic_pointer_cast<Socket_processor::Stream>(
+            dir.to->shared_from_this());
+        if (    from && to
+            &&  from->Get_type() == Io_stream::Type::TCP
+            &&  to->Get_type() == Io_stream::Type::TCP) {
+            dir.spliced = true;
+            dir.op = from->Splice_to(
+                to,
+                Make_callback(&Io_relay::On_spliced, Shared_from_this(),
+                              static_cast<uint64_t>(0), Io_result::OK, idx),
+                completion_ctx);
+            return;
+        }
+    }
+    Read_next(idx);
+}
+
+void
+Io_relay::Read_next(size_t idx)
+{
+    auto &dir = directions[idx];
+    dir.op = dir.from->Read(
+        CHUNK_SIZE, 1,
+        Make_callback(&Io_relay::On_read, Shared_from_this(),
+                      Io_buffer::Ptr(), Io_result::OK, idx),
+        completion_ctx);
+}
+
+void
+Io_relay::On_read(Io_buffer::Ptr buffer, Io_result result, size_t idx)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!active) {
+        return;
+    }
+    auto &dir = directions[idx];
+    if (buffer && buffer->Get_length()) {
+        dir.bytes += buffer->Get_length();
+        if (result == Io_result::OK) {
+            dir.op = dir.to->Write(
+                buffer,
+                Make_callback(&Io_relay::On_write, Shared_from_this(),
+                              Io_result::OK, idx),
+                completion_ctx);
+            return;
+        }
+        /* Source ended, pass the remaining data and finish. */
+        dir.to->Write(buffer, Make_dummy_callback<void, Io_result>(), completion_ctx);
+    }
+    lock.unlock();
+    Finish(result == Io_result::OK ? Io_result::CLOSED : result);
+}
+
+void
+Io_relay::On_write(Io_result result, size_t idx)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!active) {
+        return;
+    }
+    if (result != Io_result::OK) {
+        lock.unlock();
+        Finish(result);
+        return;
+    }
+    Read_next(idx);
+}
+
+void
+Io_relay::On_spliced(uint64_t bytes, Io_result result, size_t idx)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    auto &dir = directions[idx];
+    dir.bytes += bytes;
+    if (!active) {
+        return;
+    }
+    if (result == Io_result::OTHER_FAILURE && !bytes) {
+        /* Splice is not possible for these streams, fall back to buffers. */
+        dir.spliced = false;
+        Read_next(idx);
+        return;
+    }
+    lock.unlock();
+    Finish(result == Io_result::OK ? Io_result::CLOSED : result);
+}
+
+void
+Io_relay::Finish(Io_result result)
+{
+    Operation_waiter ops[2];
+    Done_handler handler;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!active) {
+            return;
+        }
+        active = false;
+        for (size_t i = 0; i < 2; i++) {
+            ops[i] = std::move(directions[i].op);
+        }
+        handler = std::move(done_handler);
+    }
+    for (auto &op : ops) {
+        /* Splice is canceled to get the relayed bytes count. */
+        op.Cancel();
+    }
+    if (handler) {
+        handler(result);
+    }
+}
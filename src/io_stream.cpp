@@ -9,6 +9,7 @@
 #include <ugcs/vsm/io_stream.h>
 #include <ugcs/vsm/debug.h>
 
+#include <algorithm>
 #include <climits>
 
 using namespace ugcs::vsm;
@@ -18,6 +19,249 @@ const Io_stream::Offset Io_stream::OFFSET_END = LLONG_MAX;
 
 std::mutex Io_stream::name_mutex;
 
+constexpr size_t Read_subscription::DEFAULT_MAX_BATCH;
+constexpr size_t Read_subscription::DEFAULT_MAX_PENDING;
+
+namespace {
+
+/** Keeps one read operation pending on behalf of a subscription, used
+ * for streams which do not support subscriptions natively.
+ */
+class Read_pump: public std::enable_shared_from_this<Read_pump> {
+    DEFINE_COMMON_CLASS(Read_pump, Read_pump)
+
+public:
+    Read_pump(Io_stream::Ptr stream, Read_subscription::Ptr subscription):
+        stream(stream), subscription(subscription)
+    {}
+
+    void
+    Start()
+    {
+        subscription->Set_ready_handler(
+                Make_callback(&Read_pump::Schedule, Shared_from_this()));
+        Schedule();
+    }
+
+private:
+    Io_stream::Ptr stream;
+
+    Read_subscription::Ptr subscription;
+
+    std::mutex mutex;
+
+    bool reading = false;
+
+    Operation_waiter read_op;
+
+    void
+    Schedule()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (subscription->Is_ended()) {
+            Operation_waiter op = std::move(read_op);
+            lock.unlock();
+            op.Abort();
+            return;
+        }
+        if (reading || !subscription->Is_ready()) {
+            return;
+        }
+        reading = true;
+        read_op = stream->Read(subscription->Get_max_to_read(), 1,
+                Make_read_callback(&Read_pump::On_read, Shared_from_this()),
+                subscription->Get_completion_context());
+    }
+
+    void
+    On_read(Io_buffer::Ptr buffer, Io_result result)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            reading = false;
+        }
+        if (buffer && buffer->Get_length()) {
+            subscription->Push(buffer);
+        }
+        if (result != Io_result::OK) {
+            subscription->End(result);
+        } else {
+            Schedule();
+        }
+    }
+};
+
+} /* anonymous namespace */
+
+Read_subscription::Read_subscription(size_t max_to_read, Handler handler,
+                                     Request_completion_context::Ptr comp_ctx,
+                                     size_t max_batch, size_t max_pending):
+    max_to_read(max_to_read),
+    max_batch(max_batch ? max_batch : 1),
+    max_pending(std::max(max_pending, max_batch)),
+    comp_ctx(comp_ctx),
+    handler(handler)
+{
+}
+
+void
+Read_subscription::Pause()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    paused = true;
+}
+
+void
+Read_subscription::Resume()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    paused = false;
+    Schedule(lock);
+}
+
+void
+Read_subscription::Cancel()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    ended = true;
+    canceled = true;
+    pending.clear();
+    /* Destroy the handlers outside the lock. */
+    Handler handler_tmp = std::move(handler);
+    Ready_handler ready = std::move(ready_handler);
+    /* Cancel from the handler itself cannot wait for it. */
+    while (     handler_thread != std::thread::id()
+            &&  handler_thread != std::this_thread::get_id()) {
+        handler_done.wait(lock);
+    }
+    lock.unlock();
+    if (ready) {
+        ready();
+    }
+}
+
+bool
+Read_subscription::Is_ended()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return ended;
+}
+
+bool
+Read_subscription::Is_ready()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return !ended && pending.size() < max_pending;
+}
+
+void
+Read_subscription::Push(Io_buffer::Ptr buffer)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (ended) {
+        return;
+    }
+    pending.push_back(buffer);
+    Schedule(lock);
+}
+
+void
+Read_subscription::End(Io_result result)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (ended) {
+        return;
+    }
+    ended = true;
+    this->result = result;
+    Ready_handler ready = std::move(ready_handler);
+    Schedule(lock);
+}
+
+void
+Read_subscription::Set_ready_handler(Ready_handler handler)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!ended) {
+        ready_handler = handler;
+    }
+}
+
+void
+Read_subscription::Schedule(std::unique_lock<std::mutex> &lock)
+{
+    if (delivering || paused || !handler || (pending.empty() && !ended)) {
+        lock.unlock();
+        return;
+    }
+    if (!comp_ctx->Is_enabled()) {
+        /* Nobody to deliver to. */
+        lock.unlock();
+        return;
+    }
+    delivering = true;
+    lock.unlock();
+    auto request = Request::Create();
+    request->Set_processing_handler(
+            Make_callback([](Request::Ptr r) {
+                r->Complete();
+            }, request));
+    request->Set_completion_handler(comp_ctx,
+            Make_callback(&Read_subscription::Deliver, Shared_from_this()));
+    request->Process(true);
+}
+
+void
+Read_subscription::Deliver()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!handler) {
+        /* Canceled. */
+        delivering = false;
+        return;
+    }
+    bool was_full = pending.size() >= max_pending;
+    std::vector<Io_buffer::Ptr> batch;
+    while (!pending.empty() && batch.size() < max_batch) {
+        batch.push_back(std::move(pending.front()));
+        pending.pop_front();
+    }
+    Handler handler_tmp;
+    Io_result res = Io_result::OK;
+    if (ended && pending.empty()) {
+        /* Final invocation. */
+        handler_tmp = std::move(handler);
+        res = result;
+    } else {
+        handler_tmp = handler;
+    }
+    Ready_handler ready = was_full ? ready_handler : Ready_handler();
+    lock.unlock();
+
+    if (ready) {
+        ready();
+    }
+
+    lock.lock();
+    /* Canceled while the lock was released. */
+    if (!canceled) {
+        handler_thread = std::this_thread::get_id();
+        lock.unlock();
+        handler_tmp(std::move(batch), res);
+        lock.lock();
+        handler_thread = std::thread::id();
+        handler_done.notify_all();
+    }
+    delivering = false;
+    Schedule(lock);
+}
+
+void
+Io_stream::Subscribe_impl(Read_subscription::Ptr subscription)
+{
+    Read_pump::Create(Shared_from_this(), subscription)->Start();
+}
+
 const char*
 Io_stream::Io_result_as_char(const Io_result res)
 {
@@ -23,6 +23,7 @@ Mavlink_demuxer::Disable()
 {
     std::lock_guard<std::mutex> lock(mutex);
     default_handler = Default_handler();
+    default_processor = nullptr;
     handlers.clear();
 }
 
@@ -33,6 +34,13 @@ Mavlink_demuxer::Register_default_handler(Default_handler handler)
     default_handler = handler;
 }
 
+void
+Mavlink_demuxer::Set_default_processor(Request_processor::Ptr processor)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    default_processor = processor;
+}
+
 bool
 Mavlink_demuxer::Demux(Io_buffer::Ptr buffer, mavlink::MESSAGE_ID_TYPE message_id,
                        System_id system_id, uint8_t component_id, uint32_t request_id)
@@ -111,10 +119,12 @@ Mavlink_demuxer::Demux_try_one(Io_buffer::Ptr buffer,
                                uint32_t request_id)
 {
     std::vector<Callback_base::Ptr> cbs;
+    Request_processor::Ptr processor;
 
     Key key(message_id, system_id, component_id);
     {
         std::lock_guard<std::mutex> lock(mutex);
+        processor = default_processor;
         auto range = handlers.equal_range(std::move(key));
         for (auto it = range.first; it != range.second; it++) {
             // copy callbacks from handlers
@@ -125,7 +135,7 @@ Mavlink_demuxer::Demux_try_one(Io_buffer::Ptr buffer,
         return false;
     } else {
         for (auto cb : cbs) {
-            (*cb)(buffer, real_system_id, real_component_id, request_id);
+            (*cb)(buffer, real_system_id, real_component_id, request_id, processor);
         }
         return true;
     }
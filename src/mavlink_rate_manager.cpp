@@ -0,0 +1,352 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Mavlink_rate_manager class implementation.
+ */
+
+#include <ugcs/vsm/mavlink_rate_manager.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace ugcs::vsm;
+
+constexpr std::chrono::seconds Mavlink_rate_manager::REBOOT_GAP;
+constexpr std::chrono::seconds Mavlink_rate_manager::DISABLE_RETRY;
+constexpr std::chrono::seconds Mavlink_rate_manager::SEND_TIMEOUT;
+
+namespace {
+
+/** Messages which are sent on request or on events, never switched off. */
+const std::set<mavlink::MESSAGE_ID_TYPE> NOT_STREAMED = {
+    mavlink::MESSAGE_ID::HEARTBEAT,
+    mavlink::MESSAGE_ID::COMMAND_ACK,
+    mavlink::MESSAGE_ID::STATUSTEXT,
+    mavlink::MESSAGE_ID::PARAM_VALUE,
+    mavlink::MESSAGE_ID::MISSION_COUNT,
+    mavlink::MESSAGE_ID::MISSION_ITEM,
+    mavlink::MESSAGE_ID::MISSION_ITEM_INT,
+    mavlink::MESSAGE_ID::MISSION_REQUEST,
+    mavlink::MESSAGE_ID::MISSION_REQUEST_INT,
+    mavlink::MESSAGE_ID::MISSION_ACK,
+    mavlink::MESSAGE_ID::MISSION_ITEM_REACHED,
+    mavlink::MESSAGE_ID::AUTOPILOT_VERSION,
+    mavlink::MESSAGE_ID::TIMESYNC,
+    mavlink::MESSAGE_ID::MESSAGE_INTERVAL,
+    mavlink::MESSAGE_ID::HOME_POSITION,
+    mavlink::MESSAGE_ID::FILE_TRANSFER_PROTOCOL,
+    mavlink::MESSAGE_ID::LOG_ENTRY,
+    mavlink::MESSAGE_ID::LOG_DATA
+};
+
+/** Messages controlled by REQUEST_DATA_STREAM groups, as ArduPilot assigns
+ * them.
+ */
+const std::vector<std::pair<mavlink::MAV_DATA_STREAM, std::vector<mavlink::MESSAGE_ID_TYPE>>>
+LEGACY_STREAMS = {
+    {mavlink::MAV_DATA_STREAM_RAW_SENSORS, {
+        mavlink::MESSAGE_ID::RAW_IMU,
+        mavlink::MESSAGE_ID::SCALED_IMU,
+        mavlink::MESSAGE_ID::SCALED_IMU2,
+        mavlink::MESSAGE_ID::SCALED_PRESSURE}},
+    {mavlink::MAV_DATA_STREAM_EXTENDED_STATUS, {
+        mavlink::MESSAGE_ID::SYS_STATUS,
+        mavlink::MESSAGE_ID::POWER_STATUS,
+        mavlink::MESSAGE_ID::MISSION_CURRENT,
+        mavlink::MESSAGE_ID::GPS_RAW_INT,
+        mavlink::MESSAGE_ID::GPS_RTK,
+        mavlink::MESSAGE_ID::GPS2_RAW,
+        mavlink::MESSAGE_ID::NAV_CONTROLLER_OUTPUT}},
+    {mavlink::MAV_DATA_STREAM_RC_CHANNELS, {
+        mavlink::MESSAGE_ID::SERVO_OUTPUT_RAW,
+        mavlink::MESSAGE_ID::RC_CHANNELS,
+        mavlink::MESSAGE_ID::RC_CHANNELS_RAW}},
+    {mavlink::MAV_DATA_STREAM_POSITION, {
+        mavlink::MESSAGE_ID::GLOBAL_POSITION_INT,
+        mavlink::MESSAGE_ID::LOCAL_POSITION_NED}},
+    {mavlink::MAV_DATA_STREAM_EXTRA1, {
+        mavlink::MESSAGE_ID::ATTITUDE,
+        mavlink::MESSAGE_ID::ATTITUDE_QUATERNION}},
+    {mavlink::MAV_DATA_STREAM_EXTRA2, {
+        mavlink::MESSAGE_ID::VFR_HUD}},
+    {mavlink::MAV_DATA_STREAM_EXTRA3, {
+        mavlink::MESSAGE_ID::SYSTEM_TIME,
+        mavlink::MESSAGE_ID::DISTANCE_SENSOR,
+        mavlink::MESSAGE_ID::BATTERY_STATUS,
+        mavlink::MESSAGE_ID::VIBRATION}}
+};
+
+} /* anonymous namespace */
+
+Mavlink_rate_manager::Mavlink_rate_manager(
+        Mavlink_stream::Ptr stream,
+        Request_completion_context::Ptr completion_ctx,
+        uint8_t target_system,
+        uint8_t target_component,
+        uint8_t system_id,
+        uint8_t component_id):
+    stream(stream),
+    completion_ctx(completion_ctx),
+    target_system(target_system),
+    target_component(target_component),
+    system_id(system_id),
+    component_id(component_id)
+{
+}
+
+void
+Mavlink_rate_manager::Enable(Mavlink_demuxer::Default_handler fallback)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->fallback = fallback;
+    }
+    auto &demuxer = stream->Get_demuxer();
+    heartbeat_key = demuxer.Register_handler<mavlink::MESSAGE_ID::HEARTBEAT, mavlink::Extension>(
+            Mavlink_demuxer::Make_handler<mavlink::MESSAGE_ID::HEARTBEAT, mavlink::Extension>(
+                    &Mavlink_rate_manager::On_heartbeat, Shared_from_this()),
+            target_system);
+    ack_key = demuxer.Register_handler<mavlink::MESSAGE_ID::COMMAND_ACK, mavlink::Extension>(
+            Mavlink_demuxer::Make_handler<mavlink::MESSAGE_ID::COMMAND_ACK, mavlink::Extension>(
+                    &Mavlink_rate_manager::On_command_ack, Shared_from_this()),
+            target_system);
+    demuxer.Register_default_handler(
+            Mavlink_demuxer::Make_default_handler(
+                    &Mavlink_rate_manager::On_unhandled, Shared_from_this()));
+}
+
+void
+Mavlink_rate_manager::Disable()
+{
+    auto &demuxer = stream->Get_demuxer();
+    demuxer.Register_default_handler(Mavlink_demuxer::Default_handler());
+    std::lock_guard<std::mutex> lock(mutex);
+    fallback = Mavlink_demuxer::Default_handler();
+    if (heartbeat_key) {
+        demuxer.Unregister_handler(heartbeat_key);
+    }
+    if (ack_key) {
+        demuxer.Unregister_handler(ack_key);
+    }
+    for (auto &iter : demands) {
+        demuxer.Unregister_handler(iter.second.key);
+    }
+    demands.clear();
+}
+
+Mavlink_rate_manager::Handler_id
+Mavlink_rate_manager::Add_demand(
+        mavlink::MESSAGE_ID_TYPE message_id, double rate, Mavlink_demuxer::Key key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto id = next_id++;
+    demands.emplace(id, Demand{message_id, rate, key});
+    Apply(message_id);
+    return id;
+}
+
+void
+Mavlink_rate_manager::Unregister_handler(Handler_id id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = demands.find(id);
+    if (it == demands.end()) {
+        return;
+    }
+    auto message_id = it->second.message_id;
+    stream->Get_demuxer().Unregister_handler(it->second.key);
+    demands.erase(it);
+    Apply(message_id);
+}
+
+void
+Mavlink_rate_manager::Keep_message(mavlink::MESSAGE_ID_TYPE message_id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    kept.insert(message_id);
+    if (switched_off.count(message_id)) {
+        switched_off.erase(message_id);
+        Apply(message_id);
+    }
+}
+
+void
+Mavlink_rate_manager::Reapply()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Reapply_locked();
+}
+
+void
+Mavlink_rate_manager::Reapply_locked()
+{
+    switched_off.clear();
+    if (legacy_mode) {
+        Apply_legacy();
+        return;
+    }
+    std::set<mavlink::MESSAGE_ID_TYPE> ids;
+    for (auto &iter : demands) {
+        ids.insert(iter.second.message_id);
+    }
+    for (auto id : ids) {
+        Apply(id);
+    }
+}
+
+double
+Mavlink_rate_manager::Get_requested_rate(mavlink::MESSAGE_ID_TYPE message_id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return Get_requested_rate_locked(message_id);
+}
+
+double
+Mavlink_rate_manager::Get_requested_rate_locked(mavlink::MESSAGE_ID_TYPE message_id)
+{
+    double rate = -1;
+    for (auto &iter : demands) {
+        if (iter.second.message_id == message_id) {
+            rate = std::max(rate, iter.second.rate);
+        }
+    }
+    if (rate < 0 && (kept.count(message_id) || NOT_STREAMED.count(message_id))) {
+        rate = 0;
+    }
+    return rate;
+}
+
+void
+Mavlink_rate_manager::Apply(mavlink::MESSAGE_ID_TYPE message_id)
+{
+    if (legacy_mode) {
+        Apply_legacy();
+        return;
+    }
+    auto rate = Get_requested_rate_locked(message_id);
+    if (rate > 0) {
+        Send_interval(message_id, 1000000 / rate);
+    } else if (rate == 0) {
+        Send_interval(message_id, 0);
+    } else {
+        Send_interval(message_id, -1);
+        switched_off[message_id] = Clock::Now();
+    }
+}
+
+void
+Mavlink_rate_manager::Apply_legacy()
+{
+    for (auto &stream_messages : LEGACY_STREAMS) {
+        double rate = -1;
+        for (auto message_id : stream_messages.second) {
+            rate = std::max(rate, Get_requested_rate_locked(message_id));
+        }
+        if (rate == 0) {
+            /* Rate is not controlled. */
+            continue;
+        }
+        mavlink::Pld_request_data_stream request;
+        request->target_system = target_system;
+        request->target_component = target_component;
+        request->req_stream_id = stream_messages.first;
+        if (rate > 0) {
+            request->req_message_rate = static_cast<uint16_t>(std::ceil(rate));
+            request->start_stop = 1;
+        } else {
+            request->req_message_rate = 0;
+            request->start_stop = 0;
+        }
+        if (stream->Get_stream()) {
+            stream->Send_message(request, system_id, component_id, SEND_TIMEOUT,
+                                 Operation_waiter::Timeout_handler(), completion_ctx);
+        }
+    }
+}
+
+void
+Mavlink_rate_manager::Send_interval(mavlink::MESSAGE_ID_TYPE message_id, float interval)
+{
+    if (!stream->Get_stream()) {
+        return;
+    }
+    mavlink::Pld_command_long cmd;
+    cmd->target_system = target_system;
+    cmd->target_component = target_component;
+    cmd->command = mavlink::MAV_CMD_SET_MESSAGE_INTERVAL;
+    cmd->confirmation = 0;
+    cmd->param1 = message_id;
+    cmd->param2 = interval;
+    cmd->param3 = 0;
+    cmd->param4 = 0;
+    cmd->param5 = 0;
+    cmd->param6 = 0;
+    cmd->param7 = 0;
+    stream->Send_message(cmd, system_id, component_id, SEND_TIMEOUT,
+                         Operation_waiter::Timeout_handler(), completion_ctx);
+}
+
+void
+Mavlink_rate_manager::On_heartbeat(mavlink::Message<mavlink::MESSAGE_ID::HEARTBEAT>::Ptr message)
+{
+    if (target_component && message->Get_sender_component_id() != target_component) {
+        return;
+    }
+    auto now = Clock::Now();
+    std::lock_guard<std::mutex> lock(mutex);
+    bool apply = !heartbeat_received || now - last_heartbeat > REBOOT_GAP;
+    if (apply && heartbeat_received) {
+        LOG_INFO("Heartbeats of system %d resumed, applying message rates.", target_system);
+    }
+    last_heartbeat = now;
+    heartbeat_received = true;
+    if (apply) {
+        Reapply_locked();
+    }
+}
+
+void
+Mavlink_rate_manager::On_command_ack(mavlink::Message<mavlink::MESSAGE_ID::COMMAND_ACK>::Ptr message)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (    message->payload->command == mavlink::MAV_CMD_SET_MESSAGE_INTERVAL
+        &&  message->payload->result == mavlink::MAV_RESULT_UNSUPPORTED
+        &&  !legacy_mode) {
+        LOG_INFO("System %d does not support message intervals, using data streams.",
+                 target_system);
+        legacy_mode = true;
+        Reapply_locked();
+    }
+}
+
+bool
+Mavlink_rate_manager::On_unhandled(
+        Io_buffer::Ptr buffer, mavlink::MESSAGE_ID_TYPE message_id,
+        Mavlink_demuxer::System_id system_id, uint8_t component_id,
+        uint32_t request_id)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (    system_id == target_system
+        &&  (!target_component || component_id == target_component)
+        &&  !legacy_mode
+        &&  Get_requested_rate_locked(message_id) < 0) {
+
+        auto now = Clock::Now();
+        auto it = switched_off.find(message_id);
+        if (it == switched_off.end() || now - it->second >= DISABLE_RETRY) {
+            LOG_DEBUG("Switching off unhandled message %d of system %d.",
+                      message_id, target_system);
+            Send_interval(message_id, -1);
+            switched_off[message_id] = now;
+        }
+    }
+    auto handler = fallback;
+    /* Fallback may register handlers via the manager. */
+    lock.unlock();
+    if (handler) {
+        return handler(buffer, message_id, system_id, component_id, request_id);
+    }
+    return false;
+}
@@ -0,0 +1,221 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Mavlink_send_scheduler class implementation.
+ */
+
+#include <ugcs/vsm/mavlink_send_scheduler.h>
+#include <ugcs/vsm/debug.h>
+
+using namespace ugcs::vsm;
+
+constexpr std::chrono::milliseconds Mavlink_send_scheduler::DEFAULT_TICK;
+constexpr std::chrono::milliseconds Mavlink_send_scheduler::WRITE_TIMEOUT;
+
+Mavlink_send_scheduler::Mavlink_send_scheduler(
+        Request_completion_context::Ptr completion_ctx,
+        std::chrono::milliseconds tick):
+    completion_ctx(completion_ctx),
+    tick(tick),
+    start_time(Clock::Now())
+{
+}
+
+void
+Mavlink_send_scheduler::Enable()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    start_time = Clock::Now();
+    for (auto &e : entries) {
+        e.second.next = Get_next_time(e.second, start_time);
+    }
+    lock.unlock();
+    timer = Timer_processor::Get_instance()->Create_timer(
+        tick,
+        Make_callback(&Mavlink_send_scheduler::On_timer, Shared_from_this()),
+        completion_ctx);
+}
+
+void
+Mavlink_send_scheduler::Disable()
+{
+    if (timer) {
+        timer->Cancel();
+        timer = nullptr;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    entries.clear();
+}
+
+Mavlink_send_scheduler::Entry_id
+Mavlink_send_scheduler::Add(
+        Mavlink_stream::Ptr stream,
+        Generator generator,
+        double rate,
+        uint8_t system_id,
+        uint8_t component_id,
+        std::chrono::milliseconds phase)
+{
+    Entry entry;
+    entry.stream = stream;
+    entry.generator = generator;
+    entry.system_id = system_id;
+    entry.component_id = component_id;
+    entry.period = Get_period(rate);
+    entry.phase = std::chrono::duration_cast<Clock::Duration>(phase) % entry.period;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    entry.next = Get_next_time(entry, Clock::Now());
+    Entry_id id = next_id++;
+    entries.emplace(id, std::move(entry));
+    return id;
+}
+
+void
+Mavlink_send_scheduler::Remove(Entry_id id)
+{
+    Generator generator;
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = entries.find(id);
+    if (it != entries.end()) {
+        /* Generator is destroyed after unlocking, it may hold the last
+         * reference to its owner.
+         */
+        generator = std::move(it->second.generator);
+        entries.erase(it);
+    }
+}
+
+void
+Mavlink_send_scheduler::Remove_stream(Mavlink_stream::Ptr stream)
+{
+    std::vector<Generator> generators;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it->second.stream == stream) {
+            generators.emplace_back(std::move(it->second.generator));
+            it = entries.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+void
+Mavlink_send_scheduler::Set_rate(Entry_id id, double rate)
+{
+    auto period = Get_period(rate);
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = entries.find(id);
+    if (it == entries.end()) {
+        return;
+    }
+    auto &entry = it->second;
+    entry.period = period;
+    entry.phase %= period;
+    entry.next = Get_next_time(entry, Clock::Now());
+}
+
+Mavlink_send_scheduler::Stats
+Mavlink_send_scheduler::Get_stats()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return stats;
+}
+
+Clock::Duration
+Mavlink_send_scheduler::Get_period(double rate)
+{
+    if (!(rate > 0)) {
+        VSM_EXCEPTION(Invalid_param_exception, "Invalid periodic message rate %f", rate);
+    }
+    auto period = std::chrono::duration_cast<Clock::Duration>(
+        std::chrono::duration<double>(1 / rate));
+    return std::max(period, Clock::Duration(1));
+}
+
+Clock::Time_point
+Mavlink_send_scheduler::Get_next_time(const Entry &entry, Clock::Time_point after)
+{
+    auto base = start_time + entry.phase;
+    if (base > after) {
+        return base;
+    }
+    return base + ((after - base) / entry.period + 1) * entry.period;
+}
+
+bool
+Mavlink_send_scheduler::On_timer()
+{
+    /** Message which is due in this tick. */
+    struct Due {
+        Mavlink_stream::Ptr stream;
+        Generator generator;
+        uint8_t system_id;
+        uint8_t component_id;
+        Clock::Duration jitter;
+    };
+
+    auto now = Clock::Now();
+    std::vector<Due> due;
+    uint64_t missed = 0;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (auto &e : entries) {
+            auto &entry = e.second;
+            if (entry.next > now) {
+                continue;
+            }
+            due.push_back({entry.stream, entry.generator, entry.system_id,
+                           entry.component_id, now - entry.next});
+            auto next = Get_next_time(entry, now);
+            missed += (next - entry.next) / entry.period - 1;
+            entry.next = next;
+        }
+    }
+
+    /* Messages of each stream are coalesced into one buffer, keeping the
+     * registration order.
+     */
+    std::map<Mavlink_stream::Ptr, std::vector<uint8_t>> buffers;
+    uint64_t sent = 0;
+    std::chrono::microseconds max_jitter = std::chrono::microseconds::zero();
+    std::chrono::microseconds total_jitter = std::chrono::microseconds::zero();
+    for (auto &d : due) {
+        if (!d.stream->Get_stream()) {
+            continue;
+        }
+        auto payload = d.generator();
+        if (!payload) {
+            continue;
+        }
+        auto buffer = d.stream->Encode_message(*payload, d.system_id, d.component_id);
+        auto data = static_cast<const uint8_t *>(buffer->Get_data());
+        auto &out = buffers[d.stream];
+        out.insert(out.end(), data, data + buffer->Get_length());
+
+        auto jitter = std::chrono::duration_cast<std::chrono::microseconds>(d.jitter);
+        max_jitter = std::max(max_jitter, jitter);
+        total_jitter += jitter;
+        sent++;
+    }
+
+    for (auto &b : buffers) {
+        b.first->Send_buffer(
+            Io_buffer::Create(std::move(b.second)),
+            WRITE_TIMEOUT,
+            Operation_waiter::Timeout_handler(),
+            completion_ctx);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    stats.ticks++;
+    stats.sent += sent;
+    stats.writes += buffers.size();
+    stats.missed += missed;
+    stats.max_jitter = std::max(stats.max_jitter, max_jitter);
+    stats.total_jitter += total_jitter;
+    return true;
+}
@@ -0,0 +1,122 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Mavlink_signing class implementation.
+ */
+
+#include <ugcs/vsm/mavlink_signing.h>
+#include <ugcs/vsm/sha256.h>
+
+#include <algorithm>
+#include <chrono>
+
+using namespace ugcs::vsm;
+
+constexpr uint64_t Mavlink_signing::MAX_NEW_STREAM_AGE;
+constexpr size_t Mavlink_signing::MAX_STREAMS;
+
+namespace {
+
+/** Mavlink signing epoch 2015-01-01 in Unix time. */
+constexpr int64_t EPOCH_UNIX_TIME = 1420070400;
+
+/** Length of signature block header, i.e. link id and timestamp. */
+constexpr size_t SIGNATURE_HEADER_LEN = 7;
+
+/** Length of the signature itself. */
+constexpr size_t SIGNATURE_VALUE_LEN = 6;
+
+constexpr size_t TIMESTAMP_LEN = 6;
+
+} /* anonymous namespace */
+
+Mavlink_signing::Mavlink_signing(const Key &key, uint8_t link_id, bool accept_unsigned):
+    key(key),
+    link_id(link_id),
+    accept_unsigned(accept_unsigned),
+    timestamp(Get_current_timestamp())
+{
+}
+
+Mavlink_signing::Key
+Mavlink_signing::Make_key(const std::string &passphrase)
+{
+    return Sha256::Calculate(passphrase.data(), passphrase.size());
+}
+
+uint64_t
+Mavlink_signing::Get_current_timestamp()
+{
+    auto since_epoch = std::chrono::system_clock::now().time_since_epoch() -
+        std::chrono::seconds(EPOCH_UNIX_TIME);
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(since_epoch).count() / 10);
+}
+
+void
+Mavlink_signing::Sign(uint8_t *packet, size_t len)
+{
+    uint8_t *block = packet + len;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        timestamp = std::max(timestamp + 1, Get_current_timestamp());
+        block[0] = link_id;
+        for (size_t i = 0; i < TIMESTAMP_LEN; i++) {
+            block[1 + i] = static_cast<uint8_t>(timestamp >> (i * 8));
+        }
+    }
+    /* Start sign is hashed by Calculate(). */
+    Calculate(packet + 1, len - 1, block, block + SIGNATURE_HEADER_LEN);
+}
+
+Mavlink_signing::Result
+Mavlink_signing::Verify(const uint8_t *packet, size_t len, const uint8_t *signature,
+                        uint8_t system_id, uint8_t component_id)
+{
+    uint8_t expected[SIGNATURE_VALUE_LEN];
+    Calculate(packet, len, signature, expected);
+    if (memcmp(expected, signature + SIGNATURE_HEADER_LEN, SIGNATURE_VALUE_LEN)) {
+        return Result::BAD_SIGNATURE;
+    }
+
+    uint64_t received = 0;
+    for (size_t i = 0; i < TIMESTAMP_LEN; i++) {
+        received |= static_cast<uint64_t>(signature[1 + i]) << (i * 8);
+    }
+    uint32_t stream_id = (static_cast<uint32_t>(signature[0]) << 16) |
+                         (static_cast<uint32_t>(system_id) << 8) | component_id;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = streams.find(stream_id);
+    if (it == streams.end()) {
+        if (received + MAX_NEW_STREAM_AGE < timestamp || streams.size() >= MAX_STREAMS) {
+            return Result::REPLAY;
+        }
+        streams.emplace(stream_id, received);
+    } else {
+        if (received <= it->second) {
+            return Result::REPLAY;
+        }
+        it->second = received;
+    }
+    if (received > timestamp) {
+        timestamp = received;
+    }
+    return Result::OK;
+}
+
+void
+Mavlink_signing::Calculate(const uint8_t *packet, size_t len, const uint8_t *signature_header,
+                           uint8_t *signature)
+{
+    static const uint8_t start_sign = mavlink::START_SIGN2;
+    Sha256 sha;
+    sha.Update(key.data(), key.size());
+    sha.Update(&start_sign, 1);
+    sha.Update(packet, len);
+    sha.Update(signature_header, SIGNATURE_HEADER_LEN);
+    auto digest = sha.Final();
+    memcpy(signature, digest.data(), SIGNATURE_VALUE_LEN);
+}
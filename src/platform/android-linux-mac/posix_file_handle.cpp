@@ -292,7 +292,9 @@ Posix_file_handle::Read_complete_cbk()
         result = Io_result::OK;
         read_cb.size -= size;
         read_buf->resize(read_buf->size() - read_cb.size);
-        cur_read_request->Set_buffer_arg(Io_buffer::Create(std::move(read_buf)));
+        auto buffer = Io_buffer::Create(std::move(read_buf));
+        buffer->Set_rx_time();
+        cur_read_request->Set_buffer_arg(buffer);
     }
     cur_read_request->Set_result_arg(result);
     cur_read_request->Complete();
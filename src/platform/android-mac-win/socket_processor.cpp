@@ -12,7 +12,7 @@
 void
 ugcs::vsm::Socket_processor::On_bind_can(
         Io_request::Ptr request,
-        std::vector<int>,
+        Can_options,
         Stream::Ptr stream,
         std::string)
 {
@@ -21,3 +21,40 @@ ugcs::vsm::Socket_processor::On_bind_can(
     request->Complete();
     return;
 }
+
+void
+ugcs::vsm::Socket_processor::Handle_can_read_requests(Stream::Ptr stream)
+{
+    Handle_read_requests(stream);
+}
+
+// Gathered write is not available, requests are written one by one.
+bool
+ugcs::vsm::Socket_processor::Handle_gather_write(Stream::Ptr)
+{
+    return false;
+}
+
+// Splice is not available.
+bool
+ugcs::vsm::Socket_processor::Is_splice_supported()
+{
+    return false;
+}
+
+bool
+ugcs::vsm::Socket_processor::Start_splice(Stream::Ptr)
+{
+    return false;
+}
+
+void
+ugcs::vsm::Socket_processor::Handle_splice(Stream::Ptr)
+{
+    ASSERT(false);
+}
+
+void
+ugcs::vsm::Socket_processor::End_splice(Stream::Ptr, Io_result, Request::Locker)
+{
+}
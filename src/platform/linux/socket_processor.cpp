@@ -8,15 +8,52 @@
 #include <ugcs/vsm/socket_processor.h>
 #include <ugcs/vsm/log.h>
 
+#include <fcntl.h>
 #include <net/if.h>
 #include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
 #include <linux/can.h>
 #include <linux/can/raw.h>
+#include <linux/net_tstamp.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+/** Maximal number of CAN frames received by one system call. */
+constexpr size_t MAX_CAN_BATCH = 64;
+
+/** Control message space for SCM_TIMESTAMPING which carries three
+ * timestamps: software, deprecated and raw hardware one.
+ */
+constexpr size_t CAN_CONTROL_SIZE = CMSG_SPACE(3 * sizeof(timespec));
+
+/** Maximal number of bytes moved by one splice() call. */
+constexpr size_t SPLICE_CHUNK_SIZE = 64 * 1024;
+
+/** Maximal number of splice rounds per socket readiness event, so one busy
+ * relay does not starve other streams.
+ */
+constexpr int MAX_SPLICE_ROUNDS = 16;
+
+/** Maximal number of write requests gathered into one system call. */
+constexpr size_t MAX_GATHER_WRITES = 32;
+
+uint64_t
+Timespec_to_ns(const timespec &ts)
+{
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+} /* anonymous namespace */
 
 void
 ugcs::vsm::Socket_processor::On_bind_can(
     Io_request::Ptr request,
-    std::vector<int> filter_messages,
+    Can_options options,
     Stream::Ptr stream,
     std::string ifname)
 {
@@ -26,24 +63,61 @@ ugcs::vsm::Socket_processor::On_bind_can(
 
     ASSERT(stream->Get_type()== Io_stream::Type::CAN);
 
+    auto fail = [&](Io_result result)
+    {
+        if (s != INVALID_SOCKET) {
+            sockets::Close_socket(s);
+        }
+        request->Set_result_arg(result);
+        request->Complete();
+    };
+
     s = socket(PF_CAN, SOCK_RAW, CAN_RAW);
     if (s == INVALID_SOCKET) {
         LOG_INFO("Cannot create can socket");
-        request->Set_result_arg(Io_result::BAD_ADDRESS);
-        request->Complete();
+        fail(Io_result::BAD_ADDRESS);
+        return;
     }
 
-    std::vector<struct can_filter> rfilter;
+    if (!options.filters.empty()) {
+        std::vector<struct can_filter> rfilter;
+        for (auto &f : options.filters) {
+            rfilter.emplace_back(can_filter{f.id, f.mask});
+        }
+        if (setsockopt(s, SOL_CAN_RAW, CAN_RAW_FILTER, rfilter.data(),
+                       sizeof(struct can_filter) * rfilter.size())) {
+            LOG_INFO("Cannot set CAN filter: %s", Log::Get_system_error().c_str());
+            fail(Io_result::OTHER_FAILURE);
+            return;
+        }
+    }
 
-    for (auto f : filter_messages) {
-        rfilter.emplace_back(can_filter{static_cast<canid_t>(f), static_cast<canid_t>(f)});
+    if (options.fd_frames) {
+        int enable = 1;
+        if (setsockopt(s, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &enable, sizeof(enable))) {
+            LOG_INFO("CAN FD frames not supported: %s", Log::Get_system_error().c_str());
+            fail(Io_result::OTHER_FAILURE);
+            return;
+        }
     }
 
-    setsockopt(s, SOL_CAN_RAW, CAN_RAW_FILTER, rfilter.data(), sizeof(struct can_filter) * rfilter.size());
+    if (options.batched && options.timestamps) {
+        int flags = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE |
+                    SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+        if (setsockopt(s, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags))) {
+            LOG_INFO("Cannot enable CAN timestamps: %s", Log::Get_system_error().c_str());
+            options.timestamps = false;
+        }
+    }
 
     snprintf(ifr.ifr_name, IFNAMSIZ, "%s", ifname.c_str());
-    ioctl(s, SIOCGIFINDEX, &ifr);
+    if (ioctl(s, SIOCGIFINDEX, &ifr)) {
+        LOG_INFO("CAN interface %s not found: %s", ifname.c_str(), Log::Get_system_error().c_str());
+        fail(Io_result::BAD_ADDRESS);
+        return;
+    }
 
+    memset(&addr, 0, sizeof(addr));
     addr.can_family  = AF_CAN;
     addr.can_ifindex = ifr.ifr_ifindex;
 
@@ -58,6 +132,9 @@ ugcs::vsm::Socket_processor::On_bind_can(
         if (request->Is_processing()) {
             // request status is still OK
             streams[stream] = stream;
+            stream->can_batched = options.batched;
+            stream->can_fd = options.fd_frames;
+            stream->can_timestamps = options.batched && options.timestamps;
             stream->Set_socket(s);
             stream->Set_state(Io_stream::State::OPENED);
             request->Set_result_arg(Io_result::OK, locker);
@@ -70,5 +147,262 @@ ugcs::vsm::Socket_processor::On_bind_can(
         request->Complete(Request::Status::OK, std::move(locker));
     } else {
         LOG_INFO("Bind failed: %s", Log::Get_system_error().c_str());
+        fail(Io_result::BAD_ADDRESS);
+    }
+}
+
+void
+ugcs::vsm::Socket_processor::Handle_can_read_requests(Stream::Ptr stream)
+{
+    constexpr size_t header_size = sizeof(Can_frame_header);
+    const size_t frame_size = stream->can_fd ? CANFD_MTU : CAN_MTU;
+    const size_t slot_size = header_size + frame_size;
+
+    mmsghdr msgs[MAX_CAN_BATCH];
+    iovec iovs[MAX_CAN_BATCH];
+    std::vector<uint8_t> control;
+    if (stream->can_timestamps) {
+        control.resize(MAX_CAN_BATCH * CAN_CONTROL_SIZE);
+    }
+
+    while (!stream->read_requests.empty()) {
+        auto request = stream->read_requests.front().first;
+
+        // Lock the request for reading so it cannot get aborted in the middle of operation
+        auto locker = request->Lock();
+        if (request->Is_aborted()) {
+            // Do not care about aborted requests.
+            stream->read_requests.pop_front();
+            continue;
+        }
+        if (!request->Is_processing()) {
+            // cancelled requests are handled in On_cancel()
+            return;
+        }
+
+        size_t count = std::min(MAX_CAN_BATCH, request->Get_max_to_read() / slot_size);
+        if (!count) {
+            LOG_WARN("Read size %zu is too small for CAN frame record",
+                     request->Get_max_to_read());
+            request->Set_result_arg(Io_result::OTHER_FAILURE, locker);
+            request->Complete(Request::Status::OK, std::move(locker));
+            stream->read_requests.pop_front();
+            continue;
+        }
+
+        /* Frames are received into fixed size slots and then packed. */
+        std::vector<uint8_t> data(count * slot_size);
+        for (size_t i = 0; i < count; i++) {
+            iovs[i].iov_base = &data[i * slot_size + header_size];
+            iovs[i].iov_len = frame_size;
+            memset(&msgs[i], 0, sizeof(msgs[i]));
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            if (stream->can_timestamps) {
+                msgs[i].msg_hdr.msg_control = &control[i * CAN_CONTROL_SIZE];
+                msgs[i].msg_hdr.msg_controllen = CAN_CONTROL_SIZE;
+            }
+        }
+
+        int received = recvmmsg(stream->Get_socket(), msgs, count, MSG_DONTWAIT, nullptr);
+        if (received <= 0) {
+            if (received < 0 && sockets::Is_last_operation_pending()) {
+                // Wait for more frames.
+                return;
+            }
+            LOG("Socket read error for stream '%s': %s",
+                stream->Get_name().c_str(),
+                Log::Get_system_error().c_str());
+            request->Set_result_arg(Io_result::CLOSED, locker);
+            request->Complete(Request::Status::OK, std::move(locker));
+            stream->read_requests.pop_front();
+            Close_stream(stream, false);
+            return;
+        }
+
+        size_t packed = 0;
+        for (int i = 0; i < received; i++) {
+            Can_frame_header header;
+            header.timestamp = 0;
+            header.frame_size = msgs[i].msg_len;
+            header.flags = 0;
+            for (auto cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr);
+                 cmsg;
+                 cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg)) {
+                if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_TIMESTAMPING) {
+                    continue;
+                }
+                auto ts = reinterpret_cast<const timespec *>(CMSG_DATA(cmsg));
+                if (ts[2].tv_sec || ts[2].tv_nsec) {
+                    header.timestamp = Timespec_to_ns(ts[2]);
+                    header.flags |= CAN_FRAME_HW_TIMESTAMP;
+                } else {
+                    header.timestamp = Timespec_to_ns(ts[0]);
+                }
+            }
+            /* Packed position never exceeds the slot position. */
+            memmove(&data[packed + header_size], &data[i * slot_size + header_size],
+                    header.frame_size);
+            memcpy(&data[packed], &header, header_size);
+            packed += header_size + header.frame_size;
+        }
+        data.resize(packed);
+
+        auto buffer = Io_buffer::Create(std::move(data));
+        buffer->Set_rx_time();
+        request->Set_buffer_arg(buffer, locker);
+        request->Set_result_arg(Io_result::OK, locker);
+        request->Complete(Request::Status::OK, std::move(locker));
+        stream->read_requests.pop_front();
+    }
+}
+
+bool
+ugcs::vsm::Socket_processor::Handle_gather_write(Stream::Ptr stream)
+{
+    iovec iov[MAX_GATHER_WRITES];
+    Request::Locker lockers[MAX_GATHER_WRITES];
+    size_t count = 0;
+    for (auto &entry : stream->write_requests) {
+        if (count == MAX_GATHER_WRITES || entry.second) {
+            break;
+        }
+        auto locker = entry.first->Lock();
+        if (!entry.first->Is_processing()) {
+            break;
+        }
+        auto &buffer = entry.first->Data_buffer();
+        /* The first request could be partially written already. */
+        size_t offset = count ? 0 : stream->written_bytes;
+        if (buffer->Get_length() <= offset) {
+            break;
+        }
+        iov[count].iov_base = const_cast<uint8_t *>(
+            static_cast<const uint8_t *>(buffer->Get_data()) + offset);
+        iov[count].iov_len = buffer->Get_length() - offset;
+        lockers[count] = std::move(locker);
+        count++;
+    }
+    if (count < 2) {
+        return false;
+    }
+
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+    ssize_t written = sendmsg(stream->Get_socket(), &msg, sockets::SEND_FLAGS);
+    if (written <= 0) {
+        /* Pending and errors are handled by regular write. */
+        return false;
+    }
+    size_t left = written;
+    for (size_t i = 0; i < count; i++) {
+        if (left < iov[i].iov_len) {
+            stream->written_bytes += left;
+            return false;
+        }
+        left -= iov[i].iov_len;
+        auto request = stream->write_requests.front().first;
+        request->Set_result_arg(Io_result::OK, lockers[i]);
+        request->Complete(Request::Status::OK, std::move(lockers[i]));
+        stream->write_requests.pop_front();
+        stream->written_bytes = 0;
+    }
+    return true;
+}
+
+bool
+ugcs::vsm::Socket_processor::Is_splice_supported()
+{
+    return true;
+}
+
+bool
+ugcs::vsm::Socket_processor::Start_splice(Stream::Ptr source)
+{
+    if (pipe2(source->splice_pipe, O_NONBLOCK | O_CLOEXEC)) {
+        LOG_INFO("Cannot create splice pipe: %s", Log::Get_system_error().c_str());
+        source->splice_pipe[0] = source->splice_pipe[1] = -1;
+        return false;
+    }
+    return true;
+}
+
+void
+ugcs::vsm::Socket_processor::Handle_splice(Stream::Ptr source)
+{
+    auto target = source->splice_target;
+    auto request = source->splice_request;
+    auto locker = request->Lock();
+    if (!request->Is_processing()) {
+        // cancelled requests are handled in On_cancel()
+        return;
+    }
+    for (int round = 0; round < MAX_SPLICE_ROUNDS; round++) {
+        if (!source->splice_pending) {
+            auto spliced = splice(source->Get_socket(), nullptr,
+                                  source->splice_pipe[1], nullptr,
+                                  SPLICE_CHUNK_SIZE, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (spliced == 0) {
+                End_splice(source, Io_result::OK, std::move(locker));
+                return;
+            }
+            if (spliced < 0) {
+                if (sockets::Is_last_operation_pending()) {
+                    return;
+                }
+                LOG("Splice read error for stream '%s': %s",
+                    source->Get_name().c_str(), Log::Get_system_error().c_str());
+                End_splice(source, Io_result::CLOSED, std::move(locker));
+                return;
+            }
+            source->splice_pending = spliced;
+        }
+        auto written = splice(source->splice_pipe[0], nullptr,
+                              target->Get_socket(), nullptr,
+                              source->splice_pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (written < 0) {
+            if (sockets::Is_last_operation_pending()) {
+                return;
+            }
+            LOG("Splice write error for stream '%s': %s",
+                target->Get_name().c_str(), Log::Get_system_error().c_str());
+            End_splice(source, Io_result::CLOSED, std::move(locker));
+            return;
+        }
+        source->splice_pending -= written;
+        source->spliced_bytes += written;
+        if (source->splice_pending) {
+            /* Target is full. */
+            return;
+        }
+    }
+}
+
+void
+ugcs::vsm::Socket_processor::End_splice(Stream::Ptr source, Io_result result,
+                                        Request::Locker locker)
+{
+    auto request = source->splice_request;
+    if (!request) {
+        return;
+    }
+    for (auto &fd : source->splice_pipe) {
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    source->splice_handler.Set_arg<0>(source->spliced_bytes);
+    source->splice_request = nullptr;
+    source->splice_handler = Stream::Splice_handler();
+    source->splice_target->splice_source = nullptr;
+    source->splice_target = nullptr;
+    source->splice_pending = 0;
+    if (!locker) {
+        locker = request->Lock();
     }
+    request->Set_result_arg(result, locker);
+    request->Complete(Request::Status::OK, std::move(locker));
 }
@@ -296,7 +296,9 @@ Windows_file_handle::Read_complete_cbk(size_t transfer_size, DWORD error)
         result = Io_result::OK;
         read_size -= transfer_size;
         read_buf->resize(read_buf->size() - read_size);
-        cur_read_request->Set_buffer_arg(Io_buffer::Create(std::move(read_buf)));
+        auto buffer = Io_buffer::Create(std::move(read_buf));
+        buffer->Set_rx_time();
+        cur_read_request->Set_buffer_arg(buffer);
     }
     cur_read_request->Set_result_arg(result);
     cur_read_request->Complete();
@@ -3,7 +3,9 @@
 // See LICENSE file for license details.
 
 #include <ugcs/vsm/property.h>
+#include <ugcs/vsm/clock.h>
 #include <cmath>
+#include <algorithm>
 
 using namespace ugcs::vsm;
 
@@ -157,7 +159,7 @@ Property::Property(
     const std::string& name,
     proto::Field_semantic sem):
     semantic(sem), field_id(id), name(name),
-    last_commit_time(std::chrono::steady_clock::now())
+    last_commit_time(Clock::Now())
 {
     if (sem == proto::FIELD_SEMANTIC_DEFAULT) {
         semantic = Get_default_semantic(name);
@@ -187,7 +189,7 @@ Property::Property(
 
 Property::Property(int id, const std::string& name, Value_type type):
     type(type), field_id(id), name(name),
-    last_commit_time(std::chrono::steady_clock::now())
+    last_commit_time(Clock::Now())
 {
     switch (type) {
     case VALUE_TYPE_DOUBLE:
@@ -219,6 +221,8 @@ Property::Property(int id, const std::string& name, Value_type type):
 Property::Property(Property::Ptr src)
 {
     *this = *src;
+    /* History belongs to the source property. */
+    history = nullptr;
 }
 
 bool
@@ -399,6 +403,10 @@ Property::Set_value(double v)
     }
     value_spec = VALUE_SPEC_REGULAR;
     update_time = std::chrono::system_clock::now();
+    rx_time = Clock::Now();
+    if (history) {
+        Record_history();
+    }
 }
 
 void
@@ -433,6 +441,10 @@ Property::Set_value(int v)
     }
     value_spec = VALUE_SPEC_REGULAR;
     update_time = std::chrono::system_clock::now();
+    rx_time = Clock::Now();
+    if (history) {
+        Record_history();
+    }
 }
 
 void
@@ -461,6 +473,10 @@ Property::Set_value(unsigned int v)
     }
     value_spec = VALUE_SPEC_REGULAR;
     update_time = std::chrono::system_clock::now();
+    rx_time = Clock::Now();
+    if (history) {
+        Record_history();
+    }
 }
 
 void
@@ -479,6 +495,10 @@ Property::Set_value(bool v)
     }
     value_spec = VALUE_SPEC_REGULAR;
     update_time = std::chrono::system_clock::now();
+    rx_time = Clock::Now();
+    if (history) {
+        Record_history();
+    }
 }
 
 void
@@ -501,6 +521,7 @@ Property::Set_value(const char* v)
         Set_value_na();
     }
     update_time = std::chrono::system_clock::now();
+    rx_time = Clock::Now();
 }
 
 void
@@ -519,6 +540,7 @@ Property::Set_value(const std::string& v)
         VSM_EXCEPTION(Invalid_param_exception, "Property %s type (%d) not string", name.c_str(), type);
     }
     update_time = std::chrono::system_clock::now();
+    rx_time = Clock::Now();
 }
 
 void
@@ -548,6 +570,7 @@ Property::Set_value(const proto::List_value &v)
         VSM_EXCEPTION(Invalid_param_exception, "Property %s type (%d) not list", name.c_str(), type);
     }
     update_time = std::chrono::system_clock::now();
+    rx_time = Clock::Now();
 }
 
 
@@ -559,6 +582,39 @@ Property::Set_value_na()
         value_spec = VALUE_SPEC_NA;
     }
     update_time = std::chrono::system_clock::now();
+    rx_time = Clock::Now();
+    if (history) {
+        Record_history();
+    }
+}
+
+void
+Property::Enable_history(size_t capacity)
+{
+    history = capacity ? Property_history::Create(capacity) : nullptr;
+}
+
+void
+Property::Record_history()
+{
+    double v;
+    switch (type) {
+    case VALUE_TYPE_DOUBLE:
+    case VALUE_TYPE_FLOAT:
+        v = double_value;
+        break;
+    case VALUE_TYPE_INT:
+    case VALUE_TYPE_ENUM:
+        v = int_value;
+        break;
+    case VALUE_TYPE_BOOL:
+        v = bool_value;
+        break;
+    default:
+        /* Not a numeric value. */
+        return;
+    }
+    history->Record(rx_time, value_spec == VALUE_SPEC_REGULAR ? v : NAN);
 }
 
 bool
@@ -689,21 +745,68 @@ Property::Set_changed()
 bool
 Property::Is_changed()
 {
-    if (is_changed && std::chrono::steady_clock::now() - last_commit_time >= COMMIT_TIMEOUT) {
-        return true;
-    }
+    return Is_changed(Commit_policy());
+}
+
+bool
+Property::Is_changed(const Commit_policy& policy, double interval_scale)
+{
     if (!Is_value_na() && timeout.count()) {
         // timeout specified and value is still present.
-        if ((std::chrono::system_clock::now() - update_time) > timeout) {
+        // Use monotonic Clock, so the timeout can be driven by virtual time.
+        if ((Clock::Now() - rx_time) > timeout) {
             // value expired, set to na.
             // LOG("Setting %d to na", field_id);
             Set_value_na();
             return true;
         }
     }
+    auto since_commit = Clock::Now() - last_commit_time;
+    if (is_changed) {
+        auto interval = policy.min_interval;
+        if (interval_scale > 1) {
+            interval = std::chrono::duration_cast<std::chrono::milliseconds>(
+                interval * interval_scale);
+        }
+        if (since_commit >= interval && !Is_within_deadband(policy.deadband)) {
+            return true;
+        }
+    }
+    // Expired values are handled above, so heartbeat never resends a value
+    // which is going to be reported as N/A.
+    if (    policy.heartbeat.count()
+        &&  since_commit >= policy.heartbeat
+        &&  !Is_value_na())
+    {
+        return true;
+    }
     return false;
 };
 
+void
+Property::Set_commit_policy(const Commit_policy& policy)
+{
+    commit_policy = policy;
+    has_commit_policy = true;
+}
+
+bool
+Property::Is_within_deadband(double deadband)
+{
+    if (deadband <= 0 || !is_committed_value_valid || value_spec != VALUE_SPEC_REGULAR) {
+        return false;
+    }
+    switch (type) {
+    case VALUE_TYPE_DOUBLE:
+    case VALUE_TYPE_FLOAT:
+        return std::abs(double_value - committed_value) < deadband;
+    case VALUE_TYPE_INT:
+        return std::abs(int_value - committed_value) < deadband;
+    default:
+        return false;
+    }
+}
+
 Property::Ptr
 Property::Default_value()
 {
@@ -778,7 +881,13 @@ Property::Write_as_telemetry(proto::Telemetry_field* tf)
     tf->set_field_id(field_id);
     Write_value(tf->mutable_value());
     is_changed = false;
-    last_commit_time = std::chrono::steady_clock::now();
+    last_commit_time = Clock::Now();
+    is_committed_value_valid = (value_spec == VALUE_SPEC_REGULAR);
+    if (type == VALUE_TYPE_INT) {
+        committed_value = int_value;
+    } else {
+        committed_value = double_value;
+    }
 }
 
 void
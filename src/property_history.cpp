@@ -0,0 +1,115 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Property_history class implementation.
+ */
+
+#include <ugcs/vsm/property_history.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace ugcs::vsm;
+
+constexpr size_t Property_history::SAMPLE_SIZE;
+
+Property_history::Property_history(size_t capacity):
+    capacity(capacity),
+    times(capacity),
+    values(capacity)
+{
+    if (!capacity) {
+        VSM_EXCEPTION(Invalid_param_exception, "Zero history capacity");
+    }
+}
+
+void
+Property_history::Set_last_time(Clock::Time_point time)
+{
+    if (size) {
+        times[head ? head - 1 : capacity - 1] = time;
+    }
+}
+
+Property_history::Sample
+Property_history::Get_sample(size_t index) const
+{
+    if (index >= size) {
+        VSM_EXCEPTION(Invalid_param_exception, "History sample %zu out of range", index);
+    }
+    size_t i = Get_index(index);
+    return {times[i], values[i]};
+}
+
+Property_history::Stats
+Property_history::Get_stats(Clock::Time_point from, Clock::Time_point to) const
+{
+    Stats stats;
+    double sum = 0;
+    stats.min = std::numeric_limits<double>::infinity();
+    stats.max = -std::numeric_limits<double>::infinity();
+    for (size_t n = 0; n < size; n++) {
+        size_t i = Get_index(n);
+        if (times[i] < from || times[i] > to || std::isnan(values[i])) {
+            continue;
+        }
+        stats.count++;
+        sum += values[i];
+        stats.min = std::min(stats.min, values[i]);
+        stats.max = std::max(stats.max, values[i]);
+    }
+    if (stats.count) {
+        stats.mean = sum / stats.count;
+    } else {
+        stats.min = stats.max = stats.mean = std::numeric_limits<double>::quiet_NaN();
+    }
+    return stats;
+}
+
+Property_history::Stats
+Property_history::Get_stats(Clock::Duration window) const
+{
+    return Get_stats(Clock::Now() - window);
+}
+
+std::vector<Property_history::Sample>
+Property_history::Downsample(
+        Clock::Time_point from, Clock::Time_point to, Clock::Duration step) const
+{
+    if (step <= Clock::Duration::zero()) {
+        VSM_EXCEPTION(Invalid_param_exception, "Non-positive downsampling step");
+    }
+    std::vector<Sample> result;
+    Clock::Time_point interval_start;
+    double sum = 0;
+    size_t count = 0;
+    for (size_t n = 0; n < size; n++) {
+        size_t i = Get_index(n);
+        if (times[i] < from || times[i] >= to || std::isnan(values[i])) {
+            continue;
+        }
+        auto start = from + (times[i] - from) / step * step;
+        if (count && start != interval_start) {
+            result.push_back({interval_start, sum / count});
+            sum = 0;
+            count = 0;
+        }
+        interval_start = start;
+        sum += values[i];
+        count++;
+    }
+    if (count) {
+        result.push_back({interval_start, sum / count});
+    }
+    return result;
+}
+
+void
+Property_history::Clear()
+{
+    head = 0;
+    size = 0;
+}
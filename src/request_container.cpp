@@ -11,6 +11,96 @@
 
 using namespace ugcs::vsm;
 
+constexpr size_t Request_container::PRIORITY_COUNT;
+constexpr unsigned Request_container::Request_queue::STARVATION_LIMIT;
+
+void
+Request_container::Request_queue::Push(Request::Ptr request)
+{
+    request->queued_time = Clock::Now();
+    lanes[static_cast<size_t>(request->priority)].requests.push_back(std::move(request));
+    size++;
+}
+
+Request::Ptr
+Request_container::Request_queue::Pop()
+{
+    if (!size) {
+        return nullptr;
+    }
+    /* Highest waiting lane which has been starved for too long goes first,
+     * otherwise the highest non-empty lane.
+     */
+    Lane *selected = nullptr;
+    for (size_t i = 1; i < lanes.size() && !selected; i++) {
+        if (!lanes[i].requests.empty() && lanes[i].starved >= STARVATION_LIMIT) {
+            selected = &lanes[i];
+        }
+    }
+    for (size_t i = 0; i < lanes.size() && !selected; i++) {
+        if (!lanes[i].requests.empty()) {
+            selected = &lanes[i];
+        }
+    }
+    for (auto &lane : lanes) {
+        if (&lane == selected || lane.requests.empty()) {
+            lane.starved = 0;
+        } else if (&lane > selected) {
+            lane.starved++;
+        }
+    }
+    auto request = std::move(selected->requests.front());
+    selected->requests.pop_front();
+    size--;
+    auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::Now() - request->queued_time);
+    auto &stats = selected->stats;
+    stats.processed++;
+    stats.total_latency += latency;
+    if (latency > stats.max_latency) {
+        stats.max_latency = latency;
+    }
+    return request;
+}
+
+std::list<Request::Ptr>
+Request_container::Request_queue::Take_all()
+{
+    std::list<Request::Ptr> result;
+    for (auto &lane : lanes) {
+        result.splice(result.end(), lane.requests);
+        lane.starved = 0;
+    }
+    size = 0;
+    return result;
+}
+
+Request_container::Lane_stats
+Request_container::Request_queue::Get_stats(Priority priority) const
+{
+    auto &lane = lanes[static_cast<size_t>(priority)];
+    auto stats = lane.stats;
+    stats.queued = lane.requests.size();
+    return stats;
+}
+
+Request::Ptr
+Request_container::Request_queue::Remove_droppable()
+{
+    for (size_t i = lanes.size() - 1; i > 0; i--) {
+        auto &requests = lanes[i].requests;
+        for (auto it = requests.begin(); it != requests.end(); it++) {
+            if ((*it)->Is_droppable()) {
+                auto request = std::move(*it);
+                requests.erase(it);
+                size--;
+                return request;
+            }
+        }
+    }
+    return nullptr;
+}
+
 Request_container::Request_container(
         const std::string& name,
         Request_waiter::Ptr waiter):
@@ -51,11 +141,11 @@ Request_container::Process_requests(int requests_limit)
     int num_processed = 0;
     while (!requests_limit || requests_limit > num_processed) {
         auto lock = waiter->Lock();
-        if (request_queue.empty()) {
+        request = request_queue.Pop();
+        if (!request) {
             break;
         }
-        request = request_queue.front();
-        request_queue.pop_front();
+        On_requests_taken();
         lock.Unlock();
         Process_request(request);
         num_processed++;
@@ -69,11 +159,11 @@ Request_container::Process_requests(std::unique_lock<std::mutex> &lock, int requ
     Request::Ptr request;
     int num_processed = 0;
     while (!requests_limit || requests_limit > num_processed) {
-        if (request_queue.empty()) {
+        request = request_queue.Pop();
+        if (!request) {
             break;
         }
-        request = request_queue.front();
-        request_queue.pop_front();
+        On_requests_taken();
         lock.unlock();
         Process_request(request);
         lock.lock();
@@ -89,7 +179,15 @@ Request_container::Set_waiter(Request_waiter::Ptr waiter)
         VSM_EXCEPTION(Nullptr_exception, "Null waiter provided");
     }
     // XXX check use cases and atomicity
+    if (this->waiter) {
+        auto lock = this->waiter->Lock();
+        this->waiter->Remove_ready(this);
+    }
     this->waiter = waiter;
+    auto lock = waiter->Lock_notify();
+    if (!request_queue.Is_empty()) {
+        waiter->Push_ready(this);
+    }
 }
 
 void
@@ -124,10 +222,11 @@ Request_container::Disable()
     Abort_requests();
 
     lock.Lock();
-    if (!request_queue.empty()) {
+    waiter->Remove_ready(this);
+    if (!request_queue.Is_empty()) {
         VSM_EXCEPTION(Internal_error_exception,
                 "%zu requests still present after container is disabled.",
-                request_queue.size());
+                request_queue.Get_size());
     }
 }
 
@@ -137,6 +236,32 @@ Request_container::Is_enabled() const
     return is_enabled;
 }
 
+Request_container::Lane_stats
+Request_container::Get_lane_stats(Priority priority)
+{
+    auto lock = waiter->Lock();
+    return request_queue.Get_stats(priority);
+}
+
+void
+Request_container::Set_capacity(size_t capacity, Overflow_policy policy)
+{
+    auto lock = waiter->Lock();
+    this->capacity = capacity;
+    overflow_policy = policy;
+    /* Blocked submitters may proceed with the new limit. */
+    space_cond.notify_all();
+}
+
+Request_container::Overload_stats
+Request_container::Get_overload_stats()
+{
+    auto lock = waiter->Lock();
+    auto stats = overload_stats;
+    stats.depth = request_queue.Get_size();
+    return stats;
+}
+
 void
 Request_container::On_enable()
 {
@@ -155,6 +280,10 @@ Request_container::Set_disabled()
 {
     auto locker = waiter->Lock_notify();
     is_enabled = false;
+    /* Wake up the threads serving the container. */
+    waiter->Push_ready(this);
+    /* And the blocked submitters. */
+    space_cond.notify_all();
 }
 
 void
@@ -163,8 +292,9 @@ Request_container::Abort_requests()
     auto lock = waiter->Lock();
     abort_ongoing = true;
     bool cont = true;
-    while (!request_queue.empty() && cont) {
-        auto requests_copy = std::move(request_queue);
+    while (!request_queue.Is_empty() && cont) {
+        auto requests_copy = request_queue.Take_all();
+        On_requests_taken();
         lock.Unlock();
 
         for (auto& req : requests_copy) {
@@ -176,7 +306,7 @@ Request_container::Abort_requests()
 
         lock.Lock();
         cont = false;
-        for (auto& req : request_queue) {
+        request_queue.For_each([&cont](const Request::Ptr &req) {
             if (req->Get_status() != Request::Status::ABORTED) {
                 /* Full abort of one request generated another request.
                  * This is potentially error prone, so assert in debug,
@@ -185,7 +315,7 @@ Request_container::Abort_requests()
                 ASSERT(false);
                 cont = true;
             }
-        }
+        });
     }
     /* New submissions are not allowed after this at all. */
     abort_ongoing = false;
@@ -205,9 +335,9 @@ Request_container::Processing_loop()
         On_wait_and_process();
     }
     auto lock = waiter->Lock();
-    if (request_queue.size()) {
+    if (request_queue.Get_size()) {
         LOG_DEBUG("Request container [%s] still has %zu requests after processing "
-                  "loop exit.", name.c_str(), request_queue.size());
+                  "loop exit.", name.c_str(), request_queue.Get_size());
     }
 }
 
@@ -220,6 +350,14 @@ Request_container::Submit_request_impl(
 
     VERIFY(locker.Is_same_waiter(waiter), true);
 
+    Request::Ptr dropped;
+    if (    capacity
+        &&  request->Get_priority() != Priority::HIGH
+        &&  request->Get_status() != Request::Status::ABORT_PENDING) {
+
+        dropped = Check_capacity(request);
+    }
+
     if (!Is_enabled()) {
         if (!abort_ongoing.load()) {
             VSM_EXCEPTION(Internal_error_exception,
@@ -233,5 +371,69 @@ Request_container::Submit_request_impl(
                     static_cast<int>(status), name.c_str());
         }
     }
-    request_queue.push_back(request);
+    if (dropped != request) {
+        request_queue.Push(request);
+        waiter->Push_ready(this);
+        if (request_queue.Get_size() > overload_stats.max_depth) {
+            overload_stats.max_depth = request_queue.Get_size();
+        }
+    }
+    if (dropped) {
+        locker.Unlock();
+        dropped->Abort();
+        /* Do process complete to finalize abort pending, if any. */
+        dropped->Process(false);
+    }
+}
+
+Request::Ptr
+Request_container::Check_capacity(const Request::Ptr &request)
+{
+    if (request_queue.Get_size() < capacity) {
+        return nullptr;
+    }
+    if (!overloaded) {
+        overloaded = true;
+        overload_stats.overload_events++;
+        LOG_WARN("Request container [%s] is overloaded, %zu requests queued.",
+                 name.c_str(), request_queue.Get_size());
+    }
+    if (overflow_policy == Overflow_policy::REJECT) {
+        overload_stats.rejected++;
+        VSM_EXCEPTION(Overflow_exception,
+                "Request queue of container [%s] is full, %zu requests queued.",
+                name.c_str(), request_queue.Get_size());
+    }
+    if (overflow_policy == Overflow_policy::BLOCK) {
+        overload_stats.blocked++;
+        blocked_submitters++;
+        /* Waiter mutex is owned by the caller, keep it locked on return. */
+        std::unique_lock<std::mutex> lock(waiter->mutex, std::adopt_lock);
+        space_cond.wait(lock, [this]() {
+            return !capacity || request_queue.Get_size() < capacity || !Is_enabled();
+        });
+        lock.release();
+        blocked_submitters--;
+        return nullptr;
+    }
+    auto dropped = request_queue.Remove_droppable();
+    if (!dropped && request->Is_droppable()) {
+        dropped = request;
+    }
+    if (dropped) {
+        overload_stats.dropped++;
+    }
+    return dropped;
+}
+
+void
+Request_container::On_requests_taken()
+{
+    if (blocked_submitters) {
+        space_cond.notify_all();
+    }
+    if (overloaded && request_queue.Get_size() <= capacity / 2) {
+        overloaded = false;
+        LOG_INFO("Request container [%s] is no longer overloaded.", name.c_str());
+    }
 }
@@ -0,0 +1,105 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Request_strand class implementation.
+ */
+
+#include <ugcs/vsm/request_strand.h>
+#include <ugcs/vsm/debug.h>
+
+using namespace ugcs::vsm;
+
+constexpr int Request_strand::RUN_BATCH;
+
+void
+Request_strand::Strand_waiter::Notify()
+{
+    strand->Schedule();
+}
+
+Request_strand::Request_strand(const std::string& name,
+                               Request_container::Ptr executor):
+    Request_container(name, Strand_waiter::Create(this)),
+    executor(executor)
+{
+    if (!executor) {
+        VSM_EXCEPTION(Nullptr_exception, "Executor not specified for strand %s",
+                      name.c_str());
+    }
+}
+
+void
+Request_strand::Schedule()
+{
+    std::unique_lock<std::mutex> lock(state_mutex);
+    if (scheduled || !Is_enabled()) {
+        return;
+    }
+    {
+        auto queue_lock = waiter->Lock();
+        if (request_queue.Is_empty()) {
+            return;
+        }
+    }
+    scheduled = true;
+    lock.unlock();
+    Submit_run();
+}
+
+void
+Request_strand::Submit_run()
+{
+    auto request = Request::Create();
+    request->Set_processing_handler(
+        Make_callback(&Request_strand::Run, Shared_from_this(), request));
+    executor->Submit_request(request);
+}
+
+void
+Request_strand::Run(Request::Ptr request)
+{
+    {
+        std::unique_lock<std::mutex> lock(state_mutex);
+        run_thread = std::this_thread::get_id();
+    }
+    if (Is_enabled()) {
+        Process_requests(RUN_BATCH);
+    }
+    request->Complete();
+
+    std::unique_lock<std::mutex> lock(state_mutex);
+    run_thread = std::thread::id();
+    bool more;
+    {
+        auto queue_lock = waiter->Lock();
+        more = !request_queue.Is_empty();
+    }
+    if (!more || !Is_enabled()) {
+        scheduled = false;
+        idle_cond.notify_all();
+        return;
+    }
+    /* Let other strands of the same executor run. */
+    lock.unlock();
+    Submit_run();
+}
+
+void
+Request_strand::On_disable()
+{
+    Set_disabled();
+    std::unique_lock<std::mutex> lock(state_mutex);
+    if (run_thread == std::this_thread::get_id()) {
+        /* Disabled from own handler, will finish after the handler returns. */
+        return;
+    }
+    idle_cond.wait(lock, [this]() { return !scheduled; });
+}
+
+void
+Request_strand::Process_request(Request::Ptr request)
+{
+    request->Process(request->Is_request_processing_needed());
+}
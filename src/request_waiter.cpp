@@ -10,6 +10,8 @@
 #include <ugcs/vsm/request_container.h>
 #include <ugcs/vsm/exception.h>
 
+#include <algorithm>
+
 using namespace ugcs::vsm;
 
 /* Request_waiter::Locker class implementation. */
@@ -76,6 +78,26 @@ Request_waiter::Locker::Is_same_waiter(const Request_waiter::Ptr& other) const
 
 /* Request_waiter class implementation. */
 
+constexpr int Request_waiter::READY_QUANTUM;
+
+namespace {
+
+template <class Container_list>
+bool
+Contains(const Container_list &containers, const Request_container::Ptr &container)
+{
+    return std::find(containers.begin(), containers.end(), container) != containers.end();
+}
+
+bool
+Contains(const std::unordered_set<Request_container::Ptr> &containers,
+         const Request_container::Ptr &container)
+{
+    return containers.count(container);
+}
+
+} /* anonymous namespace */
+
 template <class Container_list>
 int
 Request_waiter::Wait_and_process_impl(const Container_list &containers,
@@ -96,14 +118,43 @@ Request_waiter::Wait_and_process_impl(const Container_list &containers,
          */
         do {
             cur_processed = 0;
-            for (auto &container : containers) {
+            /* Visit each entry once per round, processed containers which
+             * still have requests are moved to the tail.
+             */
+            for (size_t count = ready_list.size(); count && !ready_list.empty(); count--) {
+                auto container = ready_list.front().lock();
+                ready_list.pop_front();
+                if (!container) {
+                    continue;
+                }
+                if (!Contains(containers, container)) {
+                    /* Served by other thread. */
+                    ready_list.emplace_back(container);
+                    continue;
+                }
                 if (!container->Is_enabled()) {
+                    /* Kept until the container is completely disabled, so
+                     * all its waiters notice it.
+                     */
                     is_disabled = true;
-                } else {
-                    cur_processed += container->Process_requests(lock, requests_limit);
-                    if (requests_limit && num_processed + cur_processed >= requests_limit) {
-                        break;
-                    }
+                    ready_list.emplace_back(container);
+                    continue;
+                }
+                container->in_ready_list = false;
+                if (container->request_queue.Get_size() > 1) {
+                    /* Let other threads of the same waiter share the backlog. */
+                    Push_ready(container.get());
+                }
+                int limit = READY_QUANTUM;
+                if (requests_limit) {
+                    limit = std::min(limit, requests_limit - num_processed - cur_processed);
+                }
+                cur_processed += container->Process_requests(lock, limit);
+                if (!container->request_queue.Is_empty()) {
+                    Push_ready(container.get());
+                }
+                if (requests_limit && num_processed + cur_processed >= requests_limit) {
+                    break;
                 }
             }
             num_processed += cur_processed;
@@ -124,6 +175,40 @@ Request_waiter::Wait_and_process_impl(const Container_list &containers,
     return total_processed;
 }
 
+void
+Request_waiter::Push_ready(Request_container *container)
+{
+    if (container->in_ready_list) {
+        return;
+    }
+    Request_container::Ptr ptr;
+    try {
+        ptr = container->Shared_from_this();
+    } catch (const std::bad_weak_ptr &) {
+        /* Disabled from destructor, nobody can serve it anymore. */
+        return;
+    }
+    container->in_ready_list = true;
+    ready_list.emplace_back(ptr);
+}
+
+void
+Request_waiter::Remove_ready(Request_container *container)
+{
+    if (!container->in_ready_list) {
+        return;
+    }
+    container->in_ready_list = false;
+    for (auto it = ready_list.begin(); it != ready_list.end();) {
+        auto ptr = it->lock();
+        if (!ptr || ptr.get() == container) {
+            it = ready_list.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
 int
 Request_waiter::Wait_and_process(const std::initializer_list<Request_container::Ptr> &containers,
                               std::chrono::milliseconds timeout,
@@ -140,6 +225,14 @@ Request_waiter::Wait_and_process(const std::list<Request_container::Ptr> &contai
     return Wait_and_process_impl(containers, timeout, requests_limit, predicate);
 }
 
+int
+Request_waiter::Wait_and_process(const std::unordered_set<Request_container::Ptr> &containers,
+                              std::chrono::milliseconds timeout,
+                              int requests_limit, Predicate predicate)
+{
+    return Wait_and_process_impl(containers, timeout, requests_limit, predicate);
+}
+
 void
 Request_waiter::Notify()
 {
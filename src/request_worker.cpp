@@ -34,6 +34,16 @@ Request_worker::Request_worker(
     }
 }
 
+Request_worker::Request_worker(const std::string& name, size_t threads_count) :
+        Request_completion_context(name),
+        threads_count(threads_count)
+{
+    if (!threads_count) {
+        VSM_EXCEPTION(Invalid_param_exception, "Zero threads count for worker %s",
+                      name.c_str());
+    }
+}
+
 void
 Request_worker::Enable_containers()
 {
@@ -61,22 +71,29 @@ Request_worker::On_enable()
 {
     Request_container::On_enable();
     containers.push_back(Shared_from_this());
-    thread = std::thread(&Request_worker::Processing_loop, Shared_from_this());
+    container_set.insert(containers.begin(), containers.end());
+    for (size_t i = 0; i < threads_count; i++) {
+        threads.emplace_back(&Request_worker::Processing_loop, Shared_from_this());
+    }
 }
 
 void
 Request_worker::On_disable()
 {
     Set_disabled();
-    thread.join();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    threads.clear();
     containers.remove(Shared_from_this());
     containers.clear();
+    container_set.clear();
 }
 
 void
 Request_worker::On_wait_and_process()
 {
-    this->waiter->Wait_and_process(containers);
+    this->waiter->Wait_and_process(container_set);
 }
 
 void
@@ -0,0 +1,290 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Sha256 class implementation.
+ */
+
+#include <ugcs/vsm/sha256.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SHA256_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__aarch64__) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2))
+#define SHA256_ARM 1
+#include <arm_neon.h>
+#endif
+
+using namespace ugcs::vsm;
+
+constexpr size_t Sha256::DIGEST_LEN;
+constexpr size_t Sha256::BLOCK_LEN;
+
+namespace {
+
+typedef void (*Transform_func)(uint32_t *state, const uint8_t *blocks, size_t count);
+
+const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+const uint32_t INITIAL_STATE[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+inline uint32_t
+Rotr(uint32_t x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+void
+Transform_generic(uint32_t *state, const uint8_t *blocks, size_t count)
+{
+    uint32_t w[64];
+    for (; count; count--, blocks += Sha256::BLOCK_LEN) {
+        for (int i = 0; i < 16; i++) {
+            w[i] = (static_cast<uint32_t>(blocks[i * 4]) << 24) |
+                   (static_cast<uint32_t>(blocks[i * 4 + 1]) << 16) |
+                   (static_cast<uint32_t>(blocks[i * 4 + 2]) << 8) |
+                   static_cast<uint32_t>(blocks[i * 4 + 3]);
+        }
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = Rotr(w[i - 15], 7) ^ Rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = Rotr(w[i - 2], 17) ^ Rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3],
+                 e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; i++) {
+            uint32_t s1 = Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25);
+            uint32_t ch = (e & f) ^ (~e & g);
+            uint32_t t1 = h + s1 + ch + K[i] + w[i];
+            uint32_t s0 = Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22);
+            uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t t2 = s0 + maj;
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+#if SHA256_X86
+
+bool
+Is_sha_ni_supported()
+{
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1)) {
+        return false;
+    }
+    if (__get_cpuid_max(0, nullptr) < 7) {
+        return false;
+    }
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    /* SHA extensions. */
+    return ebx & (1 << 29);
+}
+
+/* Each group of four rounds advances message schedule, which is kept in
+ * four vectors used in rotation.
+ */
+__attribute__((target("sha,sse4.1")))
+void
+Transform_sha_ni(uint32_t *state, const uint8_t *blocks, size_t count)
+{
+    const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    /* State words are rearranged as ABEF and CDGH for the round instructions. */
+    __m128i tmp = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&state[0]));
+    __m128i state1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&state[4]));
+    tmp = _mm_shuffle_epi32(tmp, 0xb1);
+    state1 = _mm_shuffle_epi32(state1, 0x1b);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+    __m128i msg[4];
+    for (; count; count--, blocks += Sha256::BLOCK_LEN) {
+        __m128i abef_save = state0;
+        __m128i cdgh_save = state1;
+        for (int i = 0; i < 16; i++) {
+            if (i < 4) {
+                msg[i] = _mm_shuffle_epi8(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i *>(blocks + i * 16)), MASK);
+            }
+            __m128i cur = _mm_add_epi32(
+                msg[i % 4], _mm_loadu_si128(reinterpret_cast<const __m128i *>(&K[i * 4])));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, cur);
+            if (i >= 3 && i < 15) {
+                auto &next = msg[(i + 1) % 4];
+                tmp = _mm_alignr_epi8(msg[i % 4], msg[(i + 3) % 4], 4);
+                next = _mm_add_epi32(next, tmp);
+                next = _mm_sha256msg2_epu32(next, msg[i % 4]);
+            }
+            cur = _mm_shuffle_epi32(cur, 0x0e);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, cur);
+            if (i >= 1 && i < 13) {
+                msg[(i + 3) % 4] = _mm_sha256msg1_epu32(msg[(i + 3) % 4], msg[i % 4]);
+            }
+        }
+        state0 = _mm_add_epi32(state0, abef_save);
+        state1 = _mm_add_epi32(state1, cdgh_save);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1b);
+    state1 = _mm_shuffle_epi32(state1, 0xb1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xf0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&state[0]), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&state[4]), state1);
+}
+
+#elif SHA256_ARM
+
+void
+Transform_armv8(uint32_t *state, const uint8_t *blocks, size_t count)
+{
+    uint32x4_t state0 = vld1q_u32(&state[0]);
+    uint32x4_t state1 = vld1q_u32(&state[4]);
+
+    uint32x4_t msg[4];
+    for (; count; count--, blocks += Sha256::BLOCK_LEN) {
+        uint32x4_t abcd_save = state0;
+        uint32x4_t efgh_save = state1;
+        for (int i = 0; i < 4; i++) {
+            msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks + i * 16)));
+        }
+        for (int i = 0; i < 16; i++) {
+            uint32x4_t cur = vaddq_u32(msg[i % 4], vld1q_u32(&K[i * 4]));
+            if (i < 12) {
+                /* Schedule for the rounds 16 ahead. */
+                auto &w = msg[i % 4];
+                w = vsha256su0q_u32(w, msg[(i + 1) % 4]);
+                w = vsha256su1q_u32(w, msg[(i + 2) % 4], msg[(i + 3) % 4]);
+            }
+            uint32x4_t prev = state0;
+            state0 = vsha256hq_u32(state0, state1, cur);
+            state1 = vsha256h2q_u32(state1, prev, cur);
+        }
+        state0 = vaddq_u32(state0, abcd_save);
+        state1 = vaddq_u32(state1, efgh_save);
+    }
+
+    vst1q_u32(&state[0], state0);
+    vst1q_u32(&state[4], state1);
+}
+
+#endif
+
+/** Select the best transform supported by the CPU. */
+Transform_func
+Get_accelerated_transform()
+{
+#if SHA256_X86
+    if (Is_sha_ni_supported()) {
+        return Transform_sha_ni;
+    }
+#elif SHA256_ARM
+    return Transform_armv8;
+#endif
+    return nullptr;
+}
+
+} /* anonymous namespace */
+
+Sha256::Sha256(bool allow_acceleration):
+    transform(Transform_generic)
+{
+    static const Transform_func accelerated = Get_accelerated_transform();
+    if (allow_acceleration && accelerated) {
+        transform = accelerated;
+    }
+    memcpy(state, INITIAL_STATE, sizeof(state));
+}
+
+void
+Sha256::Update(const void *data, size_t len)
+{
+    auto ptr = static_cast<const uint8_t *>(data);
+    total_len += len;
+    if (buffer_len) {
+        size_t n = std::min(len, BLOCK_LEN - buffer_len);
+        memcpy(buffer + buffer_len, ptr, n);
+        buffer_len += n;
+        ptr += n;
+        len -= n;
+        if (buffer_len < BLOCK_LEN) {
+            return;
+        }
+        transform(state, buffer, 1);
+        buffer_len = 0;
+    }
+    if (len >= BLOCK_LEN) {
+        transform(state, ptr, len / BLOCK_LEN);
+        ptr += len / BLOCK_LEN * BLOCK_LEN;
+        len %= BLOCK_LEN;
+    }
+    memcpy(buffer, ptr, len);
+    buffer_len = len;
+}
+
+Sha256::Digest
+Sha256::Final()
+{
+    uint64_t bit_len = total_len * 8;
+    uint8_t padding[BLOCK_LEN + 8] = {0x80};
+    size_t pad_len = (buffer_len < BLOCK_LEN - 8 ? BLOCK_LEN - 8 : 2 * BLOCK_LEN - 8) - buffer_len;
+    for (int i = 0; i < 8; i++) {
+        padding[pad_len + i] = static_cast<uint8_t>(bit_len >> (56 - i * 8));
+    }
+    Update(padding, pad_len + 8);
+
+    Digest digest;
+    for (size_t i = 0; i < 8; i++) {
+        digest[i * 4] = static_cast<uint8_t>(state[i] >> 24);
+        digest[i * 4 + 1] = static_cast<uint8_t>(state[i] >> 16);
+        digest[i * 4 + 2] = static_cast<uint8_t>(state[i] >> 8);
+        digest[i * 4 + 3] = static_cast<uint8_t>(state[i]);
+    }
+    return digest;
+}
+
+Sha256::Digest
+Sha256::Calculate(const void *data, size_t len)
+{
+    Sha256 sha;
+    sha.Update(data, len);
+    return sha.Final();
+}
+
+bool
+Sha256::Is_accelerated()
+{
+    return Get_accelerated_transform() != nullptr;
+}
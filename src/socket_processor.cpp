@@ -23,6 +23,8 @@ const int LISTEN_QUEUE_LEN = 5;
 
 Singleton<Socket_processor> Socket_processor::singleton;
 
+constexpr uint32_t Socket_processor::CAN_FRAME_HW_TIMESTAMP;
+
 Operation_waiter
 Socket_processor::Stream::Write_impl(Io_buffer::Ptr buffer,
                                      Offset offset,
@@ -138,6 +140,44 @@ Socket_processor::Stream::Write_to(
     return request;
 }
 
+Operation_waiter
+Socket_processor::Stream::Splice_to(
+        Stream::Ptr target,
+        Splice_handler completion_handler,
+        Request_completion_context::Ptr comp_ctx)
+{
+    completion_handler.Set_arg<0>(0);
+    Io_request::Ptr request = Io_request::Create(Shared_from_this(), OFFSET_NONE,
+                                                 completion_handler.Get_arg<1>());
+    request->Set_completion_handler(comp_ctx, completion_handler);
+
+    request->Set_processing_handler(
+            Make_callback(&Socket_processor::On_splice, processor, request,
+                          target, completion_handler));
+
+    request->Set_cancellation_handler(
+            Make_callback(&Socket_processor::Cancel_operation,
+            processor, request));
+
+    processor->Submit_request(request);
+    return request;
+}
+
+void
+Socket_processor::Stream::Subscribe_impl(Read_subscription::Ptr subscription)
+{
+    if (can_batched) {
+        /* Batched CAN frames are read by requests only. */
+        Io_stream::Subscribe_impl(subscription);
+        return;
+    }
+    auto request = Request::Create();
+    request->Set_processing_handler(
+            Make_callback(&Socket_processor::On_subscribe, processor, request,
+                          Shared_from_this(), subscription));
+    processor->Submit_request(request);
+}
+
 Operation_waiter
 Socket_processor::Stream::Close_impl(Close_handler completion_handler,
                                      Request_completion_context::Ptr comp_ctx)
@@ -356,6 +396,55 @@ Socket_processor::On_read(Read_request::Ptr request, Socket_address::Ptr addr)
     }
 }
 
+void
+Socket_processor::On_subscribe(Request::Ptr request, Stream::Ptr stream,
+                               Read_subscription::Ptr subscription)
+{
+    if (Lookup_stream(stream) != stream || stream->Get_state() == Io_stream::State::CLOSED) {
+        subscription->End(Io_result::CLOSED);
+    } else if (stream->read_subscription && !stream->read_subscription->Is_ended()) {
+        LOG_ERR("Stream [%s] already has read subscription.", stream->Get_name().c_str());
+        subscription->End(Io_result::OTHER_FAILURE);
+    } else {
+        stream->read_subscription = subscription;
+        subscription->Set_ready_handler(
+                Make_callback(&Socket_processor::On_subscription_ready,
+                              Shared_from_this(), stream));
+        if (stream->Get_type() == Stream::Type::UDP) {
+            stream->Process_udp_read_requests();
+        }
+    }
+    request->Complete();
+}
+
+void
+Socket_processor::On_subscription_ready(Stream::Ptr stream)
+{
+    if (!Is_enabled()) {
+        return;
+    }
+    auto request = Request::Create();
+    request->Set_processing_handler(
+            Make_callback(&Socket_processor::On_subscription_resume,
+                          Shared_from_this(), request, stream));
+    Submit_request(request);
+}
+
+void
+Socket_processor::On_subscription_resume(Request::Ptr request, Stream::Ptr stream)
+{
+    auto &subscription = stream->read_subscription;
+    if (subscription && subscription->Is_ended()) {
+        subscription = nullptr;
+    } else if (subscription && stream->Get_type() == Stream::Type::UDP) {
+        /* Cached packets. Socket itself is polled again with the next
+         * select() call.
+         */
+        stream->Process_udp_read_requests();
+    }
+    request->Complete();
+}
+
 void
 Socket_processor::Stream::Abort_pending_requests(Io_result result)
 {
@@ -382,6 +471,11 @@ Socket_processor::Stream::Abort_pending_requests(Io_result result)
         request->Complete();
     }
     accept_requests.clear();
+
+    if (read_subscription) {
+        read_subscription->End(result);
+        read_subscription = nullptr;
+    }
 }
 
 void
@@ -399,9 +493,9 @@ Socket_processor::Stream::Process_udp_read_requests()
                 if (readmax < data.first->size()) {
                     data.first->resize(readmax);
                 }
-                req->Set_buffer_arg(
-                        Io_buffer::Create(std::move(data.first)),
-                        locker);
+                auto buffer = Io_buffer::Create(std::move(data.first));
+                buffer->Set_rx_time();
+                req->Set_buffer_arg(buffer, locker);
                 req->Set_result_arg(Io_result::OK, locker);
                 auto address_ptr = read_requests.front().second;
                 if (address_ptr) {
@@ -416,8 +510,22 @@ Socket_processor::Stream::Process_udp_read_requests()
         } else {
             // Cancelled requests are handled in On_cancel()
             // Let On_cancel handle the possibly cancelled request and then get back here for other pending requests.
+            return;
+        }
+    }
+    // Remaining packets go to the subscription.
+    while (     read_requests.empty() && read_subscription && !packet_cache.Is_empty()
+            &&  read_subscription->Is_ready()) {
+        Cache_entry data;
+        if (!packet_cache.Pull(data)) {
             break;
         }
+        if (read_subscription->Get_max_to_read() < data.first->size()) {
+            data.first->resize(read_subscription->Get_max_to_read());
+        }
+        auto buffer = Io_buffer::Create(std::move(data.first));
+        buffer->Set_rx_time();
+        read_subscription->Push(buffer);
     }
 }
 
@@ -429,12 +537,16 @@ Socket_processor::On_enable()
             "Socket processor completion",
             piped_waiter);
     completion_ctx->Enable();
+    resolver = Address_resolver::Create();
+    resolver->Enable();
     thread = std::thread(&Socket_processor::Processing_loop, Shared_from_this());
 }
 
 void
 Socket_processor::On_disable()
 {
+    /* Pending resolutions are aborted, so they do not resurrect streams. */
+    resolver->Disable();
     auto req = Request::Create();
     req->Set_processing_handler(
             Make_callback(
@@ -448,11 +560,25 @@ Socket_processor::On_disable()
     thread.join();
     completion_ctx->Disable();
     completion_ctx = nullptr;
+    resolver = nullptr;
 }
 
 void
 Socket_processor::Process_on_disable(Request::Ptr request)
 {
+    /* Connects waiting for the aborted resolutions have no socket yet. */
+    for (auto iter = streams.begin(); iter != streams.end();) {
+        auto stream = iter->second;
+        auto connect_request = stream ? stream->Get_connect_request() : nullptr;
+        if (connect_request && stream->Get_socket() == INVALID_SOCKET) {
+            iter = streams.erase(iter);
+            connect_request->Set_result_arg(Io_result::CLOSED);
+            stream->Set_connect_request(nullptr);
+            connect_request->Complete();
+        } else {
+            iter++;
+        }
+    }
     if (!streams.empty()) {
         LOG_ERROR("%zu streams are still present during socket processor disabling.",
                 streams.size());
@@ -484,6 +610,10 @@ Socket_processor::On_wait_and_process()
         if (stream)
         {
             sockets::Socket_handle s = stream->Get_socket();
+            if (s == INVALID_SOCKET) {
+                /* Peer name is still being resolved. */
+                continue;
+            }
             auto is_set = false;
             switch (stream->Get_state()) {
             case Io_stream::State::OPENING:
@@ -496,7 +626,8 @@ Socket_processor::On_wait_and_process()
                     FD_SET(s, &wfds);
                     is_set = true;
                 }
-                if (!stream->read_requests.empty()) {
+                if (    !stream->read_requests.empty()
+                    ||  (stream->read_subscription && stream->read_subscription->Is_ready())) {
                     FD_SET(s, &rfds);
                     is_set = true;
                 }
@@ -505,6 +636,19 @@ Socket_processor::On_wait_and_process()
                     FD_SET(s, &rfds);
                     is_set = true;
                 }
+                if (stream->splice_request) {
+                    if (stream->splice_pending) {
+                        /* Wait until the target can accept the pipe content. */
+                        auto target = stream->splice_target->Get_socket();
+                        FD_SET(target, &wfds);
+                        if (target > max_handle) {
+                            max_handle = target;
+                        }
+                    } else {
+                        FD_SET(s, &rfds);
+                        is_set = true;
+                    }
+                }
                 break;
             default:
                 break;
@@ -560,6 +704,8 @@ Socket_processor::On_wait_and_process()
                     case Io_stream::State::OPENED:
                         if (stream->Get_type() == Io_stream::Type::UDP) {
                             Handle_udp_read_requests(stream);
+                        } else if (stream->can_batched) {
+                            Handle_can_read_requests(stream);
                         } else {
                             Handle_select_accept(stream);
                             Handle_read_requests(stream);
@@ -585,6 +731,17 @@ Socket_processor::On_wait_and_process()
             stream_iter++;
         }
     }
+
+    for (auto &stream_iter : streams) {
+        Stream::Ptr &stream = stream_iter.second;
+        if (stream && stream->splice_request &&
+            stream->Get_socket() != INVALID_SOCKET &&
+            stream->splice_target->Get_socket() != INVALID_SOCKET &&
+            (FD_ISSET(stream->Get_socket(), &rfds) ||
+             FD_ISSET(stream->splice_target->Get_socket(), &wfds))) {
+            Handle_splice(stream);
+        }
+    }
 }
 
 void
@@ -713,6 +870,14 @@ Socket_processor::Handle_select_accept(Stream::Ptr listen_stream)
 void
 Socket_processor::Handle_write_requests(Stream::Ptr stream)
 {
+    /* Several small writes (e.g. message header and cached body) are sent
+     * by one system call.
+     */
+    while (     stream->write_requests.size() > 1
+            &&  stream->Get_type() == Io_stream::Type::TCP
+            &&  Handle_gather_write(stream)) {
+    }
+
     /* Try to process as much write operations as we can without blocking. */
     while (!stream->write_requests.empty()) {
         /* Last write request which is waiting */
@@ -727,6 +892,10 @@ Socket_processor::Handle_write_requests(Stream::Ptr stream)
         // Lock the request for reading so it cannot get aborted in the middle of operation
         auto locker = request->Lock();
         auto buffer = request->Data_buffer();
+        if (stream->written_bytes && stream->written_bytes < buffer->Get_length()) {
+            // Continue partially written request.
+            buffer = buffer->Slice(stream->written_bytes);
+        }
         auto close_stream = false;
         request->Set_result_arg(Io_result::OK, locker);
         if (request->Is_processing()) {
@@ -778,6 +947,7 @@ Socket_processor::Handle_write_requests(Stream::Ptr stream)
         } else if (request->Is_aborted()) {
             // Do not care about aborted requests.
             stream->write_requests.pop_front();
+            stream->written_bytes = 0;
             continue;
         } else {
             // Cancelled requests are handled in On_cancel()
@@ -898,9 +1068,9 @@ Socket_processor::Handle_read_requests(Stream::Ptr stream)
             } while (stream->read_bytes < readmax && stream->Get_type() == Io_stream::Type::TCP);
 
             stream->reading_buffer->resize(stream->read_bytes);
-            request->Set_buffer_arg(
-                    Io_buffer::Create(std::move(stream->reading_buffer)),
-                    locker);
+            auto buffer = Io_buffer::Create(std::move(stream->reading_buffer));
+            buffer->Set_rx_time();
+            request->Set_buffer_arg(buffer, locker);
             stream->reading_buffer = nullptr;
 
             request->Complete(Request::Status::OK, std::move(locker));
@@ -918,6 +1088,46 @@ Socket_processor::Handle_read_requests(Stream::Ptr stream)
             return;
         }
     }
+    Handle_read_subscription(stream);
+}
+
+void
+Socket_processor::Handle_read_subscription(Stream::Ptr stream)
+{
+    /* Read until the socket is drained or the subscription is full. Chunks
+     * read in one pass are delivered in batches.
+     */
+    while (stream->read_subscription && stream->read_subscription->Is_ready()) {
+        auto readmax = stream->read_subscription->Get_max_to_read();
+        if (subscription_read_buffer.size() < readmax) {
+            subscription_read_buffer.resize(readmax);
+        }
+        auto read_bytes = recv(
+                stream->Get_socket(),
+                reinterpret_cast<char*>(subscription_read_buffer.data()),
+                readmax,
+                0);
+        if (read_bytes > 0) {
+            auto buffer = Io_buffer::Create(
+                    subscription_read_buffer.data(), static_cast<size_t>(read_bytes));
+            buffer->Set_rx_time();
+            stream->read_subscription->Push(buffer);
+        } else if (read_bytes == 0) {
+            // Other end closed. Do not close the stream as it can possibly
+            // still be used for writing...
+            LOG("Stream half-close: %s", stream->Get_name().c_str());
+            stream->read_subscription->End(Io_result::CLOSED);
+            stream->read_subscription = nullptr;
+        } else if (sockets::Is_last_operation_pending()) {
+            return;
+        } else {
+            LOG("Socket read error for stream '%s': %s",
+                stream->Get_name().c_str(),
+                Log::Get_system_error().c_str());
+            Close_stream(stream, false);
+            return;
+        }
+    }
 }
 
 void
@@ -1058,8 +1268,6 @@ Socket_processor::On_connect(Io_request::Ptr request, Stream::Ptr stream)
         return;
     }
     addrinfo hints;
-    addrinfo *result = nullptr, *rp;
-    sockets::Socket_handle s = INVALID_SOCKET;
 
     memset(&hints, 0, sizeof(addrinfo));
     switch (stream->Get_type()) {
@@ -1083,103 +1291,142 @@ Socket_processor::On_connect(Io_request::Ptr request, Stream::Ptr stream)
     hints.ai_addr = nullptr;
     hints.ai_next = nullptr;
 
-    int rc = getaddrinfo(
+    auto addresses = resolver->Resolve_immediately(
             stream->peer_address->Get_name_as_c_str(),
             stream->peer_address->Get_service_as_c_str(),
-            &hints,
-            &result);
-    if (rc) {
+            hints);
+    if (addresses) {
+        Connect_resolved(request, stream, addresses);
+        return;
+    }
+    /* Keep the stream known while resolving, so the connect request can be
+     * canceled. It has no socket yet, so it is not selected.
+     */
+    streams[stream] = stream;
+    resolver->Resolve(
+            stream->peer_address->Get_name_as_c_str(),
+            stream->peer_address->Get_service_as_c_str(),
+            hints,
+            Make_callback(
+                    &Socket_processor::On_connect_resolved,
+                    Shared_from_this(),
+                    Resolved_addresses::Ptr(), request, stream),
+            completion_ctx);
+}
+
+void
+Socket_processor::On_connect_resolved(Resolved_addresses::Ptr addresses,
+                                      Io_request::Ptr request, Stream::Ptr stream)
+{
+    if (Lookup_stream(stream) != stream ||
+        stream->Get_connect_request() != request) {
+        /* Canceled or closed while resolving. */
+        return;
+    }
+    streams.erase(stream);
+    if (!addresses) {
+        /* Resolution aborted. */
+        request->Set_result_arg(Io_result::CLOSED);
+        stream->Set_connect_request(nullptr);
+        request->Complete();
+        return;
+    }
+    Connect_resolved(request, stream, addresses);
+}
+
+void
+Socket_processor::Connect_resolved(Io_request::Ptr request, Stream::Ptr stream,
+                                   Resolved_addresses::Ptr addresses)
+{
+    sockets::Socket_handle s = INVALID_SOCKET;
+
+    if (addresses->Get_error()) {
         LOG_INFO("getaddrinfo failed for [%s:%s]: %s",
                 stream->peer_address->Get_name_as_c_str(),
                 stream->peer_address->Get_service_as_c_str(),
-                gai_strerror(rc));
+                gai_strerror(addresses->Get_error()));
         request->Set_result_arg(Io_result::BAD_ADDRESS);
         stream->Set_connect_request(nullptr);
         request->Complete();
-    } else {
-        for (rp = result; rp ; rp = rp->ai_next) {
-            s = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
-            if (s == INVALID_SOCKET) {
-                LOG_INFO("socket creation failed: %s", Log::Get_system_error().c_str());
-                continue;
-            }
-            // Try to bind to user specified local address.
-            if (stream->local_address) {
-                /**
-                 * Portability crap. MacOS bind is broken. It does not accept 128 here
-                 * which is the length of struct sockaddr.
-                 * Use sizeof(struct sockaddr_in) for ipv4 instead.
-                 */
-                socklen_t addr_size;
-                if (result->ai_family == AF_INET) {
-                    addr_size = sizeof(struct sockaddr_in);
-                } else {
-                    addr_size = stream->local_address->Get_len();
-                }
-                if (bind(s,
-                        stream->local_address->Get_sockaddr_ref(),
-                        addr_size) != 0) {
-                    LOG_INFO("Bind to %s failed: %s",
-                            stream->local_address->Get_as_string().c_str(),
-                            Log::Get_system_error().c_str());
-                    sockets::Close_socket(s);
-                    s = INVALID_SOCKET;
-                    continue;
-                }
+        return;
+    }
+    for (auto &rp : addresses->Get_entries()) {
+        s = socket(rp.ai_family, rp.ai_socktype, rp.ai_protocol);
+        if (s == INVALID_SOCKET) {
+            LOG_INFO("socket creation failed: %s", Log::Get_system_error().c_str());
+            continue;
+        }
+        // Try to bind to user specified local address.
+        if (stream->local_address) {
+            /**
+             * Portability crap. MacOS bind is broken. It does not accept 128 here
+             * which is the length of struct sockaddr.
+             * Use sizeof(struct sockaddr_in) for ipv4 instead.
+             */
+            socklen_t addr_size;
+            if (rp.ai_family == AF_INET) {
+                addr_size = sizeof(struct sockaddr_in);
+            } else {
+                addr_size = stream->local_address->Get_len();
             }
-
-            if (sockets::Make_nonblocking(s) != 0)
-            {/* Fatal here. */
-                freeaddrinfo(result);
+            if (bind(s,
+                    stream->local_address->Get_sockaddr_ref(),
+                    addr_size) != 0) {
+                LOG_INFO("Bind to %s failed: %s",
+                        stream->local_address->Get_as_string().c_str(),
+                        Log::Get_system_error().c_str());
                 sockets::Close_socket(s);
-                VSM_SYS_EXCEPTION("Socket %d failed to set Nonblocking", s);
+                s = INVALID_SOCKET;
+                continue;
             }
+        }
 
-            if (!connect(s, rp->ai_addr, rp->ai_addrlen)) {
-                /* Shouldn't happen with non-blocking sockets though. */
-                auto locker = request->Lock();
-                if (request->Is_processing()) {
-                    // normal operation
-                    stream->Set_state(Io_stream::State::OPENED);
-                    stream->Set_socket(s);
-                    stream->is_connected = true;
-                    request->Set_result_arg(Io_result::OK, locker);
-                    // Add to our streams list.
-                    streams[stream] = stream;
-                } else {
-                    // abort requested.
-                    sockets::Close_socket(s);
-                    stream->Set_state(Io_stream::State::CLOSED);
-                    request->Set_result_arg(Io_result::CANCELED, locker);
-                }
-                stream->Set_connect_request(nullptr);
-                request->Complete(Request::Status::OK, std::move(locker));
-                break;
-            }
+        if (sockets::Make_nonblocking(s) != 0)
+        {/* Fatal here. */
+            sockets::Close_socket(s);
+            VSM_SYS_EXCEPTION("Socket %d failed to set Nonblocking", s);
+        }
 
-            if (sockets::Is_last_operation_pending()) {
-                /* Ok. Async connection in progress. */
+        if (!connect(s, rp.ai_addr, rp.ai_addrlen)) {
+            /* Shouldn't happen with non-blocking sockets though. */
+            auto locker = request->Lock();
+            if (request->Is_processing()) {
+                // normal operation
+                stream->Set_state(Io_stream::State::OPENED);
                 stream->Set_socket(s);
+                stream->is_connected = true;
+                request->Set_result_arg(Io_result::OK, locker);
                 // Add to our streams list.
                 streams[stream] = stream;
-                ASSERT(stream->Get_connect_request());
-                break;
+            } else {
+                // abort requested.
+                sockets::Close_socket(s);
+                stream->Set_state(Io_stream::State::CLOSED);
+                request->Set_result_arg(Io_result::CANCELED, locker);
             }
-            LOG_INFO("socket connect failure: %s", Log::Get_system_error().c_str());
-            /* Try next resolved address. */
-            sockets::Close_socket(s);
-            s = INVALID_SOCKET;
-        }
-        if (s == INVALID_SOCKET) {
-            LOG_INFO("All getaddrinfo results are unusable for connect.");
-            request->Set_result_arg(Io_result::BAD_ADDRESS);
             stream->Set_connect_request(nullptr);
-            request->Complete();
+            request->Complete(Request::Status::OK, std::move(locker));
+            break;
+        }
+
+        if (sockets::Is_last_operation_pending()) {
+            /* Ok. Async connection in progress. */
+            stream->Set_socket(s);
+            // Add to our streams list.
+            streams[stream] = stream;
+            ASSERT(stream->Get_connect_request());
+            break;
         }
+        LOG_INFO("socket connect failure: %s", Log::Get_system_error().c_str());
+        /* Try next resolved address. */
+        sockets::Close_socket(s);
+        s = INVALID_SOCKET;
     }
-    if (result) {
-        freeaddrinfo(result);
-        result = nullptr;
+    if (s == INVALID_SOCKET) {
+        LOG_INFO("All getaddrinfo results are unusable for connect.");
+        request->Set_result_arg(Io_result::BAD_ADDRESS);
+        stream->Set_connect_request(nullptr);
+        request->Complete();
     }
 }
 
@@ -1189,6 +1436,20 @@ Socket_processor::Bind_can(
         std::vector<int> filter_messges,
         Listen_handler completion_handler,
         Request_completion_context::Ptr completion_context)
+{
+    Can_options options;
+    for (auto f : filter_messges) {
+        options.filters.push_back(Can_filter{static_cast<uint32_t>(f), static_cast<uint32_t>(f)});
+    }
+    return Bind_can(interface, options, completion_handler, completion_context);
+}
+
+Operation_waiter
+Socket_processor::Bind_can(
+        std::string interface,
+        Can_options options,
+        Listen_handler completion_handler,
+        Request_completion_context::Ptr completion_context)
 {
     Socket_listener::Ptr stream = Socket_listener::Create(Shared_from_this(), Io_stream::Type::CAN);
     completion_handler.Set_arg<0>(stream);
@@ -1199,7 +1460,7 @@ Socket_processor::Bind_can(
             &Socket_processor::On_bind_can,
             Shared_from_this(),
             request,
-            filter_messges,
+            std::move(options),
             stream,
             interface);
     request->Set_processing_handler(proc_handler);
@@ -1392,32 +1653,80 @@ Socket_processor::Get_addr_info(
 void
 Socket_processor::On_get_addr_info(Io_request::Ptr request, Get_addr_info_handler handler)
 {
-    request->Set_result_arg(Io_result::OTHER_FAILURE);
     auto host = handler.Get_arg<0>();
     auto service = handler.Get_arg<1>();
-    auto hint = handler.Get_arg<2>();
-    addrinfo* result = nullptr;
-    // 1) this is a blocking call
-    // 2) assumes hint always contains one element here.
-    int rc = getaddrinfo(host.c_str(), service.c_str(), &hint.front(), &result);
-    if (rc) {
+    // assumes hint always contains one element here.
+    auto hint = handler.Get_arg<2>().front();
+    resolver->Resolve(
+            host,
+            service,
+            hint,
+            Make_callback(
+                    &Socket_processor::On_addr_info_resolved,
+                    Shared_from_this(),
+                    Resolved_addresses::Ptr(), request, handler),
+            completion_ctx);
+}
+
+void
+Socket_processor::On_addr_info_resolved(Resolved_addresses::Ptr addresses,
+                                        Io_request::Ptr request,
+                                        Get_addr_info_handler handler)
+{
+    if (addresses) {
+        /* Returned entries point to the addresses storage, so keep it until
+         * the completion handler returns.
+         */
+        request->Set_done_handler(Make_callback([addresses]() {}));
+    }
+    auto locker = request->Lock();
+    if (!request->Is_processing()) {
+        return;
+    }
+    if (!addresses || addresses->Get_error()) {
         handler.Set_arg<2>(std::list<addrinfo>());
-        LOG_INFO("getaddrinfo failed for [%s:%s]: %s",
-                host.c_str(), service.c_str(), gai_strerror(rc));
-        request->Set_result_arg(Io_result::BAD_ADDRESS);
-    } else {
-        std::list<addrinfo> ret;
-        for (auto rp = result; rp ; rp = rp->ai_next) {
-            ret.emplace_back(*rp);
+        if (addresses) {
+            LOG_INFO("getaddrinfo failed for [%s:%s]: %s",
+                    handler.Get_arg<0>().c_str(), handler.Get_arg<1>().c_str(),
+                    gai_strerror(addresses->Get_error()));
         }
-        handler.Set_arg<2>(std::move(ret));
-        request->Set_result_arg(Io_result::OK);
+        request->Set_result_arg(Io_result::BAD_ADDRESS, locker);
+    } else {
+        handler.Set_arg<2>(std::list<addrinfo>(addresses->Get_entries().begin(),
+                                               addresses->Get_entries().end()));
+        request->Set_result_arg(Io_result::OK, locker);
     }
-    if (result) {
-        freeaddrinfo(result);
-        result = nullptr;
+    request->Complete(Request::Status::OK, std::move(locker));
+}
+
+void
+Socket_processor::On_splice(Io_request::Ptr request, Stream::Ptr target,
+                            Stream::Splice_handler handler)
+{
+    if (Check_for_cancel_request(request, false)) {
+        return;
     }
-    request->Complete();
+    auto source = Lookup_stream(request->Get_stream());
+    if (    !source
+        ||  !target || Lookup_stream(target) != target
+        ||  source->Get_type() != Io_stream::Type::TCP
+        ||  target->Get_type() != Io_stream::Type::TCP
+        ||  source->Get_state() != Io_stream::State::OPENED
+        ||  target->Get_state() != Io_stream::State::OPENED
+        ||  source->splice_request || target->splice_source
+        ||  !Start_splice(source)) {
+        request->Set_result_arg(Io_result::OTHER_FAILURE);
+        request->Complete();
+        return;
+    }
+    source->splice_request = request;
+    source->splice_handler = handler;
+    source->splice_target = target;
+    source->splice_pending = 0;
+    source->spliced_bytes = 0;
+    target->splice_source = source;
+    /* Data might be already available. */
+    Handle_splice(source);
 }
 
 Operation_waiter
@@ -1494,6 +1803,12 @@ Socket_processor::Close_stream(Stream::Ptr stream, bool remove_from_streams)
             Close_stream(s.second);
         }
         stream->substreams.clear();
+        if (stream->splice_request) {
+            End_splice(stream, Io_result::CLOSED);
+        }
+        if (stream->splice_source) {
+            End_splice(stream->splice_source, Io_result::CLOSED);
+        }
         stream->Close_socket();
         stream->Abort_pending_requests();
         stream->packet_cache.Clear();
@@ -1542,6 +1857,11 @@ Socket_processor::Check_for_cancel_request(Io_request::Ptr request, bool force_c
                 return true;
             }
 
+            if (request == stream->splice_request) {
+                End_splice(stream, result, std::move(locker));
+                return true;
+            }
+
             // Check for read request.
             if (!stream->read_requests.empty()) {
                 auto iter = stream->read_requests.begin();
@@ -7,8 +7,56 @@
 #include <ugcs/vsm/set_home_action.h>
 #include <ugcs/vsm/takeoff_action.h>
 
+#include <algorithm>
+
 using namespace ugcs::vsm;
 
+std::vector<Task::Item_range>
+Task::Get_changed_items() const
+{
+    std::vector<Item_range> ranges;
+    auto &items = item_hashes;
+    auto &previous = previous_item_hashes;
+    if (previous.empty()) {
+        if (!items.empty()) {
+            ranges.push_back({0, items.size()});
+        }
+        return ranges;
+    }
+
+    /* Common head and tail. */
+    size_t common = std::min(items.size(), previous.size());
+    size_t head = 0;
+    while (head < common && items[head] == previous[head]) {
+        head++;
+    }
+    size_t tail = 0;
+    while (tail < common - head &&
+           items[items.size() - 1 - tail] == previous[previous.size() - 1 - tail]) {
+        tail++;
+    }
+
+    size_t end = items.size() - tail;
+    if (items.size() != previous.size()) {
+        /* Items inserted or removed, the rest is shifted. */
+        ranges.push_back({head, end - head});
+        return ranges;
+    }
+
+    /* Items modified in place. */
+    for (size_t i = head; i < end; i++) {
+        if (items[i] == previous[i]) {
+            continue;
+        }
+        if (!ranges.empty() && ranges.back().first + ranges.back().count == i) {
+            ranges.back().count++;
+        } else {
+            ranges.push_back({i, 1});
+        }
+    }
+    return ranges;
+}
+
 Wgs84_position
 Task::Get_home_position() const
 {
@@ -0,0 +1,183 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Telemetry_cache class implementation.
+ */
+
+#include <ugcs/vsm/telemetry_cache.h>
+
+#include <algorithm>
+
+using namespace ugcs::vsm;
+
+constexpr uint32_t Telemetry_cache::NO_DATA_INDEX;
+
+template <typename Value>
+Value &
+Telemetry_cache::Flat_map<Value>::operator [](uint32_t id)
+{
+    if (values.empty()) {
+        base = id;
+    } else if (id < base) {
+        values.insert(values.begin(), base - id, Value());
+        base = id;
+    }
+    size_t idx = id - base;
+    if (idx >= values.size()) {
+        values.resize(idx + 1);
+    }
+    return values[idx];
+}
+
+std::string &
+Telemetry_cache::Get_data(Telemetry_value &entry)
+{
+    if (entry.data_index == NO_DATA_INDEX) {
+        entry.data_index = data.size();
+        data.emplace_back();
+    }
+    return data[entry.data_index];
+}
+
+void
+Telemetry_cache::Update(const proto::Telemetry_field &field)
+{
+    auto &entry = telemetry[field.field_id()];
+    auto &value = field.value();
+    entry.ms_since_epoch = field.ms_since_epoch();
+
+    int members = value.has_meta_value() + value.has_int_value() +
+        value.has_float_value() + value.has_double_value() +
+        value.has_string_value() + value.has_bool_value() +
+        value.has_list_value() + value.has_bytes_value();
+    if (members != 1 || value.has_list_value()) {
+        entry.type = Value_type::ENCODED;
+        value.SerializeToString(&Get_data(entry));
+    } else if (value.has_meta_value()) {
+        entry.type = Value_type::META;
+        entry.meta_value = value.meta_value();
+    } else if (value.has_int_value()) {
+        entry.type = Value_type::INT;
+        entry.int_value = value.int_value();
+    } else if (value.has_float_value()) {
+        entry.type = Value_type::FLOAT;
+        entry.float_value = value.float_value();
+    } else if (value.has_double_value()) {
+        entry.type = Value_type::DOUBLE;
+        entry.double_value = value.double_value();
+    } else if (value.has_bool_value()) {
+        entry.type = Value_type::BOOL;
+        entry.bool_value = value.bool_value();
+    } else if (value.has_string_value()) {
+        entry.type = Value_type::STRING;
+        Get_data(entry) = value.string_value();
+    } else {
+        entry.type = Value_type::BYTES;
+        Get_data(entry) = value.bytes_value();
+    }
+}
+
+void
+Telemetry_cache::Update(const proto::Command_availability &command)
+{
+    auto &entry = availability[command.id()];
+    entry.flags = Availability_value::PRESENT;
+    if (command.has_is_available()) {
+        entry.flags |= Availability_value::HAS_AVAILABLE;
+        if (command.is_available()) {
+            entry.flags |= Availability_value::AVAILABLE;
+        }
+    }
+    if (command.has_is_enabled()) {
+        entry.flags |= Availability_value::HAS_ENABLED;
+        if (command.is_enabled()) {
+            entry.flags |= Availability_value::ENABLED;
+        }
+    }
+}
+
+void
+Telemetry_cache::Fill(proto::Device_status &status) const
+{
+    auto id = telemetry.Get_base();
+    for (auto &entry : telemetry.Get_values()) {
+        auto field_id = id++;
+        if (entry.type == Value_type::NONE) {
+            continue;
+        }
+        if (    entry.type == Value_type::META
+            &&  entry.meta_value == proto::META_VALUE_NA) {
+            continue;
+        }
+        auto field = status.add_telemetry_fields();
+        field->set_field_id(field_id);
+        field->set_ms_since_epoch(entry.ms_since_epoch);
+        auto value = field->mutable_value();
+        switch (entry.type) {
+        case Value_type::META:
+            value->set_meta_value(static_cast<proto::Meta_value>(entry.meta_value));
+            break;
+        case Value_type::INT:
+            value->set_int_value(entry.int_value);
+            break;
+        case Value_type::FLOAT:
+            value->set_float_value(entry.float_value);
+            break;
+        case Value_type::DOUBLE:
+            value->set_double_value(entry.double_value);
+            break;
+        case Value_type::BOOL:
+            value->set_bool_value(entry.bool_value);
+            break;
+        case Value_type::STRING:
+            value->set_string_value(Get_data(entry));
+            break;
+        case Value_type::BYTES:
+            value->set_bytes_value(Get_data(entry));
+            break;
+        case Value_type::ENCODED:
+            value->ParseFromString(Get_data(entry));
+            if (    value->has_meta_value()
+                &&  value->meta_value() == proto::META_VALUE_NA) {
+                status.mutable_telemetry_fields()->RemoveLast();
+            }
+            break;
+        case Value_type::NONE:
+            break;
+        }
+    }
+
+    id = availability.Get_base();
+    for (auto &entry : availability.Get_values()) {
+        auto command_id = id++;
+        if (!(entry.flags & Availability_value::PRESENT)) {
+            continue;
+        }
+        auto command = status.add_command_availability();
+        command->set_id(command_id);
+        if (entry.flags & Availability_value::HAS_AVAILABLE) {
+            command->set_is_available(entry.flags & Availability_value::AVAILABLE);
+        }
+        if (entry.flags & Availability_value::HAS_ENABLED) {
+            command->set_is_enabled(entry.flags & Availability_value::ENABLED);
+        }
+    }
+}
+
+size_t
+Telemetry_cache::Get_telemetry_count() const
+{
+    auto &values = telemetry.Get_values();
+    return std::count_if(values.begin(), values.end(),
+        [](const Telemetry_value &v) { return v.type != Value_type::NONE; });
+}
+
+size_t
+Telemetry_cache::Get_availability_count() const
+{
+    auto &values = availability.Get_values();
+    return std::count_if(values.begin(), values.end(),
+        [](const Availability_value &v) { return v.flags & Availability_value::PRESENT; });
+}
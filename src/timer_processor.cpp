@@ -16,7 +16,7 @@ Timer_processor::Timer::Timer(const Timer_processor::Ptr &processor,
                               std::chrono::milliseconds interval):
     processor(processor),
     interval(interval),
-    fire_time(std::chrono::steady_clock::now() + interval)
+    fire_time(Clock::Now() + interval)
 {
 }
 
@@ -134,6 +134,8 @@ Timer_processor::Timer::Set_request(Request::Ptr &request)
 
 Singleton<Timer_processor> Timer_processor::singleton;
 
+constexpr std::chrono::milliseconds Timer_processor::VIRTUAL_IDLE_CHECK_TIME;
+
 Timer_processor::Timer_processor():
     Request_processor("Timer processor")
 {
@@ -154,7 +156,7 @@ Timer_processor::Timer_process_handler(Timer::Ptr timer)
         return;
     }
     /* Check if it still needs to be placed in tree. */
-    auto now = std::chrono::steady_clock::now();
+    auto now = Clock::Now();
     if (timer->Get_fire_time() <= now) {
         timer->Fire();
         return;
@@ -181,7 +183,7 @@ Timer_processor::Timer_handler(Timer::Ptr timer, Handler handler,
     if (handler() && timer->Is_running()) {
         timer->fire_time += timer->interval;
         /* Do not allow to accumulate firings. */
-        auto now = std::chrono::steady_clock::now();
+        auto now = Clock::Now();
         if (timer->fire_time < now) {
             timer->fire_time = now;
         }
@@ -243,6 +245,42 @@ Timer_processor::Cancel_timer(Timer::Ptr timer)
     timer->Destroy(true);
 }
 
+void
+Timer_processor::Watch_clock(const Clock::Ptr &clock)
+{
+    if (clock == watched_clock) {
+        return;
+    }
+    if (watched_clock) {
+        watched_clock->Remove_change_handler(clock_handler_id);
+    }
+    watched_clock = clock;
+    if (watched_clock && !watched_clock->Is_real_time()) {
+        clock_handler_id = watched_clock->Add_change_handler(
+            Make_callback(&Timer_processor::On_clock_changed,
+                          Shared_from_this()));
+    }
+}
+
+void
+Timer_processor::On_clock_changed()
+{
+    if (!Is_enabled()) {
+        return;
+    }
+    Request::Ptr request = Request::Create();
+    request->Set_processing_handler(
+        Make_callback(&Timer_processor::Wake_up_handler, this, request));
+    Submit_request(request);
+}
+
+void
+Timer_processor::Wake_up_handler(Request::Ptr request)
+{
+    /* Nothing to do, just return from waiting to check the timers. */
+    request->Complete();
+}
+
 void
 Timer_processor::On_enable()
 {
@@ -256,6 +294,7 @@ Timer_processor::On_disable()
     Set_disabled();
     /* Wait for dedicated thread terminates. */
     thread.join();
+    Watch_clock(nullptr);
     std::unique_lock<std::mutex> lock(tree_lock);
     for (auto& iter : tree) {
         if (!iter.second->Is_running()) {
@@ -288,9 +327,11 @@ Timer_processor::On_disable()
 void
 Timer_processor::On_wait_and_process()
 {
+    auto clock = Clock::Get_current();
+    Watch_clock(clock);
     std::unique_lock<std::mutex> lock(tree_lock);
     while (true) {
-        auto now = std::chrono::steady_clock::now();
+        auto now = clock ? clock->Get_time() : std::chrono::steady_clock::now();
         /* Get nearest timer to fire. */
         if (tree.empty()) {
             /* Wait indefinitely. */
@@ -300,14 +341,29 @@ Timer_processor::On_wait_and_process()
         }
         auto it = tree.begin();
         Timer::Ptr timer = it->second;
-        std::chrono::milliseconds delay =
-            std::chrono::duration_cast<std::chrono::milliseconds>
-            (timer->Get_fire_time().time_since_epoch() - now.time_since_epoch());
+        /* Not rounded, otherwise a timer less than 1 ms ahead fires early. */
+        auto delay = timer->Get_fire_time() - now;
         if (delay.count() > 0) {
-            /* Wait until this timer. */
             lock.unlock();
-            this->waiter->Wait_and_process({Shared_from_this()},
-                                           delay);
+            if (clock && !clock->Is_real_time()) {
+                /* Virtual time. Process whatever is already submitted, and
+                 * either let the clock jump to this timer or wait until the
+                 * time is moved.
+                 */
+                if (!this->waiter->Wait_and_process({Shared_from_this()},
+                                                    VIRTUAL_IDLE_CHECK_TIME) &&
+                    !clock->On_idle(timer->Get_fire_time())) {
+
+                    this->waiter->Wait_and_process({Shared_from_this()});
+                }
+                break;
+            }
+            /* Wait until this timer, the wait is rounded up. */
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(delay);
+            if (wait < delay) {
+                wait += std::chrono::milliseconds(1);
+            }
+            this->waiter->Wait_and_process({Shared_from_this()}, wait);
             /* If waken up by timeout, timers will be fired during next iteration. */
             break;
         }
@@ -17,6 +17,48 @@ using namespace ugcs::vsm;
 
 std::hash<Vehicle*> Vehicle::Hasher::hasher;
 
+namespace {
+
+template <Action::Type type>
+Action::Ptr
+Clone_action_as(const Action& action)
+{
+    typedef typename Action::Mapper<type>::type Action_type;
+    return std::make_shared<Action_type>(static_cast<const Action_type&>(action));
+}
+
+/** Create a copy of a mission action. */
+Action::Ptr
+Clone_action(const Action::Ptr& action)
+{
+    switch (action->Get_type()) {
+    case Action::Type::MOVE: return Clone_action_as<Action::Type::MOVE>(*action);
+    case Action::Type::WAIT: return Clone_action_as<Action::Type::WAIT>(*action);
+    case Action::Type::PAYLOAD_STEERING: return Clone_action_as<Action::Type::PAYLOAD_STEERING>(*action);
+    case Action::Type::TAKEOFF: return Clone_action_as<Action::Type::TAKEOFF>(*action);
+    case Action::Type::LANDING: return Clone_action_as<Action::Type::LANDING>(*action);
+    case Action::Type::CHANGE_SPEED: return Clone_action_as<Action::Type::CHANGE_SPEED>(*action);
+    case Action::Type::SET_HOME: return Clone_action_as<Action::Type::SET_HOME>(*action);
+    case Action::Type::POI: return Clone_action_as<Action::Type::POI>(*action);
+    case Action::Type::HEADING: return Clone_action_as<Action::Type::HEADING>(*action);
+    case Action::Type::CAMERA_CONTROL: return Clone_action_as<Action::Type::CAMERA_CONTROL>(*action);
+    case Action::Type::CAMERA_TRIGGER: return Clone_action_as<Action::Type::CAMERA_TRIGGER>(*action);
+    case Action::Type::PANORAMA: return Clone_action_as<Action::Type::PANORAMA>(*action);
+    case Action::Type::TASK_ATTRIBUTES: return Clone_action_as<Action::Type::TASK_ATTRIBUTES>(*action);
+    case Action::Type::CAMERA_SERIES_BY_TIME: return Clone_action_as<Action::Type::CAMERA_SERIES_BY_TIME>(*action);
+    case Action::Type::CAMERA_SERIES_BY_DISTANCE:
+        return Clone_action_as<Action::Type::CAMERA_SERIES_BY_DISTANCE>(*action);
+    case Action::Type::SET_PARAMETER: return Clone_action_as<Action::Type::SET_PARAMETER>(*action);
+    case Action::Type::SET_SERVO: return Clone_action_as<Action::Type::SET_SERVO>(*action);
+    case Action::Type::REPEAT_SERVO: return Clone_action_as<Action::Type::REPEAT_SERVO>(*action);
+    case Action::Type::VTOL_TRANSITION: return Clone_action_as<Action::Type::VTOL_TRANSITION>(*action);
+    }
+    VSM_EXCEPTION(Internal_error_exception, "Action type %d unknown.",
+                  static_cast<int>(action->Get_type()));
+}
+
+} /* anonymous namespace */
+
 Vehicle::Vehicle(
     proto::Device_type type,
     Request_processor::Ptr proc,
@@ -124,6 +166,11 @@ Vehicle::Vehicle(
 
     c_rth = flight_controller->Add_command("return_to_home", false);
 
+    // Emergency commands preempt the queued ones.
+    c_emergency_land->Set_preemptive();
+    c_rth->Set_preemptive();
+    c_disarm->Set_preemptive();
+
     c_takeoff_command = flight_controller->Add_command("takeoff_command", false);
     c_takeoff_command->Add_parameter("relative_altitude", proto::FIELD_SEMANTIC_ALTITUDE_RAW);
 
@@ -388,10 +435,36 @@ Vehicle::Handle_ucs_command(
             if (params.Get_value("name", route_name)) {
                 VEHICLE_LOG_INF((*this), "Route name : %s", route_name.c_str());
             }
-            task = Vehicle_task_request::Create(
-                completion_handler,
-                completion_ctx,
-                vsm_cmd.sub_commands_size());
+            /* Items of the mission previously uploaded to the vehicle are
+             * reused if not changed.
+             */
+            auto baseline = std::make_shared<Mission_baseline>();
+            std::shared_ptr<Mission_baseline> previous;
+            if (cmd == c_mission_upload) {
+                baseline->mission_hash = Get_mission_hash(vsm_cmd);
+                /* Changed mission parameters affect all items. */
+                if (mission_baseline && mission_baseline->mission_hash == baseline->mission_hash) {
+                    previous = mission_baseline;
+                }
+                task = Vehicle_task_request::Create(
+                    Make_callback(
+                        &Vehicle::Mission_upload_completed,
+                        Shared_from_this(),
+                        Vehicle_request::Result::NOK,
+                        std::string(),
+                        ucs_request,
+                        baseline),
+                    completion_ctx,
+                    vsm_cmd.sub_commands_size());
+                if (previous) {
+                    task->payload.previous_item_hashes = previous->item_hashes;
+                }
+            } else {
+                task = Vehicle_task_request::Create(
+                    completion_handler,
+                    completion_ctx,
+                    vsm_cmd.sub_commands_size());
+            }
 
             float altitude_origin;
             if (params.Get_value("altitude_origin", altitude_origin)) {
@@ -408,8 +481,26 @@ Vehicle::Handle_ucs_command(
             }
 
             auto item_count = 0;
+            auto reused_count = 0;
+            task->payload.item_hashes.reserve(vsm_cmd.sub_commands_size());
             for (int i = 0; i < vsm_cmd.sub_commands_size(); i++) {
-                auto vsm_scmd = vsm_cmd.sub_commands(i);
+                auto &vsm_scmd = vsm_cmd.sub_commands(i);
+                auto hash = Get_mission_item_hash(vsm_scmd);
+                task->payload.item_hashes.push_back(hash);
+                baseline->item_hashes.push_back(hash);
+                size_t idx = i;
+                if (previous && idx < previous->item_hashes.size() &&
+                    previous->item_hashes[idx] == hash && previous->actions[idx]) {
+                    /* Unchanged item, conversion is skipped. The VSM gets
+                     * a copy, so the baseline is not affected if it modifies
+                     * the action.
+                     */
+                    task->payload.actions.push_back(Clone_action(previous->actions[idx]));
+                    baseline->actions.push_back(previous->actions[idx]);
+                    reused_count++;
+                    item_count++;
+                    continue;
+                }
                 auto cmd = Get_command(vsm_scmd.command_id());
                 if (cmd) {
                     VEHICLE_LOG_INF((*this), "MISSION item %s", Dump_command(vsm_scmd).c_str());
@@ -470,12 +561,18 @@ Vehicle::Handle_ucs_command(
                     if (action) {
                         action->Set_id(item_count);
                         task->payload.actions.push_back(action);
+                        baseline->actions.push_back(Clone_action(action));
+                    } else {
+                        baseline->actions.push_back(nullptr);
                     }
                 } else {
                     VSM_EXCEPTION(Action::Format_exception, "Unregistered mission item %d", vsm_scmd.command_id());
                 }
                 item_count++;
             }
+            if (previous) {
+                VEHICLE_LOG_INF((*this), "%d of %d mission items unchanged", reused_count, item_count);
+            }
             task->payload.ucs_response = ucs_request->response;
             Submit_vehicle_request(task);
         } else {
@@ -550,6 +647,52 @@ Vehicle::Command_completed(
     }
 }
 
+void
+Vehicle::Mission_upload_completed(
+    Vehicle_request::Result result,
+    const std::string& status_text,
+    Ucs_request::Ptr ucs_request,
+    std::shared_ptr<Mission_baseline> baseline)
+{
+    if (result == Vehicle_request::Result::OK) {
+        mission_baseline = baseline;
+    } else {
+        /* Mission could be partially uploaded. */
+        mission_baseline = nullptr;
+    }
+    Command_completed(result, status_text, ucs_request);
+}
+
+void
+Vehicle::Reset_mission_baseline()
+{
+    mission_baseline = nullptr;
+}
+
+Task::Item_hash
+Vehicle::Get_mission_item_hash(const proto::Device_command& item)
+{
+    auto data = item.SerializeAsString();
+    return Sha256::Calculate(data.data(), data.size());
+}
+
+Task::Item_hash
+Vehicle::Get_mission_hash(const proto::Device_command& mission)
+{
+    Sha256 sha;
+    for (auto &param : mission.parameters()) {
+        auto data = param.SerializeAsString();
+        sha.Update(data.data(), data.size());
+    }
+    for (auto &item : mission.sub_commands()) {
+        if (c_set_parameter && Get_command(item.command_id()) == c_set_parameter) {
+            auto data = item.SerializeAsString();
+            sha.Update(data.data(), data.size());
+        }
+    }
+    return sha.Final();
+}
+
 void
 Vehicle::Command_succeeded(
     Ucs_request::Ptr ucs_request)
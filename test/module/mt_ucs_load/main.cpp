@@ -0,0 +1,229 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/* Scaling benchmark for VSM to UCS communications.
+ *
+ * Runs the VSM SDK together with a synthetic UCS server which connects to the
+ * local UCS listening port (see ucs.local_listening_* in vsm.conf). The given
+ * numbers of synthetic vehicles are registered step by step and for each
+ * step throughput, CPU usage, memory and latency percentiles are printed.
+ */
+
+#include "ucs_stub.h"
+#include "synthetic_vehicle.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef __unix__
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+using namespace ugcs::vsm;
+
+DEFINE_DEFAULT_VSM_NAME;
+
+const char usage[] = "\
+Usage: \n\
+%s [-f <fields>] [-r <rate Hz>] [-d <seconds>] [-c <command period ms>] [-t] <vehicles> [<vehicles> ...]\n\
+  -f  Number of additional telemetry fields per vehicle (default 10).\n\
+  -r  Telemetry update rate of each vehicle, up to 1000 (default 5).\n\
+  -d  Measurement duration for each step (default 10).\n\
+  -c  Period of commands sent to each vehicle, 0 to disable (default 1000).\n\
+  -t  Use dedicated thread for each vehicle instead of shared one.\n\
+Example: %s -r 10 1 10 100 1000\n\
+";
+
+namespace {
+
+/** Telemetry is updated from a timer with millisecond resolution, so the
+ * period can not be shorter than 1 ms.
+ */
+constexpr double MAX_RATE = 1000;
+
+struct Usage {
+    /** CPU time consumed by the process, seconds. */
+    double cpu = 0;
+    /** Resident set size, MB. */
+    double rss = 0;
+};
+
+Usage
+Get_usage()
+{
+    Usage u;
+#   ifdef __unix__
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0) {
+        u.cpu = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+            (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+        u.rss = ru.ru_maxrss / 1024.0;
+    }
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (f) {
+        long size, resident;
+        if (fscanf(f, "%ld %ld", &size, &resident) == 2) {
+            u.rss = static_cast<double>(resident) * sysconf(_SC_PAGESIZE) / (1024 * 1024);
+        }
+        fclose(f);
+    }
+#   endif
+    return u;
+}
+
+double
+Percentile(std::vector<double>& v, double p)
+{
+    if (v.empty()) {
+        return 0;
+    }
+    std::sort(v.begin(), v.end());
+    return v[static_cast<size_t>(p * (v.size() - 1))];
+}
+
+} /* anonymous namespace */
+
+int
+main(int argc, char *argv[])
+{
+    size_t fields = 10;
+    double rate = 5;
+    int duration = 10;
+    int command_period = 1000;
+    bool dedicated_threads = false;
+    std::vector<size_t> steps;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-t")) {
+            dedicated_threads = true;
+        } else if (argv[i][0] == '-' && i + 1 < argc) {
+            switch (argv[i][1]) {
+            case 'f': fields = std::stoul(argv[++i]); break;
+            case 'r': rate = std::stod(argv[++i]); break;
+            case 'd': duration = std::stoi(argv[++i]); break;
+            case 'c': command_period = std::stoi(argv[++i]); break;
+            default:
+                std::printf(usage, argv[0], argv[0]);
+                return 1;
+            }
+        } else if (isdigit(argv[i][0])) {
+            steps.push_back(std::stoul(argv[i]));
+        } else {
+            std::printf(usage, argv[0], argv[0]);
+            return 1;
+        }
+    }
+    if (steps.empty() || !(rate > 0 && rate <= MAX_RATE) || duration <= 0) {
+        std::printf(usage, argv[0], argv[0]);
+        return 1;
+    }
+
+    ugcs::vsm::Initialize();
+
+    auto props = Properties::Get_instance();
+    auto host = props->Get("ucs.local_listening_address");
+    auto port = props->Get("ucs.local_listening_port");
+    auto stub = Ucs_stub::Create();
+    /* VSM starts listening asynchronously, give it some time. */
+    int attempts = 50;
+    while (!stub->Connect(host, port)) {
+        if (!--attempts) {
+            LOG_ERR("Failed to connect to VSM on %s:%s", host.c_str(), port.c_str());
+            stub->Disconnect();
+            ugcs::vsm::Terminate();
+            return 1;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    Request_processor::Ptr processor;
+    Request_completion_context::Ptr completion_ctx;
+    Request_worker::Ptr worker;
+    if (!dedicated_threads) {
+        processor = Request_processor::Create("Synthetic vehicles processor");
+        completion_ctx = Request_completion_context::Create("Synthetic vehicles completion");
+        worker = Request_worker::Create(
+            "Synthetic vehicles worker",
+            std::initializer_list<Request_container::Ptr>{completion_ctx, processor});
+        processor->Enable();
+        completion_ctx->Enable();
+        worker->Enable();
+    }
+
+    auto period = std::chrono::duration_cast<Clock::Duration>(
+        std::chrono::duration<double>(1 / rate));
+    std::vector<Synthetic_vehicle::Ptr> vehicles;
+
+    std::printf("%8s %10s %10s %10s %6s %8s %8s %8s %8s %8s %8s %8s\n",
+        "vehicles", "msg/s", "fields/s", "KB/s", "cpu%", "rss MB",
+        "tlm p50", "tlm p90", "tlm p99", "tlm max", "cmd p50", "cmd p99");
+
+    for (auto count : steps) {
+        while (vehicles.size() < count) {
+            auto v = Synthetic_vehicle::Create(
+                "synthetic_" + std::to_string(vehicles.size()),
+                fields, period, processor, completion_ctx);
+            v->Enable();
+            v->Register();
+            vehicles.push_back(v);
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+        while (stub->Get_device_count() < vehicles.size() && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        if (stub->Get_device_count() < vehicles.size()) {
+            LOG_ERR("Only %zu of %zu vehicles registered on server",
+                stub->Get_device_count(), vehicles.size());
+        }
+
+        stub->Take_stats();
+        auto usage_start = Get_usage();
+        auto start = std::chrono::steady_clock::now();
+        auto end = start + std::chrono::seconds(duration);
+        auto next_command = start;
+        while (std::chrono::steady_clock::now() < end) {
+            if (command_period && std::chrono::steady_clock::now() >= next_command) {
+                stub->Send_commands();
+                next_command += std::chrono::milliseconds(command_period);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        auto stats = stub->Take_stats();
+        auto usage_end = Get_usage();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::printf("%8zu %10.0f %10.0f %10.1f %6.1f %8.1f %8.1f %8.1f %8.1f %8.1f %8.2f %8.2f\n",
+            vehicles.size(),
+            stats.messages / elapsed,
+            stats.telemetry_fields / elapsed,
+            stats.bytes / elapsed / 1024,
+            (usage_end.cpu - usage_start.cpu) / elapsed * 100,
+            usage_end.rss,
+            Percentile(stats.telemetry_latency, 0.5),
+            Percentile(stats.telemetry_latency, 0.9),
+            Percentile(stats.telemetry_latency, 0.99),
+            Percentile(stats.telemetry_latency, 1),
+            Percentile(stats.command_latency, 0.5),
+            Percentile(stats.command_latency, 0.99));
+        std::fflush(stdout);
+    }
+
+    for (auto& v : vehicles) {
+        v->Disable();
+    }
+    vehicles.clear();
+    stub->Disconnect();
+
+    if (worker) {
+        worker->Disable();
+        processor->Disable();
+        completion_ctx->Disable();
+    }
+
+    ugcs::vsm::Terminate();
+    return 0;
+}
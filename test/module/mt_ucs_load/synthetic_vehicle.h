@@ -0,0 +1,131 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Synthetic vehicle which emits telemetry at a fixed rate. All instances can
+ * share the same processing contexts, so thousands of them can be created
+ * without creating a thread per vehicle.
+ */
+
+#ifndef _MT_UCS_LOAD_SYNTHETIC_VEHICLE_H_
+#define _MT_UCS_LOAD_SYNTHETIC_VEHICLE_H_
+
+#include <ugcs/vsm/vsm.h>
+
+class Synthetic_vehicle: public ugcs::vsm::Device
+{
+    DEFINE_COMMON_CLASS(Synthetic_vehicle, ugcs::vsm::Device)
+
+public:
+    /**
+     * @param serial_number Serial number reported to server.
+     * @param field_count Number of numeric telemetry fields in addition to
+     *      the mandatory ones.
+     * @param period Telemetry update period, not shorter than 1 ms.
+     * @param processor Shared processor, nullptr to use dedicated thread.
+     * @param completion_ctx Shared completion context, nullptr to use
+     *      dedicated thread.
+     */
+    Synthetic_vehicle(
+        const std::string& serial_number,
+        size_t field_count,
+        ugcs::vsm::Clock::Duration period,
+        ugcs::vsm::Request_processor::Ptr processor = nullptr,
+        ugcs::vsm::Request_completion_context::Ptr completion_ctx = nullptr):
+        Device(ugcs::vsm::proto::DEVICE_TYPE_VEHICLE, processor, completion_ctx),
+        period(period)
+    {
+        Set_property("vehicle_type", ugcs::vsm::proto::VEHICLE_TYPE_MULTICOPTER);
+        Set_property("serial_number", serial_number);
+
+        auto fc = Add_subsystem(ugcs::vsm::proto::SUBSYSTEM_TYPE_FLIGHT_CONTROLLER);
+        fc->Set_property("autopilot_type", "synthetic");
+
+        t_downlink_present = fc->Add_telemetry("downlink_present", ugcs::vsm::proto::FIELD_SEMANTIC_BOOL);
+        t_altitude_raw = fc->Add_telemetry("altitude_raw");
+        for (size_t i = 0; i < field_count; i++) {
+            fields.push_back(
+                fc->Add_telemetry("synthetic_" + std::to_string(i), ugcs::vsm::Property::VALUE_TYPE_DOUBLE));
+        }
+        /* Commit every update, default policy limits the rate to 5 Hz. */
+        ugcs::vsm::Property::Commit_policy policy;
+        policy.min_interval = std::chrono::milliseconds::zero();
+        t_altitude_raw->Set_commit_policy(policy);
+        for (auto& f : fields) {
+            f->Set_commit_policy(policy);
+        }
+
+        c_arm = fc->Add_command("arm", false);
+    }
+
+protected:
+    virtual void
+    On_enable() override
+    {
+        /* Timers have millisecond resolution, so the timer ticks at the
+         * period rounded down and updates are sent when due. This keeps the
+         * average rate exact for periods which are not whole milliseconds.
+         */
+        auto tick = std::max(
+            std::chrono::duration_cast<std::chrono::milliseconds>(period),
+            std::chrono::milliseconds(1));
+        next_update = ugcs::vsm::Clock::Now() + period;
+        timer = ugcs::vsm::Timer_processor::Get_instance()->Create_timer(
+            tick,
+            ugcs::vsm::Make_callback(&Synthetic_vehicle::Send_telemetry, Shared_from_this()),
+            Get_completion_ctx());
+        t_downlink_present->Set_value(true);
+        c_arm->Set_available();
+        c_arm->Set_enabled();
+        Commit_to_ucs();
+    }
+
+    virtual void
+    On_disable() override
+    {
+        timer->Cancel();
+    }
+
+    virtual void
+    Handle_ucs_command(ugcs::vsm::Ucs_request::Ptr ucs_request) override
+    {
+        ucs_request->Complete();
+    }
+
+private:
+    bool
+    Send_telemetry()
+    {
+        auto now = ugcs::vsm::Clock::Now();
+        if (now < next_update) {
+            return true;
+        }
+        /* Late updates are not sent twice. */
+        next_update = std::max(next_update + period, now);
+        counter++;
+        t_altitude_raw->Set_value(static_cast<double>(counter));
+        for (auto& f : fields) {
+            f->Set_value(static_cast<double>(counter));
+        }
+        Commit_to_ucs();
+        return true;
+    }
+
+    ugcs::vsm::Clock::Duration period;
+
+    /** Time when the next update is due. */
+    ugcs::vsm::Clock::Time_point next_update;
+
+    uint64_t counter = 0;
+
+    ugcs::vsm::Timer_processor::Timer::Ptr timer;
+
+    ugcs::vsm::Property::Ptr t_downlink_present;
+    ugcs::vsm::Property::Ptr t_altitude_raw;
+    std::vector<ugcs::vsm::Property::Ptr> fields;
+
+    ugcs::vsm::Vsm_command::Ptr c_arm;
+};
+
+#endif /* _MT_UCS_LOAD_SYNTHETIC_VEHICLE_H_ */
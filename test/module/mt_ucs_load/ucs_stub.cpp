@@ -0,0 +1,267 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+#include "ucs_stub.h"
+
+#include <ugcs/vsm/param_setter.h>
+
+using namespace ugcs::vsm;
+
+constexpr size_t Ucs_stub::READ_SIZE;
+
+namespace {
+
+/** Current system time in milliseconds since 1970. */
+int64_t
+Now_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} /* anonymous namespace */
+
+Ucs_stub::Ucs_stub():
+    pending(Io_buffer::Create())
+{
+}
+
+bool
+Ucs_stub::Connect(const std::string& host, const std::string& port)
+{
+    if (!worker) {
+        completion_ctx = Request_completion_context::Create("UCS stub completion");
+        worker = Request_worker::Create(
+            "UCS stub worker",
+            std::initializer_list<Request_container::Ptr>{completion_ctx});
+        completion_ctx->Enable();
+        worker->Enable();
+    }
+
+    Io_result result;
+    Socket_processor::Get_instance()->Connect(host, port, Make_setter(stream, result));
+    if (result != Io_result::OK || !stream) {
+        stream = nullptr;
+        return false;
+    }
+
+    proto::Vsm_message msg;
+    msg.set_device_id(0);
+    auto peer = msg.mutable_register_peer();
+    peer->set_peer_id(Get_application_instance_id() ^ 0x5a5a5a5a);
+    peer->set_peer_type(proto::PEER_TYPE_SERVER);
+    peer->set_version_major(Cucs_processor::SUPPORTED_UCS_VERSION_MAJOR);
+    peer->set_version_minor(Cucs_processor::SUPPORTED_UCS_VERSION_MINOR);
+    peer->set_name("UCS load stub");
+    Send(msg);
+    Schedule_read();
+    return true;
+}
+
+void
+Ucs_stub::Disconnect()
+{
+    if (stream) {
+        auto s = stream;
+        stream = nullptr;
+        s->Close();
+    }
+    if (worker) {
+        worker->Disable();
+        completion_ctx->Disable();
+        worker = nullptr;
+        completion_ctx = nullptr;
+    }
+}
+
+size_t
+Ucs_stub::Get_device_count()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return devices.size();
+}
+
+void
+Ucs_stub::Send_commands()
+{
+    std::vector<proto::Vsm_message> commands;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto now = std::chrono::steady_clock::now();
+        for (auto& dev : devices) {
+            if (!dev.second.command_id) {
+                continue;
+            }
+            proto::Vsm_message msg;
+            msg.set_device_id(dev.first);
+            msg.set_message_id(next_message_id++);
+            msg.set_response_required(true);
+            msg.add_device_commands()->set_command_id(dev.second.command_id);
+            pending_commands[msg.message_id()] = now;
+            stats.commands_sent++;
+            commands.emplace_back(std::move(msg));
+        }
+    }
+    for (auto& msg : commands) {
+        Send(msg);
+    }
+}
+
+Ucs_stub::Stats
+Ucs_stub::Take_stats()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    Stats ret = std::move(stats);
+    stats = Stats();
+    return ret;
+}
+
+void
+Ucs_stub::Schedule_read()
+{
+    stream->Read(
+        READ_SIZE,
+        1,
+        Make_read_callback(&Ucs_stub::On_read, Shared_from_this()),
+        completion_ctx);
+}
+
+void
+Ucs_stub::On_read(Io_buffer::Ptr buffer, Io_result result)
+{
+    if (result != Io_result::OK) {
+        if (stream) {
+            LOG_ERR("UCS stub connection closed");
+        }
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stats.bytes += buffer->Get_length();
+    }
+    pending = pending->Concatenate(buffer);
+
+    while (pending->Get_length()) {
+        auto data = static_cast<const uint8_t*>(pending->Get_data());
+        size_t len = pending->Get_length();
+        size_t message_size = 0;
+        size_t header_len = 0;
+        int shift = 0;
+        bool header_done = false;
+        while (header_len < len) {
+            uint8_t byte = data[header_len++];
+            message_size |= static_cast<size_t>(byte & 0x7f) << shift;
+            shift += 7;
+            if (!(byte & 0x80)) {
+                header_done = true;
+                break;
+            }
+        }
+        if (!header_done || header_len + message_size > len) {
+            // Wait for more data.
+            break;
+        }
+        proto::Vsm_message msg;
+        if (!msg.ParseFromArray(data + header_len, message_size)) {
+            LOG_ERR("UCS stub failed to parse message, closing");
+            stream->Close();
+            return;
+        }
+        pending = pending->Slice(header_len + message_size);
+        On_message(msg);
+    }
+    Schedule_read();
+}
+
+void
+Ucs_stub::On_message(const proto::Vsm_message& msg)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    stats.messages++;
+
+    if (msg.has_register_device()) {
+        Device_info info;
+        info.begin_of_epoch = msg.register_device().begin_of_epoch();
+        info.command_id = 0;
+        for (auto& subsystem : msg.register_device().subsystems()) {
+            for (auto& cmd : subsystem.commands()) {
+                if (!info.command_id && !cmd.available_in_mission()) {
+                    info.command_id = cmd.id();
+                }
+            }
+        }
+        devices[msg.device_id()] = info;
+        lock.unlock();
+        Respond_ok(msg);
+        return;
+    }
+
+    if (msg.has_unregister_device()) {
+        devices.erase(msg.device_id());
+        return;
+    }
+
+    if (msg.has_device_status()) {
+        auto dev = devices.find(msg.device_id());
+        auto now = Now_ms();
+        auto& status = msg.device_status();
+        stats.telemetry_fields += status.telemetry_fields_size();
+        if (dev != devices.end()) {
+            for (auto& field : status.telemetry_fields()) {
+                stats.telemetry_latency.push_back(
+                    now - (dev->second.begin_of_epoch + field.ms_since_epoch()));
+            }
+        }
+    }
+
+    if (msg.has_device_response()) {
+        auto cmd = pending_commands.find(msg.message_id());
+        if (cmd != pending_commands.end()
+            && msg.device_response().code() != proto::STATUS_IN_PROGRESS) {
+            stats.command_responses++;
+            stats.command_latency.push_back(
+                std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - cmd->second).count());
+            pending_commands.erase(cmd);
+        }
+        return;
+    }
+
+    if (msg.has_response_required() && msg.response_required()) {
+        // Keep-alive pings and any other requests to the server.
+        lock.unlock();
+        Respond_ok(msg);
+    }
+}
+
+void
+Ucs_stub::Respond_ok(const proto::Vsm_message& request)
+{
+    proto::Vsm_message resp;
+    resp.set_device_id(request.device_id());
+    resp.set_message_id(request.message_id());
+    resp.mutable_device_response()->set_code(proto::STATUS_OK);
+    Send(resp);
+}
+
+void
+Ucs_stub::Send(const proto::Vsm_message& message)
+{
+    auto payload_len = message.ByteSizeLong();
+    std::vector<uint8_t> data;
+    data.reserve(10 + payload_len);
+    auto tmp_len = payload_len;
+    do {
+        uint8_t byte = tmp_len & 0x7f;
+        tmp_len >>= 7;
+        if (tmp_len) {
+            byte |= 0x80;
+        }
+        data.push_back(byte);
+    } while (tmp_len);
+    auto header_len = data.size();
+    data.resize(header_len + payload_len);
+    message.SerializeToArray(data.data() + header_len, payload_len);
+    stream->Write(Io_buffer::Create(std::move(data)));
+}
@@ -0,0 +1,121 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Minimal UCS server stand-in. Connects to the VSM UCS listening port and
+ * speaks the same varint framed Vsm_message protocol as the real server:
+ * registers itself as a peer, accepts device registrations, collects device
+ * status and sends commands to registered devices.
+ */
+
+#ifndef _MT_UCS_LOAD_UCS_STUB_H_
+#define _MT_UCS_LOAD_UCS_STUB_H_
+
+#include <ugcs/vsm/vsm.h>
+#include <ugcs/vsm/cucs_processor.h>
+#include <ugcs/vsm/socket_processor.h>
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class Ucs_stub: public std::enable_shared_from_this<Ucs_stub>
+{
+    DEFINE_COMMON_CLASS(Ucs_stub, Ucs_stub)
+
+public:
+    /** Statistics gathered since the last Take_stats() call. */
+    struct Stats {
+        /** Vsm_messages received. */
+        uint64_t messages = 0;
+        /** Bytes received including framing. */
+        uint64_t bytes = 0;
+        /** Telemetry fields received. */
+        uint64_t telemetry_fields = 0;
+        /** Commands sent to devices. */
+        uint64_t commands_sent = 0;
+        /** Responses received for sent commands. */
+        uint64_t command_responses = 0;
+        /** Time between value update in VSM and reception by server, ms. */
+        std::vector<double> telemetry_latency;
+        /** Round trip time of device commands, ms. */
+        std::vector<double> command_latency;
+    };
+
+    Ucs_stub();
+
+    /** Connect to VSM and register as a server peer. Blocks until the
+     * connection is established.
+     * @return true on success.
+     */
+    bool
+    Connect(const std::string& host, const std::string& port);
+
+    /** Close connection to VSM. */
+    void
+    Disconnect();
+
+    /** Number of devices successfully registered on this server. */
+    size_t
+    Get_device_count();
+
+    /** Send one command to each registered device which has any commands. */
+    void
+    Send_commands();
+
+    /** Get statistics and reset them. */
+    Stats
+    Take_stats();
+
+private:
+    typedef struct {
+        // Milliseconds since 1970 as reported in Register_device.
+        int64_t begin_of_epoch;
+        // Any command supported by device, 0 if none.
+        uint32_t command_id;
+    } Device_info;
+
+    /** Maximum bytes to read in one go. */
+    static constexpr size_t READ_SIZE = 65536;
+
+    /** Serves read and write completions. */
+    ugcs::vsm::Request_worker::Ptr worker;
+
+    ugcs::vsm::Request_completion_context::Ptr completion_ctx;
+
+    ugcs::vsm::Socket_stream::Ref stream;
+
+    /** Received data which do not form a complete message yet. */
+    ugcs::vsm::Io_buffer::Ptr pending;
+
+    /** Protects all the members below. */
+    std::mutex mutex;
+
+    std::unordered_map<uint32_t, Device_info> devices;
+
+    /** message_id -> send time of commands waiting for response. */
+    std::unordered_map<uint32_t, std::chrono::steady_clock::time_point> pending_commands;
+
+    uint32_t next_message_id = 1;
+
+    Stats stats;
+
+    void
+    Schedule_read();
+
+    void
+    On_read(ugcs::vsm::Io_buffer::Ptr buffer, ugcs::vsm::Io_result result);
+
+    void
+    On_message(const ugcs::vsm::proto::Vsm_message& message);
+
+    void
+    Send(const ugcs::vsm::proto::Vsm_message& message);
+
+    /** Send Device_response with OK status to the given request. */
+    void
+    Respond_ok(const ugcs::vsm::proto::Vsm_message& request);
+};
+
+#endif /* _MT_UCS_LOAD_UCS_STUB_H_ */
@@ -0,0 +1,238 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Tests for coroutine adapters. Built as C++20.
+ */
+
+#include <ugcs/vsm/coroutine.h>
+#include <ugcs/vsm/request_worker.h>
+
+#include <atomic>
+#include <memory>
+
+#include <UnitTest++.h>
+
+using namespace ugcs::vsm;
+
+namespace {
+
+/** Wait until the task is done. */
+bool
+Wait_done(const Async_task &task)
+{
+    for (int i = 0; i < 500 && !task.Is_done(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return task.Is_done();
+}
+
+/** Counts live instances to check the coroutine frame is destroyed. */
+struct Frame_guard {
+    static std::atomic<int> count;
+
+    Frame_guard()
+    {
+        count++;
+    }
+
+    ~Frame_guard()
+    {
+        count--;
+    }
+};
+
+std::atomic<int> Frame_guard::count = { 0 };
+
+/** Completion context with a worker thread. */
+class Context_fixture {
+public:
+    Request_completion_context::Ptr ctx =
+        Request_completion_context::Create("UT coroutine completion");
+    Request_processor::Ptr processor = Request_processor::Create("UT coroutine processor");
+    Request_worker::Ptr worker = Request_worker::Create(
+        "UT coroutine worker",
+        std::initializer_list<Request_container::Ptr>({ctx}));
+
+    Context_fixture()
+    {
+        ctx->Enable();
+        processor->Enable();
+        worker->Enable();
+    }
+
+    ~Context_fixture()
+    {
+        worker->Disable();
+        processor->Disable();
+        ctx->Disable();
+    }
+};
+
+Async_task
+Submit_and_record(Request_processor::Ptr processor, Request::Ptr request,
+                  Request_completion_context::Ptr ctx, Request::Status &status,
+                  std::thread::id &thread)
+{
+    Frame_guard guard;
+    status = co_await Async_submit(processor, request, ctx);
+    thread = std::this_thread::get_id();
+}
+
+Async_task
+Sleep_and_throw(Request_completion_context::Ptr ctx, bool &fired)
+{
+    Frame_guard guard;
+    fired = co_await Async_sleep(std::chrono::milliseconds(10), ctx);
+    VSM_EXCEPTION(Invalid_op_exception, "Coroutine failure");
+}
+
+typedef internal::Coroutine_resumer<int> Test_resumer;
+
+/** Awaiter which hands the handler reference over to the test, so the test
+ * can invoke or drop it from its own thread.
+ */
+class Handler_awaiter {
+public:
+    Handler_awaiter(Request_completion_context::Ptr ctx,
+                    std::unique_ptr<Test_resumer::Handler_ref> &handler):
+        resumer(-1, ctx), handler(handler)
+    {
+    }
+
+    bool
+    await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void
+    await_suspend(std::coroutine_handle<> handle)
+    {
+        handler.reset(new Test_resumer::Handler_ref(resumer.Suspend(handle)));
+        resumer.Arm();
+    }
+
+    int
+    await_resume()
+    {
+        return resumer.Get_result();
+    }
+
+private:
+    Test_resumer resumer;
+    std::unique_ptr<Test_resumer::Handler_ref> &handler;
+};
+
+Async_task
+Await_handler(Request_completion_context::Ptr ctx,
+              std::unique_ptr<Test_resumer::Handler_ref> &handler,
+              int &result, std::thread::id &thread)
+{
+    Frame_guard guard;
+    result = co_await Handler_awaiter(ctx, handler);
+    thread = std::this_thread::get_id();
+}
+
+} /* anonymous namespace */
+
+TEST_FIXTURE(Context_fixture, submit_resumes_in_context)
+{
+    auto request = Request::Create();
+    request->Set_processing_handler(Make_callback(
+        [request]()
+        {
+            request->Complete(Request::Status::OK);
+        }));
+    auto proc_worker = Request_worker::Create(
+        "UT coroutine processor worker",
+        std::initializer_list<Request_container::Ptr>({processor}));
+    proc_worker->Enable();
+
+    Request::Status status = Request::Status::PENDING;
+    std::thread::id thread;
+    auto task = Submit_and_record(processor, request, ctx, status, thread);
+    CHECK(Wait_done(task));
+    CHECK(Request::Status::OK == status);
+    CHECK(thread != std::this_thread::get_id());
+    CHECK(!task.Get_exception());
+    CHECK_EQUAL(0, Frame_guard::count);
+    proc_worker->Disable();
+}
+
+/* Exception escaping the coroutine is stored and the frame is released. */
+TEST_FIXTURE(Context_fixture, exception_releases_frame)
+{
+    auto timer_proc = Timer_processor::Get_instance();
+    timer_proc->Enable();
+
+    bool fired = false;
+    auto task = Sleep_and_throw(ctx, fired);
+    CHECK(Wait_done(task));
+    CHECK(fired);
+    CHECK_EQUAL(0, Frame_guard::count);
+    auto exception = task.Get_exception();
+    CHECK(exception);
+    CHECK_THROW(std::rethrow_exception(exception), Invalid_op_exception);
+
+    timer_proc->Disable();
+}
+
+/* Aborted request resumes the coroutine with error instead of leaking it. */
+TEST_FIXTURE(Context_fixture, aborted_submit_resumes)
+{
+    auto request = Request::Create();
+    request->Set_processing_handler(Make_callback(
+        [request]()
+        {
+            request->Complete(Request::Status::OK);
+        }));
+
+    /* Processor has no worker, so the request stays queued. */
+    Request::Status status = Request::Status::PENDING;
+    std::thread::id thread;
+    auto task = Submit_and_record(processor, request, ctx, status, thread);
+    CHECK(!task.Is_done());
+    CHECK_EQUAL(1, Frame_guard::count);
+
+    request->Abort();
+    CHECK(Wait_done(task));
+    CHECK(Request::Status::ABORTED == status);
+    CHECK_EQUAL(0, Frame_guard::count);
+}
+
+/* Handler dropped in a foreign thread resumes the coroutine in the completion
+ * context, not in the dropping thread.
+ */
+TEST_FIXTURE(Context_fixture, abandoned_resumes_in_context)
+{
+    std::unique_ptr<Test_resumer::Handler_ref> handler;
+    int result = 0;
+    std::thread::id thread;
+    auto task = Await_handler(ctx, handler, result, thread);
+    CHECK(!task.Is_done());
+    CHECK(handler);
+
+    handler.reset();
+    CHECK(Wait_done(task));
+    CHECK_EQUAL(-1, result);
+    CHECK(thread != std::this_thread::get_id());
+    CHECK_EQUAL(0, Frame_guard::count);
+}
+
+/* Handler dropped when the completion context is disabled destroys the frame. */
+TEST(abandoned_in_disabled_context)
+{
+    auto ctx = Request_completion_context::Create("UT coroutine disabled completion");
+    std::unique_ptr<Test_resumer::Handler_ref> handler;
+    int result = 0;
+    std::thread::id thread;
+    auto task = Await_handler(ctx, handler, result, thread);
+    CHECK_EQUAL(1, Frame_guard::count);
+
+    handler.reset();
+    CHECK(task.Is_done());
+    CHECK_EQUAL(0, result);
+    CHECK_EQUAL(0, Frame_guard::count);
+}
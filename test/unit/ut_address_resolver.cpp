@@ -0,0 +1,98 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Tests for Address_resolver class.
+ */
+
+#include <ugcs/vsm/address_resolver.h>
+#include <ugcs/vsm/request_worker.h>
+
+#include <cstring>
+
+#include <UnitTest++.h>
+
+using namespace ugcs::vsm;
+
+namespace {
+
+addrinfo
+Make_hints()
+{
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    return hints;
+}
+
+/** Resolve and wait for the result. */
+Resolved_addresses::Ptr
+Resolve(Address_resolver::Ptr resolver, Request_completion_context::Ptr ctx,
+        const std::string &host, const std::string &service)
+{
+    Resolved_addresses::Ptr result;
+    auto waiter = resolver->Resolve(host, service, Make_hints(),
+        Make_callback([&](Resolved_addresses::Ptr addresses)
+        {
+            result = addresses;
+        },
+        Resolved_addresses::Ptr()),
+        ctx);
+    waiter.Wait();
+    return result;
+}
+
+} /* anonymous namespace */
+
+TEST(address_resolver_numeric)
+{
+    auto resolver = Address_resolver::Create();
+    auto addresses = resolver->Resolve_immediately("127.0.0.1", "5556", Make_hints());
+    CHECK(addresses != nullptr);
+    CHECK(addresses->Is_ok());
+    CHECK_EQUAL(1U, addresses->Get_entries().size());
+    auto &entry = addresses->Get_entries().front();
+    CHECK_EQUAL(AF_INET, entry.ai_family);
+    auto sin = reinterpret_cast<const sockaddr_in *>(entry.ai_addr);
+    CHECK_EQUAL(5556, ntohs(sin->sin_port));
+    CHECK_EQUAL(0x7f000001U, ntohl(sin->sin_addr.s_addr));
+
+    /* Not numeric and not cached. */
+    CHECK(resolver->Resolve_immediately("localhost", "5556", Make_hints()) == nullptr);
+}
+
+TEST(address_resolver_cache)
+{
+    auto resolver = Address_resolver::Create();
+    auto ctx = Request_completion_context::Create("UT resolver completion");
+    auto worker = Request_worker::Create(
+        "UT resolver worker",
+        std::initializer_list<Request_container::Ptr>({ctx}));
+    resolver->Enable();
+    ctx->Enable();
+    worker->Enable();
+
+    auto addresses = Resolve(resolver, ctx, "localhost", "5556");
+    CHECK(addresses != nullptr);
+    CHECK(addresses->Is_ok());
+    /* Now it is served from the cache. */
+    CHECK(resolver->Resolve_immediately("localhost", "5556", Make_hints()) == addresses);
+    /* Other service is a different entry. */
+    CHECK(resolver->Resolve_immediately("localhost", "5557", Make_hints()) == nullptr);
+
+    /* Failures are cached too. */
+    auto failed = Resolve(resolver, ctx, "no-such-host.invalid", "1");
+    CHECK(failed != nullptr);
+    CHECK(!failed->Is_ok());
+    CHECK(failed->Get_error() != 0);
+    CHECK(resolver->Resolve_immediately("no-such-host.invalid", "1", Make_hints()) == failed);
+
+    resolver->Clear_cache();
+    CHECK(resolver->Resolve_immediately("localhost", "5556", Make_hints()) == nullptr);
+
+    resolver->Disable();
+    ctx->Disable();
+    worker->Disable();
+}
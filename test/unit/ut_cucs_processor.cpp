@@ -4,8 +4,510 @@
 
 
 #include <ugcs/vsm/cucs_processor.h>
+#include <ugcs/vsm/mavlink.h>
+#include <ugcs/vsm/vsm.h>
 
 #include <UnitTest++.h>
 
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
 using namespace ugcs::vsm;
 
+class Test_case_wrapper
+{
+public:
+    Test_case_wrapper() {
+        ugcs::vsm::Initialize("vsm.conf");
+    }
+
+    ~Test_case_wrapper() {
+        ugcs::vsm::Terminate();
+    }
+};
+
+/* Server side of UCS connection. */
+class Ucs_client
+{
+public:
+    Socket_processor::Stream::Ref stream;
+
+    Ucs_client(uint32_t peer_id)
+    {
+        auto sp = Socket_processor::Get_instance();
+        auto result = Io_result::CONNECTION_REFUSED;
+        while (result == Io_result::CONNECTION_REFUSED) {
+            auto w = sp->Connect("127.0.0.1", "5556",
+                    Make_socket_connect_callback([&](Socket_processor::Stream::Ref s, Io_result res) {
+                result = res;
+                stream = s;
+            }));
+            w.Wait();
+            if (result == Io_result::CONNECTION_REFUSED) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+        }
+        proto::Vsm_message msg;
+        msg.set_device_id(0);
+        auto r = msg.mutable_register_peer();
+        r->set_peer_id(peer_id);
+        r->set_version_major(SDK_VERSION_MAJOR);
+        r->set_version_minor(SDK_VERSION_MINOR);
+        Send(msg);
+        /* VSM hello. */
+        Read(msg);
+    }
+
+    void
+    Send(const proto::Vsm_message &message)
+    {
+        auto payload = message.SerializeAsString();
+        std::vector<uint8_t> data;
+        auto len = payload.size();
+        do {
+            uint8_t byte = len & 0x7f;
+            len >>= 7;
+            data.push_back(len ? byte | 0x80 : byte);
+        } while (len);
+        data.insert(data.end(), payload.begin(), payload.end());
+        stream->Write(Io_buffer::Create(std::move(data))).Wait();
+    }
+
+    void
+    Read(proto::Vsm_message &message)
+    {
+        Io_buffer::Ptr buf;
+        Io_result result;
+        size_t len = 0;
+        int byte;
+        int shift = 0;
+        do {
+            stream->Read(1, 1, Make_setter(buf, result)).Wait();
+            CHECK(result == Io_result::OK);
+            byte = *static_cast<const uint8_t*>(buf->Get_data());
+            len |= static_cast<size_t>(byte & 0x7f) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        stream->Read(len, len, Make_setter(buf, result)).Wait();
+        CHECK(result == Io_result::OK);
+        CHECK(message.ParseFromArray(buf->Get_data(), buf->Get_length()));
+    }
+
+    /* Skip messages until the one matching the predicate. */
+    template <class Predicate>
+    proto::Vsm_message
+    Read_until(Predicate predicate)
+    {
+        proto::Vsm_message message;
+        do {
+            Read(message);
+        } while (!predicate(message));
+        return message;
+    }
+
+    /* Accept Register_device of the next registered device. Returns when
+     * the registration is processed, i.e. cached telemetry is received.
+     */
+    void
+    Accept_registration()
+    {
+        auto reg = Read_until([](const proto::Vsm_message &m) { return m.has_register_device(); });
+        proto::Vsm_message response;
+        response.set_device_id(reg.device_id());
+        response.set_message_id(reg.message_id());
+        response.mutable_device_response()->set_code(proto::STATUS_OK);
+        Send(response);
+        Read_until([](const proto::Vsm_message &m) { return m.has_device_status(); });
+    }
+};
+
+class Test_vehicle: public Vehicle
+{
+    DEFINE_COMMON_CLASS(Test_vehicle, Vehicle)
+public:
+    Test_vehicle()
+    {
+        Set_vehicle_type(proto::VEHICLE_TYPE_MULTICOPTER);
+        Set_autopilot_type("myvehicle");
+        Set_model_name("SuperCopter");
+        Set_serial_number("123456");
+    }
+
+    /* Report telemetry value taken from the received message. */
+    void
+    Report_altitude(mavlink::Message<mavlink::MESSAGE_ID::HEARTBEAT>::Ptr message)
+    {
+        /* Do not wait for the interval since the commit on registration. */
+        Property::Commit_policy policy;
+        policy.min_interval = std::chrono::milliseconds::zero();
+        t_altitude_origin->Set_commit_policy(policy);
+        t_altitude_origin->Set_value(message->payload->custom_mode.Get(), message->Get_rx_time());
+        Commit_to_ucs();
+    }
+};
+
+/* Field which is not registered by the vehicle. */
+constexpr uint32_t TEST_FIELD_ID = 1000000;
+
+/* Telemetry message with a field of the specified size, sequence number is
+ * passed in the field timestamp.
+ */
+Proto_msg_ptr
+Make_status(int seq, size_t size)
+{
+    auto msg = std::make_shared<proto::Vsm_message>();
+    auto field = msg->mutable_device_status()->add_telemetry_fields();
+    field->set_field_id(TEST_FIELD_ID);
+    field->set_ms_since_epoch(seq);
+    field->mutable_value()->set_string_value(std::string(size, 'x'));
+    return msg;
+}
+
+bool
+Is_test_status(const proto::Vsm_message &m)
+{
+    return  m.device_status().telemetry_fields_size() == 1
+        &&  m.device_status().telemetry_fields(0).field_id() == TEST_FIELD_ID;
+}
+
+int
+Get_test_seq(const proto::Vsm_message &m)
+{
+    return m.device_status().telemetry_fields(0).ms_since_epoch();
+}
+
+/* Wait for the condition checked in the caller thread. */
+template <class Predicate>
+bool
+Wait_for(Predicate predicate)
+{
+    for (int i = 0; i < 5000; i++) {
+        if (predicate()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return predicate();
+}
+
+
+TEST(telemetry_age_bucket)
+{
+    using std::chrono::milliseconds;
+    CHECK_EQUAL(0U, Cucs_processor::Get_telemetry_age_bucket(std::chrono::microseconds(500)));
+    CHECK_EQUAL(1U, Cucs_processor::Get_telemetry_age_bucket(milliseconds(1)));
+    CHECK_EQUAL(2U, Cucs_processor::Get_telemetry_age_bucket(milliseconds(2)));
+    CHECK_EQUAL(2U, Cucs_processor::Get_telemetry_age_bucket(milliseconds(3)));
+    CHECK_EQUAL(8U, Cucs_processor::Get_telemetry_age_bucket(milliseconds(200)));
+    CHECK_EQUAL(Cucs_processor::TELEMETRY_AGE_BUCKETS - 1,
+        Cucs_processor::Get_telemetry_age_bucket(std::chrono::hours(1)));
+}
+
+TEST(peek_message_header)
+{
+    proto::Vsm_message msg;
+    msg.set_device_id(42);
+    msg.add_device_commands()->set_command_id(7);
+    msg.set_message_id(300);
+    auto data = msg.SerializeAsString();
+
+    Cucs_processor::Message_header header;
+    CHECK(Cucs_processor::Peek_message_header(data.data(), data.size(), header));
+    CHECK_EQUAL(42U, header.device_id);
+    CHECK(header.message_id);
+    CHECK_EQUAL(300U, *header.message_id);
+    CHECK(!header.response_required);
+    CHECK(!header.is_response);
+
+    msg.set_response_required(true);
+    msg.mutable_device_response()->set_code(proto::STATUS_OK);
+    data = msg.SerializeAsString();
+    header = Cucs_processor::Message_header();
+    CHECK(Cucs_processor::Peek_message_header(data.data(), data.size(), header));
+    CHECK(header.response_required);
+    CHECK(header.is_response);
+
+    msg.Clear();
+    msg.set_device_id(1);
+    msg.mutable_register_peer()->set_peer_id(2);
+    data = msg.SerializeAsString();
+    header = Cucs_processor::Message_header();
+    CHECK(Cucs_processor::Peek_message_header(data.data(), data.size(), header));
+    CHECK(header.is_register_peer);
+    CHECK(!header.message_id);
+
+    /* Truncated. */
+    CHECK(!Cucs_processor::Peek_message_header(data.data(), data.size() - 1, header));
+
+    /* No device_id. */
+    msg.clear_device_id();
+    data = msg.SerializePartialAsString();
+    CHECK(!Cucs_processor::Peek_message_header(data.data(), data.size(), header));
+}
+
+TEST(parse_message)
+{
+    proto::Vsm_message msg;
+    msg.set_device_id(1);
+    for (int i = 0; i < 100; i++) {
+        msg.add_device_commands()->set_command_id(i);
+    }
+    auto data = msg.SerializeAsString();
+    auto parsed = Cucs_processor::Parse_message(data.data(), data.size());
+    CHECK(parsed);
+    CHECK(parsed->GetArena());
+    CHECK_EQUAL(100, parsed->device_commands_size());
+    CHECK_EQUAL(99U, parsed->device_commands(99).command_id());
+
+    CHECK(!Cucs_processor::Parse_message(data.data(), data.size() - 1));
+}
+
+/* Every server connection gets broadcast telemetry. */
+TEST_FIXTURE(Test_case_wrapper, broadcast_to_connections)
+{
+    auto cucs = Cucs_processor::Get_instance();
+    Ucs_client c1(1), c2(2);
+    auto v = Test_vehicle::Create();
+    v->Enable();
+    v->Register();
+    c1.Accept_registration();
+    c2.Accept_registration();
+
+    auto handle = v->Get_session_id();
+    for (int i = 0; i < 10; i++) {
+        cucs->Send_ucs_message(handle, Make_status(i, 100));
+    }
+    for (auto c : {&c1, &c2}) {
+        for (int i = 0; i < 10; i++) {
+            auto m = c->Read_until(Is_test_status);
+            CHECK_EQUAL(handle, m.device_id());
+            CHECK_EQUAL(i, Get_test_seq(m));
+        }
+    }
+    CHECK_EQUAL(2U, cucs->Get_link_stats().size());
+
+    v->Disable();
+    c1.stream->Close();
+    c2.stream->Close();
+}
+
+/* Connection closed by the server while a lot of data is queued for it does
+ * not affect other connections.
+ */
+TEST_FIXTURE(Test_case_wrapper, close_with_pending_writes)
+{
+    auto cucs = Cucs_processor::Get_instance();
+    Ucs_client c1(1), c2(2);
+    auto v = Test_vehicle::Create();
+    v->Enable();
+    v->Register();
+    c1.Accept_registration();
+    c2.Accept_registration();
+
+    /* More than socket buffers can hold, c1 does not read. */
+    constexpr int COUNT = 200;
+    auto handle = v->Get_session_id();
+    for (int i = 0; i < COUNT; i++) {
+        cucs->Send_ucs_message(handle, Make_status(i, 64 * 1024));
+    }
+    CHECK(Wait_for([&]() { return cucs->Get_write_backlog() > 0; }));
+    c1.stream->Close();
+
+    for (int i = 0; i < COUNT; i++) {
+        auto m = c2.Read_until(Is_test_status);
+        CHECK_EQUAL(i, Get_test_seq(m));
+    }
+    CHECK(Wait_for([&]() { return cucs->Get_link_stats().size() == 1; }));
+    CHECK(Wait_for([&]() { return cucs->Get_write_backlog() == 0; }));
+
+    v->Disable();
+    c2.stream->Close();
+}
+
+/* Messages sent while the device is unregistered are either delivered
+ * before Unregister_device or dropped.
+ */
+TEST_FIXTURE(Test_case_wrapper, unregister_racing_send)
+{
+    auto cucs = Cucs_processor::Get_instance();
+    Ucs_client c(1);
+    auto v = Test_vehicle::Create();
+    v->Enable();
+    v->Register();
+    c.Accept_registration();
+
+    auto handle = v->Get_session_id();
+    std::atomic_bool started = { false };
+    std::thread sender([&]() {
+        for (int i = 0; i < 1000; i++) {
+            cucs->Send_ucs_message(handle, Make_status(i, 100));
+            started = true;
+        }
+    });
+    while (!started) {
+        std::this_thread::yield();
+    }
+    v->Disable();
+    sender.join();
+
+    int last = -1;
+    auto m = c.Read_until([&](const proto::Vsm_message &m) {
+        if (Is_test_status(m)) {
+            /* Delivered in order. */
+            CHECK_EQUAL(last + 1, Get_test_seq(m));
+            last++;
+        }
+        return m.has_unregister_device();
+    });
+    CHECK_EQUAL(handle, m.device_id());
+    CHECK(last >= 0);
+    auto histogram = cucs->Get_telemetry_age_histogram(handle);
+    CHECK(std::all_of(histogram.begin(), histogram.end(), [](uint64_t n) { return n == 0; }));
+
+    c.stream->Close();
+}
+
+/* Messages queued for a server which does not read are bounded, the oldest
+ * telemetry is dropped. Other connections are not affected.
+ */
+TEST_FIXTURE(Test_case_wrapper, stalled_connection)
+{
+    auto cucs = Cucs_processor::Get_instance();
+    Ucs_client stalled(1), c(2);
+    auto v = Test_vehicle::Create();
+    v->Enable();
+    v->Register();
+    stalled.Accept_registration();
+    c.Accept_registration();
+
+    constexpr int COUNT = 4000;
+    constexpr int BATCH = 100;
+    std::atomic_int received = { 0 };
+    std::thread reader([&]() {
+        for (int i = 0; i < COUNT; i++) {
+            auto m = c.Read_until(Is_test_status);
+            CHECK_EQUAL(i, Get_test_seq(m));
+            received = i + 1;
+        }
+    });
+    auto handle = v->Get_session_id();
+    /* Cached telemetry resent after drops has one more field, so it is not
+     * taken for a test message.
+     */
+    auto other = Make_status(0, 1);
+    other->mutable_device_status()->mutable_telemetry_fields(0)->set_field_id(TEST_FIELD_ID + 1);
+    cucs->Send_ucs_message(handle, other);
+    for (int i = 0; i < COUNT; i++) {
+        cucs->Send_ucs_message(handle, Make_status(i, 16 * 1024));
+        /* Let the reading server keep up. */
+        if (i % BATCH == BATCH - 1) {
+            CHECK(Wait_for([&]() { return received > i - BATCH; }));
+        }
+    }
+    reader.join();
+    CHECK_EQUAL(COUNT, received);
+
+    auto link_stats = cucs->Get_link_stats();
+    CHECK_EQUAL(2U, link_stats.size());
+    for (auto &stats : link_stats) {
+        CHECK(stats.ucs_id);
+        if (*stats.ucs_id == 1) {
+            CHECK(stats.tx_dropped > 0);
+            CHECK(stats.tx_queued <= 1000);
+            CHECK(stats.tx_queued > 0);
+        } else {
+            CHECK_EQUAL(0U, stats.tx_dropped);
+        }
+    }
+    /* Only the write window of the stalled connection is pending. */
+    CHECK(cucs->Get_write_backlog() <= 256 * 1024 + 16 * 1024 + 100);
+
+    v->Disable();
+    stalled.stream->Close();
+    c.stream->Close();
+}
+
+/* Receive time of the buffer the value is parsed from is carried through the
+ * property to the telemetry age histogram.
+ */
+TEST_FIXTURE(Test_case_wrapper, telemetry_age_from_rx_time)
+{
+    auto cucs = Cucs_processor::Get_instance();
+    Ucs_client c(1);
+    auto v = Test_vehicle::Create();
+    v->Enable();
+    v->Register();
+    c.Accept_registration();
+
+    auto handle = v->Get_session_id();
+    auto before = cucs->Get_telemetry_age_histogram(handle);
+    auto bucket = Cucs_processor::Get_telemetry_age_bucket(std::chrono::milliseconds(150));
+
+    mavlink::Pld_heartbeat heartbeat;
+    heartbeat->custom_mode = 100;
+    auto buffer = heartbeat.Get_buffer();
+    buffer->Set_rx_time(Clock::Now() - std::chrono::milliseconds(150));
+    v->Report_altitude(mavlink::Message<mavlink::MESSAGE_ID::HEARTBEAT>::Create(1, 1, 0, buffer));
+
+    c.Read_until([](const proto::Vsm_message &m) {
+        return m.device_status().telemetry_fields_size() > 0;
+    });
+    CHECK(Wait_for([&]() {
+        return cucs->Get_telemetry_age_histogram(handle)[bucket] == before[bucket] + 1;
+    }));
+
+    v->Disable();
+    c.stream->Close();
+}
+
+/* Keep-alive timeout is driven by the installed clock. */
+TEST(keep_alive_virtual_time)
+{
+    {
+        std::ifstream conf("vsm.conf");
+        std::ofstream keep_alive_conf("vsm_keep_alive.conf");
+        keep_alive_conf << conf.rdbuf() << "\nucs.keep_alive_timeout = 3\n";
+    }
+    auto clock = Virtual_clock::Create();
+    Clock::Set_current(clock);
+    ugcs::vsm::Initialize("vsm_keep_alive.conf");
+    /* Listener is started by the transport detector timer. */
+    clock->Advance(std::chrono::seconds(1));
+    /* Registered at the current virtual time. */
+    Ucs_client c(1);
+    auto cucs = Cucs_processor::Get_instance();
+    CHECK(Wait_for([&]() {
+        auto stats = cucs->Get_link_stats();
+        return stats.size() == 1 && stats[0].ucs_id;
+    }));
+
+    /* The server does not respond. It is pinged each second until the
+     * timeout passes since its last message, i.e. at 1, 2 and 3 seconds
+     * after the registration, then the connection is closed.
+     */
+    int pings = 0;
+    Io_result result = Io_result::OK;
+    for (int i = 0; i < 10 && result == Io_result::OK; i++) {
+        clock->Advance(std::chrono::seconds(1));
+        Io_buffer::Ptr buf;
+        c.stream->Read(1, 1, Make_setter(buf, result)).Wait();
+        if (result != Io_result::OK) {
+            break;
+        }
+        size_t len = *static_cast<const uint8_t*>(buf->Get_data());
+        c.stream->Read(len, len, Make_setter(buf, result)).Wait();
+        proto::Vsm_message ping;
+        CHECK(result == Io_result::OK);
+        CHECK(ping.ParseFromArray(buf->Get_data(), buf->Get_length()));
+        CHECK(ping.response_required());
+        pings++;
+    }
+    CHECK(result != Io_result::OK);
+    CHECK_EQUAL(3, pings);
+    c.stream->Close();
+
+    ugcs::vsm::Terminate();
+    Clock::Set_current(nullptr);
+    std::remove("vsm_keep_alive.conf");
+}
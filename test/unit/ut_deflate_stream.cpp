@@ -0,0 +1,85 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Tests for Deflate_stream class.
+ */
+
+#include <ugcs/vsm/deflate_stream.h>
+
+#include <string>
+
+#include <UnitTest++.h>
+
+using namespace ugcs::vsm;
+
+namespace {
+
+std::string
+Make_frame(int i)
+{
+    std::string frame;
+    for (int j = 0; j < 20; j++) {
+        frame += "field_" + std::to_string(j) + "=" + std::to_string(i * j) + ";";
+    }
+    return frame;
+}
+
+} /* anonymous namespace */
+
+TEST(deflate_stream_round_trip)
+{
+    auto deflater = Deflate_stream::Create(Deflate_stream::Mode::COMPRESS);
+    auto inflater = Deflate_stream::Create(Deflate_stream::Mode::DECOMPRESS);
+
+    size_t raw_len = 0, compressed_len = 0;
+    for (int i = 0; i < 100; i++) {
+        auto frame = Make_frame(i);
+        std::vector<uint8_t> compressed;
+        if (i % 2) {
+            /* Frame compressed in two parts. */
+            deflater->Compress(frame.data(), 10, false, compressed);
+            deflater->Compress(frame.data() + 10, frame.size() - 10, true, compressed);
+        } else {
+            deflater->Compress(frame.data(), frame.size(), true, compressed);
+        }
+        raw_len += frame.size();
+        compressed_len += compressed.size();
+
+        std::vector<uint8_t> plain;
+        CHECK(inflater->Decompress(compressed.data(), compressed.size(), 1000, plain));
+        CHECK_EQUAL(frame, std::string(plain.begin(), plain.end()));
+    }
+    /* History is shared between frames. */
+    CHECK(compressed_len * 2 < raw_len);
+
+    /* Empty frame. */
+    std::vector<uint8_t> compressed, plain;
+    deflater->Compress(nullptr, 0, true, compressed);
+    CHECK(inflater->Decompress(compressed.data(), compressed.size(), 1000, plain));
+    CHECK_EQUAL(0U, plain.size());
+}
+
+TEST(deflate_stream_limits)
+{
+    auto deflater = Deflate_stream::Create(Deflate_stream::Mode::COMPRESS);
+    std::string frame(10000, 'a');
+    std::vector<uint8_t> compressed, plain;
+    deflater->Compress(frame.data(), frame.size(), true, compressed);
+    CHECK(compressed.size() < 100);
+
+    /* Too long. */
+    auto inflater = Deflate_stream::Create(Deflate_stream::Mode::DECOMPRESS);
+    CHECK(!inflater->Decompress(compressed.data(), compressed.size(), 9999, plain));
+
+    inflater = Deflate_stream::Create(Deflate_stream::Mode::DECOMPRESS);
+    plain.clear();
+    CHECK(inflater->Decompress(compressed.data(), compressed.size(), 10000, plain));
+    CHECK_EQUAL(10000U, plain.size());
+
+    /* Corrupted. */
+    inflater = Deflate_stream::Create(Deflate_stream::Mode::DECOMPRESS);
+    std::vector<uint8_t> garbage(100, 0xff);
+    CHECK(!inflater->Decompress(garbage.data(), garbage.size(), 10000, plain));
+}
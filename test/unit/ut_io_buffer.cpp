@@ -5,6 +5,7 @@
 /* Unit tests for Io_buffer class. */
 
 #include <ugcs/vsm/io_buffer.h>
+#include <ugcs/vsm/io_buffer_pool.h>
 
 #include <UnitTest++.h>
 
@@ -47,3 +48,81 @@ TEST(basic_functionality)
 
     //XXX empty buffers
 }
+
+TEST(rx_time)
+{
+    auto buf = Io_buffer::Create("0123456789");
+    CHECK(!buf->Has_rx_time());
+
+    auto t1 = std::chrono::steady_clock::now();
+    buf->Set_rx_time(t1);
+    CHECK(buf->Has_rx_time());
+    CHECK(t1 == buf->Get_rx_time());
+
+    /* Preserved by copy and slice. */
+    CHECK(t1 == Io_buffer::Create(*buf)->Get_rx_time());
+    CHECK(t1 == buf->Slice(2, 3)->Get_rx_time());
+    CHECK(t1 == buf->Slice(10)->Get_rx_time());
+
+    /* Concatenation takes the latest timestamp. */
+    auto t2 = t1 + std::chrono::milliseconds(10);
+    auto buf2 = Io_buffer::Create("abc");
+    buf2->Set_rx_time(t2);
+    CHECK(t2 == buf->Concatenate(buf2)->Get_rx_time());
+    CHECK(t2 == buf2->Concatenate(buf)->Get_rx_time());
+    CHECK_EQUAL("0123456789abc", buf->Concatenate(buf2)->Get_string());
+
+    /* Empty buffer with newer timestamp updates timestamp only. */
+    auto empty = Io_buffer::Create();
+    empty->Set_rx_time(t2);
+    auto res = buf->Concatenate(empty);
+    CHECK(t2 == res->Get_rx_time());
+    CHECK_EQUAL("0123456789", res->Get_string());
+    CHECK(t1 == buf->Get_rx_time());
+    res = empty->Concatenate(buf);
+    CHECK(t2 == res->Get_rx_time());
+    CHECK(t1 == buf->Get_rx_time());
+}
+
+TEST(buffer_pool)
+{
+    auto pool = Io_buffer_pool::Create(2, 100);
+    CHECK_EQUAL(0U, pool->Get_pooled_count());
+
+    auto data = pool->Allocate(3);
+    CHECK_EQUAL(3U, data->size());
+    memcpy(data->data(), "abc", 3);
+    auto raw = data.get();
+    auto buf = Io_buffer_pool::Create_buffer(std::move(data));
+    CHECK_EQUAL("abc", buf->Get_string());
+    auto slice = buf->Slice(1);
+    buf = nullptr;
+    /* Still referenced by slice. */
+    CHECK_EQUAL(0U, pool->Get_pooled_count());
+    CHECK_EQUAL("bc", slice->Get_string());
+    slice = nullptr;
+    CHECK_EQUAL(1U, pool->Get_pooled_count());
+
+    /* Vector is reused. */
+    data = pool->Allocate(5);
+    CHECK(raw == data.get());
+    CHECK_EQUAL(5U, data->size());
+    CHECK_EQUAL(0U, pool->Get_pooled_count());
+
+    /* Pool size and capacity limits. */
+    auto data2 = pool->Allocate(10);
+    auto data3 = pool->Allocate(10);
+    auto big = pool->Allocate(1000);
+    data = nullptr;
+    data2 = nullptr;
+    data3 = nullptr;
+    CHECK_EQUAL(2U, pool->Get_pooled_count());
+    pool->Allocate(1);
+    big = nullptr;
+    CHECK_EQUAL(2U, pool->Get_pooled_count());
+
+    /* Pool outlives its reference while vectors are in use. */
+    data = pool->Allocate(1);
+    pool = nullptr;
+    data = nullptr;
+}
@@ -0,0 +1,126 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Tests for Io_relay class.
+ */
+
+#include <ugcs/vsm/io_relay.h>
+#include <ugcs/vsm/socket_processor.h>
+#include <ugcs/vsm/param_setter.h>
+#include <ugcs/vsm/request_worker.h>
+#include <ugcs/vsm/vsm.h>
+
+#include <atomic>
+
+#include <UnitTest++.h>
+
+using namespace ugcs::vsm;
+
+namespace {
+
+class Test_case_wrapper
+{
+public:
+    Test_case_wrapper() {
+        ugcs::vsm::Initialize("vsm.conf");
+        ctx = Request_completion_context::Create("UT relay completion");
+        worker = Request_worker::Create(
+            "UT relay worker",
+            std::initializer_list<Request_container::Ptr>({ctx}));
+        ctx->Enable();
+        worker->Enable();
+    }
+
+    ~Test_case_wrapper() {
+        ctx->Disable();
+        worker->Disable();
+        ugcs::vsm::Terminate();
+    }
+
+    /** Create connected pair of TCP streams. */
+    void
+    Connect(const char *port, Socket_processor::Stream::Ref &client,
+            Socket_processor::Stream::Ref &server)
+    {
+        auto sp = Socket_processor::Get_instance();
+        Socket_processor::Socket_listener::Ref listener;
+        sp->Listen("127.0.0.1", port,
+            Make_socket_listen_callback([&](Socket_processor::Stream::Ref l, Io_result) {
+                listener = l;
+            }));
+        auto accept_op = sp->Accept(listener,
+            Make_socket_accept_callback([&](Socket_processor::Stream::Ref s, Io_result) {
+                server = s;
+            }),
+            ctx);
+        sp->Connect("127.0.0.1", port,
+            Make_socket_connect_callback([&](Socket_processor::Stream::Ref s, Io_result) {
+                client = s;
+            }));
+        accept_op.Wait(false);
+        listener->Close();
+    }
+
+    /** Relay between two connections and check data in both directions. */
+    void
+    Relay(bool allow_splice, const char *port1, const char *port2)
+    {
+        Socket_processor::Stream::Ref client1, server1, client2, server2;
+        Connect(port1, client1, server1);
+        Connect(port2, client2, server2);
+        CHECK(server1 && server2);
+
+        auto relay = Io_relay::Create(server1, server2, ctx, allow_splice);
+        std::atomic_bool done(false);
+        Io_result done_result = Io_result::OK;
+        relay->Start(Make_callback([&](Io_result result) {
+            done_result = result;
+            done = true;
+        }, Io_result::OK));
+        CHECK_EQUAL(allow_splice && Socket_processor::Is_splice_supported(),
+                    relay->Is_spliced());
+
+        Io_buffer::Ptr buf;
+        Io_result result;
+        client1->Write(Io_buffer::Create("0123456789"), Make_setter(result));
+        client2->Read(10, 10, Make_setter(buf, result)).Timeout(std::chrono::seconds(2));
+        CHECK(result == Io_result::OK);
+        CHECK_EQUAL("0123456789", buf->Get_string().c_str());
+
+        client2->Write(Io_buffer::Create("abcdef"), Make_setter(result));
+        client1->Read(6, 6, Make_setter(buf, result)).Timeout(std::chrono::seconds(2));
+        CHECK(result == Io_result::OK);
+        CHECK_EQUAL("abcdef", buf->Get_string().c_str());
+
+        /* End of the first stream stops the relay. */
+        client1->Close();
+        for (int i = 0; i < 200 && (!done || relay->Get_backward_bytes() != 6); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        CHECK(done);
+        CHECK(done_result == Io_result::CLOSED);
+        CHECK_EQUAL(10U, relay->Get_forward_bytes());
+        CHECK_EQUAL(6U, relay->Get_backward_bytes());
+
+        server1->Close();
+        client2->Close();
+        server2->Close();
+    }
+
+    Request_completion_context::Ptr ctx;
+    Request_worker::Ptr worker;
+};
+
+} /* anonymous namespace */
+
+TEST_FIXTURE(Test_case_wrapper, io_relay_buffered)
+{
+    Relay(false, "12361", "12362");
+}
+
+TEST_FIXTURE(Test_case_wrapper, io_relay_spliced)
+{
+    Relay(true, "12363", "12364");
+}
@@ -0,0 +1,219 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Tests for Mavlink_rate_manager class.
+ */
+
+#include <ugcs/vsm/vsm.h>
+#include <ugcs/vsm/mavlink_rate_manager.h>
+
+#include <fstream>
+#include <iterator>
+
+#include <UnitTest++.h>
+
+using namespace ugcs::vsm;
+
+namespace {
+
+const char *TEST_FILE = "test_mavlink_rate_manager.tmp";
+
+constexpr uint8_t VEHICLE_SYSTEM = 1;
+constexpr uint8_t VEHICLE_COMPONENT = 1;
+
+void
+On_message(mavlink::Message<mavlink::MESSAGE_ID::ATTITUDE>::Ptr)
+{
+}
+
+void
+On_position(mavlink::Message<mavlink::MESSAGE_ID::GLOBAL_POSITION_INT>::Ptr)
+{
+}
+
+template <class Condition>
+bool
+Wait_for(Condition condition)
+{
+    for (int i = 0; i < 5000; i++) {
+        if (condition()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return condition();
+}
+
+/** Feed message from the vehicle. */
+template<class Payload>
+void
+Receive(Mavlink_stream::Ptr stream, const Payload &payload, uint8_t system_id = VEHICLE_SYSTEM)
+{
+    stream->Get_decoder().Decode(Mavlink_encoder().Encode_v2(payload, system_id, VEHICLE_COMPONENT));
+}
+
+/** Messages sent to the vehicle, as text. */
+std::vector<std::string>
+Read_sent()
+{
+    std::ifstream file(TEST_FILE, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::vector<std::string> sent;
+    auto stream = Mavlink_stream::Create(nullptr);
+    stream->Bind_decoder_demuxer();
+    stream->Get_demuxer().Register_handler<mavlink::MESSAGE_ID::COMMAND_LONG, mavlink::Extension>(
+        Mavlink_demuxer::Make_handler<mavlink::MESSAGE_ID::COMMAND_LONG, mavlink::Extension>(
+            [&sent](mavlink::Message<mavlink::MESSAGE_ID::COMMAND_LONG>::Ptr message) {
+                auto &p = message->payload;
+                CHECK_EQUAL(mavlink::MAV_CMD_SET_MESSAGE_INTERVAL, p->command.Get());
+                sent.push_back("interval " + std::to_string(static_cast<int>(p->param1.Get())) +
+                    " " + std::to_string(static_cast<int>(p->param2.Get())));
+            }));
+    stream->Get_demuxer().Register_handler<mavlink::MESSAGE_ID::REQUEST_DATA_STREAM, mavlink::Extension>(
+        Mavlink_demuxer::Make_handler<mavlink::MESSAGE_ID::REQUEST_DATA_STREAM, mavlink::Extension>(
+            [&sent](mavlink::Message<mavlink::MESSAGE_ID::REQUEST_DATA_STREAM>::Ptr message) {
+                auto &p = message->payload;
+                sent.push_back("stream " + std::to_string(p->req_stream_id.Get()) +
+                    " " + std::to_string(p->req_message_rate.Get()) +
+                    " " + std::to_string(p->start_stop.Get()));
+            }));
+    stream->Get_decoder().Decode(Io_buffer::Create(std::move(data)));
+    stream->Disable();
+    return sent;
+}
+
+} /* anonymous namespace */
+
+TEST(mavlink_rate_manager)
+{
+    Timer_processor::Get_instance()->Enable();
+    auto fp = File_processor::Create();
+    fp->Enable();
+    auto ctx = Request_completion_context::Create("UT rate manager completion");
+    ctx->Enable();
+    auto worker = Request_worker::Create("UT rate manager worker",
+        std::initializer_list<Request_container::Ptr>{ctx});
+    worker->Enable();
+
+    auto file = fp->Open(TEST_FILE, "w+");
+    auto stream = Mavlink_stream::Create(file);
+    stream->Set_mavlink_v2();
+    stream->Bind_decoder_demuxer();
+    auto manager = Mavlink_rate_manager::Create(
+        stream, ctx, VEHICLE_SYSTEM, VEHICLE_COMPONENT, 255, 190);
+    manager->Enable();
+
+    manager->Register_handler<mavlink::MESSAGE_ID::ATTITUDE>(
+        Mavlink_demuxer::Make_handler<mavlink::MESSAGE_ID::ATTITUDE, mavlink::Extension>(On_message), 10);
+    manager->Register_handler<mavlink::MESSAGE_ID::GLOBAL_POSITION_INT>(
+        Mavlink_demuxer::Make_handler<mavlink::MESSAGE_ID::GLOBAL_POSITION_INT, mavlink::Extension>(
+            On_position), 2);
+    auto fast = manager->Register_handler<mavlink::MESSAGE_ID::GLOBAL_POSITION_INT>(
+        Mavlink_demuxer::Make_handler<mavlink::MESSAGE_ID::GLOBAL_POSITION_INT, mavlink::Extension>(
+            On_position), 5);
+    CHECK_CLOSE(5, manager->Get_requested_rate(mavlink::MESSAGE_ID::GLOBAL_POSITION_INT), 0.001);
+
+    /* Unhandled message is switched off once, only for the managed vehicle. */
+    mavlink::Pld_vfr_hud hud;
+    Receive(stream, hud);
+    Receive(stream, hud);
+    Receive(stream, hud, VEHICLE_SYSTEM + 1);
+    CHECK(manager->Get_requested_rate(mavlink::MESSAGE_ID::VFR_HUD) < 0);
+    /* Not streamed messages are kept. */
+    mavlink::Pld_statustext text;
+    Receive(stream, text);
+    CHECK_EQUAL(0, manager->Get_requested_rate(mavlink::MESSAGE_ID::STATUSTEXT));
+
+    /* First heartbeat applies the rates. */
+    mavlink::Pld_heartbeat hb;
+    Receive(stream, hb);
+    Receive(stream, hb);
+
+    manager->Unregister_handler(fast);
+
+    /* Fall back to data streams. */
+    mavlink::Pld_command_ack ack;
+    ack->command = mavlink::MAV_CMD_SET_MESSAGE_INTERVAL;
+    ack->result = mavlink::MAV_RESULT_UNSUPPORTED;
+    Receive(stream, ack);
+    CHECK(manager->Is_legacy_mode());
+
+    std::vector<std::string> expected = {
+        "interval 30 100000",
+        "interval 33 500000",
+        "interval 33 200000",
+        "interval 74 -1",
+        "interval 30 100000",
+        "interval 33 200000",
+        "interval 33 500000",
+        "stream 1 0 0",
+        "stream 2 0 0",
+        "stream 3 0 0",
+        "stream 6 2 1",
+        "stream 10 10 1",
+        "stream 11 0 0",
+        "stream 12 0 0"
+    };
+    /* Wait until all writes reach the file. */
+    CHECK(Wait_for([&]() { return Read_sent().size() >= expected.size(); }));
+    manager->Disable();
+    stream->Disable();
+    file->Close().Wait();
+
+    auto sent = Read_sent();
+    CHECK_EQUAL(expected.size(), sent.size());
+    for (size_t i = 0; i < std::min(expected.size(), sent.size()); i++) {
+        CHECK_EQUAL(expected[i], sent[i]);
+    }
+
+    worker->Disable();
+    ctx->Disable();
+    fp->Disable();
+    Timer_processor::Get_instance()->Disable();
+}
+
+/* Default handler runs in the decoding threads while handlers are registered
+ * from another thread.
+ */
+TEST(mavlink_rate_manager_decode_offload)
+{
+    auto pool = Request_worker::Create("UT rate manager pool", 2);
+    pool->Enable();
+    auto ctx = Request_completion_context::Create("UT rate manager completion");
+    ctx->Enable();
+
+    auto stream = Mavlink_stream::Create(nullptr);
+    stream->Bind_decoder_demuxer();
+    stream->Enable_decode_offload(pool);
+    auto manager = Mavlink_rate_manager::Create(
+        stream, ctx, VEHICLE_SYSTEM, VEHICLE_COMPONENT, 255, 190);
+    std::atomic_int received(0);
+    manager->Enable(Mavlink_demuxer::Make_default_handler(
+        [&](Io_buffer::Ptr, mavlink::MESSAGE_ID_TYPE, Mavlink_demuxer::System_id,
+            uint8_t, uint32_t)
+        {
+            received++;
+            return false;
+        }));
+
+    constexpr int MESSAGES = 500;
+    Mavlink_encoder encoder;
+    for (int i = 0; i < MESSAGES; i++) {
+        mavlink::Pld_vfr_hud hud;
+        stream->Decode(encoder.Encode_v2(hud, VEHICLE_SYSTEM, VEHICLE_COMPONENT));
+        auto id = manager->Register_handler<mavlink::MESSAGE_ID::VFR_HUD>(
+            Mavlink_demuxer::Make_handler<mavlink::MESSAGE_ID::VFR_HUD, mavlink::Extension>(
+                [&](mavlink::Message<mavlink::MESSAGE_ID::VFR_HUD>::Ptr) { received++; }), 4);
+        manager->Get_requested_rate(mavlink::MESSAGE_ID::VFR_HUD);
+        manager->Unregister_handler(id);
+    }
+    CHECK(Wait_for([&]() { return received == MESSAGES; }));
+    CHECK(manager->Get_requested_rate(mavlink::MESSAGE_ID::VFR_HUD) < 0);
+
+    manager->Disable();
+    stream->Disable();
+    ctx->Disable();
+    pool->Disable();
+}
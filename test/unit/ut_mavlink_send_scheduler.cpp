@@ -0,0 +1,135 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Tests for Mavlink_send_scheduler class.
+ */
+
+#include <ugcs/vsm/vsm.h>
+#include <ugcs/vsm/mavlink_send_scheduler.h>
+
+#include <fstream>
+#include <iterator>
+
+#include <UnitTest++.h>
+
+using namespace ugcs::vsm;
+
+namespace {
+
+template <class Condition>
+bool
+Wait_for(Condition condition)
+{
+    for (int i = 0; i < 5000; i++) {
+        if (condition()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return condition();
+}
+
+/** Ids of the messages written to the file. */
+std::vector<mavlink::MESSAGE_ID_TYPE>
+Read_sent(const char *name)
+{
+    std::ifstream file(name, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::vector<mavlink::MESSAGE_ID_TYPE> sent;
+    Mavlink_decoder decoder;
+    decoder.Register_handler(Mavlink_decoder::Make_decoder_handler(
+        [&sent](Io_buffer::Ptr, mavlink::MESSAGE_ID_TYPE message_id, Mavlink_demuxer::System_id,
+                uint8_t, uint32_t)
+        {
+            sent.push_back(message_id);
+        }));
+    decoder.Decode(Io_buffer::Create(std::move(data)));
+    decoder.Disable();
+    return sent;
+}
+
+} /* anonymous namespace */
+
+TEST(mavlink_send_scheduler)
+{
+    auto clock = Virtual_clock::Create();
+    Clock::Set_current(clock);
+    Timer_processor::Get_instance()->Enable();
+    auto fp = File_processor::Create();
+    fp->Enable();
+    auto ctx = Request_completion_context::Create("UT send scheduler completion");
+    ctx->Enable();
+    auto worker = Request_worker::Create("UT send scheduler worker",
+        std::initializer_list<Request_container::Ptr>{ctx});
+    worker->Enable();
+
+    auto file1 = fp->Open("test_mavlink_send_scheduler1.tmp", "w+");
+    auto file2 = fp->Open("test_mavlink_send_scheduler2.tmp", "w+");
+    auto stream1 = Mavlink_stream::Create(file1);
+    auto stream2 = Mavlink_stream::Create(file2);
+    stream2->Set_mavlink_v2();
+
+    auto scheduler = Mavlink_send_scheduler::Create(ctx);
+    scheduler->Enable();
+
+    auto heartbeat = mavlink::Pld_heartbeat::Create();
+    auto attitude = mavlink::Pld_attitude::Create();
+    auto Heartbeat = [heartbeat]() -> mavlink::Payload_base::Ptr { return heartbeat; };
+    auto Attitude = [attitude]() -> mavlink::Payload_base::Ptr { return attitude; };
+    auto Nothing = []() -> mavlink::Payload_base::Ptr { return nullptr; };
+
+    scheduler->Add(stream1, Make_callback(Heartbeat), 1, 255, 190);
+    scheduler->Add(stream1, Make_callback(Attitude), 10, 255, 190);
+    scheduler->Add(stream2, Make_callback(Heartbeat), 1, 255, 190, std::chrono::milliseconds(500));
+    auto removed = scheduler->Add(stream2, Make_callback(Attitude), 10, 255, 190);
+    scheduler->Add(stream2, Make_callback(Nothing), 50, 255, 190);
+    scheduler->Remove(removed);
+    CHECK_THROW(scheduler->Add(stream1, Make_callback(Nothing), 0, 255, 190), Invalid_param_exception);
+
+    for (uint64_t i = 1; i <= 100; i++) {
+        clock->Advance(Mavlink_send_scheduler::DEFAULT_TICK);
+        CHECK(Wait_for([&]() { return scheduler->Get_stats().ticks == i; }));
+    }
+    auto stats = scheduler->Get_stats();
+    /* Ten attitudes and two heartbeats, heartbeat and attitude of the
+     * first stream are coalesced at the end of the second.
+     */
+    CHECK_EQUAL(12u, stats.sent);
+    CHECK_EQUAL(11u, stats.writes);
+    CHECK_EQUAL(0u, stats.missed);
+    CHECK_EQUAL(0, stats.max_jitter.count());
+
+    /* Late tick. */
+    scheduler->Remove_stream(stream2);
+    clock->Advance(std::chrono::milliseconds(250));
+    CHECK(Wait_for([&]() { return scheduler->Get_stats().sent == 13; }));
+    stats = scheduler->Get_stats();
+    CHECK_EQUAL(1u, stats.missed);
+    CHECK_EQUAL(150000, stats.max_jitter.count());
+    CHECK_EQUAL(150000 / 13, stats.Get_mean_jitter().count());
+
+    scheduler->Disable();
+    /* Wait until the last write reaches the file. */
+    CHECK(Wait_for([&]() { return Read_sent("test_mavlink_send_scheduler1.tmp").size() == 12; }));
+    file1->Close().Wait();
+    file2->Close().Wait();
+    stream1->Disable();
+    stream2->Disable();
+
+    std::vector<mavlink::MESSAGE_ID_TYPE> expected1(9, mavlink::MESSAGE_ID::ATTITUDE);
+    expected1.push_back(mavlink::MESSAGE_ID::HEARTBEAT);
+    expected1.push_back(mavlink::MESSAGE_ID::ATTITUDE);
+    expected1.push_back(mavlink::MESSAGE_ID::ATTITUDE);
+    auto sent1 = Read_sent("test_mavlink_send_scheduler1.tmp");
+    CHECK(expected1 == sent1);
+    auto sent2 = Read_sent("test_mavlink_send_scheduler2.tmp");
+    CHECK_EQUAL(1u, sent2.size());
+
+    worker->Disable();
+    ctx->Disable();
+    fp->Disable();
+    Timer_processor::Get_instance()->Disable();
+    Clock::Set_current(nullptr);
+}
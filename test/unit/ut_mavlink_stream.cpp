@@ -5,8 +5,31 @@
 #include <UnitTest++.h>
 #include <ugcs/vsm/vsm.h>
 
+#include <atomic>
+
 using namespace ugcs::vsm;
 
+namespace {
+
+/** Run the handler in the processor and wait until it is done. */
+template <class Handler>
+void
+Submit_and_wait(Request_container::Ptr container, Handler handler)
+{
+    auto request = Request::Create();
+    request->Set_processing_handler(Make_callback(
+        [handler](Request::Ptr request)
+        {
+            handler();
+            request->Complete();
+        },
+        request));
+    container->Submit_request(request);
+    request->Wait_done(false);
+}
+
+} /* anonymous namespace */
+
 void
 On_heartbeat(mavlink::Message<mavlink::MESSAGE_ID::HEARTBEAT>::Ptr,
         Mavlink_stream::Ptr mav_stream)
@@ -39,3 +62,78 @@ TEST(disable_in_handler)
     stream->Close();
     fp->Disable();
 }
+
+TEST(decode_offload)
+{
+    auto pool = Request_worker::Create("UT decode pool", 2);
+    pool->Enable();
+    auto processor = Request_processor::Create("UT handlers");
+    processor->Enable();
+    auto worker = Request_worker::Create("UT handlers worker",
+        std::initializer_list<Request_container::Ptr>{processor});
+    worker->Enable();
+
+    constexpr int STREAMS = 3;
+    constexpr int MESSAGES = 200;
+    std::vector<Mavlink_stream::Ptr> streams;
+    std::vector<std::vector<uint32_t>> received(STREAMS);
+    std::atomic_int handled(0);
+    std::atomic_int wrong_thread(0);
+    std::thread::id handler_thread;
+    Submit_and_wait(processor, [&]() { handler_thread = std::this_thread::get_id(); });
+
+    for (int i = 0; i < STREAMS; i++) {
+        auto stream = Mavlink_stream::Create(nullptr);
+        stream->Bind_decoder_demuxer();
+        stream->Enable_decode_offload(pool, processor);
+        auto &result = received[i];
+        /* Handler without own processor goes to the default one. */
+        stream->Get_demuxer().Register_handler<mavlink::MESSAGE_ID::HEARTBEAT, mavlink::Extension>(
+            Mavlink_demuxer::Make_handler<mavlink::MESSAGE_ID::HEARTBEAT, mavlink::Extension>(
+                [&](mavlink::Message<mavlink::MESSAGE_ID::HEARTBEAT>::Ptr message)
+                {
+                    if (std::this_thread::get_id() != handler_thread) {
+                        wrong_thread++;
+                    }
+                    result.push_back(message->payload->custom_mode);
+                    handled++;
+                }));
+        streams.push_back(stream);
+    }
+
+    /* Data of all streams are interleaved, several messages per buffer. */
+    Mavlink_encoder encoder;
+    for (int n = 0; n < MESSAGES; n += 10) {
+        for (int i = 0; i < STREAMS; i++) {
+            Io_buffer::Ptr buffer = Io_buffer::Create();
+            for (int k = n; k < n + 10; k++) {
+                mavlink::Pld_heartbeat hb;
+                hb->custom_mode = k;
+                buffer = buffer->Concatenate(encoder.Encode_v2(hb, i + 1, 1));
+            }
+            streams[i]->Decode(buffer);
+        }
+    }
+
+    for (int i = 0; i < 500 && handled < STREAMS * MESSAGES; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK_EQUAL(STREAMS * MESSAGES, handled);
+    CHECK_EQUAL(0, wrong_thread);
+    for (auto &result : received) {
+        CHECK_EQUAL(MESSAGES, static_cast<int>(result.size()));
+        for (int n = 0; n < static_cast<int>(result.size()); n++) {
+            if (result[n] != static_cast<uint32_t>(n)) {
+                CHECK_EQUAL(static_cast<uint32_t>(n), result[n]);
+                break;
+            }
+        }
+    }
+
+    for (auto &stream : streams) {
+        stream->Disable();
+    }
+    worker->Disable();
+    processor->Disable();
+    pool->Disable();
+}
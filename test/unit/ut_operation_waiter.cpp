@@ -12,22 +12,29 @@
 #include <ugcs/vsm/request_worker.h>
 #include <ugcs/vsm/param_setter.h>
 
+#include <algorithm>
 #include <thread>
+#include <vector>
 
 #include <UnitTest++.h>
 
 using namespace ugcs::vsm;
 
-class Fixture {
+/* SDK driven by a virtual clock, installed before any timers are created. */
+class Virtual_time_fixture {
 public:
-    Fixture()
+    Virtual_clock::Ptr clock = Virtual_clock::Create();
+
+    Virtual_time_fixture()
     {
+        Clock::Set_current(clock);
         Initialize("vsm.conf");
     }
 
-    ~Fixture()
+    ~Virtual_time_fixture()
     {
         Terminate();
+        Clock::Set_current(nullptr);
     }
 };
 
@@ -272,6 +279,173 @@ TEST(worker)
     proc->Disable();
 }
 
+/* Container with a long queue does not delay other containers of the worker. */
+TEST(worker_fairness)
+{
+    auto busy = Request_processor::Create("UT busy processor");
+    auto idle = Request_processor::Create("UT idle processor");
+    busy->Enable();
+    idle->Enable();
+    Request_worker::Ptr worker = Request_worker::Create("UT fairness worker",
+        std::initializer_list<Request_container::Ptr>{busy, idle});
+
+    std::vector<int> order;
+    auto Submit = [&order](Request_container::Ptr container, int id) {
+        auto request = Request::Create();
+        request->Set_processing_handler(Make_callback(
+            [&order, id](Request::Ptr request) {
+                order.push_back(id);
+                request->Complete();
+            },
+            request));
+        container->Submit_request(request);
+        return request;
+    };
+    constexpr int BUSY_REQUESTS = 200;
+    Request::Ptr last;
+    for (int i = 0; i < BUSY_REQUESTS; i++) {
+        last = Submit(busy, i);
+    }
+    auto idle_request = Submit(idle, -1);
+
+    worker->Enable();
+    last->Wait_done(false);
+    idle_request->Wait_done(false);
+
+    CHECK_EQUAL(BUSY_REQUESTS + 1, static_cast<int>(order.size()));
+    auto pos = std::find(order.begin(), order.end(), -1) - order.begin();
+    CHECK(pos < BUSY_REQUESTS / 2);
+
+    worker->Disable();
+    busy->Disable();
+    idle->Disable();
+}
+
+/* Requests are served by priority, lower lanes are not starved. */
+TEST(request_priority)
+{
+    auto proc = Request_processor::Create("UT priority processor");
+    proc->Enable();
+    Request_worker::Ptr worker = Request_worker::Create("UT priority worker",
+        std::initializer_list<Request_container::Ptr>{proc});
+
+    std::vector<int> order;
+    auto Submit = [&](Request::Priority priority, int id) {
+        auto request = Request::Create();
+        request->Set_priority(priority);
+        request->Set_processing_handler(Make_callback(
+            [&order, id](Request::Ptr request) {
+                order.push_back(id);
+                request->Complete();
+            },
+            request));
+        proc->Submit_request(request);
+        return request;
+    };
+    Submit(Request::Priority::LOW, 3);
+    Submit(Request::Priority::NORMAL, 2);
+    Submit(Request::Priority::HIGH, 1);
+    Submit(Request::Priority::NORMAL, 22);
+    constexpr int HIGH_REQUESTS = 100;
+    Request::Ptr last;
+    for (int i = 0; i < HIGH_REQUESTS; i++) {
+        last = Submit(Request::Priority::HIGH, 100);
+    }
+    CHECK_EQUAL(HIGH_REQUESTS + 1, static_cast<int>(proc->Get_lane_stats(Request::Priority::HIGH).queued));
+
+    worker->Enable();
+    last->Wait_done(false);
+    for (int i = 0; i < 100 && order.size() < HIGH_REQUESTS + 4; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK_EQUAL(HIGH_REQUESTS + 4, static_cast<int>(order.size()));
+    CHECK_EQUAL(1, order[0]);
+    /* Same lane is served in submission order, after starvation limit. */
+    auto pos2 = std::find(order.begin(), order.end(), 2) - order.begin();
+    auto pos22 = std::find(order.begin(), order.end(), 22) - order.begin();
+    auto pos3 = std::find(order.begin(), order.end(), 3) - order.begin();
+    CHECK(pos2 < pos22);
+    CHECK(pos2 <= static_cast<int>(Request_container::Request_queue::STARVATION_LIMIT) + 1);
+    CHECK(pos22 < HIGH_REQUESTS);
+    CHECK(pos3 < HIGH_REQUESTS);
+
+    auto stats = proc->Get_lane_stats(Request::Priority::HIGH);
+    CHECK_EQUAL(0U, stats.queued);
+    CHECK_EQUAL(static_cast<uint64_t>(HIGH_REQUESTS + 1), stats.processed);
+    CHECK(stats.max_latency >= stats.total_latency / (HIGH_REQUESTS + 1));
+    CHECK_EQUAL(2U, proc->Get_lane_stats(Request::Priority::NORMAL).processed);
+
+    worker->Disable();
+    proc->Disable();
+}
+
+/* Overflow policies of a bounded queue. */
+TEST(request_queue_capacity)
+{
+    auto proc = Request_processor::Create("UT capacity processor");
+    proc->Enable();
+    Request_worker::Ptr worker = Request_worker::Create("UT capacity worker",
+        std::initializer_list<Request_container::Ptr>{proc});
+
+    std::vector<int> order;
+    auto Submit = [&](int id, bool droppable,
+                      Request::Priority priority = Request::Priority::NORMAL) {
+        auto request = Request::Create();
+        request->Set_priority(priority);
+        request->Set_droppable(droppable);
+        request->Set_processing_handler(Make_callback(
+            [&order, id](Request::Ptr request) {
+                order.push_back(id);
+                request->Complete();
+            },
+            request));
+        proc->Submit_request(request);
+        return request;
+    };
+
+    proc->Set_capacity(3, Request_container::Overflow_policy::REJECT);
+    Submit(1, false);
+    Submit(2, true);
+    auto oldest_droppable = Submit(3, true);
+    auto rejected = Request::Create();
+    rejected->Set_processing_handler(Make_callback([](){}));
+    CHECK_THROW(proc->Submit_request(rejected), Request_container::Overflow_exception);
+    rejected->Abort();
+    /* High priority is always accepted. */
+    Submit(5, false, Request::Priority::HIGH);
+
+    proc->Set_capacity(4, Request_container::Overflow_policy::DROP_OLDEST);
+    /* Request 2 is dropped. */
+    Submit(6, false);
+    auto droppable = Submit(7, true);
+    CHECK(oldest_droppable->Is_aborted());
+    CHECK(!droppable->Is_aborted());
+    auto stats = proc->Get_overload_stats();
+    CHECK_EQUAL(4U, stats.depth);
+    CHECK_EQUAL(4U, stats.max_depth);
+    CHECK_EQUAL(1U, stats.rejected);
+    CHECK_EQUAL(2U, stats.dropped);
+    CHECK_EQUAL(1U, stats.overload_events);
+
+    proc->Set_capacity(4, Request_container::Overflow_policy::BLOCK);
+    Request::Ptr blocked;
+    std::thread submitter([&]() { blocked = Submit(8, false); });
+    for (int i = 0; i < 100 && !proc->Get_overload_stats().blocked; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK_EQUAL(1U, proc->Get_overload_stats().blocked);
+    worker->Enable();
+    submitter.join();
+    blocked->Wait_done(false);
+
+    std::vector<int> expected = {5, 1, 6, 7, 8};
+    CHECK(expected == order);
+    CHECK_EQUAL(0U, proc->Get_overload_stats().depth);
+
+    worker->Disable();
+    proc->Disable();
+}
+
 TEST(wait_timeout)
 {
     Some_processor::Ptr proc = Some_processor::Create();
@@ -299,7 +473,7 @@ TEST(wait_timeout)
     proc->Disable();
 }
 
-TEST_FIXTURE(Fixture, timeout)
+TEST_FIXTURE(Virtual_time_fixture, timeout)
 {
     Some_processor::Ptr proc = Some_processor::Create();
     proc->Enable();
@@ -320,23 +494,29 @@ TEST_FIXTURE(Fixture, timeout)
             waiter->Cancel();
         };
 
+    /* The processing timer is created asynchronously. Requests are processed
+     * in order, so it exists once the next request is done. The virtual time
+     * does not move meanwhile, so both timers start at the same time.
+     */
+    auto sync = [&proc]()
+        {
+            int dummy;
+            proc->Some_method(0, Make_setter(dummy)).Wait();
+        };
+    /* Real time limit of the waits only prevents the test from hanging. */
+    constexpr auto LIMIT = std::chrono::seconds(5);
 
     /* Without handling, just canceling. */
     test_param = 0;
     auto waiter = proc->Some_long_method(20, std::chrono::milliseconds(1000),
                                          Make_some_callback(handler), worker);
     waiter.Timeout(std::chrono::milliseconds(500));
-    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    sync();
+    clock->Advance(std::chrono::milliseconds(300));
     CHECK_EQUAL(false, waiter.Is_done());
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    CHECK_EQUAL(true, waiter.Is_done());
+    clock->Advance(std::chrono::milliseconds(500));
+    CHECK_EQUAL(true, waiter.Wait(false, LIMIT));
     CHECK_EQUAL(0, test_param);
-    if (!waiter.Is_done()) {
-        /* Diagnostic. Try to wait even more. */
-        LOG_INFO("Waiting more... (1)");
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-        CHECK_EQUAL(true, waiter.Is_done());
-    }
 
 
     /* Handle timeout. */
@@ -344,19 +524,13 @@ TEST_FIXTURE(Fixture, timeout)
                                     Make_some_callback(handler), worker);
     waiter.Timeout(std::chrono::milliseconds(500),
                    Make_timeout_callback(timeout_handler), false);
-    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    sync();
+    clock->Advance(std::chrono::milliseconds(300));
     CHECK_EQUAL(false, waiter.Is_done());
     CHECK_EQUAL(false, timeout_called);
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    CHECK_EQUAL(true, waiter.Is_done());
+    clock->Advance(std::chrono::milliseconds(500));
+    CHECK_EQUAL(true, waiter.Wait(false, LIMIT));
     CHECK_EQUAL(true, timeout_called);
-    if (!waiter.Is_done()) {
-        /* Diagnostics. Try to wait even more. */
-        LOG_INFO("Waiting more... (2)");
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-        CHECK_EQUAL(true, waiter.Is_done());
-        CHECK_EQUAL(true, timeout_called);
-    }
     CHECK_EQUAL(0, test_param);
 
 
@@ -366,10 +540,11 @@ TEST_FIXTURE(Fixture, timeout)
                                     Make_some_callback(handler), worker);
     waiter.Timeout(std::chrono::milliseconds(1000),
                    Make_timeout_callback(timeout_handler), false);
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    sync();
+    clock->Advance(std::chrono::milliseconds(100));
     CHECK_EQUAL(false, waiter.Is_done());
-    std::this_thread::sleep_for(std::chrono::milliseconds(700));
-    CHECK_EQUAL(true, waiter.Is_done());
+    clock->Advance(std::chrono::milliseconds(700));
+    CHECK_EQUAL(true, waiter.Wait(false, LIMIT));
     CHECK_EQUAL(false, timeout_called);
     CHECK_EQUAL(20, test_param);
 
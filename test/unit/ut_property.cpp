@@ -0,0 +1,244 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Tests for Property telemetry commit policies and history.
+ */
+
+#include <ugcs/vsm/property.h>
+#include <ugcs/vsm/device.h>
+#include <ugcs/vsm/clock.h>
+
+#include <cmath>
+
+#include <UnitTest++.h>
+
+using namespace ugcs::vsm;
+
+namespace {
+
+class Test_case_wrapper
+{
+public:
+    Test_case_wrapper()
+    {
+        clock = Virtual_clock::Create();
+        Clock::Set_current(clock);
+        field = Property::Create(1, "altitude_raw", proto::FIELD_SEMANTIC_ALTITUDE_RAW);
+    }
+
+    ~Test_case_wrapper()
+    {
+        Clock::Set_current(nullptr);
+    }
+
+    void
+    Commit()
+    {
+        proto::Telemetry_field tf;
+        field->Write_as_telemetry(&tf);
+    }
+
+    Virtual_clock::Ptr clock;
+    Property::Ptr field;
+};
+
+} /* anonymous namespace */
+
+TEST_FIXTURE(Test_case_wrapper, property_commit_default)
+{
+    field->Set_value(1.0);
+    CHECK(!field->Is_changed());
+    clock->Advance(Property::COMMIT_TIMEOUT);
+    CHECK(field->Is_changed());
+    Commit();
+    field->Set_value(2.0);
+    CHECK(!field->Is_changed());
+    clock->Advance(Property::COMMIT_TIMEOUT);
+    CHECK(field->Is_changed());
+    Commit();
+    /* Not changed, no heartbeat by default. */
+    clock->Advance(std::chrono::seconds(10));
+    CHECK(!field->Is_changed());
+}
+
+TEST_FIXTURE(Test_case_wrapper, property_commit_policy)
+{
+    Property::Commit_policy policy;
+    policy.min_interval = std::chrono::seconds(1);
+    policy.deadband = 0.5;
+    policy.heartbeat = std::chrono::seconds(5);
+
+    /* N/A value is not sent by heartbeat. */
+    clock->Advance(std::chrono::seconds(5));
+    CHECK(!field->Is_changed(policy));
+
+    field->Set_value(10.0);
+    CHECK(field->Is_changed(policy));
+    Commit();
+
+    /* Rate limit. */
+    field->Set_value(20.0);
+    clock->Advance(std::chrono::milliseconds(999));
+    CHECK(!field->Is_changed(policy));
+    clock->Advance(std::chrono::milliseconds(1));
+    CHECK(field->Is_changed(policy));
+    Commit();
+
+    /* Deadband. */
+    field->Set_value(20.4);
+    clock->Advance(std::chrono::seconds(1));
+    CHECK(!field->Is_changed(policy));
+    field->Set_value(19.5);
+    CHECK(field->Is_changed(policy));
+    Commit();
+
+    /* N/A is always sent. */
+    field->Set_value_na();
+    clock->Advance(std::chrono::seconds(1));
+    CHECK(field->Is_changed(policy));
+    Commit();
+    field->Set_value(19.5);
+    clock->Advance(std::chrono::seconds(1));
+    CHECK(field->Is_changed(policy));
+    Commit();
+
+    /* Heartbeat. */
+    clock->Advance(std::chrono::milliseconds(4999));
+    CHECK(!field->Is_changed(policy));
+    clock->Advance(std::chrono::milliseconds(1));
+    CHECK(field->Is_changed(policy));
+    Commit();
+
+    /* Scaled interval. */
+    policy.deadband = 0;
+    field->Set_value(30.0);
+    clock->Advance(std::chrono::seconds(1));
+    CHECK(field->Is_changed(policy));
+    CHECK(!field->Is_changed(policy, 2));
+    clock->Advance(std::chrono::seconds(1));
+    CHECK(field->Is_changed(policy, 2));
+    Commit();
+
+    /* Zero interval stays unlimited. */
+    policy.min_interval = std::chrono::milliseconds(0);
+    field->Set_value(31.0);
+    CHECK(field->Is_changed(policy, 2));
+}
+
+/* Expired value is reported as N/A instead of being resent by heartbeat. */
+TEST_FIXTURE(Test_case_wrapper, property_heartbeat_timeout)
+{
+    Property::Commit_policy policy;
+    policy.heartbeat = std::chrono::seconds(1);
+    field->Set_timeout(1);
+    field->Set_value(1.0);
+    clock->Advance(Property::COMMIT_TIMEOUT);
+    CHECK(field->Is_changed(policy));
+    Commit();
+
+    clock->Advance(std::chrono::seconds(1));
+    CHECK(field->Is_changed(policy));
+    CHECK(field->Is_value_na());
+    Commit();
+    clock->Advance(std::chrono::seconds(5));
+    CHECK(!field->Is_changed(policy));
+}
+
+TEST_FIXTURE(Test_case_wrapper, property_timeout)
+{
+    field->Set_timeout(2);
+    field->Set_value(1.0);
+    clock->Advance(Property::COMMIT_TIMEOUT);
+    CHECK(field->Is_changed());
+    Commit();
+
+    /* Value is still valid. */
+    clock->Advance(std::chrono::seconds(2) - Property::COMMIT_TIMEOUT);
+    CHECK(!field->Is_changed());
+    CHECK(!field->Is_value_na());
+
+    /* Expired value is reported once as N/A. */
+    clock->Advance(std::chrono::milliseconds(1));
+    CHECK(field->Is_changed());
+    CHECK(field->Is_value_na());
+    Commit();
+    clock->Advance(std::chrono::seconds(10));
+    CHECK(!field->Is_changed());
+
+    /* New value restarts the timeout. */
+    field->Set_value(2.0);
+    clock->Advance(std::chrono::seconds(2));
+    CHECK(field->Is_changed());
+    Commit();
+    CHECK(!field->Is_value_na());
+    clock->Advance(std::chrono::milliseconds(1));
+    CHECK(field->Is_changed());
+    CHECK(field->Is_value_na());
+}
+
+TEST(property_link_budget_scale)
+{
+    CHECK_EQUAL(1.0, Device::Get_link_budget_scale(1000, 0));
+    CHECK_EQUAL(1.0, Device::Get_link_budget_scale(0, 1000));
+    CHECK_CLOSE(1 + (Device::LINK_BUDGET_MAX_SCALE - 1) / 2,
+                Device::Get_link_budget_scale(500, 1000), 1e-9);
+    CHECK_EQUAL(Device::LINK_BUDGET_MAX_SCALE, Device::Get_link_budget_scale(1000, 1000));
+    CHECK_EQUAL(Device::LINK_BUDGET_MAX_SCALE, Device::Get_link_budget_scale(5000, 1000));
+}
+
+TEST_FIXTURE(Test_case_wrapper, property_history)
+{
+    CHECK(!field->Get_history());
+    field->Enable_history(4);
+    auto history = field->Get_history();
+    auto start = clock->Get_time();
+
+    /* Values are recorded with receive time, N/A as NaN. */
+    field->Set_value(1.0);
+    clock->Advance(std::chrono::seconds(1));
+    field->Set_value_na();
+    clock->Advance(std::chrono::seconds(1));
+    field->Set_value(3.0);
+    field->Set_value(5.0, start + std::chrono::milliseconds(2500));
+    CHECK_EQUAL(4u, history->Get_size());
+    CHECK(std::isnan(history->Get_sample(1).value));
+    CHECK(history->Get_sample(3).time == start + std::chrono::milliseconds(2500));
+
+    auto stats = history->Get_stats(start);
+    CHECK_EQUAL(3u, stats.count);
+    CHECK_EQUAL(1.0, stats.min);
+    CHECK_EQUAL(5.0, stats.max);
+    CHECK_EQUAL(3.0, stats.mean);
+
+    /* Oldest samples are overwritten. */
+    clock->Advance(std::chrono::seconds(1));
+    field->Set_value(7.0);
+    field->Set_value(9.0);
+    CHECK_EQUAL(4u, history->Get_size());
+    CHECK_EQUAL(3.0, history->Get_sample(0).value);
+    CHECK_EQUAL(9.0, history->Get_sample(3).value);
+
+    /* Window is counted back from now. */
+    stats = history->Get_stats(std::chrono::milliseconds(400));
+    CHECK_EQUAL(2u, stats.count);
+    CHECK_EQUAL(8.0, stats.mean);
+    stats = history->Get_stats(start + std::chrono::seconds(10));
+    CHECK_EQUAL(0u, stats.count);
+    CHECK(std::isnan(stats.mean));
+
+    auto samples = history->Downsample(start, start + std::chrono::seconds(4), std::chrono::seconds(1));
+    CHECK_EQUAL(2u, samples.size());
+    CHECK(samples[0].time == start + std::chrono::seconds(2));
+    CHECK_EQUAL(4.0, samples[0].value);
+    CHECK_EQUAL(8.0, samples[1].value);
+    CHECK_THROW(history->Downsample(start, start, Clock::Duration::zero()), Invalid_param_exception);
+
+    /* Copy does not share the history. */
+    auto copy = Property::Create(field);
+    CHECK(!copy->Get_history());
+
+    field->Enable_history(0);
+    CHECK(!field->Get_history());
+}
@@ -0,0 +1,128 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Tests for Request_strand class.
+ */
+
+#include <ugcs/vsm/request_strand.h>
+#include <ugcs/vsm/request_worker.h>
+
+#include <atomic>
+#include <vector>
+
+#include <UnitTest++.h>
+
+using namespace ugcs::vsm;
+
+namespace {
+
+/** Submit request which runs the handler to the container. */
+template <class Handler>
+Request::Ptr
+Submit(Request_container::Ptr container, Handler handler)
+{
+    auto request = Request::Create();
+    request->Set_processing_handler(Make_callback(
+        [handler](Request::Ptr request)
+        {
+            handler();
+            request->Complete();
+        },
+        request));
+    container->Submit_request(request);
+    return request;
+}
+
+} /* anonymous namespace */
+
+TEST(strand_ordering)
+{
+    auto pool = Request_worker::Create("UT strand pool", 4);
+    pool->Enable();
+
+    constexpr int STRANDS = 16;
+    constexpr int REQUESTS = 500;
+    std::vector<Request_strand::Ptr> strands;
+    std::vector<std::vector<int>> results(STRANDS);
+    std::vector<std::atomic_int> active(STRANDS);
+    std::atomic_int violations(0);
+    for (int i = 0; i < STRANDS; i++) {
+        strands.push_back(Request_strand::Create("UT strand", pool));
+        strands.back()->Enable();
+        active[i] = 0;
+    }
+
+    std::vector<Request::Ptr> requests;
+    for (int n = 0; n < REQUESTS; n++) {
+        for (int i = 0; i < STRANDS; i++) {
+            requests.push_back(Submit(strands[i], [&, i, n]()
+            {
+                if (active[i]++) {
+                    violations++;
+                }
+                results[i].push_back(n);
+                std::this_thread::yield();
+                active[i]--;
+            }));
+        }
+    }
+    for (auto &request : requests) {
+        request->Wait_done(false);
+    }
+
+    CHECK_EQUAL(0, violations);
+    for (auto &result : results) {
+        CHECK_EQUAL(REQUESTS, static_cast<int>(result.size()));
+        for (int n = 0; n < static_cast<int>(result.size()); n++) {
+            if (result[n] != n) {
+                CHECK_EQUAL(n, result[n]);
+                break;
+            }
+        }
+    }
+
+    for (auto &strand : strands) {
+        strand->Disable();
+    }
+    pool->Disable();
+}
+
+TEST(strand_as_completion_context)
+{
+    auto pool = Request_worker::Create("UT strand pool", 2);
+    pool->Enable();
+    auto processor = Request_strand::Create("UT strand processor", pool);
+    auto completion_ctx = Request_strand::Create("UT strand completion", pool);
+    processor->Enable();
+    completion_ctx->Enable();
+
+    std::atomic_int completed(0);
+    auto request = Request::Create();
+    request->Set_processing_handler(Make_callback(
+        [](Request::Ptr request) { request->Complete(); }, request));
+    request->Set_completion_handler(completion_ctx, Make_callback(
+        [&]() { completed++; }));
+    processor->Submit_request(request);
+    request->Wait_done(false);
+    CHECK_EQUAL(1, completed);
+
+    processor->Disable();
+    completion_ctx->Disable();
+    pool->Disable();
+}
+
+TEST(strand_disable_from_handler)
+{
+    auto pool = Request_worker::Create("UT strand pool", 2);
+    pool->Enable();
+    auto strand = Request_strand::Create("UT strand", pool);
+    strand->Enable();
+
+    auto request = Submit(strand, [&]() { strand->Disable(); });
+    request->Wait_done(false);
+    CHECK_EQUAL(false, strand->Is_enabled());
+
+    pool->Disable();
+}
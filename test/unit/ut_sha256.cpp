@@ -0,0 +1,74 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Tests for Sha256 class.
+ */
+
+#include <ugcs/vsm/sha256.h>
+
+#include <algorithm>
+#include <string>
+
+#include <UnitTest++.h>
+
+using namespace ugcs::vsm;
+
+namespace {
+
+std::string
+To_hex(const Sha256::Digest &digest)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string result;
+    for (auto b : digest) {
+        result += digits[b >> 4];
+        result += digits[b & 0xf];
+    }
+    return result;
+}
+
+std::string
+Hash(const std::string &data, bool accelerated, size_t part_len = 0)
+{
+    Sha256 sha(accelerated);
+    if (part_len) {
+        for (size_t pos = 0; pos < data.size(); pos += part_len) {
+            sha.Update(data.data() + pos, std::min(part_len, data.size() - pos));
+        }
+    } else {
+        sha.Update(data.data(), data.size());
+    }
+    return To_hex(sha.Final());
+}
+
+} /* anonymous namespace */
+
+TEST(sha256_vectors)
+{
+    for (bool accelerated : {false, true}) {
+        CHECK_EQUAL("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+                    Hash("", accelerated));
+        CHECK_EQUAL("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+                    Hash("abc", accelerated));
+        CHECK_EQUAL("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1",
+                    Hash("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", accelerated));
+        CHECK_EQUAL("cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0",
+                    Hash(std::string(1000000, 'a'), accelerated));
+    }
+}
+
+TEST(sha256_parts)
+{
+    std::string data;
+    for (int i = 0; i < 1000; i++) {
+        data += static_cast<char>(i * 7);
+    }
+    auto expected = Hash(data, false);
+    for (size_t part_len : {1, 3, 63, 64, 65, 200}) {
+        CHECK_EQUAL(expected, Hash(data, false, part_len));
+        CHECK_EQUAL(expected, Hash(data, true, part_len));
+    }
+    CHECK_EQUAL(expected, To_hex(Sha256::Calculate(data.data(), data.size())));
+}
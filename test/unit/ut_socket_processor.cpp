@@ -9,7 +9,11 @@
 #include <ugcs/vsm/callback.h>
 #include <ugcs/vsm/debug.h>
 
+#include <atomic>
+#include <cstring>
 #include <iostream>
+#include <mutex>
+#include <thread>
 
 #include <UnitTest++.h>
 
@@ -234,6 +238,312 @@ TEST_FIXTURE(Test_case_wrapper, socket_processor_listen_accept)
     worker->Disable();
 }
 
+/* Many queued writes, including partially written ones, arrive intact. */
+TEST_FIXTURE(Test_case_wrapper, socket_processor_gather_write)
+{
+    Socket_processor::Ptr sp = ugcs::vsm::Socket_processor::Get_instance();
+    Request_worker::Ptr worker = Request_worker::Create("UT gather write worker");
+    worker->Enable();
+
+    Socket_processor::Socket_listener::Ref listener;
+    Socket_processor::Stream::Ref client_stream;
+    Socket_processor::Stream::Ref server_stream;
+    sp->Listen("127.0.0.1", "12346",
+            Make_socket_listen_callback([&](Socket_processor::Stream::Ref l, Io_result){
+                listener = l;
+            }));
+    auto accept_op = sp->Accept(listener,
+            Make_socket_accept_callback([&](Socket_processor::Stream::Ref s, Io_result){
+                server_stream = s;
+            }), worker);
+    sp->Connect("127.0.0.1", "12346",
+            Make_socket_connect_callback([&](Socket_processor::Stream::Ref s, Io_result){
+                client_stream = s;
+            }));
+    accept_op.Wait(false);
+    CHECK(client_stream && server_stream);
+
+    /* Small chunks interleaved with big ones which overflow socket buffer. */
+    std::string expected;
+    std::atomic_int completed(0);
+    std::atomic_int failed(0);
+    constexpr int WRITES = 400;
+    for (int i = 0; i < WRITES; i++) {
+        std::string data;
+        if (i % 50 == 0) {
+            data.assign(200000, 'a' + (i / 50) % 26);
+        } else {
+            data = std::to_string(i) + ";";
+        }
+        expected += data;
+        client_stream->Write(Io_buffer::Create(data),
+            Make_write_callback([&](Io_result result) {
+                if (result != Io_result::OK) {
+                    failed++;
+                }
+                completed++;
+            }), worker);
+    }
+
+    std::string received;
+    Io_buffer::Ptr buf;
+    Io_result result = Io_result::OK;
+    while (received.size() < expected.size() && result == Io_result::OK) {
+        server_stream->Read(1000000, 1, Make_setter(buf, result)).Timeout(std::chrono::seconds(5));
+        if (result == Io_result::OK) {
+            received += buf->Get_string();
+        }
+    }
+    CHECK(received == expected);
+    for (int i = 0; i < 100 && completed != WRITES; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK_EQUAL(WRITES, completed);
+    CHECK_EQUAL(0, failed);
+
+    client_stream->Close();
+    server_stream->Close();
+    listener->Close();
+    worker->Disable();
+}
+
+/* Subscription delivers all data written to TCP stream and the closure. */
+TEST_FIXTURE(Test_case_wrapper, socket_processor_read_subscription)
+{
+    Socket_processor::Ptr sp = ugcs::vsm::Socket_processor::Get_instance();
+    Request_worker::Ptr worker = Request_worker::Create("UT read subscription worker");
+    worker->Enable();
+
+    Socket_processor::Socket_listener::Ref listener;
+    Socket_processor::Stream::Ref client_stream;
+    Socket_processor::Stream::Ref server_stream;
+    sp->Listen("127.0.0.1", "12347",
+            Make_socket_listen_callback([&](Socket_processor::Stream::Ref l, Io_result){
+                listener = l;
+            }));
+    auto accept_op = sp->Accept(listener,
+            Make_socket_accept_callback([&](Socket_processor::Stream::Ref s, Io_result){
+                server_stream = s;
+            }), worker);
+    sp->Connect("127.0.0.1", "12347",
+            Make_socket_connect_callback([&](Socket_processor::Stream::Ref s, Io_result){
+                client_stream = s;
+            }));
+    accept_op.Wait(false);
+    CHECK(client_stream && server_stream);
+
+    std::mutex mutex;
+    std::string received;
+    std::atomic_int deliveries(0);
+    std::atomic_int final_results(0);
+    std::atomic<Io_result> final_result(Io_result::OK);
+    auto subscription = server_stream->Subscribe(100,
+        Make_read_subscription_callback(
+            [&](std::vector<Io_buffer::Ptr> buffers, Io_result result) {
+                std::unique_lock<std::mutex> lock(mutex);
+                for (auto &buf : buffers) {
+                    CHECK(buf->Get_length() <= 100);
+                    received += buf->Get_string();
+                }
+                deliveries++;
+                if (result != Io_result::OK) {
+                    final_results++;
+                    final_result = result;
+                }
+            }), worker, 4);
+
+    auto Wait_received = [&](size_t size) {
+        for (int i = 0; i < 500; i++) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (received.size() >= size) {
+                    return;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    };
+
+    std::string expected;
+    for (int i = 0; i < 100; i++) {
+        expected += std::to_string(i) + ";";
+        client_stream->Write(Io_buffer::Create(std::to_string(i) + ";"));
+    }
+    Wait_received(expected.size());
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        CHECK(received == expected);
+    }
+
+    /* Nothing is delivered while paused. */
+    subscription->Pause();
+    int paused_deliveries = deliveries;
+    std::string tail(10000, 'x');
+    client_stream->Write(Io_buffer::Create(tail));
+    expected += tail;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    CHECK_EQUAL(paused_deliveries, deliveries);
+    subscription->Resume();
+    Wait_received(expected.size());
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        CHECK(received == expected);
+    }
+
+    /* Peer closure ends the subscription. */
+    client_stream->Close();
+    for (int i = 0; i < 500 && !subscription->Is_ended(); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(subscription->Is_ended());
+    CHECK_EQUAL(1, final_results);
+    CHECK(final_result == Io_result::CLOSED);
+
+    server_stream->Close();
+    listener->Close();
+    worker->Disable();
+}
+
+/* Cancel waits for the delivery which is in progress. */
+TEST_FIXTURE(Test_case_wrapper, socket_processor_read_subscription_cancel)
+{
+    Socket_processor::Ptr sp = ugcs::vsm::Socket_processor::Get_instance();
+    Request_worker::Ptr worker = Request_worker::Create("UT subscription cancel worker");
+    worker->Enable();
+
+    Socket_processor::Socket_listener::Ref listener;
+    Socket_processor::Stream::Ref client_stream;
+    Socket_processor::Stream::Ref server_stream;
+    sp->Listen("127.0.0.1", "12348",
+            Make_socket_listen_callback([&](Socket_processor::Stream::Ref l, Io_result){
+                listener = l;
+            }));
+    auto accept_op = sp->Accept(listener,
+            Make_socket_accept_callback([&](Socket_processor::Stream::Ref s, Io_result){
+                server_stream = s;
+            }), worker);
+    sp->Connect("127.0.0.1", "12348",
+            Make_socket_connect_callback([&](Socket_processor::Stream::Ref s, Io_result){
+                client_stream = s;
+            }));
+    accept_op.Wait(false);
+    CHECK(client_stream && server_stream);
+
+    std::atomic_bool in_handler(false);
+    std::atomic_int deliveries(0);
+    auto subscription = server_stream->Subscribe(0,
+        Make_read_subscription_callback(
+            [&](std::vector<Io_buffer::Ptr>, Io_result) {
+                in_handler = true;
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                deliveries++;
+                in_handler = false;
+            }), worker);
+
+    client_stream->Write(Io_buffer::Create("data"));
+    for (int i = 0; i < 500 && !in_handler; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(in_handler);
+    subscription->Cancel();
+    CHECK(!in_handler);
+    CHECK_EQUAL(1, deliveries);
+    client_stream->Write(Io_buffer::Create("late"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK_EQUAL(1, deliveries);
+
+    client_stream->Close();
+    server_stream->Close();
+    listener->Close();
+    worker->Disable();
+}
+
+/* Each datagram is a separate chunk, cancel stops delivery. */
+TEST_FIXTURE(Test_case_wrapper, socket_processor_udp_read_subscription)
+{
+    Socket_processor::Ptr sp = ugcs::vsm::Socket_processor::Get_instance();
+    Request_worker::Ptr worker = Request_worker::Create("UT UDP read subscription worker");
+    worker->Enable();
+
+    Socket_processor::Stream::Ref client_stream;
+    Socket_processor::Stream::Ref server_stream;
+    auto server_point = Socket_address::Create("127.0.0.1", "32770");
+    sp->Bind_udp(server_point,
+            Make_socket_listen_callback([&](Socket_processor::Stream::Ref l, Io_result){
+                server_stream = l;
+            }));
+    sp->Connect(server_point,
+            Make_socket_listen_callback([&](Socket_processor::Stream::Ref l, Io_result){
+                client_stream = l;
+            }),
+            Request_temp_completion_context::Create(),
+            Io_stream::Type::UDP);
+    CHECK(client_stream && server_stream);
+
+    std::mutex mutex;
+    std::vector<std::string> received;
+    std::atomic_int final_results(0);
+    auto subscription = server_stream->Subscribe(0,
+        Make_read_subscription_callback(
+            [&](std::vector<Io_buffer::Ptr> buffers, Io_result result) {
+                std::unique_lock<std::mutex> lock(mutex);
+                for (auto &buf : buffers) {
+                    received.push_back(buf->Get_string());
+                }
+                if (result != Io_result::OK) {
+                    final_results++;
+                }
+            }), worker);
+
+    constexpr size_t PACKETS = 20;
+    for (size_t i = 0; i < PACKETS; i++) {
+        Io_result result;
+        client_stream->Write(Io_buffer::Create("packet" + std::to_string(i)), Make_setter(result));
+        CHECK(result == Io_result::OK);
+    }
+    for (int i = 0; i < 500; i++) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (received.size() >= PACKETS) {
+                break;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        CHECK_EQUAL(PACKETS, received.size());
+        for (size_t i = 0; i < received.size(); i++) {
+            CHECK_EQUAL("packet" + std::to_string(i), received[i]);
+        }
+    }
+
+    subscription->Cancel();
+    CHECK(subscription->Is_ended());
+    client_stream->Write(Io_buffer::Create("late"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        CHECK_EQUAL(PACKETS, received.size());
+    }
+    CHECK_EQUAL(0, final_results);
+
+    /* Stream can be read by requests again. */
+    Io_buffer::Ptr buf;
+    Io_result result;
+    client_stream->Write(Io_buffer::Create("again"));
+    server_stream->Read(0, 1, Make_setter(buf, result)).Timeout(std::chrono::seconds(1));
+    CHECK(result == Io_result::OK);
+    if (result == Io_result::OK) {
+        CHECK(buf->Get_string() == "late" || buf->Get_string() == "again");
+    }
+
+    client_stream->Close();
+    server_stream->Close();
+    worker->Disable();
+}
+
 /* Overflow write queue until write operations time out, then cancel them all. */
 class Timed_writes
 {
@@ -362,3 +672,79 @@ TEST_FIXTURE(Timed_writes, timed_writes)
     /* No specific checks, it should just work, don't crash, don't assert anywhere. */
 }
 
+
+/* Needs virtual CAN interface, skipped if it is not present:
+ * ip link add dev vcan0 type vcan && ip link set up vcan0
+ */
+TEST_FIXTURE(Test_case_wrapper, socket_processor_can_batched)
+{
+    auto sp = Socket_processor::Get_instance();
+    Socket_processor::Stream::Ref tx_stream;
+    Socket_processor::Stream::Ref rx_stream;
+    Io_result result = Io_result::OTHER_FAILURE;
+
+    sp->Bind_can("vcan0", std::vector<int>(),
+            Make_socket_listen_callback([&](Socket_processor::Stream::Ref s, Io_result res) {
+                tx_stream = s;
+                result = res;
+            }));
+    if (result != Io_result::OK) {
+        std::cout << "vcan0 is not available, CAN test skipped." << std::endl;
+        return;
+    }
+
+    Socket_processor::Can_options options;
+    /* Standard identifiers 0x100-0x1ff. */
+    options.filters.push_back(Socket_processor::Can_filter{0x100, 0x700});
+    options.batched = true;
+    options.timestamps = true;
+    sp->Bind_can("vcan0", options,
+            Make_socket_listen_callback([&](Socket_processor::Stream::Ref s, Io_result res) {
+                rx_stream = s;
+                result = res;
+            }));
+    CHECK(result == Io_result::OK);
+
+    const uint32_t ids[] = {0x100, 0x200, 0x101, 0x300, 0x1ff};
+    for (auto id : ids) {
+        /* struct can_frame: id, dlc, padding, data. */
+        uint8_t frame[16] = {0};
+        memcpy(frame, &id, sizeof(id));
+        frame[4] = 1;
+        frame[8] = static_cast<uint8_t>(id);
+        tx_stream->Write(Io_buffer::Create(frame, sizeof(frame)), Make_setter(result));
+        CHECK(result == Io_result::OK);
+    }
+
+    std::vector<uint32_t> received;
+    for (int attempt = 0; attempt < 10 && received.size() < 3; attempt++) {
+        Io_buffer::Ptr buf;
+        rx_stream->Read(4096, 1, Make_setter(buf, result)).Timeout(std::chrono::milliseconds(500));
+        if (result != Io_result::OK) {
+            break;
+        }
+        auto data = static_cast<const uint8_t *>(buf->Get_data());
+        size_t offset = 0;
+        while (offset + sizeof(Socket_processor::Can_frame_header) <= buf->Get_length()) {
+            Socket_processor::Can_frame_header header;
+            memcpy(&header, data + offset, sizeof(header));
+            offset += sizeof(header);
+            CHECK_EQUAL(16U, header.frame_size);
+            CHECK(header.timestamp != 0);
+            uint32_t id;
+            memcpy(&id, data + offset, sizeof(id));
+            received.push_back(id);
+            offset += header.frame_size;
+        }
+        CHECK_EQUAL(buf->Get_length(), offset);
+    }
+    CHECK_EQUAL(3U, received.size());
+    if (received.size() == 3) {
+        CHECK_EQUAL(0x100U, received[0]);
+        CHECK_EQUAL(0x101U, received[1]);
+        CHECK_EQUAL(0x1ffU, received[2]);
+    }
+
+    tx_stream->Close();
+    rx_stream->Close();
+}
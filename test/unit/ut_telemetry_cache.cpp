@@ -0,0 +1,143 @@
+// Copyright (c) 2018, Smart Projects Holdings Ltd
+// All rights reserved.
+// See LICENSE file for license details.
+
+/*
+ * Tests for Telemetry_cache class.
+ */
+
+#include <ugcs/vsm/telemetry_cache.h>
+
+#include <map>
+
+#include <UnitTest++.h>
+
+using namespace ugcs::vsm;
+
+namespace {
+
+proto::Telemetry_field
+Make_field(uint32_t id, int64_t time)
+{
+    proto::Telemetry_field field;
+    field.set_field_id(id);
+    field.set_ms_since_epoch(time);
+    return field;
+}
+
+std::map<uint32_t, proto::Telemetry_field>
+Get_snapshot(const Telemetry_cache &cache)
+{
+    proto::Device_status status;
+    cache.Fill(status);
+    std::map<uint32_t, proto::Telemetry_field> result;
+    for (auto &f : status.telemetry_fields()) {
+        result[f.field_id()] = f;
+    }
+    return result;
+}
+
+} /* anonymous namespace */
+
+TEST(telemetry_cache_values)
+{
+    Telemetry_cache cache;
+
+    auto f = Make_field(10, 100);
+    f.mutable_value()->set_int_value(-5);
+    cache.Update(f);
+    f = Make_field(12, 101);
+    f.mutable_value()->set_double_value(1.5);
+    cache.Update(f);
+    f = Make_field(11, 102);
+    f.mutable_value()->set_string_value("abc");
+    cache.Update(f);
+    /* Below the first id. */
+    f = Make_field(7, 103);
+    f.mutable_value()->set_bool_value(true);
+    cache.Update(f);
+    f = Make_field(8, 104);
+    auto list = f.mutable_value()->mutable_list_value();
+    list->add_values()->set_float_value(2.5);
+    list->add_values()->set_int_value(3);
+    cache.Update(f);
+    f = Make_field(9, 105);
+    f.mutable_value()->set_meta_value(proto::META_VALUE_NA);
+    cache.Update(f);
+    CHECK_EQUAL(6U, cache.Get_telemetry_count());
+
+    auto snapshot = Get_snapshot(cache);
+    /* N/A value is not sent. */
+    CHECK_EQUAL(5U, snapshot.size());
+    CHECK_EQUAL(-5, snapshot[10].value().int_value());
+    CHECK_EQUAL(100, snapshot[10].ms_since_epoch());
+    CHECK_EQUAL(1.5, snapshot[12].value().double_value());
+    CHECK_EQUAL("abc", snapshot[11].value().string_value());
+    CHECK_EQUAL(true, snapshot[7].value().bool_value());
+    CHECK_EQUAL(2, snapshot[8].value().list_value().values_size());
+    CHECK_EQUAL(2.5f, snapshot[8].value().list_value().values(0).float_value());
+    CHECK(snapshot.find(9) == snapshot.end());
+
+    /* Update overwrites the value. */
+    f = Make_field(10, 200);
+    f.mutable_value()->set_float_value(0.25);
+    cache.Update(f);
+    snapshot = Get_snapshot(cache);
+    CHECK(!snapshot[10].value().has_int_value());
+    CHECK_EQUAL(0.25f, snapshot[10].value().float_value());
+    CHECK_EQUAL(200, snapshot[10].ms_since_epoch());
+}
+
+TEST(telemetry_cache_data_reuse)
+{
+    Telemetry_cache cache;
+
+    auto f = Make_field(3, 100);
+    f.mutable_value()->set_string_value("first");
+    cache.Update(f);
+    /* Grows the array below the first id. */
+    f = Make_field(1, 101);
+    f.mutable_value()->set_bytes_value("bytes");
+    cache.Update(f);
+    /* Scalar in between does not lose the data of the field. */
+    f = Make_field(3, 102);
+    f.mutable_value()->set_int_value(7);
+    cache.Update(f);
+    auto snapshot = Get_snapshot(cache);
+    CHECK_EQUAL(7, snapshot[3].value().int_value());
+    CHECK_EQUAL("bytes", snapshot[1].value().bytes_value());
+
+    f = Make_field(3, 103);
+    f.mutable_value()->set_string_value("second");
+    cache.Update(f);
+    snapshot = Get_snapshot(cache);
+    CHECK_EQUAL("second", snapshot[3].value().string_value());
+    CHECK_EQUAL("bytes", snapshot[1].value().bytes_value());
+}
+
+TEST(telemetry_cache_availability)
+{
+    Telemetry_cache cache;
+    proto::Command_availability c;
+    c.set_id(20);
+    c.set_is_available(true);
+    c.set_is_enabled(false);
+    cache.Update(c);
+    c.Clear();
+    c.set_id(22);
+    c.set_is_enabled(true);
+    cache.Update(c);
+    CHECK_EQUAL(2U, cache.Get_availability_count());
+    CHECK_EQUAL(0U, cache.Get_telemetry_count());
+
+    proto::Device_status status;
+    cache.Fill(status);
+    CHECK_EQUAL(2, status.command_availability_size());
+    CHECK_EQUAL(20U, status.command_availability(0).id());
+    CHECK(status.command_availability(0).is_available());
+    CHECK(status.command_availability(0).has_is_enabled());
+    CHECK(!status.command_availability(0).is_enabled());
+    CHECK_EQUAL(22U, status.command_availability(1).id());
+    CHECK(!status.command_availability(1).has_is_available());
+    CHECK(status.command_availability(1).is_enabled());
+}
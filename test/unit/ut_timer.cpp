@@ -8,6 +8,8 @@
 
 #include <ugcs/vsm/timer_processor.h>
 #include <ugcs/vsm/request_worker.h>
+#include <condition_variable>
+#include <mutex>
 #include <unordered_set>
 #include <vector>
 
@@ -15,14 +17,74 @@
 
 using namespace ugcs::vsm;
 
-TEST(timer_usage)
+namespace {
+
+/** Process requests of the context until the condition becomes true. The
+ * condition is checked after each wake up of the context, the real time
+ * limit only prevents the test from hanging on failure.
+ */
+template <typename Condition>
+bool
+Process_until(Request_completion_context::Ptr ctx, Condition condition)
 {
-    Timer_processor::Ptr timer_proc = Timer_processor::Create();
-    timer_proc->Enable();
+    auto limit = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() >= limit) {
+            return false;
+        }
+        ctx->Get_waiter()->Wait_and_process({ctx}, std::chrono::milliseconds(100));
+    }
+    return true;
+}
 
-    auto worker = Request_worker::Create("UT timer_usage");
-    worker->Enable();
+/** Timer processor driven by a virtual clock. Timer handlers are executed
+ * only when the test processes the context.
+ */
+class Virtual_time {
+public:
+    Virtual_clock::Ptr clock = Virtual_clock::Create();
+    Timer_processor::Ptr timer_proc;
+    Request_completion_context::Ptr ctx =
+        Request_completion_context::Create("UT virtual time");
+
+    Virtual_time()
+    {
+        Clock::Set_current(clock);
+        timer_proc = Timer_processor::Create();
+        timer_proc->Enable();
+        ctx->Enable();
+    }
+
+    ~Virtual_time()
+    {
+        ctx->Disable();
+        timer_proc->Disable();
+        Clock::Set_current(nullptr);
+    }
+
+    /** Advance the clock and process handlers of all timers fired up to the
+     * new time. Timers are fired in order, so a sentinel timer expiring at
+     * the new time is fired after all of them. Periodic timers rescheduled
+     * to the same time can be fired after the sentinel though, so it is
+     * used to check that nothing else fires.
+     */
+    bool
+    Advance(std::chrono::milliseconds duration)
+    {
+        bool done = false;
+        timer_proc->Create_timer(
+            duration,
+            Make_callback([&done]() { done = true; return false; }),
+            ctx);
+        clock->Advance(duration);
+        return Process_until(ctx, [&done]() { return done; });
+    }
+};
+
+} /* anonymous namespace */
 
+TEST_FIXTURE(Virtual_time, timer_usage)
+{
     int count = 3;
     auto handler = [&](int param)
     {
@@ -33,25 +95,22 @@ TEST(timer_usage)
 
     auto timer = timer_proc->Create_timer(std::chrono::milliseconds(100),
                                           Make_callback(handler, 10),
-                                          worker);
-
-    std::this_thread::sleep_for(std::chrono::seconds(1));
+                                          ctx);
 
+    for (int expected = 2; expected >= 0; expected--) {
+        clock->Advance(std::chrono::milliseconds(100));
+        CHECK(Process_until(ctx, [&]() { return count == expected; }));
+    }
     CHECK_EQUAL(false, timer->Is_running());
     CHECK_EQUAL(0, count);
 
-    worker->Disable();
-    timer_proc->Disable();
+    /* Not invoked after the handler stopped it. */
+    CHECK(Advance(std::chrono::seconds(1)));
+    CHECK_EQUAL(0, count);
 }
 
-TEST(timer_cancelation)
+TEST_FIXTURE(Virtual_time, timer_cancelation)
 {
-    Timer_processor::Ptr timer_proc = Timer_processor::Create();
-    timer_proc->Enable();
-
-    auto worker = Request_worker::Create("UT timer_cancelation");
-    worker->Enable();
-
     int count = 0;
     auto handler = [&](int param)
     {
@@ -62,32 +121,23 @@ TEST(timer_cancelation)
 
     auto timer = timer_proc->Create_timer(std::chrono::milliseconds(100),
                                           Make_callback(handler, 10),
-                                          worker);
+                                          ctx);
 
-    std::this_thread::sleep_for(std::chrono::seconds(1));
+    for (int expected = 1; expected <= 10; expected++) {
+        clock->Advance(std::chrono::milliseconds(100));
+        CHECK(Process_until(ctx, [&]() { return count == expected; }));
+    }
     CHECK_EQUAL(true, timer->Is_running());
-    CHECK(count > 5);
+    CHECK_EQUAL(10, count);
     timer->Cancel();
     CHECK_EQUAL(false, timer->Is_running());
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    CHECK(count > 5);
-    int initial_count = count;
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    CHECK(Advance(std::chrono::milliseconds(500)));
     CHECK_EQUAL(false, timer->Is_running());
-    CHECK_EQUAL(initial_count, count);
-
-    worker->Disable();
-    timer_proc->Disable();
+    CHECK_EQUAL(10, count);
 }
 
-TEST(timer_instant_cancelation)
+TEST_FIXTURE(Virtual_time, timer_instant_cancelation)
 {
-    Timer_processor::Ptr timer_proc = Timer_processor::Create();
-    timer_proc->Enable();
-
-    auto worker = Request_worker::Create("UT timer_instant_cancelation");
-    worker->Enable();
-
     int count = 0;
     auto handler = [&]()
     {
@@ -97,44 +147,47 @@ TEST(timer_instant_cancelation)
 
     auto timer = timer_proc->Create_timer(std::chrono::milliseconds(100),
                                           Make_callback(handler),
-                                          worker);
+                                          ctx);
 
     timer->Cancel();
     CHECK_EQUAL(false, timer->Is_running());
-    std::this_thread::sleep_for(std::chrono::seconds(1));
+    CHECK(Advance(std::chrono::seconds(1)));
     CHECK_EQUAL(0, count);
-
-    worker->Disable();
-    timer_proc->Disable();
 }
 
-TEST(worker_usage)
+/* Handlers are executed by a worker thread. */
+TEST_FIXTURE(Virtual_time, worker_usage)
 {
-    Timer_processor::Ptr timer_proc = Timer_processor::Create();
-    timer_proc->Enable();
-
     Request_worker::Ptr worker = Request_worker::Create("UT timer worker_usage");
     worker->Enable();
 
+    std::mutex mutex;
+    std::condition_variable cond;
     int count = 3;
     auto handler = [&](int param)
     {
         CHECK_EQUAL(10, param);
+        std::unique_lock<std::mutex> lock(mutex);
         CHECK(count > 0);
-        return --count != 0;
+        bool running = --count != 0;
+        cond.notify_all();
+        return running;
     };
 
     auto timer = timer_proc->Create_timer(std::chrono::milliseconds(100),
                                           Make_callback(handler, 10),
                                           worker);
 
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-
+    for (int expected = 2; expected >= 0; expected--) {
+        clock->Advance(std::chrono::milliseconds(100));
+        std::unique_lock<std::mutex> lock(mutex);
+        CHECK(cond.wait_for(lock, std::chrono::seconds(5),
+                            [&]() { return count == expected; }));
+    }
+    /* Disabling the worker waits for the handler to return. */
+    worker->Disable();
     CHECK_EQUAL(false, timer->Is_running());
     CHECK_EQUAL(0, count);
-
-    worker->Disable();
-    timer_proc->Disable();
 }
 
 TEST(cancel_timer_before_termination)
@@ -183,17 +236,13 @@ TEST(cancel_timer_before_termination)
     timer_proc->Disable();
 }
 
-TEST(cancel_in_handler)
+TEST_FIXTURE(Virtual_time, cancel_in_handler)
 {
-    Timer_processor::Ptr timer_proc = Timer_processor::Create();
-    timer_proc->Enable();
-
-    auto worker = Request_worker::Create("UT timer cancel_in_handler");
-    worker->Enable();
-
     Timer_processor::Timer::Ptr timer;
+    int count = 0;
     auto handler = [&]()
         {
+            count++;
             timer->Cancel();
             timer = nullptr;
             return true;
@@ -201,11 +250,11 @@ TEST(cancel_in_handler)
     timer = timer_proc->Create_timer(
             std::chrono::milliseconds(100),
             Make_callback(handler),
-            worker);
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-
-    worker->Disable();
-    timer_proc->Disable();
+            ctx);
+    clock->Advance(std::chrono::milliseconds(100));
+    CHECK(Process_until(ctx, [&]() { return !timer; }));
+    CHECK(Advance(std::chrono::seconds(1)));
+    CHECK_EQUAL(1, count);
 }
 
 /* This test tries to reproduce the race condition situation when timer B is
@@ -332,3 +381,92 @@ TEST(cancel_race)
         LOG_INFO("Iteration done.");
     }
 }
+
+TEST(virtual_clock_advance)
+{
+    auto clock = Virtual_clock::Create();
+    Clock::Set_current(clock);
+
+    Timer_processor::Ptr timer_proc = Timer_processor::Create();
+    timer_proc->Enable();
+    /* Handlers are executed only when the test processes the context. */
+    auto ctx = Request_completion_context::Create("UT virtual_clock_advance");
+    ctx->Enable();
+
+    int count = 0;
+    auto timer = timer_proc->Create_timer(
+        std::chrono::seconds(10),
+        Make_callback([&]() { return ++count < 3; }),
+        ctx);
+    /* Fires just before the tested timer, timers are fired in order. */
+    bool before = false;
+    timer_proc->Create_timer(
+        std::chrono::milliseconds(9999),
+        Make_callback([&]() { before = true; return false; }),
+        ctx);
+
+    clock->Advance(std::chrono::milliseconds(9999));
+    CHECK(Process_until(ctx, [&]() { return before; }));
+    CHECK_EQUAL(0, count);
+
+    clock->Advance(std::chrono::milliseconds(1));
+    CHECK(Process_until(ctx, [&]() { return count == 1; }));
+
+    /* Next periods are counted from the scheduled fire time. */
+    CHECK(timer->Get_fire_time() == clock->Get_time() + std::chrono::seconds(10));
+    clock->Advance(std::chrono::seconds(10));
+    CHECK(Process_until(ctx, [&]() { return count == 2; }));
+    clock->Advance(std::chrono::seconds(10));
+    CHECK(Process_until(ctx, [&]() { return count == 3; }));
+    CHECK(!timer->Is_running());
+
+    ctx->Disable();
+    timer_proc->Disable();
+    Clock::Set_current(nullptr);
+}
+
+/* Timer less than a millisecond ahead is not fired early. */
+TEST_FIXTURE(Virtual_time, virtual_clock_sub_millisecond)
+{
+    int count = 0;
+    timer_proc->Create_timer(
+        std::chrono::milliseconds(10),
+        Make_callback([&]() { count++; return false; }),
+        ctx);
+
+    CHECK(Advance(std::chrono::milliseconds(9)));
+    clock->Advance(std::chrono::microseconds(500));
+    ctx->Get_waiter()->Wait_and_process({ctx}, std::chrono::milliseconds(100));
+    CHECK_EQUAL(0, count);
+
+    clock->Advance(std::chrono::microseconds(500));
+    CHECK(Process_until(ctx, [&]() { return count == 1; }));
+}
+
+TEST(virtual_clock_free_running)
+{
+    auto clock = Virtual_clock::Create();
+    auto start = clock->Get_time();
+    clock->Set_free_running(true);
+    Clock::Set_current(clock);
+
+    Timer_processor::Ptr timer_proc = Timer_processor::Create();
+    timer_proc->Enable();
+    auto ctx = Request_completion_context::Create("UT virtual_clock_free_running");
+    ctx->Enable();
+
+    int count = 0;
+    auto timer = timer_proc->Create_timer(
+        std::chrono::hours(1),
+        Make_callback([&]() { return ++count < 5; }),
+        ctx);
+
+    /* Five hours of virtual time pass in no time. */
+    CHECK(Process_until(ctx, [&]() { return !timer->Is_running(); }));
+    CHECK_EQUAL(5, count);
+    CHECK(clock->Get_time() - start >= std::chrono::hours(5));
+
+    ctx->Disable();
+    timer_proc->Disable();
+    Clock::Set_current(nullptr);
+}
@@ -10,6 +10,8 @@
 
 #include <UnitTest++.h>
 
+#include <future>
+
 using namespace ugcs::vsm;
 
 
@@ -104,6 +106,16 @@ TEST(basic_usage)
     v->Register();
     CHECK_EQUAL(10, v->some_prop);
 
+    // Telemetry history memory is bounded per device.
+    v->Set_history_budget(100 * Property_history::SAMPLE_SIZE);
+    auto f1 = Property::Create(1000, "history1", Property::VALUE_TYPE_DOUBLE);
+    auto f2 = Property::Create(1001, "history2", Property::VALUE_TYPE_DOUBLE);
+    CHECK_EQUAL(60u, v->Enable_telemetry_history(f1, 60));
+    CHECK_EQUAL(40u, v->Enable_telemetry_history(f2, 60));
+    CHECK_EQUAL(10u, v->Enable_telemetry_history(f1, 10));
+    CHECK_EQUAL(90u, v->Enable_telemetry_history(f2, 200));
+    CHECK_EQUAL(90u, f2->Get_history()->Get_capacity());
+
     Socket_processor::Ptr sp = ugcs::vsm::Socket_processor::Get_instance();
 
     // Wait for ucs listener to appear.
@@ -157,3 +169,192 @@ TEST(basic_usage)
     ugcs::vsm::Terminate();
 }
 
+
+class Order_vehicle: public Vehicle
+{
+    DEFINE_COMMON_CLASS(Order_vehicle, Vehicle)
+public:
+    std::promise<void> start;
+    std::shared_future<void> started = start.get_future().share();
+    std::promise<void> enter;
+    std::vector<int> handled;
+
+    std::vector<int>
+    Get_command_ids()
+    {
+        return {c_takeoff_command->Get_id(), c_mission_upload->Get_id(),
+                c_arm->Get_id(), c_rth->Get_id(), c_emergency_land->Get_id(),
+                c_waypoint->Get_id()};
+    }
+
+protected:
+    void
+    Handle_ucs_command(Ucs_request::Ptr request) override
+    {
+        if (handled.empty()) {
+            enter.set_value();
+        }
+        started.wait();
+        for (auto &cmd : request->request.device_commands()) {
+            handled.push_back(static_cast<int>(cmd.command_id()));
+        }
+        request->Complete(proto::STATUS_OK);
+    }
+};
+
+/* Commands are handled in the order they were received, so dependent
+ * commands are never reordered. Only requests carrying nothing but emergency
+ * commands preempt the queued ones.
+ */
+TEST(command_order)
+{
+    auto v = Order_vehicle::Create();
+    v->Enable();
+
+    auto Send = [&](std::vector<int> ids) {
+        proto::Vsm_message msg;
+        msg.set_device_id(1);
+        for (auto id : ids) {
+            msg.add_device_commands()->set_command_id(id);
+        }
+        v->On_ucs_message(std::move(msg));
+    };
+    auto ids = v->Get_command_ids();
+    /* Request being handled is not preempted. */
+    auto entered = v->enter.get_future();
+    Send({ids[0]});
+    entered.wait();
+    /* Others are queued while the first one is being handled. */
+    for (size_t i = 1; i < ids.size(); i++) {
+        Send({ids[i]});
+    }
+    /* Request with a regular command is not preemptive. */
+    Send({ids[2], ids[3]});
+    v->start.set_value();
+    v->Disable();
+
+    std::vector<int> expected = {ids[0], ids[3], ids[4], ids[1], ids[2], ids[5],
+                                 ids[2], ids[3]};
+    CHECK(expected == v->handled);
+}
+
+class Mission_vehicle: public Vehicle
+{
+    DEFINE_COMMON_CLASS(Mission_vehicle, Vehicle)
+public:
+    /** Result of the next mission upload. */
+    bool succeed = true;
+    /** Last uploaded task. */
+    Task task;
+
+    /** Build mission with wait items of the specified durations. */
+    proto::Vsm_message
+    Make_mission(float altitude_origin, std::vector<float> waits)
+    {
+        proto::Vsm_message msg;
+        msg.set_device_id(1);
+        auto mission = msg.add_device_commands();
+        mission->set_command_id(c_mission_upload->Get_id());
+        /* Other mission parameters are not specified. */
+        Property_list params;
+        for (auto name : {"name", "safe_altitude", "rth_wait_altitude", "rc_loss_action",
+                          "gps_loss_action", "low_battery_action", "rth_action"}) {
+            params.emplace(name, Property::Create(0, name, Property::VALUE_TYPE_FLOAT));
+        }
+        params.emplace("altitude_origin", Property::Create("altitude_origin", altitude_origin));
+        c_mission_upload->Build_command(mission, params);
+        for (auto wait : waits) {
+            auto item = mission->add_sub_commands();
+            item->set_command_id(c_wait->Get_id());
+            params.clear();
+            params.emplace("time", Property::Create("time", wait));
+            c_wait->Build_command(item, params);
+        }
+        return msg;
+    }
+
+protected:
+    void
+    Handle_vehicle_request(Vehicle_task_request::Handle request) override
+    {
+        task = *request;
+        if (succeed) {
+            request.Succeed();
+        } else {
+            request.Fail();
+        }
+    }
+};
+
+/* Mission is diffed against the last successfully uploaded one. */
+TEST(mission_baseline)
+{
+    auto v = Mission_vehicle::Create();
+    v->Enable();
+    auto ctx = Request_completion_context::Create("Mission test completion");
+    auto worker = Request_worker::Create("Mission test worker",
+        std::initializer_list<Request_container::Ptr>({ctx}));
+    ctx->Enable();
+    worker->Enable();
+
+    auto upload = [&](proto::Vsm_message msg, bool succeed)
+    {
+        v->succeed = succeed;
+        std::promise<proto::Status_code> done;
+        v->On_ucs_message(
+            std::move(msg),
+            Make_callback(
+                [&](uint32_t, Proto_msg_ptr response)
+                {
+                    done.set_value(response->device_response().code());
+                },
+                0u,
+                std::make_shared<proto::Vsm_message>()),
+            ctx);
+        return done.get_future().get();
+    };
+
+    /* Previous mission is not known. */
+    CHECK_EQUAL(proto::STATUS_OK, upload(v->Make_mission(100, {1, 2, 3}), true));
+    CHECK(!v->task.Is_incremental());
+    CHECK_EQUAL(3u, v->task.actions.size());
+    auto first = v->task.actions;
+
+    /* Unchanged mission reuses copies of the converted actions. */
+    CHECK_EQUAL(proto::STATUS_OK, upload(v->Make_mission(100, {1, 2, 3}), true));
+    CHECK(v->task.Is_incremental());
+    CHECK(v->task.Get_changed_items().empty());
+    CHECK_EQUAL(3u, v->task.actions.size());
+    for (size_t i = 0; i < first.size(); i++) {
+        CHECK(first[i] != v->task.actions[i]);
+        CHECK(Action::Type::WAIT == v->task.actions[i]->Get_type());
+        CHECK_EQUAL(static_cast<int>(i), v->task.actions[i]->command_id);
+    }
+    /* Modification by the VSM does not affect the next upload. */
+    v->task.actions[0]->Get_action<Action::Type::WAIT>()->wait_time = 10;
+    first[1]->Get_action<Action::Type::WAIT>()->wait_time = 20;
+
+    /* Failed upload is diffed but clears the baseline. */
+    CHECK_EQUAL(proto::STATUS_FAILED, upload(v->Make_mission(100, {1, 5, 3}), false));
+    CHECK(v->task.Is_incremental());
+    auto ranges = v->task.Get_changed_items();
+    CHECK_EQUAL(1u, ranges.size());
+    CHECK_EQUAL(1u, ranges[0].first);
+    CHECK_EQUAL(1u, ranges[0].count);
+    CHECK_CLOSE(1, v->task.actions[0]->Get_action<Action::Type::WAIT>()->wait_time, 0.001);
+    CHECK_CLOSE(5, v->task.actions[1]->Get_action<Action::Type::WAIT>()->wait_time, 0.001);
+
+    CHECK_EQUAL(proto::STATUS_OK, upload(v->Make_mission(100, {1, 2, 3}), true));
+    CHECK(!v->task.Is_incremental());
+
+    /* Changed mission parameters force full upload. */
+    CHECK_EQUAL(proto::STATUS_OK, upload(v->Make_mission(200, {1, 2, 3}), true));
+    CHECK(!v->task.Is_incremental());
+    CHECK_EQUAL(1u, v->task.Get_changed_items().size());
+    CHECK_EQUAL(proto::STATUS_OK, upload(v->Make_mission(200, {1, 2, 3}), true));
+    CHECK(v->task.Is_incremental());
+
+    v->Disable();
+    worker->Disable();
+    ctx->Disable();
+}
@@ -108,3 +108,71 @@ TEST(vehicle_request_handle_copy_and_payload_access)
 
     comp_ctx->Disable();
 }
+
+/* Item hashes with the specified first byte. */
+static std::vector<Task::Item_hash>
+Hashes(std::initializer_list<uint8_t> values)
+{
+    std::vector<Task::Item_hash> hashes;
+    for (auto value : values) {
+        Task::Item_hash hash = {};
+        hash[0] = value;
+        hashes.push_back(hash);
+    }
+    return hashes;
+}
+
+TEST(task_changed_items)
+{
+    Task task;
+    /* Previous mission is not known. */
+    task.item_hashes = Hashes({1, 2, 3, 4, 5, 6});
+    CHECK(!task.Is_incremental());
+    auto ranges = task.Get_changed_items();
+    CHECK_EQUAL(1u, ranges.size());
+    CHECK_EQUAL(0u, ranges[0].first);
+    CHECK_EQUAL(6u, ranges[0].count);
+
+    /* Not changed. */
+    task.previous_item_hashes = task.item_hashes;
+    CHECK(task.Is_incremental());
+    CHECK(task.Get_changed_items().empty());
+
+    /* Modified in place. */
+    task.item_hashes = Hashes({1, 20, 30, 4, 50, 6});
+    ranges = task.Get_changed_items();
+    CHECK_EQUAL(2u, ranges.size());
+    CHECK_EQUAL(1u, ranges[0].first);
+    CHECK_EQUAL(2u, ranges[0].count);
+    CHECK_EQUAL(4u, ranges[1].first);
+    CHECK_EQUAL(1u, ranges[1].count);
+
+    /* Inserted. */
+    task.item_hashes = Hashes({1, 2, 7, 8, 3, 4, 5, 6});
+    ranges = task.Get_changed_items();
+    CHECK_EQUAL(1u, ranges.size());
+    CHECK_EQUAL(2u, ranges[0].first);
+    CHECK_EQUAL(2u, ranges[0].count);
+
+    /* Removed. */
+    task.item_hashes = Hashes({1, 2, 5, 6});
+    ranges = task.Get_changed_items();
+    CHECK_EQUAL(1u, ranges.size());
+    CHECK_EQUAL(2u, ranges[0].first);
+    CHECK_EQUAL(0u, ranges[0].count);
+
+    /* Truncated. */
+    task.item_hashes = Hashes({1, 2, 3});
+    ranges = task.Get_changed_items();
+    CHECK_EQUAL(1u, ranges.size());
+    CHECK_EQUAL(3u, ranges[0].first);
+    CHECK_EQUAL(0u, ranges[0].count);
+
+    /* Repeated items. */
+    task.previous_item_hashes = Hashes({1, 1, 1});
+    task.item_hashes = Hashes({1, 1, 1, 1});
+    ranges = task.Get_changed_items();
+    CHECK_EQUAL(1u, ranges.size());
+    CHECK_EQUAL(3u, ranges[0].first);
+    CHECK_EQUAL(1u, ranges[0].count);
+}